@@ -9,6 +9,9 @@
 #include "Voodoo80211Device.h"
 #include <libkern/c++/OSString.h>
 #include <IOKit/IOLib.h>
+#include <kern/clock.h>
+#include <sys/sysctl.h>
+#include <sys/kauth.h>
 
 OSDefineMetaClassAndStructors(Voodoo80211Device, IO80211Controller)
 OSDefineMetaClassAndStructors(VoodooTimeout, OSObject)
@@ -71,6 +74,7 @@ bool Voodoo80211Device::start(IOService* provider) {
 	if (device_attach(&fAttachArgs) == false)
 		return false;
 	
+	sysctlRegister();
 	registerService();
 	IOLog("Starting\n");
 	return true;
@@ -78,6 +82,7 @@ bool Voodoo80211Device::start(IOService* provider) {
 
 void Voodoo80211Device::stop(IOService* provider) {
 	IOLog("Stopping\n");
+	sysctlUnregister();
 	device_detach(0);
     
     //If debug flag set print the reference counts of the objects left before we release them
@@ -169,6 +174,370 @@ void Voodoo80211Device::wakeupOn(void* ident) {
 		fCommandGate->commandWakeup(ident);
 }
 
+#pragma mark -
+#pragma mark RX latency probes
+/*
+ * Each probe only touches the timestamps of the probes next to it, which
+ * works because a frame goes through the RX path on the workloop in one go.
+ * A stamp is consumed by the probe after it so frames that enter the stack
+ * some other way (reordered, injected) are not measured from a stale stamp.
+ */
+void Voodoo80211Device::latencyProbe(int probe) {
+	u_int64_t now;
+	
+	clock_get_uptime(&now);
+	switch (probe) {
+		case VOODOO80211_PROBE_INTR:
+			fLatStamp[VOODOO80211_PROBE_INTR] = now;
+			break;
+			
+		case VOODOO80211_PROBE_RXDESC:
+			if (fLatStamp[VOODOO80211_PROBE_INTR])
+				latencyRecord(VOODOO80211_LAT_INTR_RXDESC, now - fLatStamp[VOODOO80211_PROBE_INTR]);
+			fLatStamp[VOODOO80211_PROBE_RXDESC] = now;
+			break;
+			
+		case VOODOO80211_PROBE_INPUT:
+			fLatStamp[VOODOO80211_PROBE_INPUT] = 0;
+			if (fLatStamp[VOODOO80211_PROBE_RXDESC] == 0)
+				break;
+			latencyRecord(VOODOO80211_LAT_RXDESC_INPUT, now - fLatStamp[VOODOO80211_PROBE_RXDESC]);
+			fLatStamp[VOODOO80211_PROBE_RXDESC] = 0;
+			fLatStamp[VOODOO80211_PROBE_INPUT] = now;
+			break;
+			
+		case VOODOO80211_PROBE_DELIVER:
+			if (fLatStamp[VOODOO80211_PROBE_INPUT] == 0)
+				break;
+			latencyRecord(VOODOO80211_LAT_INPUT_DELIVER, now - fLatStamp[VOODOO80211_PROBE_INPUT]);
+			if (fLatStamp[VOODOO80211_PROBE_INTR])
+				latencyRecord(VOODOO80211_LAT_INTR_DELIVER, now - fLatStamp[VOODOO80211_PROBE_INTR]);
+			fLatStamp[VOODOO80211_PROBE_INPUT] = 0;
+			break;
+	}
+}
+
+static inline u_int32_t latencyBucket(u_int64_t ns) {
+	int msb;
+	u_int32_t bucket;
+	
+	if (ns < (1 << VOODOO80211_LAT_SUB_BITS))
+		return (u_int32_t)ns;
+	msb = 63 - __builtin_clzll(ns);
+	bucket = ((msb - VOODOO80211_LAT_SUB_BITS + 1) << VOODOO80211_LAT_SUB_BITS) |
+		((ns >> (msb - VOODOO80211_LAT_SUB_BITS)) & ((1 << VOODOO80211_LAT_SUB_BITS) - 1));
+	if (bucket >= VOODOO80211_LAT_BUCKETS)
+		bucket = VOODOO80211_LAT_BUCKETS - 1;
+	return bucket;
+}
+
+void Voodoo80211Device::latencyRecord(int hist, u_int64_t elapsed) {
+	struct voodoo80211_latency_hist* h = &fLatency[hist];
+	u_int64_t ns;
+	
+	absolutetime_to_nanoseconds(elapsed, &ns);
+	h->count++;
+	h->sum_ns += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+	h->buckets[latencyBucket(ns)]++;
+}
+
+/*
+ * The histograms are updated on the work loop, so they are read and
+ * cleared through the command gate to get a consistent copy.  arg0 is
+ * the buffer to fill, or NULL to reset.
+ */
+IOReturn Voodoo80211Device::latencyAction(OSObject* owner, void* arg0, void* arg1, void* arg2, void* arg3) {
+	Voodoo80211Device* dev = OSDynamicCast(Voodoo80211Device, owner);
+	struct voodoo80211_latency_data* data = (struct voodoo80211_latency_data*)arg0;
+	
+	if (dev == 0)
+		return kIOReturnError;
+	if (data == NULL) {
+		bzero(dev->fLatency, sizeof(dev->fLatency));
+		return kIOReturnSuccess;
+	}
+	data->nhist = VOODOO80211_LAT_COUNT;
+	data->sub_bits = VOODOO80211_LAT_SUB_BITS;
+	data->nbuckets = VOODOO80211_LAT_BUCKETS;
+	bcopy(dev->fLatency, data->hist, sizeof(dev->fLatency));
+	return kIOReturnSuccess;
+}
+
+#pragma mark -
+#pragma mark Debug sysctls
+/*
+ * The first device to start owns the debug.voodoo80211 node.  Handlers
+ * run on whatever thread called sysctl, so they count themselves in
+ * sysctlUsers before looking at the device and stop waits for them to
+ * leave once the device is gone.
+ */
+static Voodoo80211Device* sysctlDevice;
+static volatile SInt32 sysctlUsers;
+
+SYSCTL_NODE(_debug, OID_AUTO, voodoo80211, CTLFLAG_RW | CTLFLAG_LOCKED, 0, "Voodoo80211 debugging");
+SYSCTL_PROC(_debug_voodoo80211, OID_AUTO, hw_stats, CTLTYPE_OPAQUE | CTLFLAG_RD | CTLFLAG_LOCKED,
+    0, 0, Voodoo80211Device::sysctlHwStats, "S,voodoo80211_hw_stats_data", "Driver hardware counters");
+SYSCTL_PROC(_debug_voodoo80211, OID_AUTO, latency, CTLTYPE_OPAQUE | CTLFLAG_RD | CTLFLAG_LOCKED,
+    0, 0, Voodoo80211Device::sysctlLatency, "S,voodoo80211_latency_data", "RX path latency histograms");
+SYSCTL_PROC(_debug_voodoo80211, OID_AUTO, latency_reset, CTLTYPE_INT | CTLFLAG_RW | CTLFLAG_LOCKED,
+    0, 0, Voodoo80211Device::sysctlLatencyReset, "I", "Write 1 to clear the latency histograms");
+SYSCTL_PROC(_debug_voodoo80211, OID_AUTO, fw_dump, CTLTYPE_OPAQUE | CTLFLAG_RW | CTLFLAG_LOCKED,
+    0, 0, Voodoo80211Device::sysctlFwDump, "S,voodoo80211_fw_dump_header", "Captured firmware error dumps");
+SYSCTL_PROC(_debug_voodoo80211, OID_AUTO, mmio_trace, CTLTYPE_OPAQUE | CTLFLAG_RW | CTLFLAG_LOCKED,
+    0, 0, Voodoo80211Device::sysctlMMIOTrace, "S", "Recorded or replayed register access trace");
+
+static struct sysctl_oid* sysctlOids[] = {
+	&sysctl__debug_voodoo80211,
+	&sysctl__debug_voodoo80211_hw_stats,
+	&sysctl__debug_voodoo80211_latency,
+	&sysctl__debug_voodoo80211_latency_reset,
+	&sysctl__debug_voodoo80211_fw_dump,
+	&sysctl__debug_voodoo80211_mmio_trace,
+};
+
+void Voodoo80211Device::sysctlRegister() {
+	if (!OSCompareAndSwapPtr(NULL, this, (void* volatile*)&sysctlDevice))
+		return;
+	for (size_t i = 0; i < sizeof(sysctlOids) / sizeof(sysctlOids[0]); i++)
+		sysctl_register_oid(sysctlOids[i]);
+}
+
+void Voodoo80211Device::sysctlUnregister() {
+	if (sysctlDevice != this)
+		return;
+	for (size_t i = sizeof(sysctlOids) / sizeof(sysctlOids[0]); i > 0; i--)
+		sysctl_unregister_oid(sysctlOids[i - 1]);
+	__atomic_store_n(&sysctlDevice, (Voodoo80211Device*)NULL, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&sysctlUsers, __ATOMIC_SEQ_CST))
+		IOSleep(1);
+}
+
+Voodoo80211Device* Voodoo80211Device::sysctlEnter() {
+	Voodoo80211Device* dev;
+	
+	__atomic_fetch_add(&sysctlUsers, 1, __ATOMIC_SEQ_CST);
+	dev = __atomic_load_n(&sysctlDevice, __ATOMIC_SEQ_CST);
+	if (dev == NULL)
+		sysctlExit();
+	return dev;
+}
+
+void Voodoo80211Device::sysctlExit() {
+	__atomic_fetch_sub(&sysctlUsers, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * xnu only asks for root to write a node.  The nodes expose firmware
+ * memory and driver internals, so reading them needs root as well.
+ */
+static int sysctlPrivileged() {
+	return kauth_cred_issuser(kauth_cred_get()) ? 0 : EPERM;
+}
+
+int Voodoo80211Device::sysctlHwStats(struct sysctl_oid* oidp, void* arg1, int arg2, struct sysctl_req* req) {
+	struct voodoo80211_hw_stats_data data;
+	Voodoo80211Device* dev;
+	IOReturn ret;
+	int error;
+	
+	if ((error = sysctlPrivileged()))
+		return error;
+	if (req->newptr != USER_ADDR_NULL)
+		return EPERM;
+	if ((dev = sysctlEnter()) == NULL)
+		return ENODEV;
+	bzero(&data, sizeof(data));
+	data.version = VOODOO80211_SYSCTL_VERSION;
+	ret = dev->device_hw_stats(&data);
+	sysctlExit();
+	if (ret != kIOReturnSuccess)
+		return ENOTSUP;
+	return SYSCTL_OUT(req, &data, sizeof(data));
+}
+
+int Voodoo80211Device::sysctlLatency(struct sysctl_oid* oidp, void* arg1, int arg2, struct sysctl_req* req) {
+	struct voodoo80211_latency_data* data;
+	Voodoo80211Device* dev;
+	IOReturn ret;
+	int error;
+	
+	if ((error = sysctlPrivileged()))
+		return error;
+	if (req->newptr != USER_ADDR_NULL)
+		return EPERM;
+	/* Only report the size, nothing to copy */
+	if (req->oldptr == USER_ADDR_NULL)
+		return SYSCTL_OUT(req, NULL, sizeof(*data));
+	/* A few KB, too big for the kernel stack */
+	data = (struct voodoo80211_latency_data*)IOMalloc(sizeof(*data));
+	if (data == NULL)
+		return ENOMEM;
+	bzero(data, sizeof(*data));
+	data->version = VOODOO80211_SYSCTL_VERSION;
+	if ((dev = sysctlEnter()) == NULL) {
+		IOFree(data, sizeof(*data));
+		return ENODEV;
+	}
+	ret = dev->fCommandGate->runAction(latencyAction, data);
+	sysctlExit();
+	error = ret == kIOReturnSuccess ? SYSCTL_OUT(req, data, sizeof(*data)) : EIO;
+	IOFree(data, sizeof(*data));
+	return error;
+}
+
+int Voodoo80211Device::sysctlLatencyReset(struct sysctl_oid* oidp, void* arg1, int arg2, struct sysctl_req* req) {
+	Voodoo80211Device* dev;
+	int reset = 0;
+	int error;
+	
+	if ((error = sysctlPrivileged()))
+		return error;
+	error = sysctl_handle_int(oidp, &reset, 0, req);
+	if (error || req->newptr == USER_ADDR_NULL)
+		return error;
+	if (reset != 1)
+		return EINVAL;
+	if ((dev = sysctlEnter()) == NULL)
+		return ENODEV;
+	if (dev->fCommandGate->runAction(latencyAction, NULL) != kIOReturnSuccess)
+		error = EIO;
+	sysctlExit();
+	return error;
+}
+
+static int fwDumpCopyout(void* ctx, const struct voodoo80211_fw_dump_header* header, const void* data) {
+	struct sysctl_req* req = (struct sysctl_req*)ctx;
+	int error;
+	
+	if (header->len > VOODOO80211_FW_DUMP_MAX)
+		return EIO;
+	if ((error = SYSCTL_OUT(req, header, sizeof(*header))))
+		return error;
+	return SYSCTL_OUT(req, data, header->len);
+}
+
+int Voodoo80211Device::sysctlFwDump(struct sysctl_oid* oidp, void* arg1, int arg2, struct sysctl_req* req) {
+	struct voodoo80211_fw_dump_header header;
+	Voodoo80211Device* dev;
+	u_int32_t index = 0;
+	int error;
+	
+	if ((error = sysctlPrivileged()))
+		return error;
+	/* Only report the largest size, nothing to copy */
+	if (req->oldptr == USER_ADDR_NULL)
+		return SYSCTL_OUT(req, NULL, sizeof(header) + VOODOO80211_FW_DUMP_MAX);
+	if (req->newptr != USER_ADDR_NULL) {
+		if (req->newlen != sizeof(index))
+			return EINVAL;
+		if ((error = SYSCTL_IN(req, &index, sizeof(index))))
+			return error;
+	}
+	if ((dev = sysctlEnter()) == NULL)
+		return ENODEV;
+	bzero(&header, sizeof(header));
+	header.version = VOODOO80211_SYSCTL_VERSION;
+	header.index = index;
+	error = dev->device_fw_dump(&header, fwDumpCopyout, req);
+	sysctlExit();
+	return error;
+}
+
+IOReturn Voodoo80211Device::mmioTraceSizeAction(OSObject* owner, void* arg0, void* arg1, void* arg2, void* arg3) {
+	Voodoo80211Device* dev = OSDynamicCast(Voodoo80211Device, owner);
+	
+	if (dev == 0)
+		return kIOReturnError;
+	*(size_t*)arg0 = dev->device_mmio_trace_size();
+	return kIOReturnSuccess;
+}
+
+IOReturn Voodoo80211Device::mmioTraceSaveAction(OSObject* owner, void* arg0, void* arg1, void* arg2, void* arg3) {
+	Voodoo80211Device* dev = OSDynamicCast(Voodoo80211Device, owner);
+	
+	if (dev == 0)
+		return kIOReturnError;
+	*(size_t*)arg2 = dev->device_mmio_trace_save(arg0, (size_t)arg1);
+	return kIOReturnSuccess;
+}
+
+IOReturn Voodoo80211Device::mmioTraceLoadAction(OSObject* owner, void* arg0, void* arg1, void* arg2, void* arg3) {
+	Voodoo80211Device* dev = OSDynamicCast(Voodoo80211Device, owner);
+	
+	if (dev == 0)
+		return kIOReturnError;
+	*(int*)arg2 = dev->device_mmio_trace_load(arg0, (size_t)arg1);
+	return kIOReturnSuccess;
+}
+
+/*
+ * Reading saves the recorded trace, the newest entries if the buffer is
+ * short.  Writing loads a trace to replay.  Traces run to hundreds of KB
+ * so they are staged in a kernel buffer.  The trace is sized and saved on
+ * the gate so the work loop does not add to it in between, and copied out
+ * after leaving the gate.
+ */
+int Voodoo80211Device::sysctlMMIOTrace(struct sysctl_oid* oidp, void* arg1, int arg2, struct sysctl_req* req) {
+	Voodoo80211Device* dev;
+	void* buffer;
+	size_t size, saved;
+	int error = 0;
+	
+	if ((error = sysctlPrivileged()))
+		return error;
+	if ((dev = sysctlEnter()) == NULL)
+		return ENODEV;
+	if (req->newptr != USER_ADDR_NULL) {
+		size = req->newlen;
+		if (size == 0 || size > VOODOO80211_MMIO_TRACE_MAX) {
+			error = EINVAL;
+			goto out;
+		}
+		if ((buffer = IOMalloc(size)) == NULL) {
+			error = ENOMEM;
+			goto out;
+		}
+		if ((error = SYSCTL_IN(req, buffer, size)) == 0 &&
+		    dev->fCommandGate->runAction(mmioTraceLoadAction, buffer, (void*)size, &error) != kIOReturnSuccess)
+			error = EIO;
+		IOFree(buffer, size);
+		goto out;
+	}
+	
+	if (dev->fCommandGate->runAction(mmioTraceSizeAction, &size) != kIOReturnSuccess) {
+		error = EIO;
+		goto out;
+	}
+	if (size == 0) {
+		error = ENOTSUP;
+		goto out;
+	}
+	/* Only report the size, nothing to copy */
+	if (req->oldptr == USER_ADDR_NULL) {
+		error = SYSCTL_OUT(req, NULL, size);
+		goto out;
+	}
+	if (size > req->oldlen)
+		size = req->oldlen;
+	if ((buffer = IOMalloc(size)) == NULL) {
+		error = ENOMEM;
+		goto out;
+	}
+	/* Zero if the buffer is too short for the header */
+	if (dev->fCommandGate->runAction(mmioTraceSaveAction, buffer, (void*)size, &saved) != kIOReturnSuccess)
+		error = EIO;
+	else if (saved == 0)
+		error = ENOMEM;
+	else
+		error = SYSCTL_OUT(req, buffer, saved);
+	IOFree(buffer, size);
+out:
+	sysctlExit();
+	return error;
+}
+
 #pragma mark -
 #pragma mark Apple IOCTL
 SInt32 Voodoo80211Device::apple80211Request( UInt32 type, int req, IO80211Interface * intf, void * data ) {
@@ -239,6 +608,26 @@ Voodoo80211Device::apple80211Request_SET
 			ic->ic_des_esslen = got->ad_ssid_len;
 			memcpy(ic->ic_des_essid, got->ad_ssid, got->ad_ssid_len);
 			DPRINTF(("Setting desired ESSID to %s\n", ic->ic_des_essid));
+			if (got->ad_key.key_cipher_type == APPLE80211_CIPHER_PMK ||
+			    got->ad_key.key_cipher_type == VOODOO80211_CIPHER_PASSPHRASE) {
+				/* the cipher type says what the key is, never its length */
+				int format = got->ad_key.key_cipher_type == APPLE80211_CIPHER_PMK ?
+				    IEEE80211_PSK_PMK : IEEE80211_PSK_PASSPHRASE;
+				if (got->ad_key.key_len > APPLE80211_KEY_BUFF_LEN)
+					return kIOReturnInvalid;
+				switch (ieee80211_psk_key(format, got->ad_key.key, got->ad_key.key_len, ic->ic_psk)) {
+				case 0:
+					break;
+				case 1:
+					if (ieee80211_passphrase_to_pmk(ic, got->ad_ssid, got->ad_ssid_len,
+					    (const char *)got->ad_key.key, got->ad_key.key_len, ic->ic_psk) != 0)
+						return kIOReturnInvalid;
+					break;
+				default:
+					return kIOReturnInvalid;
+				}
+				ic->ic_flags |= IEEE80211_F_PSK;
+			}
 			device_netreset();
 			return kIOReturnSuccess;
 			// TODO: prefer BSSID if it's specified, and >>set crypto keys<<
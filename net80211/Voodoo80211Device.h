@@ -44,6 +44,90 @@ struct ExtraMbufParams {
 
 const ExtraMbufParams ieee80211_is_mgmt_frame = { true };
 
+struct sysctl_oid;
+struct sysctl_req;
+
+// Private debugging interface, sysctls under debug.voodoo80211. Every node copies
+// a fixed size structure with SYSCTL_OUT so readers get the length checked
+#define VOODOO80211_SYSCTL_VERSION	1
+
+// key_cipher_type of an APPLE80211_IOC_ASSOCIATE key holding a WPA passphrase instead of
+// the PMK airportd passes as APPLE80211_CIPHER_PMK. The passphrase is not NUL terminated,
+// so up to APPLE80211_KEY_BUFF_LEN characters fit
+#define VOODOO80211_CIPHER_PASSPHRASE	0x100
+
+// Driver hardware counters, read from debug.voodoo80211.hw_stats
+#define VOODOO80211_HW_STATS_MAX	32
+
+struct voodoo80211_hw_stats_data {
+	u_int32_t	version;
+	u_int32_t	count;		// number of valid entries in counters
+	u_int64_t	counters[VOODOO80211_HW_STATS_MAX];
+};
+
+// RX path probe points, see latencyProbe()
+enum {
+	VOODOO80211_PROBE_INTR,		// interrupt handler entered
+	VOODOO80211_PROBE_RXDESC,	// driver picked a frame off the RX ring
+	VOODOO80211_PROBE_INPUT,	// frame handed to ieee80211_input
+	VOODOO80211_PROBE_DELIVER,	// data frame handed to the interface
+	VOODOO80211_PROBE_COUNT
+};
+
+// Latency histograms kept between the probe points
+enum {
+	VOODOO80211_LAT_INTR_RXDESC,
+	VOODOO80211_LAT_RXDESC_INPUT,
+	VOODOO80211_LAT_INPUT_DELIVER,
+	VOODOO80211_LAT_INTR_DELIVER,	// end to end
+	VOODOO80211_LAT_COUNT
+};
+
+/*
+ * Log-linear (HDR style) buckets over nanoseconds: values below
+ * 2^VOODOO80211_LAT_SUB_BITS get a bucket each, every power of two above
+ * that is split into 2^VOODOO80211_LAT_SUB_BITS linear buckets, so the
+ * error is bounded at 1/8 of the value.  The last bucket also counts
+ * everything above 2^26ns (~67ms).
+ */
+#define VOODOO80211_LAT_SUB_BITS	3
+#define VOODOO80211_LAT_BUCKETS		((26 - VOODOO80211_LAT_SUB_BITS + 1) << VOODOO80211_LAT_SUB_BITS)
+
+struct voodoo80211_latency_hist {
+	u_int64_t	count;
+	u_int64_t	sum_ns;
+	u_int64_t	max_ns;
+	u_int32_t	buckets[VOODOO80211_LAT_BUCKETS];
+};
+
+// Read from debug.voodoo80211.latency, cleared by writing 1 to debug.voodoo80211.latency_reset
+struct voodoo80211_latency_data {
+	u_int32_t	version;
+	u_int32_t	nhist;
+	u_int32_t	sub_bits;
+	u_int32_t	nbuckets;
+	struct voodoo80211_latency_hist	hist[VOODOO80211_LAT_COUNT];
+};
+
+// Captured firmware error dump, read from debug.voodoo80211.fw_dump. The dump to read is
+// picked by writing an int in the same call, 0 (the default) is the newest. The header is
+// followed by len bytes, an iwlwifi dump file for Intel
+#define VOODOO80211_FW_DUMP_MAX	(32 * 1024)
+
+struct voodoo80211_fw_dump_header {
+	u_int32_t	version;
+	u_int32_t	index;		// 0 for the newest dump, 1 for the one before it...
+	u_int32_t	sequence;	// capture number of the dump
+	u_int32_t	len;		// bytes following the header, at most VOODOO80211_FW_DUMP_MAX
+};
+
+// Copies a dump out of the driver, called without any driver lock held
+typedef int (*voodoo80211_fw_dump_copyout)(void* ctx, const struct voodoo80211_fw_dump_header* header, const void* data);
+
+// Register access trace, read from debug.voodoo80211.mmio_trace when the driver records one
+// and written to it to replay. The layout is device specific, struct mmioTraceHeader for Intel
+#define VOODOO80211_MMIO_TRACE_MAX	(1024 * 1024)
+
 class Voodoo80211Device : public IO80211Controller
 {
 	OSDeclareDefaultStructors(Voodoo80211Device)
@@ -73,10 +157,25 @@ public:
 	virtual IOReturn	setMulticastMode	( IOEnetMulticastMode mode );
 	virtual IOReturn	setMulticastList	( IOEthernetAddress* addr, UInt32 len );
 	virtual SInt32		monitorModeSetEnabled	( IO80211Interface * interface, bool enabled, UInt32 dlt );
+#pragma mark Debug sysctl handlers
+	static int		sysctlHwStats		( struct sysctl_oid* oidp, void* arg1, int arg2, struct sysctl_req* req );
+	static int		sysctlLatency		( struct sysctl_oid* oidp, void* arg1, int arg2, struct sysctl_req* req );
+	static int		sysctlLatencyReset	( struct sysctl_oid* oidp, void* arg1, int arg2, struct sysctl_req* req );
+	static int		sysctlFwDump		( struct sysctl_oid* oidp, void* arg1, int arg2, struct sysctl_req* req );
+	static int		sysctlMMIOTrace		( struct sysctl_oid* oidp, void* arg1, int arg2, struct sysctl_req* req );
 	
 private:
 #pragma mark Debuging functions
     void printRefCounts();
+	void	sysctlRegister();
+	void	sysctlUnregister();
+	static Voodoo80211Device*	sysctlEnter();
+	static void	sysctlExit();
+	void	latencyRecord(int hist, u_int64_t elapsed);
+	static IOReturn	latencyAction(OSObject* owner, void* arg0, void* arg1, void* arg2, void* arg3);
+	static IOReturn	mmioTraceSizeAction(OSObject* owner, void* arg0, void* arg1, void* arg2, void* arg3);
+	static IOReturn	mmioTraceSaveAction(OSObject* owner, void* arg0, void* arg1, void* arg2, void* arg3);
+	static IOReturn	mmioTraceLoadAction(OSObject* owner, void* arg0, void* arg1, void* arg2, void* arg3);
     
 #pragma mark Private data
 	IO80211Interface*	fInterface;
@@ -88,6 +187,8 @@ private:
 	struct ieee80211_node*	fNextNodeToSend; // as scan result
 	bool			fScanResultWrapping;
 	IOSimpleLock*	fLock; // for enable()
+	u_int64_t	fLatStamp[VOODOO80211_PROBE_COUNT]; // uptime, 0 if not in flight
+	struct voodoo80211_latency_hist	fLatency[VOODOO80211_LAT_COUNT];
 
 protected:
 #pragma mark Protected data
@@ -114,6 +215,14 @@ protected:
 	virtual int	device_activate(int) { return 1; }
 	virtual void	device_netreset() { return; }
 	virtual bool	device_powered_on() { return false; }
+	virtual IOReturn	device_hw_stats(struct voodoo80211_hw_stats_data*) { return kIOReturnUnsupported; }
+	virtual int	device_fw_dump(struct voodoo80211_fw_dump_header*, voodoo80211_fw_dump_copyout, void*) { return ENOTSUP; }
+	virtual size_t	device_mmio_trace_size() { return 0; }
+	virtual size_t	device_mmio_trace_save(void*, size_t) { return 0; }
+	virtual int	device_mmio_trace_load(const void*, size_t) { return ENOTSUP; }
+	
+#pragma mark Latency probes
+	void	latencyProbe(int probe);
 	
 #pragma mark ieee80211_amrr.h
 	void	ieee80211_amrr_node_init(const struct ieee80211_amrr *, struct ieee80211_amrr_node *);
@@ -195,6 +304,7 @@ protected:
 	void	ieee80211_prf(const u_int8_t *, size_t, const u_int8_t *, size_t, const u_int8_t *, size_t, u_int8_t *, size_t);
 	void	ieee80211_kdf(const u_int8_t *, size_t, const u_int8_t *, size_t, const u_int8_t *, size_t, u_int8_t *, size_t);
 	void	ieee80211_derive_pmkid(enum ieee80211_akm, const u_int8_t *, const u_int8_t *, const u_int8_t *, u_int8_t *);
+	int     ieee80211_passphrase_to_pmk(struct ieee80211com *, const u_int8_t *, u_int, const char *, size_t, u_int8_t *);
 	// header file
 	void	ieee80211_crypto_attach(struct ieee80211com *);
 	void	ieee80211_crypto_detach(struct ieee80211com *);
@@ -209,22 +319,27 @@ protected:
 	int     ieee80211_eapol_key_decrypt(struct ieee80211_eapol_key *, const u_int8_t *);
 	struct	ieee80211_pmk *ieee80211_pmksa_add(struct ieee80211com *, enum ieee80211_akm, const u_int8_t *, const u_int8_t *, u_int32_t);
 	struct	ieee80211_pmk *ieee80211_pmksa_find(struct ieee80211com *, struct ieee80211_node *, const u_int8_t *);
+	void	ieee80211_pmksa_remove(struct ieee80211com *, struct ieee80211_pmk *);
 	void	ieee80211_derive_ptk(enum ieee80211_akm, const u_int8_t *, const u_int8_t *, const u_int8_t *, const u_int8_t *, const u_int8_t *, struct ieee80211_ptk *);
 	int     ieee80211_cipher_keylen(enum ieee80211_cipher);
 	int     ieee80211_wep_set_key(struct ieee80211com *, struct ieee80211_key *) { return 1; }
 	void	ieee80211_wep_delete_key(struct ieee80211com *, struct ieee80211_key *) { return; }
 	mbuf_t	ieee80211_wep_encrypt(struct ieee80211com *, mbuf_t, struct ieee80211_key *) { return 0; }
 	mbuf_t	ieee80211_wep_decrypt(struct ieee80211com *, mbuf_t, struct ieee80211_key *) { return 0; }
-	int     ieee80211_tkip_set_key(struct ieee80211com *, struct ieee80211_key *) { return 1; }
-	void	ieee80211_tkip_delete_key(struct ieee80211com *, struct ieee80211_key *) { return; }
-	mbuf_t	ieee80211_tkip_encrypt(struct ieee80211com *, mbuf_t, struct ieee80211_key *) { return 0; }
-	mbuf_t	ieee80211_tkip_decrypt(struct ieee80211com *, mbuf_t, struct ieee80211_key *) { return 0; }
-	void	ieee80211_tkip_mic(mbuf_t, int, const u_int8_t *, u_int8_t[IEEE80211_TKIP_MICLEN]) { return; }
-	void	ieee80211_michael_mic_failure(struct ieee80211com *, u_int64_t) { return; }
+	int     ieee80211_tkip_set_key(struct ieee80211com *, struct ieee80211_key *);
+	void	ieee80211_tkip_delete_key(struct ieee80211com *, struct ieee80211_key *);
+	mbuf_t	ieee80211_tkip_encrypt(struct ieee80211com *, mbuf_t, struct ieee80211_key *);
+	mbuf_t	ieee80211_tkip_decrypt(struct ieee80211com *, mbuf_t, struct ieee80211_key *);
+	void	ieee80211_tkip_mic(mbuf_t, int, const u_int8_t *, u_int8_t[IEEE80211_TKIP_MICLEN]);
+	void	ieee80211_michael_mic_failure(struct ieee80211com *, u_int64_t);
 	int     ieee80211_ccmp_set_key(struct ieee80211com *, struct ieee80211_key *);
 	void	ieee80211_ccmp_delete_key(struct ieee80211com *, struct ieee80211_key *);
 	mbuf_t	ieee80211_ccmp_encrypt(struct ieee80211com *, mbuf_t, struct ieee80211_key *);
 	mbuf_t	ieee80211_ccmp_decrypt(struct ieee80211com *, mbuf_t, struct ieee80211_key *);
+	int     ieee80211_gcmp_set_key(struct ieee80211com *, struct ieee80211_key *);
+	void	ieee80211_gcmp_delete_key(struct ieee80211com *, struct ieee80211_key *);
+	mbuf_t	ieee80211_gcmp_encrypt(struct ieee80211com *, mbuf_t, struct ieee80211_key *);
+	mbuf_t	ieee80211_gcmp_decrypt(struct ieee80211com *, mbuf_t, struct ieee80211_key *);
 	int     ieee80211_bip_set_key(struct ieee80211com *, struct ieee80211_key *) { return 1; }
 	void	ieee80211_bip_delete_key(struct ieee80211com *, struct ieee80211_key *) { return; }
 	mbuf_t	ieee80211_bip_encap(struct ieee80211com *, mbuf_t, struct ieee80211_key *) { return 0; }
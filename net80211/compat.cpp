@@ -137,15 +137,27 @@ void pci_intr_disestablish(pci_chipset_tag_t pc, void *ih) {
 }
 
 uint32_t bus_space_read_4(bus_space_tag_t space, bus_space_handle_t handle, bus_size_t offset) {
-	return *((uint32_t*)(handle + offset));
+	return *((volatile uint32_t*)(handle + offset));
 }
 
 void bus_space_write_4(bus_space_tag_t space, bus_space_handle_t handle, bus_size_t offset, uint32_t value) {
-	*((uint32_t*)(handle + offset)) = value;
+	*((volatile uint32_t*)(handle + offset)) = value;
 }
 
 void bus_space_barrier(bus_space_tag_t space, bus_space_handle_t handle, bus_size_t offset, bus_size_t length, int flags) {
-	return; // In OSX device memory access is always uncached and serialized (afaik!)
+	// Device memory is mapped uncached so register accesses are already serialized, the
+	// barrier is there to order them against descriptor writes in (cached) DMA memory
+	switch (flags & (BUS_SPACE_BARRIER_READ | BUS_SPACE_BARRIER_WRITE)) {
+	case BUS_SPACE_BARRIER_READ:
+		__asm__ __volatile__("lfence" ::: "memory");
+		break;
+	case BUS_SPACE_BARRIER_WRITE:
+		__asm__ __volatile__("sfence" ::: "memory");
+		break;
+	default:
+		__asm__ __volatile__("mfence" ::: "memory");
+		break;
+	}
 }
 
 int bus_dmamap_create(bus_dma_tag_t tag, bus_size_t size, int nsegments, bus_size_t maxsegsz, bus_size_t boundary, int flags, bus_dmamap_t *dmamp) {
@@ -23,9 +23,9 @@
 #define PCI_PCIE_LCSR_ASPM_L0S	0x00000001	// from BSD
 
 #define IPL_NET			0 // XXX not used
+#define BUS_SPACE_BARRIER_READ	0x01
+#define BUS_SPACE_BARRIER_WRITE	0x02
 // the following isn't actually used
-#define BUS_SPACE_BARRIER_READ	0
-#define BUS_SPACE_BARRIER_WRITE	0
 #define BUS_DMA_NOWAIT		0
 #define BUS_DMA_ZERO		0
 #define BUS_DMA_COHERENT	0
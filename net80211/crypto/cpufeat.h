@@ -0,0 +1,133 @@
+//
+//  cpufeat.h
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+#ifndef _CPUFEAT_H_
+#define _CPUFEAT_H_
+
+/*
+ * CPU instruction set extensions used by the accelerated crypto kernels.
+ * CPUID is only executed once (it traps when running under a hypervisor);
+ * the result is cached in a static that every caller may race to fill in
+ * with the same value.
+ */
+#define CRYPTO_CPU_SSSE3	0x00000001
+#define CRYPTO_CPU_SSE41	0x00000002
+#define CRYPTO_CPU_CLMUL	0x00000004
+#define CRYPTO_CPU_SHA		0x00000008
+#define CRYPTO_CPU_VALID	0x80000000
+
+/* CRYPTO_NO_SIMD builds only the portable code, the host tests use it */
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(CRYPTO_NO_SIMD)
+#define CRYPTO_X86
+
+static __inline void
+crypto_cpuid(u_int32_t leaf, u_int32_t subleaf, u_int32_t regs[4])
+{
+	__asm__ __volatile__("cpuid"
+	    : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+	    : "a" (leaf), "c" (subleaf));
+}
+
+static __inline u_int32_t
+crypto_cpu_features(void)
+{
+	static volatile u_int32_t features = 0;
+	u_int32_t regs[4], f;
+
+	if (features & CRYPTO_CPU_VALID)
+		return features;
+
+	f = CRYPTO_CPU_VALID;
+	crypto_cpuid(0, 0, regs);
+	if (regs[0] >= 1) {
+		crypto_cpuid(1, 0, regs);
+		if (regs[2] & (1 << 9))
+			f |= CRYPTO_CPU_SSSE3;
+		if (regs[2] & (1 << 19))
+			f |= CRYPTO_CPU_SSE41;
+		if (regs[2] & (1 << 1))
+			f |= CRYPTO_CPU_CLMUL;
+	}
+	crypto_cpuid(0, 0, regs);
+	if (regs[0] >= 7) {
+		crypto_cpuid(7, 0, regs);
+		if (regs[1] & (1 << 29))
+			f |= CRYPTO_CPU_SHA;
+	}
+	features = f;
+	return f;
+}
+
+/*
+ * The kernel does not preserve the vector registers of the thread it was
+ * entered from, so the SIMD kernels may run on top of live user state.
+ * As in xnu's own AES code, every register they may touch is saved before
+ * and restored after the call.  The kernels are kept out of line (their
+ * target attribute already prevents inlining into kernel code) so no
+ * vector instruction can be scheduled outside the bracket; so are these
+ * two, as kernel code may not name vector registers at all.
+ */
+#ifdef __x86_64__
+#define CRYPTO_XMM_REGS		16
+#else
+#define CRYPTO_XMM_REGS		8
+#endif
+
+struct crypto_xmm_state {
+	u_int8_t	xmm[CRYPTO_XMM_REGS][16];
+};
+
+#define CRYPTO_XMM_SAVE(n)	"movdqu %%xmm" #n ", " #n "*16(%0)\n\t"
+#define CRYPTO_XMM_LOAD(n)	"movdqu " #n "*16(%0), %%xmm" #n "\n\t"
+
+static __inline __attribute__((target("sse2"))) void
+crypto_xmm_save(struct crypto_xmm_state *st)
+{
+	__asm__ __volatile__(
+	    CRYPTO_XMM_SAVE(0) CRYPTO_XMM_SAVE(1) CRYPTO_XMM_SAVE(2)
+	    CRYPTO_XMM_SAVE(3) CRYPTO_XMM_SAVE(4) CRYPTO_XMM_SAVE(5)
+	    CRYPTO_XMM_SAVE(6) CRYPTO_XMM_SAVE(7)
+#ifdef __x86_64__
+	    CRYPTO_XMM_SAVE(8) CRYPTO_XMM_SAVE(9) CRYPTO_XMM_SAVE(10)
+	    CRYPTO_XMM_SAVE(11) CRYPTO_XMM_SAVE(12) CRYPTO_XMM_SAVE(13)
+	    CRYPTO_XMM_SAVE(14) CRYPTO_XMM_SAVE(15)
+#endif
+	    : : "r" (st->xmm) : "memory");
+}
+
+static __inline __attribute__((target("sse2"))) void
+crypto_xmm_restore(const struct crypto_xmm_state *st)
+{
+	__asm__ __volatile__(
+	    CRYPTO_XMM_LOAD(0) CRYPTO_XMM_LOAD(1) CRYPTO_XMM_LOAD(2)
+	    CRYPTO_XMM_LOAD(3) CRYPTO_XMM_LOAD(4) CRYPTO_XMM_LOAD(5)
+	    CRYPTO_XMM_LOAD(6) CRYPTO_XMM_LOAD(7)
+#ifdef __x86_64__
+	    CRYPTO_XMM_LOAD(8) CRYPTO_XMM_LOAD(9) CRYPTO_XMM_LOAD(10)
+	    CRYPTO_XMM_LOAD(11) CRYPTO_XMM_LOAD(12) CRYPTO_XMM_LOAD(13)
+	    CRYPTO_XMM_LOAD(14) CRYPTO_XMM_LOAD(15)
+#endif
+	    : : "r" (st->xmm) : "memory",
+	    "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+#ifdef __x86_64__
+	    , "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14",
+	    "xmm15"
+#endif
+	    );
+}
+#else
+static __inline u_int32_t
+crypto_cpu_features(void)
+{
+	return CRYPTO_CPU_VALID;
+}
+#endif
+
+/* non-zero if all of the requested features are present */
+#define crypto_cpu_has(mask)	((crypto_cpu_features() & (mask)) == (mask))
+
+#endif /* _CPUFEAT_H_ */
@@ -0,0 +1,285 @@
+//
+//  gmac.cpp
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+/*
+ * This code implements the GHASH universal hash function used by the
+ * Galois/Counter Mode (GCM) described in NIST SP800-38D.
+ *
+ * Two multiplication kernels are provided: a 4-bit table driven one
+ * (Shoup's method) that works everywhere, and one using the PCLMULQDQ
+ * carry-less multiply instruction which is picked at key setup time
+ * when the CPU supports it.
+ */
+
+#include <sys/param.h>
+#include <sys/systm.h>
+
+#include "cpufeat.h"
+#include "gmac.h"
+
+#ifdef CRYPTO_X86
+#define GHASH_CLMUL
+#include <wmmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+#define GET_BE64(p)						\
+	((u_int64_t)(p)[0] << 56 | (u_int64_t)(p)[1] << 48 |	\
+	 (u_int64_t)(p)[2] << 40 | (u_int64_t)(p)[3] << 32 |	\
+	 (u_int64_t)(p)[4] << 24 | (u_int64_t)(p)[5] << 16 |	\
+	 (u_int64_t)(p)[6] <<  8 | (u_int64_t)(p)[7])
+
+#define PUT_BE64(p, v) do {					\
+	int i;							\
+	for (i = 0; i < 8; i++)					\
+		(p)[i] = (u_int8_t)((v) >> (56 - 8 * i));	\
+} while (0)
+
+/* reduction constants for the 4-bit table method */
+static const u_int64_t ghash_last4[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+/*
+ * S := (S ^ X[0..nblocks-1]) * H, one block at a time, using the 4-bit
+ * multiplication table.
+ */
+static void
+ghash_blocks_table(const GHASH_KEY *key, u_int8_t S[GMAC_BLOCK_LEN],
+    const u_int8_t *x, size_t nblocks)
+{
+	u_int64_t zh, zl;
+	u_int8_t lo, hi, rem;
+	u_int8_t v[GMAC_BLOCK_LEN];
+	int i;
+
+	while (nblocks-- > 0) {
+		for (i = 0; i < GMAC_BLOCK_LEN; i++)
+			v[i] = S[i] ^ x[i];
+
+		lo = v[15] & 0xf;
+		zh = key->HH[lo];
+		zl = key->HL[lo];
+		for (i = 15; i >= 0; i--) {
+			lo = v[i] & 0xf;
+			hi = v[i] >> 4;
+			if (i != 15) {
+				rem = zl & 0xf;
+				zl = zh << 60 | zl >> 4;
+				zh = zh >> 4;
+				zh ^= ghash_last4[rem] << 48;
+				zh ^= key->HH[lo];
+				zl ^= key->HL[lo];
+			}
+			rem = zl & 0xf;
+			zl = zh << 60 | zl >> 4;
+			zh = zh >> 4;
+			zh ^= ghash_last4[rem] << 48;
+			zh ^= key->HH[hi];
+			zl ^= key->HL[hi];
+		}
+		PUT_BE64(&S[0], zh);
+		PUT_BE64(&S[8], zl);
+		x += GMAC_BLOCK_LEN;
+	}
+}
+
+#ifdef GHASH_CLMUL
+/*
+ * Same as ghash_blocks_table() but using PCLMULQDQ.  Operands are
+ * byte-reflected so the 256-bit product can be shifted and reduced
+ * modulo x^128 + x^7 + x^2 + x + 1 with plain SSE2 shifts (see Intel's
+ * "Carry-Less Multiplication Instruction and its Usage for Computing
+ * the GCM Mode", algorithm 5).
+ */
+__attribute__((target("pclmul,ssse3"), noinline))
+static void
+ghash_blocks_clmul(const GHASH_KEY *key, u_int8_t S[GMAC_BLOCK_LEN],
+    const u_int8_t *x, size_t nblocks)
+{
+	const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+	    8, 9, 10, 11, 12, 13, 14, 15);
+	__m128i h, s, t0, t1, t2, t3, t4, t5;
+
+	h = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)key->H), bswap);
+	s = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)S), bswap);
+
+	while (nblocks-- > 0) {
+		t0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)x),
+		    bswap);
+		s = _mm_xor_si128(s, t0);
+
+		/* 128x128 -> 256 bit carry-less product in t3:t0 */
+		t0 = _mm_clmulepi64_si128(s, h, 0x00);
+		t1 = _mm_clmulepi64_si128(s, h, 0x10);
+		t2 = _mm_clmulepi64_si128(s, h, 0x01);
+		t3 = _mm_clmulepi64_si128(s, h, 0x11);
+		t1 = _mm_xor_si128(t1, t2);
+		t2 = _mm_slli_si128(t1, 8);
+		t1 = _mm_srli_si128(t1, 8);
+		t0 = _mm_xor_si128(t0, t2);
+		t3 = _mm_xor_si128(t3, t1);
+
+		/* shift the product left by one bit (bit reflection) */
+		t4 = _mm_srli_epi32(t0, 31);
+		t5 = _mm_srli_epi32(t3, 31);
+		t0 = _mm_slli_epi32(t0, 1);
+		t3 = _mm_slli_epi32(t3, 1);
+		t2 = _mm_srli_si128(t4, 12);
+		t5 = _mm_slli_si128(t5, 4);
+		t4 = _mm_slli_si128(t4, 4);
+		t0 = _mm_or_si128(t0, t4);
+		t3 = _mm_or_si128(t3, t5);
+		t3 = _mm_or_si128(t3, t2);
+
+		/* reduce */
+		t4 = _mm_slli_epi32(t0, 31);
+		t5 = _mm_slli_epi32(t0, 30);
+		t2 = _mm_slli_epi32(t0, 25);
+		t4 = _mm_xor_si128(t4, t5);
+		t4 = _mm_xor_si128(t4, t2);
+		t5 = _mm_srli_si128(t4, 4);
+		t4 = _mm_slli_si128(t4, 12);
+		t0 = _mm_xor_si128(t0, t4);
+		t1 = _mm_srli_epi32(t0, 1);
+		t2 = _mm_srli_epi32(t0, 2);
+		t4 = _mm_srli_epi32(t0, 7);
+		t1 = _mm_xor_si128(t1, t2);
+		t1 = _mm_xor_si128(t1, t4);
+		t1 = _mm_xor_si128(t1, t5);
+		t0 = _mm_xor_si128(t0, t1);
+		s = _mm_xor_si128(t3, t0);
+
+		x += GMAC_BLOCK_LEN;
+	}
+	_mm_storeu_si128((__m128i *)S, _mm_shuffle_epi8(s, bswap));
+}
+#endif	/* GHASH_CLMUL */
+
+static void
+ghash_blocks(const GHASH_KEY *key, u_int8_t S[GMAC_BLOCK_LEN],
+    const u_int8_t *x, size_t nblocks)
+{
+#ifdef GHASH_CLMUL
+	if (key->use_clmul) {
+		struct crypto_xmm_state xmm;
+
+		crypto_xmm_save(&xmm);
+		ghash_blocks_clmul(key, S, x, nblocks);
+		crypto_xmm_restore(&xmm);
+		return;
+	}
+#endif
+	ghash_blocks_table(key, S, x, nblocks);
+}
+
+/*
+ * Precompute the multiplication table for hash subkey H = E(K, 0^128).
+ */
+void
+ghash_setkey(GHASH_KEY *key, const u_int8_t H[GMAC_BLOCK_LEN])
+{
+	u_int64_t vh, vl, t;
+	int i, j;
+
+	memcpy(key->H, H, GMAC_BLOCK_LEN);
+
+	vh = GET_BE64(&H[0]);
+	vl = GET_BE64(&H[8]);
+	key->HH[8] = vh;
+	key->HL[8] = vl;
+	key->HH[0] = key->HL[0] = 0;
+	for (i = 4; i > 0; i >>= 1) {
+		t = (vl & 1) * 0xe1000000U;
+		vl = vh << 63 | vl >> 1;
+		vh = vh >> 1 ^ t << 32;
+		key->HH[i] = vh;
+		key->HL[i] = vl;
+	}
+	for (i = 2; i <= 8; i *= 2) {
+		vh = key->HH[i];
+		vl = key->HL[i];
+		for (j = 1; j < i; j++) {
+			key->HH[i + j] = vh ^ key->HH[j];
+			key->HL[i + j] = vl ^ key->HL[j];
+		}
+	}
+
+#ifdef GHASH_CLMUL
+	key->use_clmul = crypto_cpu_has(CRYPTO_CPU_CLMUL | CRYPTO_CPU_SSSE3);
+#else
+	key->use_clmul = 0;
+#endif
+}
+
+void
+ghash_init(GHASH_CTX *ctx, const GHASH_KEY *key)
+{
+	ctx->key = key;
+	memset(ctx->S, 0, sizeof ctx->S);
+	ctx->buflen = 0;
+}
+
+void
+ghash_update(GHASH_CTX *ctx, const u_int8_t *data, size_t len)
+{
+	size_t n;
+
+	if (ctx->buflen > 0) {
+		n = MIN(GMAC_BLOCK_LEN - ctx->buflen, len);
+		memcpy(ctx->buf + ctx->buflen, data, n);
+		ctx->buflen += n;
+		data += n;
+		len -= n;
+		if (ctx->buflen < GMAC_BLOCK_LEN)
+			return;
+		ghash_blocks(ctx->key, ctx->S, ctx->buf, 1);
+		ctx->buflen = 0;
+	}
+	if (len >= GMAC_BLOCK_LEN) {
+		n = len / GMAC_BLOCK_LEN;
+		ghash_blocks(ctx->key, ctx->S, data, n);
+		data += n * GMAC_BLOCK_LEN;
+		len -= n * GMAC_BLOCK_LEN;
+	}
+	if (len > 0) {
+		memcpy(ctx->buf, data, len);
+		ctx->buflen = len;
+	}
+}
+
+/*
+ * Zero-pad and absorb a partial block, if any.  Used to separate the
+ * AAD from the ciphertext.
+ */
+void
+ghash_pad(GHASH_CTX *ctx)
+{
+	if (ctx->buflen == 0)
+		return;
+	memset(ctx->buf + ctx->buflen, 0, GMAC_BLOCK_LEN - ctx->buflen);
+	ghash_blocks(ctx->key, ctx->S, ctx->buf, 1);
+	ctx->buflen = 0;
+}
+
+/*
+ * Absorb len(A) || len(C) (in bits) and return the GHASH output.
+ */
+void
+ghash_final(u_int8_t digest[GMAC_DIGEST_LEN], GHASH_CTX *ctx,
+    u_int64_t alen, u_int64_t clen)
+{
+	u_int8_t lens[GMAC_BLOCK_LEN];
+
+	ghash_pad(ctx);
+	PUT_BE64(&lens[0], alen * NBBY);
+	PUT_BE64(&lens[8], clen * NBBY);
+	ghash_blocks(ctx->key, ctx->S, lens, 1);
+	memcpy(digest, ctx->S, GMAC_DIGEST_LEN);
+	memset(ctx->S, 0, sizeof ctx->S);
+}
@@ -0,0 +1,42 @@
+//
+//  gmac.h
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+#ifndef _GMAC_H_
+#define _GMAC_H_
+
+#define GMAC_BLOCK_LEN		16
+#define GMAC_DIGEST_LEN		16
+
+/*
+ * Per-key GHASH state: the hash subkey H together with the 4-bit
+ * multiplication table used when carry-less multiply is not available.
+ */
+typedef struct _GHASH_KEY {
+	u_int8_t	H[GMAC_BLOCK_LEN];
+	u_int64_t	HH[16];
+	u_int64_t	HL[16];
+	int		use_clmul;
+} GHASH_KEY;
+
+/* Per-message GHASH state */
+typedef struct _GHASH_CTX {
+	const GHASH_KEY	*key;
+	u_int8_t	S[GMAC_BLOCK_LEN];
+	u_int8_t	buf[GMAC_BLOCK_LEN];
+	u_int		buflen;
+} GHASH_CTX;
+
+#include <sys/cdefs.h>
+
+void	 ghash_setkey(GHASH_KEY *, const u_int8_t [GMAC_BLOCK_LEN]);
+void	 ghash_init(GHASH_CTX *, const GHASH_KEY *);
+void	 ghash_update(GHASH_CTX *, const u_int8_t *, size_t);
+void	 ghash_pad(GHASH_CTX *);
+void	 ghash_final(u_int8_t [GMAC_DIGEST_LEN], GHASH_CTX *, u_int64_t,
+	    u_int64_t);
+
+#endif /* _GMAC_H_ */
@@ -25,35 +25,42 @@
 #include <sys/systm.h>
 
 #include <libkern/crypto/md5.h>
-#include <libkern/crypto/sha1.h>
+#include "sha1.h"
 #include "sha2.h"
 #include "hmac.h"
 
 void
 HMAC_MD5_Init(HMAC_MD5_CTX *ctx, const u_int8_t *key, u_int key_len)
 {
-	u_int8_t k_ipad[MD5_BLOCK_LENGTH];
+	u_int8_t k_pad[MD5_BLOCK_LENGTH];
+	u_int8_t k_hash[MD5_DIGEST_LENGTH];
 	int i;
 
 	if (key_len > MD5_BLOCK_LENGTH) {
 		MD5Init(&ctx->ctx);
 		MD5Update(&ctx->ctx, key, key_len);
-		MD5Final(ctx->key, &ctx->ctx);
-		ctx->key_len = MD5_DIGEST_LENGTH;
-	} else {
-		bcopy(key, ctx->key, key_len);
-		ctx->key_len = key_len;
+		MD5Final(k_hash, &ctx->ctx);
+		key = k_hash;
+		key_len = MD5_DIGEST_LENGTH;
 	}
 
-	bzero(k_ipad, MD5_BLOCK_LENGTH);
-	bcopy(ctx->key, k_ipad, ctx->key_len);
+	bzero(k_pad, MD5_BLOCK_LENGTH);
+	bcopy(key, k_pad, key_len);
 	for (i = 0; i < MD5_BLOCK_LENGTH; i++)
-		k_ipad[i] ^= 0x36;
+		k_pad[i] ^= 0x5c;
+
+	MD5Init(&ctx->octx);
+	MD5Update(&ctx->octx, k_pad, MD5_BLOCK_LENGTH);
+
+	/* turn the opad into the ipad */
+	for (i = 0; i < MD5_BLOCK_LENGTH; i++)
+		k_pad[i] ^= 0x5c ^ 0x36;
 
 	MD5Init(&ctx->ctx);
-	MD5Update(&ctx->ctx, k_ipad, MD5_BLOCK_LENGTH);
+	MD5Update(&ctx->ctx, k_pad, MD5_BLOCK_LENGTH);
 
-	bzero(k_ipad, sizeof k_ipad);
+	bzero(k_pad, sizeof k_pad);
+	bzero(k_hash, sizeof k_hash);
 }
 
 void
@@ -65,49 +72,47 @@ HMAC_MD5_Update(HMAC_MD5_CTX *ctx, const u_int8_t *data, u_int len)
 void
 HMAC_MD5_Final(u_int8_t digest[MD5_DIGEST_LENGTH], HMAC_MD5_CTX *ctx)
 {
-	u_int8_t k_opad[MD5_BLOCK_LENGTH];
-	int i;
-
 	MD5Final(digest, &ctx->ctx);
 
-	bzero(k_opad, MD5_BLOCK_LENGTH);
-	bcopy(ctx->key, k_opad, ctx->key_len);
-	for (i = 0; i < MD5_BLOCK_LENGTH; i++)
-		k_opad[i] ^= 0x5c;
-
-	MD5Init(&ctx->ctx);
-	MD5Update(&ctx->ctx, k_opad, MD5_BLOCK_LENGTH);
+	ctx->ctx = ctx->octx;
 	MD5Update(&ctx->ctx, digest, MD5_DIGEST_LENGTH);
 	MD5Final(digest, &ctx->ctx);
 
-	bzero(k_opad, sizeof k_opad);
+	bzero(&ctx->octx, sizeof ctx->octx);
 }
 
 void
 HMAC_SHA1_Init(HMAC_SHA1_CTX *ctx, const u_int8_t *key, u_int key_len)
 {
-	u_int8_t k_ipad[SHA1_BLOCK_LENGTH];
+	u_int8_t k_pad[SHA1_BLOCK_LENGTH];
+	u_int8_t k_hash[SHA1_DIGEST_LENGTH];
 	int i;
 
 	if (key_len > SHA1_BLOCK_LENGTH) {
 		SHA1Init(&ctx->ctx);
 		SHA1Update(&ctx->ctx, key, key_len);
-		SHA1Final(ctx->key, &ctx->ctx);
-		ctx->key_len = SHA1_DIGEST_LENGTH;
-	} else {
-		bcopy(key, ctx->key, key_len);
-		ctx->key_len = key_len;
+		SHA1Final(k_hash, &ctx->ctx);
+		key = k_hash;
+		key_len = SHA1_DIGEST_LENGTH;
 	}
 
-	bzero(k_ipad, SHA1_BLOCK_LENGTH);
-	bcopy(ctx->key, k_ipad, ctx->key_len);
+	bzero(k_pad, SHA1_BLOCK_LENGTH);
+	bcopy(key, k_pad, key_len);
+	for (i = 0; i < SHA1_BLOCK_LENGTH; i++)
+		k_pad[i] ^= 0x5c;
+
+	SHA1Init(&ctx->octx);
+	SHA1Update(&ctx->octx, k_pad, SHA1_BLOCK_LENGTH);
+
+	/* turn the opad into the ipad */
 	for (i = 0; i < SHA1_BLOCK_LENGTH; i++)
-		k_ipad[i] ^= 0x36;
+		k_pad[i] ^= 0x5c ^ 0x36;
 
 	SHA1Init(&ctx->ctx);
-	SHA1Update(&ctx->ctx, k_ipad, SHA1_BLOCK_LENGTH);
+	SHA1Update(&ctx->ctx, k_pad, SHA1_BLOCK_LENGTH);
 
-	bzero(k_ipad, sizeof k_ipad);
+	bzero(k_pad, sizeof k_pad);
+	bzero(k_hash, sizeof k_hash);
 }
 
 void
@@ -119,49 +124,47 @@ HMAC_SHA1_Update(HMAC_SHA1_CTX *ctx, const u_int8_t *data, u_int len)
 void
 HMAC_SHA1_Final(u_int8_t digest[SHA1_DIGEST_LENGTH], HMAC_SHA1_CTX *ctx)
 {
-	u_int8_t k_opad[SHA1_BLOCK_LENGTH];
-	int i;
-
 	SHA1Final(digest, &ctx->ctx);
 
-	bzero(k_opad, SHA1_BLOCK_LENGTH);
-	bcopy(ctx->key, k_opad, ctx->key_len);
-	for (i = 0; i < SHA1_BLOCK_LENGTH; i++)
-		k_opad[i] ^= 0x5c;
-
-	SHA1Init(&ctx->ctx);
-	SHA1Update(&ctx->ctx, k_opad, SHA1_BLOCK_LENGTH);
+	ctx->ctx = ctx->octx;
 	SHA1Update(&ctx->ctx, digest, SHA1_DIGEST_LENGTH);
 	SHA1Final(digest, &ctx->ctx);
 
-	bzero(k_opad, sizeof k_opad);
+	bzero(&ctx->octx, sizeof ctx->octx);
 }
 
 void
 HMAC_SHA256_Init(HMAC_SHA256_CTX *ctx, const u_int8_t *key, u_int key_len)
 {
-	u_int8_t k_ipad[SHA256_BLOCK_LENGTH];
+	u_int8_t k_pad[SHA256_BLOCK_LENGTH];
+	u_int8_t k_hash[SHA256_DIGEST_LENGTH];
 	int i;
 
 	if (key_len > SHA256_BLOCK_LENGTH) {
 		SHA256Init(&ctx->ctx);
 		SHA256Update(&ctx->ctx, key, key_len);
-		SHA256Final(ctx->key, &ctx->ctx);
-		ctx->key_len = SHA256_DIGEST_LENGTH;
-	} else {
-		bcopy(key, ctx->key, key_len);
-		ctx->key_len = key_len;
+		SHA256Final(k_hash, &ctx->ctx);
+		key = k_hash;
+		key_len = SHA256_DIGEST_LENGTH;
 	}
 
-	bzero(k_ipad, SHA256_BLOCK_LENGTH);
-	bcopy(ctx->key, k_ipad, ctx->key_len);
+	bzero(k_pad, SHA256_BLOCK_LENGTH);
+	bcopy(key, k_pad, key_len);
+	for (i = 0; i < SHA256_BLOCK_LENGTH; i++)
+		k_pad[i] ^= 0x5c;
+
+	SHA256Init(&ctx->octx);
+	SHA256Update(&ctx->octx, k_pad, SHA256_BLOCK_LENGTH);
+
+	/* turn the opad into the ipad */
 	for (i = 0; i < SHA256_BLOCK_LENGTH; i++)
-		k_ipad[i] ^= 0x36;
+		k_pad[i] ^= 0x5c ^ 0x36;
 
 	SHA256Init(&ctx->ctx);
-	SHA256Update(&ctx->ctx, k_ipad, SHA256_BLOCK_LENGTH);
+	SHA256Update(&ctx->ctx, k_pad, SHA256_BLOCK_LENGTH);
 
-	bzero(k_ipad, sizeof k_ipad);
+	bzero(k_pad, sizeof k_pad);
+	bzero(k_hash, sizeof k_hash);
 }
 
 void
@@ -173,20 +176,11 @@ HMAC_SHA256_Update(HMAC_SHA256_CTX *ctx, const u_int8_t *data, u_int len)
 void
 HMAC_SHA256_Final(u_int8_t digest[SHA256_DIGEST_LENGTH], HMAC_SHA256_CTX *ctx)
 {
-	u_int8_t k_opad[SHA256_BLOCK_LENGTH];
-	int i;
-
 	SHA256Final(digest, &ctx->ctx);
 
-	bzero(k_opad, SHA256_BLOCK_LENGTH);
-	bcopy(ctx->key, k_opad, ctx->key_len);
-	for (i = 0; i < SHA256_BLOCK_LENGTH; i++)
-		k_opad[i] ^= 0x5c;
-
-	SHA256Init(&ctx->ctx);
-	SHA256Update(&ctx->ctx, k_opad, SHA256_BLOCK_LENGTH);
+	ctx->ctx = ctx->octx;
 	SHA256Update(&ctx->ctx, digest, SHA256_DIGEST_LENGTH);
 	SHA256Final(digest, &ctx->ctx);
 
-	bzero(k_opad, sizeof k_opad);
+	bzero(&ctx->octx, sizeof ctx->octx);
 }
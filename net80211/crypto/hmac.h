@@ -22,25 +22,25 @@
 /* mercurysquad: Following should be in the libkern includes but aren't */
 #define	MD5_BLOCK_LENGTH		64
 #define	MD5_DIGEST_LENGTH		16
-#define	SHA1_BLOCK_LENGTH		64
-#define	SHA1_DIGEST_LENGTH		20
 
+/*
+ * The inner and outer hash states are both computed at init time, so that
+ * a keyed context can be copied and reused for several messages without
+ * hashing the padded key again.
+ */
 typedef struct _HMAC_MD5_CTX {
 	MD5_CTX		ctx;
-	u_int8_t	key[MD5_BLOCK_LENGTH];
-	u_int		key_len;
+	MD5_CTX		octx;
 } HMAC_MD5_CTX;
 
 typedef struct _HMAC_SHA1_CTX {
 	SHA1_CTX	ctx;
-	u_int8_t	key[SHA1_BLOCK_LENGTH];
-	u_int		key_len;
+	SHA1_CTX	octx;
 } HMAC_SHA1_CTX;
 
 typedef struct _HMAC_SHA256_CTX {
 	SHA2_CTX	ctx;
-	u_int8_t	key[SHA256_BLOCK_LENGTH];
-	u_int		key_len;
+	SHA2_CTX	octx;
 } HMAC_SHA256_CTX;
 
 #include <sys/cdefs.h>
@@ -59,21 +59,40 @@ michael_init(MICHAEL_CTX *ctx)
 	bzero(ctx, sizeof(MICHAEL_CTX));
 }
 
+/*
+ * The message is consumed a 32-bit word at a time; only a word that
+ * straddles two calls (e.g. two mbufs) goes through michael_state.
+ */
 void
 michael_update(MICHAEL_CTX *ctx, const u_int8_t *data, u_int len)
 {
-	int i;
+	u_int32_t l = ctx->michael_l, r = ctx->michael_r;
 
-	for (i = 0; i < len; i++) {
-		ctx->michael_state |= data[i] << (ctx->michael_count << 3);
-		ctx->michael_count++;
-
-		if (ctx->michael_count >= MICHAEL_RAW_BLOCK_LENGTH) {
-			ctx->michael_l ^= ctx->michael_state;
-			MICHAEL_BLOCK(ctx->michael_l, ctx->michael_r);
+	/* complete a word left over from the previous call */
+	while (ctx->michael_count != 0 && len > 0) {
+		ctx->michael_state |= *data++ << (ctx->michael_count << 3);
+		len--;
+		if (++ctx->michael_count >= MICHAEL_RAW_BLOCK_LENGTH) {
+			l ^= ctx->michael_state;
+			MICHAEL_BLOCK(l, r);
 			ctx->michael_state = ctx->michael_count = 0;
 		}
 	}
+
+	for (; len >= MICHAEL_RAW_BLOCK_LENGTH;
+	    len -= MICHAEL_RAW_BLOCK_LENGTH, data += MICHAEL_RAW_BLOCK_LENGTH) {
+		l ^= GETLE32(data);
+		MICHAEL_BLOCK(l, r);
+	}
+
+	/* keep the trailing bytes for the next call */
+	while (len-- > 0) {
+		ctx->michael_state |= *data++ << (ctx->michael_count << 3);
+		ctx->michael_count++;
+	}
+
+	ctx->michael_l = l;
+	ctx->michael_r = r;
 }
 
 void
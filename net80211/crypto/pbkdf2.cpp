@@ -0,0 +1,185 @@
+//
+//  pbkdf2.cpp
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+/*
+ * Password-Based Key Derivation Function 2 (PKCS #5 v2.0) with HMAC-SHA1
+ * as the PRF, as used to turn a WPA passphrase into a PMK.
+ *
+ * All but the first of the 4096 iterations hash a fixed-size message
+ * with a fixed key, so the HMAC ipad/opad hash states are computed once
+ * and each iteration costs exactly two SHA-1 compressions.  Up to four
+ * output blocks are run side by side through SHA1TransformX4(); when the
+ * CPU has the SHA extensions the blocks are run one after the other
+ * instead, as a single hardware chain is faster than four SSE2 lanes.
+ */
+
+#include <sys/param.h>
+#include <sys/systm.h>
+
+#include "cpufeat.h"
+#include "md5.h"
+#include "sha1.h"
+#include "sha2.h"
+#include "hmac.h"
+#include "pbkdf2.h"
+
+#define PBKDF2_LANES	4
+
+/* message length of the inner and outer hashes, in bits */
+#define PBKDF2_MSGBITS	((SHA1_BLOCK_LENGTH + SHA1_DIGEST_LENGTH) * NBBY)
+
+#define PUT_BE32(p, v) do {						\
+	(p)[0] = (u_int8_t)((v) >> 24);					\
+	(p)[1] = (u_int8_t)((v) >> 16);					\
+	(p)[2] = (u_int8_t)((v) >> 8);					\
+	(p)[3] = (u_int8_t)(v);						\
+} while (0)
+
+#define GET_BE32(p)							\
+	((u_int32_t)(p)[0] << 24 | (u_int32_t)(p)[1] << 16 |		\
+	 (u_int32_t)(p)[2] << 8 | (u_int32_t)(p)[3])
+
+/*
+ * Run iterations 2..rounds for up to four blocks in parallel.  On entry
+ * T holds U_1 for each lane; on return it holds U_1 ^ ... ^ U_rounds.
+ */
+static void
+pbkdf2_iterate_x4(const u_int32_t istate[5], const u_int32_t ostate[5],
+    u_int32_t T[5][PBKDF2_LANES], u_int rounds)
+{
+	u_int32_t st[5][PBKDF2_LANES], blk[16][PBKDF2_LANES];
+	u_int r;
+	int i, lane;
+
+	memset(blk, 0, sizeof(blk));
+	for (lane = 0; lane < PBKDF2_LANES; lane++) {
+		for (i = 0; i < 5; i++)
+			blk[i][lane] = T[i][lane];
+		blk[5][lane] = 0x80000000;
+		blk[15][lane] = PBKDF2_MSGBITS;
+	}
+
+	for (r = 1; r < rounds; r++) {
+		for (i = 0; i < 5; i++)
+			for (lane = 0; lane < PBKDF2_LANES; lane++)
+				st[i][lane] = istate[i];
+		SHA1TransformX4(st, blk);
+
+		for (i = 0; i < 5; i++)
+			for (lane = 0; lane < PBKDF2_LANES; lane++) {
+				blk[i][lane] = st[i][lane];
+				st[i][lane] = ostate[i];
+			}
+		SHA1TransformX4(st, blk);
+
+		for (i = 0; i < 5; i++)
+			for (lane = 0; lane < PBKDF2_LANES; lane++) {
+				blk[i][lane] = st[i][lane];
+				T[i][lane] ^= st[i][lane];
+			}
+	}
+	memset(st, 0, sizeof(st));
+	memset(blk, 0, sizeof(blk));
+}
+
+/*
+ * Same as pbkdf2_iterate_x4() for a single block, through SHA1Transform().
+ */
+static void
+pbkdf2_iterate(const u_int32_t istate[5], const u_int32_t ostate[5],
+    u_int32_t T[5][PBKDF2_LANES], int lane, u_int rounds)
+{
+	u_int8_t blk[SHA1_BLOCK_LENGTH];
+	u_int32_t st[5];
+	u_int r;
+	int i;
+
+	memset(blk, 0, sizeof(blk));
+	for (i = 0; i < 5; i++)
+		PUT_BE32(&blk[4 * i], T[i][lane]);
+	blk[SHA1_DIGEST_LENGTH] = 0x80;
+	PUT_BE32(&blk[SHA1_BLOCK_LENGTH - 4], PBKDF2_MSGBITS);
+
+	for (r = 1; r < rounds; r++) {
+		memcpy(st, istate, sizeof(st));
+		SHA1Transform(st, blk);
+		for (i = 0; i < 5; i++)
+			PUT_BE32(&blk[4 * i], st[i]);
+
+		memcpy(st, ostate, sizeof(st));
+		SHA1Transform(st, blk);
+		for (i = 0; i < 5; i++) {
+			PUT_BE32(&blk[4 * i], st[i]);
+			T[i][lane] ^= st[i];
+		}
+	}
+	memset(st, 0, sizeof(st));
+	memset(blk, 0, sizeof(blk));
+}
+
+/*
+ * Derive key_len bytes from a password and a salt (RFC 2898, section
+ * 5.2).  Returns 0 on success, -1 on invalid arguments.
+ */
+int
+pkcs5_pbkdf2(const char *pass, size_t pass_len, const u_int8_t *salt,
+    size_t salt_len, u_int8_t *key, size_t key_len, u_int rounds)
+{
+	HMAC_SHA1_CTX hctx, ctx;
+	u_int32_t T[5][PBKDF2_LANES];
+	u_int8_t cnt[4], d[SHA1_DIGEST_LENGTH];
+	u_int32_t count;
+	size_t r;
+	int i, lane, nlanes, serial;
+
+	if (rounds < 1 || key_len == 0)
+		return -1;
+
+	HMAC_SHA1_Init(&hctx, (const u_int8_t *)pass, pass_len);
+	serial = crypto_cpu_has(CRYPTO_CPU_SHA | CRYPTO_CPU_SSSE3 |
+	    CRYPTO_CPU_SSE41);
+
+	for (count = 1; key_len > 0; count += nlanes) {
+		nlanes = (key_len + SHA1_DIGEST_LENGTH - 1) / SHA1_DIGEST_LENGTH;
+		if (nlanes > PBKDF2_LANES)
+			nlanes = PBKDF2_LANES;
+
+		/* U_1 = PRF(P, S || INT(i)) */
+		memset(T, 0, sizeof(T));
+		for (lane = 0; lane < nlanes; lane++) {
+			PUT_BE32(cnt, count + lane);
+			ctx = hctx;
+			HMAC_SHA1_Update(&ctx, salt, salt_len);
+			HMAC_SHA1_Update(&ctx, cnt, sizeof(cnt));
+			HMAC_SHA1_Final(d, &ctx);
+			for (i = 0; i < 5; i++)
+				T[i][lane] = GET_BE32(&d[4 * i]);
+		}
+
+		if (serial) {
+			for (lane = 0; lane < nlanes; lane++)
+				pbkdf2_iterate(hctx.ctx.state, hctx.octx.state,
+				    T, lane, rounds);
+		} else
+			pbkdf2_iterate_x4(hctx.ctx.state, hctx.octx.state,
+			    T, rounds);
+
+		for (lane = 0; lane < nlanes; lane++) {
+			for (i = 0; i < 5; i++)
+				PUT_BE32(&d[4 * i], T[i][lane]);
+			r = MIN(key_len, SHA1_DIGEST_LENGTH);
+			memcpy(key, d, r);
+			key += r;
+			key_len -= r;
+		}
+	}
+	bzero(&hctx, sizeof(hctx));
+	bzero(&ctx, sizeof(ctx));
+	bzero(T, sizeof(T));
+	bzero(d, sizeof(d));
+	return 0;
+}
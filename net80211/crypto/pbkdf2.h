@@ -0,0 +1,16 @@
+//
+//  pbkdf2.h
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+#ifndef _PBKDF2_H_
+#define _PBKDF2_H_
+
+#include <sys/cdefs.h>
+
+int	 pkcs5_pbkdf2(const char *, size_t, const u_int8_t *, size_t,
+	    u_int8_t *, size_t, u_int);
+
+#endif /* _PBKDF2_H_ */
@@ -0,0 +1,480 @@
+/*	$OpenBSD: sha1.c,v 1.9 2011/01/11 15:50:40 deraadt Exp $	*/
+
+/*
+ * SHA-1 in C
+ * By Steve Reid <steve@edmweb.com>
+ * 100% Public Domain
+ *
+ * Test Vectors (from FIPS PUB 180-1)
+ * "abc"
+ *   A9993E36 4706816A BA3E2571 7850C26C 9CD0D89D
+ * "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"
+ *   84983E44 1C3BD26E BAAE4AA1 F95129E5 E54670F1
+ * A million repetitions of "a"
+ *   34AA973C D4C4DAA4 F61EEB2B DBAD2731 6534016F
+ */
+
+/*
+ * The compression function is also provided using the Intel SHA
+ * extensions; SHA1Transform() picks it at run time when available.
+ */
+
+#include <sys/param.h>
+#include <sys/systm.h>
+
+#include "cpufeat.h"
+#include "sha1.h"
+
+#ifdef CRYPTO_X86
+#define SHA1_SHANI
+#include <immintrin.h>
+#endif
+
+#define rol(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
+
+/*
+ * blk0() and blk() perform the initial expand.
+ * I got the idea of expanding during the round function from SSLeay
+ */
+#define blk0(i) (block[i] = (u_int32_t)buffer[4 * (i)] << 24 |		\
+    (u_int32_t)buffer[4 * (i) + 1] << 16 |				\
+    (u_int32_t)buffer[4 * (i) + 2] << 8 | (u_int32_t)buffer[4 * (i) + 3])
+#define blk(i) (block[i&15] = rol(block[(i+13)&15]^block[(i+8)&15] \
+    ^block[(i+2)&15]^block[i&15],1))
+
+/*
+ * (R0+R1), R2, R3, R4 are the different operations (rounds) used in SHA1
+ */
+#define R0(v,w,x,y,z,i) z+=((w&(x^y))^y)+blk0(i)+0x5A827999+rol(v,5);w=rol(w,30);
+#define R1(v,w,x,y,z,i) z+=((w&(x^y))^y)+blk(i)+0x5A827999+rol(v,5);w=rol(w,30);
+#define R2(v,w,x,y,z,i) z+=(w^x^y)+blk(i)+0x6ED9EBA1+rol(v,5);w=rol(w,30);
+#define R3(v,w,x,y,z,i) z+=(((w|x)&y)|(w&x))+blk(i)+0x8F1BBCDC+rol(v,5);w=rol(w,30);
+#define R4(v,w,x,y,z,i) z+=(w^x^y)+blk(i)+0xCA62C1D6+rol(v,5);w=rol(w,30);
+
+/*
+ * Hash a single 512-bit block. This is the core of the algorithm.
+ */
+static void
+SHA1TransformGeneric(u_int32_t state[5], const unsigned char buffer[SHA1_BLOCK_LENGTH])
+{
+	u_int32_t a, b, c, d, e;
+	u_int32_t block[16];
+
+	/* Copy context->state[] to working vars */
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+
+	/* 4 rounds of 20 operations each. Loop unrolled. */
+	R0(a,b,c,d,e, 0); R0(e,a,b,c,d, 1); R0(d,e,a,b,c, 2); R0(c,d,e,a,b, 3);
+	R0(b,c,d,e,a, 4); R0(a,b,c,d,e, 5); R0(e,a,b,c,d, 6); R0(d,e,a,b,c, 7);
+	R0(c,d,e,a,b, 8); R0(b,c,d,e,a, 9); R0(a,b,c,d,e,10); R0(e,a,b,c,d,11);
+	R0(d,e,a,b,c,12); R0(c,d,e,a,b,13); R0(b,c,d,e,a,14); R0(a,b,c,d,e,15);
+	R1(e,a,b,c,d,16); R1(d,e,a,b,c,17); R1(c,d,e,a,b,18); R1(b,c,d,e,a,19);
+	R2(a,b,c,d,e,20); R2(e,a,b,c,d,21); R2(d,e,a,b,c,22); R2(c,d,e,a,b,23);
+	R2(b,c,d,e,a,24); R2(a,b,c,d,e,25); R2(e,a,b,c,d,26); R2(d,e,a,b,c,27);
+	R2(c,d,e,a,b,28); R2(b,c,d,e,a,29); R2(a,b,c,d,e,30); R2(e,a,b,c,d,31);
+	R2(d,e,a,b,c,32); R2(c,d,e,a,b,33); R2(b,c,d,e,a,34); R2(a,b,c,d,e,35);
+	R2(e,a,b,c,d,36); R2(d,e,a,b,c,37); R2(c,d,e,a,b,38); R2(b,c,d,e,a,39);
+	R3(a,b,c,d,e,40); R3(e,a,b,c,d,41); R3(d,e,a,b,c,42); R3(c,d,e,a,b,43);
+	R3(b,c,d,e,a,44); R3(a,b,c,d,e,45); R3(e,a,b,c,d,46); R3(d,e,a,b,c,47);
+	R3(c,d,e,a,b,48); R3(b,c,d,e,a,49); R3(a,b,c,d,e,50); R3(e,a,b,c,d,51);
+	R3(d,e,a,b,c,52); R3(c,d,e,a,b,53); R3(b,c,d,e,a,54); R3(a,b,c,d,e,55);
+	R3(e,a,b,c,d,56); R3(d,e,a,b,c,57); R3(c,d,e,a,b,58); R3(b,c,d,e,a,59);
+	R4(a,b,c,d,e,60); R4(e,a,b,c,d,61); R4(d,e,a,b,c,62); R4(c,d,e,a,b,63);
+	R4(b,c,d,e,a,64); R4(a,b,c,d,e,65); R4(e,a,b,c,d,66); R4(d,e,a,b,c,67);
+	R4(c,d,e,a,b,68); R4(b,c,d,e,a,69); R4(a,b,c,d,e,70); R4(e,a,b,c,d,71);
+	R4(d,e,a,b,c,72); R4(c,d,e,a,b,73); R4(b,c,d,e,a,74); R4(a,b,c,d,e,75);
+	R4(e,a,b,c,d,76); R4(d,e,a,b,c,77); R4(c,d,e,a,b,78); R4(b,c,d,e,a,79);
+
+	/* Add the working vars back into context.state[] */
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+
+	/* Wipe variables */
+	a = b = c = d = e = 0;
+	memset(block, 0, sizeof(block));
+}
+
+#ifdef SHA1_SHANI
+/*
+ * Same as SHA1TransformGeneric() using SHA1RNDS4/SHA1NEXTE/SHA1MSG1/
+ * SHA1MSG2.  Each step below does four rounds; the message schedule for
+ * later steps is computed in the shadow of the current one.
+ */
+__attribute__((target("sha,ssse3,sse4.1"), noinline))
+static void
+SHA1TransformSHANI(u_int32_t state[5], const unsigned char data[SHA1_BLOCK_LENGTH])
+{
+	const __m128i MASK = _mm_set_epi64x(0x0001020304050607ULL,
+	    0x08090a0b0c0d0e0fULL);
+	__m128i ABCD, ABCD_SAVE, E0, E0_SAVE, E1;
+	__m128i MSG0, MSG1, MSG2, MSG3;
+
+	ABCD = _mm_loadu_si128((const __m128i *)state);
+	ABCD = _mm_shuffle_epi32(ABCD, 0x1b);
+	E0 = _mm_set_epi32(state[4], 0, 0, 0);
+	ABCD_SAVE = ABCD;
+	E0_SAVE = E0;
+
+	/* rounds 0-3 */
+	MSG0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 0)), MASK);
+	E0 = _mm_add_epi32(E0, MSG0);
+	E1 = ABCD;
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+
+	/* rounds 4-7 */
+	MSG1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), MASK);
+	E1 = _mm_sha1nexte_epu32(E1, MSG1);
+	E0 = ABCD;
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 0);
+	MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+
+	/* rounds 8-11 */
+	MSG2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), MASK);
+	E0 = _mm_sha1nexte_epu32(E0, MSG2);
+	E1 = ABCD;
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+	MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+	MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+	/* rounds 12-15 */
+	MSG3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), MASK);
+	E1 = _mm_sha1nexte_epu32(E1, MSG3);
+	E0 = ABCD;
+	MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 0);
+	MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+	MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+	/* rounds 16-19 */
+	E0 = _mm_sha1nexte_epu32(E0, MSG0);
+	E1 = ABCD;
+	MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+	MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+	MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+	/* rounds 20-23 */
+	E1 = _mm_sha1nexte_epu32(E1, MSG1);
+	E0 = ABCD;
+	MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 1);
+	MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+	MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+	/* rounds 24-27 */
+	E0 = _mm_sha1nexte_epu32(E0, MSG2);
+	E1 = ABCD;
+	MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 1);
+	MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+	MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+	/* rounds 28-31 */
+	E1 = _mm_sha1nexte_epu32(E1, MSG3);
+	E0 = ABCD;
+	MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 1);
+	MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+	MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+	/* rounds 32-35 */
+	E0 = _mm_sha1nexte_epu32(E0, MSG0);
+	E1 = ABCD;
+	MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 1);
+	MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+	MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+	/* rounds 36-39 */
+	E1 = _mm_sha1nexte_epu32(E1, MSG1);
+	E0 = ABCD;
+	MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 1);
+	MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+	MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+	/* rounds 40-43 */
+	E0 = _mm_sha1nexte_epu32(E0, MSG2);
+	E1 = ABCD;
+	MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 2);
+	MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+	MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+	/* rounds 44-47 */
+	E1 = _mm_sha1nexte_epu32(E1, MSG3);
+	E0 = ABCD;
+	MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 2);
+	MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+	MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+	/* rounds 48-51 */
+	E0 = _mm_sha1nexte_epu32(E0, MSG0);
+	E1 = ABCD;
+	MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 2);
+	MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+	MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+	/* rounds 52-55 */
+	E1 = _mm_sha1nexte_epu32(E1, MSG1);
+	E0 = ABCD;
+	MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 2);
+	MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+	MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+	/* rounds 56-59 */
+	E0 = _mm_sha1nexte_epu32(E0, MSG2);
+	E1 = ABCD;
+	MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 2);
+	MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+	MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+	/* rounds 60-63 */
+	E1 = _mm_sha1nexte_epu32(E1, MSG3);
+	E0 = ABCD;
+	MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+	MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+	MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+	/* rounds 64-67 */
+	E0 = _mm_sha1nexte_epu32(E0, MSG0);
+	E1 = ABCD;
+	MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 3);
+	MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+	MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+	/* rounds 68-71 */
+	E1 = _mm_sha1nexte_epu32(E1, MSG1);
+	E0 = ABCD;
+	MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+	MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+	/* rounds 72-75 */
+	E0 = _mm_sha1nexte_epu32(E0, MSG2);
+	E1 = ABCD;
+	MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 3);
+
+	/* rounds 76-79 */
+	E1 = _mm_sha1nexte_epu32(E1, MSG3);
+	E0 = ABCD;
+	ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+	E0 = _mm_sha1nexte_epu32(E0, E0_SAVE);
+	ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+
+	ABCD = _mm_shuffle_epi32(ABCD, 0x1b);
+	_mm_storeu_si128((__m128i *)state, ABCD);
+	state[4] = _mm_extract_epi32(E0, 3);
+}
+#endif	/* SHA1_SHANI */
+
+void
+SHA1Transform(u_int32_t state[5], const unsigned char buffer[SHA1_BLOCK_LENGTH])
+{
+#ifdef SHA1_SHANI
+	if (crypto_cpu_has(CRYPTO_CPU_SHA | CRYPTO_CPU_SSSE3 |
+	    CRYPTO_CPU_SSE41)) {
+		struct crypto_xmm_state xmm;
+
+		crypto_xmm_save(&xmm);
+		SHA1TransformSHANI(state, buffer);
+		crypto_xmm_restore(&xmm);
+		return;
+	}
+#endif
+	SHA1TransformGeneric(state, buffer);
+}
+
+#ifdef CRYPTO_X86
+/*
+ * Four-lane versions of the round macros above.  Each __m128i holds the
+ * same working variable for four independent blocks.
+ */
+#define x4_rol(x, n)	_mm_or_si128(_mm_slli_epi32((x), (n)),		\
+    _mm_srli_epi32((x), 32 - (n)))
+#define x4_add3(x, y, z) _mm_add_epi32(_mm_add_epi32((x), (y)), (z))
+#define x4_blk(i) (W[(i)&15] = x4_rol(_mm_xor_si128(			\
+    _mm_xor_si128(W[((i)+13)&15], W[((i)+8)&15]),			\
+    _mm_xor_si128(W[((i)+2)&15], W[(i)&15])), 1))
+#define x4_f1(w,x,y)	_mm_xor_si128(y, _mm_and_si128(w, _mm_xor_si128(x, y)))
+#define x4_f2(w,x,y)	_mm_xor_si128(_mm_xor_si128(w, x), y)
+#define x4_f3(w,x,y)	_mm_or_si128(_mm_and_si128(_mm_or_si128(w, x), y), \
+    _mm_and_si128(w, x))
+#define x4_round(v,w,x,y,z,f,wi,k) do {					\
+	z = x4_add3(z, f, wi);						\
+	z = x4_add3(z, k, x4_rol(v, 5));				\
+	w = x4_rol(w, 30);						\
+} while (0)
+#define X0(v,w,x,y,z,i) x4_round(v,w,x,y,z,x4_f1(w,x,y),W[i],K0)
+#define X1(v,w,x,y,z,i) x4_round(v,w,x,y,z,x4_f1(w,x,y),x4_blk(i),K0)
+#define X2(v,w,x,y,z,i) x4_round(v,w,x,y,z,x4_f2(w,x,y),x4_blk(i),K1)
+#define X3(v,w,x,y,z,i) x4_round(v,w,x,y,z,x4_f3(w,x,y),x4_blk(i),K2)
+#define X4(v,w,x,y,z,i) x4_round(v,w,x,y,z,x4_f2(w,x,y),x4_blk(i),K3)
+
+/*
+ * Hash four independent blocks at once, one per 32-bit lane of an SSE2
+ * register.  This is for callers like PBKDF2 that have several unrelated
+ * chains to run and no SHA extensions to run them with.
+ */
+__attribute__((target("sse2"), noinline))
+static void
+SHA1TransformX4SSE2(u_int32_t state[5][4], const u_int32_t block[16][4])
+{
+	const __m128i K0 = _mm_set1_epi32(0x5A827999);
+	const __m128i K1 = _mm_set1_epi32(0x6ED9EBA1);
+	const __m128i K2 = _mm_set1_epi32(0x8F1BBCDC);
+	const __m128i K3 = _mm_set1_epi32(0xCA62C1D6);
+	__m128i a, b, c, d, e;
+	__m128i W[16];
+	int i;
+
+	a = _mm_loadu_si128((const __m128i *)state[0]);
+	b = _mm_loadu_si128((const __m128i *)state[1]);
+	c = _mm_loadu_si128((const __m128i *)state[2]);
+	d = _mm_loadu_si128((const __m128i *)state[3]);
+	e = _mm_loadu_si128((const __m128i *)state[4]);
+	for (i = 0; i < 16; i++)
+		W[i] = _mm_loadu_si128((const __m128i *)block[i]);
+
+	X0(a,b,c,d,e, 0); X0(e,a,b,c,d, 1); X0(d,e,a,b,c, 2); X0(c,d,e,a,b, 3);
+	X0(b,c,d,e,a, 4); X0(a,b,c,d,e, 5); X0(e,a,b,c,d, 6); X0(d,e,a,b,c, 7);
+	X0(c,d,e,a,b, 8); X0(b,c,d,e,a, 9); X0(a,b,c,d,e,10); X0(e,a,b,c,d,11);
+	X0(d,e,a,b,c,12); X0(c,d,e,a,b,13); X0(b,c,d,e,a,14); X0(a,b,c,d,e,15);
+	X1(e,a,b,c,d,16); X1(d,e,a,b,c,17); X1(c,d,e,a,b,18); X1(b,c,d,e,a,19);
+	X2(a,b,c,d,e,20); X2(e,a,b,c,d,21); X2(d,e,a,b,c,22); X2(c,d,e,a,b,23);
+	X2(b,c,d,e,a,24); X2(a,b,c,d,e,25); X2(e,a,b,c,d,26); X2(d,e,a,b,c,27);
+	X2(c,d,e,a,b,28); X2(b,c,d,e,a,29); X2(a,b,c,d,e,30); X2(e,a,b,c,d,31);
+	X2(d,e,a,b,c,32); X2(c,d,e,a,b,33); X2(b,c,d,e,a,34); X2(a,b,c,d,e,35);
+	X2(e,a,b,c,d,36); X2(d,e,a,b,c,37); X2(c,d,e,a,b,38); X2(b,c,d,e,a,39);
+	X3(a,b,c,d,e,40); X3(e,a,b,c,d,41); X3(d,e,a,b,c,42); X3(c,d,e,a,b,43);
+	X3(b,c,d,e,a,44); X3(a,b,c,d,e,45); X3(e,a,b,c,d,46); X3(d,e,a,b,c,47);
+	X3(c,d,e,a,b,48); X3(b,c,d,e,a,49); X3(a,b,c,d,e,50); X3(e,a,b,c,d,51);
+	X3(d,e,a,b,c,52); X3(c,d,e,a,b,53); X3(b,c,d,e,a,54); X3(a,b,c,d,e,55);
+	X3(e,a,b,c,d,56); X3(d,e,a,b,c,57); X3(c,d,e,a,b,58); X3(b,c,d,e,a,59);
+	X4(a,b,c,d,e,60); X4(e,a,b,c,d,61); X4(d,e,a,b,c,62); X4(c,d,e,a,b,63);
+	X4(b,c,d,e,a,64); X4(a,b,c,d,e,65); X4(e,a,b,c,d,66); X4(d,e,a,b,c,67);
+	X4(c,d,e,a,b,68); X4(b,c,d,e,a,69); X4(a,b,c,d,e,70); X4(e,a,b,c,d,71);
+	X4(d,e,a,b,c,72); X4(c,d,e,a,b,73); X4(b,c,d,e,a,74); X4(a,b,c,d,e,75);
+	X4(e,a,b,c,d,76); X4(d,e,a,b,c,77); X4(c,d,e,a,b,78); X4(b,c,d,e,a,79);
+
+	a = _mm_add_epi32(a, _mm_loadu_si128((const __m128i *)state[0]));
+	b = _mm_add_epi32(b, _mm_loadu_si128((const __m128i *)state[1]));
+	c = _mm_add_epi32(c, _mm_loadu_si128((const __m128i *)state[2]));
+	d = _mm_add_epi32(d, _mm_loadu_si128((const __m128i *)state[3]));
+	e = _mm_add_epi32(e, _mm_loadu_si128((const __m128i *)state[4]));
+	_mm_storeu_si128((__m128i *)state[0], a);
+	_mm_storeu_si128((__m128i *)state[1], b);
+	_mm_storeu_si128((__m128i *)state[2], c);
+	_mm_storeu_si128((__m128i *)state[3], d);
+	_mm_storeu_si128((__m128i *)state[4], e);
+}
+
+void
+SHA1TransformX4(u_int32_t state[5][4], const u_int32_t block[16][4])
+{
+	struct crypto_xmm_state xmm;
+
+	crypto_xmm_save(&xmm);
+	SHA1TransformX4SSE2(state, block);
+	crypto_xmm_restore(&xmm);
+}
+#else	/* CRYPTO_X86 */
+void
+SHA1TransformX4(u_int32_t state[5][4], const u_int32_t block[16][4])
+{
+	unsigned char buf[SHA1_BLOCK_LENGTH];
+	u_int32_t st[5];
+	int lane, i;
+
+	for (lane = 0; lane < 4; lane++) {
+		for (i = 0; i < 16; i++) {
+			buf[4 * i] = block[i][lane] >> 24;
+			buf[4 * i + 1] = block[i][lane] >> 16;
+			buf[4 * i + 2] = block[i][lane] >> 8;
+			buf[4 * i + 3] = block[i][lane];
+		}
+		for (i = 0; i < 5; i++)
+			st[i] = state[i][lane];
+		SHA1TransformGeneric(st, buf);
+		for (i = 0; i < 5; i++)
+			state[i][lane] = st[i];
+	}
+	memset(buf, 0, sizeof(buf));
+}
+#endif	/* CRYPTO_X86 */
+
+/*
+ * SHA1Init - Initialize new context
+ */
+void
+SHA1Init(SHA1_CTX *context)
+{
+	/* SHA1 initialization constants */
+	context->count = 0;
+	context->state[0] = 0x67452301;
+	context->state[1] = 0xEFCDAB89;
+	context->state[2] = 0x98BADCFE;
+	context->state[3] = 0x10325476;
+	context->state[4] = 0xC3D2E1F0;
+}
+
+/*
+ * Run your data through this.
+ */
+void
+SHA1Update(SHA1_CTX *context, const unsigned char *data, unsigned int len)
+{
+	unsigned int i, j;
+
+	j = (u_int32_t)((context->count >> 3) & 63);
+	context->count += ((u_int64_t)len << 3);
+	if ((j + len) > 63) {
+		memcpy(&context->buffer[j], data, (i = 64 - j));
+		SHA1Transform(context->state, context->buffer);
+		for ( ; i + 63 < len; i += 64)
+			SHA1Transform(context->state, &data[i]);
+		j = 0;
+	} else
+		i = 0;
+	memcpy(&context->buffer[j], &data[i], len - i);
+}
+
+/*
+ * Add padding and return the message digest.
+ */
+void
+SHA1Final(unsigned char digest[SHA1_DIGEST_LENGTH], SHA1_CTX *context)
+{
+	unsigned int i;
+	unsigned char finalcount[8];
+
+	for (i = 0; i < 8; i++) {
+		finalcount[i] = (unsigned char)((context->count >>
+		    ((7 - (i & 7)) * 8)) & 255);	/* Endian independent */
+	}
+	SHA1Update(context, (unsigned char *)"\200", 1);
+	while ((context->count & 504) != 448)
+		SHA1Update(context, (unsigned char *)"\0", 1);
+	SHA1Update(context, finalcount, 8);  /* Should cause a SHA1Transform() */
+
+	if (digest)
+		for (i = 0; i < SHA1_DIGEST_LENGTH; i++) {
+			digest[i] = (unsigned char)((context->state[i >> 2] >>
+			    ((3 - (i & 3)) * 8)) & 255);
+		}
+	memset(finalcount, 0, 8);	/* SWR */
+}
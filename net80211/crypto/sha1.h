@@ -1,9 +1,41 @@
+/*	$OpenBSD: sha1.h,v 1.5 2007/09/10 22:19:42 henric Exp $	*/
+
+/*
+ * SHA-1 in C
+ * By Steve Reid <steve@edmweb.com>
+ * 100% Public Domain
+ */
+
 /*
  *  sha1.h
  *  net80211
  *
  *  Copyright 2011 Prashant Vaibhav. All rights reserved.
  *
+ *  The libkern SHA-1 has no way to plug in an accelerated compression
+ *  function, so we carry our own (see sha1.cpp).
  */
 
-#include <libkern/crypto/sha1.h>
+#ifndef _SHA1_H_
+#define _SHA1_H_
+
+#define	SHA1_BLOCK_LENGTH		64
+#define	SHA1_DIGEST_LENGTH		20
+
+typedef struct {
+	u_int32_t	state[5];
+	u_int64_t	count;
+	unsigned char	buffer[SHA1_BLOCK_LENGTH];
+} SHA1_CTX;
+
+#include <sys/cdefs.h>
+
+void SHA1Init(SHA1_CTX * context);
+void SHA1Transform(u_int32_t state[5], const unsigned char buffer[SHA1_BLOCK_LENGTH]);
+void SHA1Update(SHA1_CTX *context, const unsigned char *data, unsigned int len);
+void SHA1Final(unsigned char digest[SHA1_DIGEST_LENGTH], SHA1_CTX *context);
+
+/* four blocks in parallel; words are in host order, indexed [word][lane] */
+void SHA1TransformX4(u_int32_t state[5][4], const u_int32_t block[16][4]);
+
+#endif /* _SHA1_H_ */
@@ -37,7 +37,13 @@
 #include <sys/param.h>
 #include <sys/time.h>
 #include <sys/systm.h>
+#include "cpufeat.h"
 #include "sha2.h"	
+
+#ifdef CRYPTO_X86
+#define SHA2_SHANI
+#include <immintrin.h>
+#endif
 	
 /*
  * UNROLLED TRANSFORM LOOP NOTE:
@@ -162,6 +168,7 @@
  */
 void SHA512Last(SHA2_CTX *);
 void SHA256Transform(SHA2_CTX *, const u_int8_t *);
+static void SHA256TransformGeneric(SHA2_CTX *, const u_int8_t *);
 void SHA512Transform(SHA2_CTX *, const u_int8_t *);
 
 
@@ -305,8 +312,8 @@ SHA256Init(SHA2_CTX *context)
 	j++;								    \
 } while(0)
 
-void
-SHA256Transform(SHA2_CTX *context, const u_int8_t *data)
+static void
+SHA256TransformGeneric(SHA2_CTX *context, const u_int8_t *data)
 {
 	u_int32_t	a, b, c, d, e, f, g, h, s0, s1;
 	u_int32_t	T1, *W256;
@@ -365,8 +372,8 @@ SHA256Transform(SHA2_CTX *context, const u_int8_t *data)
 
 #else /* SHA2_UNROLL_TRANSFORM */
 
-void
-SHA256Transform(SHA2_CTX *context, const u_int8_t *data)
+static void
+SHA256TransformGeneric(SHA2_CTX *context, const u_int8_t *data)
 {
 	u_int32_t	a, b, c, d, e, f, g, h, s0, s1;
 	u_int32_t	T1, T2, *W256;
@@ -443,6 +450,207 @@ SHA256Transform(SHA2_CTX *context, const u_int8_t *data)
 
 #endif /* SHA2_UNROLL_TRANSFORM */
 
+#ifdef SHA2_SHANI
+/*
+ * SHA-256 transform using the Intel SHA extensions.  SHA256RNDS2 wants
+ * the state split as ABEF/CDGH rather than ABCD/EFGH, so it is shuffled
+ * on the way in and out; each step below does four rounds and extends
+ * the message schedule for the steps that follow.
+ */
+__attribute__((target("sha,ssse3,sse4.1"), noinline))
+static void
+SHA256TransformSHANI(SHA2_CTX *context, const u_int8_t *data)
+{
+	const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+	    0x0405060700010203ULL);
+	__m128i STATE0, STATE1, ABEF_SAVE, CDGH_SAVE;
+	__m128i MSG, TMP, MSG0, MSG1, MSG2, MSG3;
+
+	TMP = _mm_loadu_si128((const __m128i *)&context->state.st32[0]);
+	STATE1 = _mm_loadu_si128((const __m128i *)&context->state.st32[4]);
+	TMP = _mm_shuffle_epi32(TMP, 0xb1);		/* CDAB */
+	STATE1 = _mm_shuffle_epi32(STATE1, 0x1b);	/* EFGH */
+	STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);	/* ABEF */
+	STATE1 = _mm_blend_epi16(STATE1, TMP, 0xf0);	/* CDGH */
+	ABEF_SAVE = STATE0;
+	CDGH_SAVE = STATE1;
+
+	/* rounds 0-3 */
+	MSG0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 0)), MASK);
+	MSG = _mm_add_epi32(MSG0, _mm_loadu_si128((const __m128i *)&K256[0]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+
+	/* rounds 4-7 */
+	MSG1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), MASK);
+	MSG = _mm_add_epi32(MSG1, _mm_loadu_si128((const __m128i *)&K256[4]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	MSG0 = _mm_sha256msg1_epu32(MSG0, MSG1);
+
+	/* rounds 8-11 */
+	MSG2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), MASK);
+	MSG = _mm_add_epi32(MSG2, _mm_loadu_si128((const __m128i *)&K256[8]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	MSG1 = _mm_sha256msg1_epu32(MSG1, MSG2);
+
+	/* rounds 12-15 */
+	MSG3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), MASK);
+	MSG = _mm_add_epi32(MSG3, _mm_loadu_si128((const __m128i *)&K256[12]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	TMP = _mm_alignr_epi8(MSG3, MSG2, 4);
+	MSG0 = _mm_add_epi32(MSG0, TMP);
+	MSG0 = _mm_sha256msg2_epu32(MSG0, MSG3);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	MSG2 = _mm_sha256msg1_epu32(MSG2, MSG3);
+
+	/* rounds 16-19 */
+	MSG = _mm_add_epi32(MSG0, _mm_loadu_si128((const __m128i *)&K256[16]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	TMP = _mm_alignr_epi8(MSG0, MSG3, 4);
+	MSG1 = _mm_add_epi32(MSG1, TMP);
+	MSG1 = _mm_sha256msg2_epu32(MSG1, MSG0);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	MSG3 = _mm_sha256msg1_epu32(MSG3, MSG0);
+
+	/* rounds 20-23 */
+	MSG = _mm_add_epi32(MSG1, _mm_loadu_si128((const __m128i *)&K256[20]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	TMP = _mm_alignr_epi8(MSG1, MSG0, 4);
+	MSG2 = _mm_add_epi32(MSG2, TMP);
+	MSG2 = _mm_sha256msg2_epu32(MSG2, MSG1);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	MSG0 = _mm_sha256msg1_epu32(MSG0, MSG1);
+
+	/* rounds 24-27 */
+	MSG = _mm_add_epi32(MSG2, _mm_loadu_si128((const __m128i *)&K256[24]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	TMP = _mm_alignr_epi8(MSG2, MSG1, 4);
+	MSG3 = _mm_add_epi32(MSG3, TMP);
+	MSG3 = _mm_sha256msg2_epu32(MSG3, MSG2);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	MSG1 = _mm_sha256msg1_epu32(MSG1, MSG2);
+
+	/* rounds 28-31 */
+	MSG = _mm_add_epi32(MSG3, _mm_loadu_si128((const __m128i *)&K256[28]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	TMP = _mm_alignr_epi8(MSG3, MSG2, 4);
+	MSG0 = _mm_add_epi32(MSG0, TMP);
+	MSG0 = _mm_sha256msg2_epu32(MSG0, MSG3);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	MSG2 = _mm_sha256msg1_epu32(MSG2, MSG3);
+
+	/* rounds 32-35 */
+	MSG = _mm_add_epi32(MSG0, _mm_loadu_si128((const __m128i *)&K256[32]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	TMP = _mm_alignr_epi8(MSG0, MSG3, 4);
+	MSG1 = _mm_add_epi32(MSG1, TMP);
+	MSG1 = _mm_sha256msg2_epu32(MSG1, MSG0);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	MSG3 = _mm_sha256msg1_epu32(MSG3, MSG0);
+
+	/* rounds 36-39 */
+	MSG = _mm_add_epi32(MSG1, _mm_loadu_si128((const __m128i *)&K256[36]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	TMP = _mm_alignr_epi8(MSG1, MSG0, 4);
+	MSG2 = _mm_add_epi32(MSG2, TMP);
+	MSG2 = _mm_sha256msg2_epu32(MSG2, MSG1);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	MSG0 = _mm_sha256msg1_epu32(MSG0, MSG1);
+
+	/* rounds 40-43 */
+	MSG = _mm_add_epi32(MSG2, _mm_loadu_si128((const __m128i *)&K256[40]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	TMP = _mm_alignr_epi8(MSG2, MSG1, 4);
+	MSG3 = _mm_add_epi32(MSG3, TMP);
+	MSG3 = _mm_sha256msg2_epu32(MSG3, MSG2);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	MSG1 = _mm_sha256msg1_epu32(MSG1, MSG2);
+
+	/* rounds 44-47 */
+	MSG = _mm_add_epi32(MSG3, _mm_loadu_si128((const __m128i *)&K256[44]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	TMP = _mm_alignr_epi8(MSG3, MSG2, 4);
+	MSG0 = _mm_add_epi32(MSG0, TMP);
+	MSG0 = _mm_sha256msg2_epu32(MSG0, MSG3);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	MSG2 = _mm_sha256msg1_epu32(MSG2, MSG3);
+
+	/* rounds 48-51 */
+	MSG = _mm_add_epi32(MSG0, _mm_loadu_si128((const __m128i *)&K256[48]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	TMP = _mm_alignr_epi8(MSG0, MSG3, 4);
+	MSG1 = _mm_add_epi32(MSG1, TMP);
+	MSG1 = _mm_sha256msg2_epu32(MSG1, MSG0);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	MSG3 = _mm_sha256msg1_epu32(MSG3, MSG0);
+
+	/* rounds 52-55 */
+	MSG = _mm_add_epi32(MSG1, _mm_loadu_si128((const __m128i *)&K256[52]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	TMP = _mm_alignr_epi8(MSG1, MSG0, 4);
+	MSG2 = _mm_add_epi32(MSG2, TMP);
+	MSG2 = _mm_sha256msg2_epu32(MSG2, MSG1);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+
+	/* rounds 56-59 */
+	MSG = _mm_add_epi32(MSG2, _mm_loadu_si128((const __m128i *)&K256[56]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	TMP = _mm_alignr_epi8(MSG2, MSG1, 4);
+	MSG3 = _mm_add_epi32(MSG3, TMP);
+	MSG3 = _mm_sha256msg2_epu32(MSG3, MSG2);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+
+	/* rounds 60-63 */
+	MSG = _mm_add_epi32(MSG3, _mm_loadu_si128((const __m128i *)&K256[60]));
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+	MSG = _mm_shuffle_epi32(MSG, 0x0e);
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, MSG);
+	STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+	STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+
+	TMP = _mm_shuffle_epi32(STATE0, 0x1b);		/* FEBA */
+	STATE1 = _mm_shuffle_epi32(STATE1, 0xb1);	/* DCHG */
+	STATE0 = _mm_blend_epi16(TMP, STATE1, 0xf0);	/* DCBA */
+	STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);	/* HGFE */
+	_mm_storeu_si128((__m128i *)&context->state.st32[0], STATE0);
+	_mm_storeu_si128((__m128i *)&context->state.st32[4], STATE1);
+}
+#endif /* SHA2_SHANI */
+
+void
+SHA256Transform(SHA2_CTX *context, const u_int8_t *data)
+{
+#ifdef SHA2_SHANI
+	if (crypto_cpu_has(CRYPTO_CPU_SHA | CRYPTO_CPU_SSSE3 |
+	    CRYPTO_CPU_SSE41)) {
+		struct crypto_xmm_state xmm;
+
+		crypto_xmm_save(&xmm);
+		SHA256TransformSHANI(context, data);
+		crypto_xmm_restore(&xmm);
+		return;
+	}
+#endif
+	SHA256TransformGeneric(context, data);
+}
+
 void
 SHA256Update(SHA2_CTX *context, const u_int8_t *data, size_t len)
 {
@@ -67,6 +67,7 @@ int	ieee80211_debug = 0;
 #endif
 
 int ieee80211_cache_size = IEEE80211_CACHE_SIZE;
+int ieee80211_pmksa_max = IEEE80211_PMKSA_MAX;
 
 struct ieee80211com_head ieee80211com_head =
 LIST_HEAD_INITIALIZER(ieee80211com_head);
@@ -51,18 +51,29 @@
 #include "crypto/rijndael.h"
 #include "crypto/cmac.h"
 #include "crypto/key_wrap.h"
+#include "crypto/pbkdf2.h"
 
 #include <IOKit/IOLib.h>
 #include <libkern/OSMalloc.h>
+#include <kern/clock.h>
 
 void Voodoo80211Device::
 ieee80211_crypto_attach(struct ieee80211com *ic)
 {
+	int i;
+
 	TAILQ_INIT(&ic->ic_pmksa);
+	for (i = 0; i < IEEE80211_PMKSA_HASHSIZE; i++) {
+		LIST_INIT(&ic->ic_pmksa_hash[i]);
+		LIST_INIT(&ic->ic_pmksa_idhash[i]);
+	}
+	ic->ic_pmksa_count = 0;
+	ic->ic_pmksa_max = ieee80211_pmksa_max;
 	if (ic->ic_caps & IEEE80211_C_RSN) {
 		ic->ic_rsnprotos = IEEE80211_PROTO_WPA | IEEE80211_PROTO_RSN;
 		ic->ic_rsnakms = IEEE80211_AKM_PSK;
-		ic->ic_rsnciphers = IEEE80211_CIPHER_TKIP | IEEE80211_CIPHER_CCMP;
+		ic->ic_rsnciphers = IEEE80211_CIPHER_TKIP | IEEE80211_CIPHER_CCMP |
+		    IEEE80211_CIPHER_GCMP | IEEE80211_CIPHER_GCMP_256;
 		ic->ic_rsngroupcipher = IEEE80211_CIPHER_TKIP;
 		ic->ic_rsngroupmgmtcipher = IEEE80211_CIPHER_BIP;
 	}
@@ -75,11 +86,8 @@ ieee80211_crypto_detach(struct ieee80211com *ic)
 	int i;
     
 	/* purge the PMKSA cache */
-	while ((pmk = TAILQ_FIRST(&ic->ic_pmksa)) != NULL) {
-		TAILQ_REMOVE(&ic->ic_pmksa, pmk, pmk_next);
-		bzero(pmk, sizeof(*pmk)); // XXX: was explicit_bzero
-		free(pmk);
-	}
+	while ((pmk = TAILQ_FIRST(&ic->ic_pmksa)) != NULL)
+		ieee80211_pmksa_remove(ic, pmk);
     
 	/* clear all group keys from memory */
 	for (i = 0; i < IEEE80211_GROUP_NKID; i++) {
@@ -91,6 +99,7 @@ ieee80211_crypto_detach(struct ieee80211com *ic)
     
 	/* clear pre-shared key from memory */
 	/*explicit_*/bzero(ic->ic_psk, IEEE80211_PMK_LEN);
+	/*explicit_*/bzero(ic->ic_pskcache, sizeof(ic->ic_pskcache));
 }
 
 /*
@@ -110,6 +119,10 @@ ieee80211_cipher_keylen(enum ieee80211_cipher cipher)
             return 13;
         case IEEE80211_CIPHER_BIP:
             return 16;
+        case IEEE80211_CIPHER_GCMP:
+            return 16;
+        case IEEE80211_CIPHER_GCMP_256:
+            return 32;
         default:	/* unknown cipher */
             return 0;
 	}
@@ -132,6 +145,10 @@ ieee80211_set_key(struct ieee80211com *ic, struct ieee80211_node *ni,
         case IEEE80211_CIPHER_CCMP:
             error = ieee80211_ccmp_set_key(ic, k);
             break;
+        case IEEE80211_CIPHER_GCMP:
+        case IEEE80211_CIPHER_GCMP_256:
+            error = ieee80211_gcmp_set_key(ic, k);
+            break;
         case IEEE80211_CIPHER_BIP:
             error = ieee80211_bip_set_key(ic, k);
             break;
@@ -157,6 +174,10 @@ ieee80211_delete_key(struct ieee80211com *ic, struct ieee80211_node *ni,
         case IEEE80211_CIPHER_CCMP:
             ieee80211_ccmp_delete_key(ic, k);
             break;
+        case IEEE80211_CIPHER_GCMP:
+        case IEEE80211_CIPHER_GCMP_256:
+            ieee80211_gcmp_delete_key(ic, k);
+            break;
         case IEEE80211_CIPHER_BIP:
             ieee80211_bip_delete_key(ic, k);
             break;
@@ -202,6 +223,10 @@ ieee80211_encrypt(struct ieee80211com *ic, mbuf_t m0,
         case IEEE80211_CIPHER_CCMP:
             m0 = ieee80211_ccmp_encrypt(ic, m0, k);
             break;
+        case IEEE80211_CIPHER_GCMP:
+        case IEEE80211_CIPHER_GCMP_256:
+            m0 = ieee80211_gcmp_encrypt(ic, m0, k);
+            break;
         case IEEE80211_CIPHER_BIP:
             m0 = ieee80211_bip_encap(ic, m0, k);
             break;
@@ -274,6 +299,10 @@ ieee80211_decrypt(struct ieee80211com *ic, mbuf_t m0,
         case IEEE80211_CIPHER_CCMP:
             m0 = ieee80211_ccmp_decrypt(ic, m0, k);
             break;
+        case IEEE80211_CIPHER_GCMP:
+        case IEEE80211_CIPHER_GCMP_256:
+            m0 = ieee80211_gcmp_decrypt(ic, m0, k);
+            break;
         case IEEE80211_CIPHER_BIP:
             m0 = ieee80211_bip_decap(ic, m0, k);
             break;
@@ -293,14 +322,16 @@ ieee80211_prf(const u_int8_t *key, size_t key_len, const u_int8_t *label,
               size_t label_len, const u_int8_t *context, size_t context_len,
               u_int8_t *output, size_t len)
 {
-	HMAC_SHA1_CTX ctx;
+	HMAC_SHA1_CTX base, ctx;
 	u_int8_t digest[SHA1_DIGEST_LENGTH];
 	u_int8_t count;
     
+	/* only the trailing counter differs between output blocks */
+	HMAC_SHA1_Init(&base, key, key_len);
+	HMAC_SHA1_Update(&base, label, label_len);
+	HMAC_SHA1_Update(&base, context, context_len);
 	for (count = 0; len != 0; count++) {
-		HMAC_SHA1_Init(&ctx, key, key_len);
-		HMAC_SHA1_Update(&ctx, label, label_len);
-		HMAC_SHA1_Update(&ctx, context, context_len);
+		ctx = base;
 		HMAC_SHA1_Update(&ctx, &count, 1);
 		if (len < SHA1_DIGEST_LENGTH) {
 			HMAC_SHA1_Final(digest, &ctx);
@@ -312,6 +343,7 @@ ieee80211_prf(const u_int8_t *key, size_t key_len, const u_int8_t *label,
 		output += SHA1_DIGEST_LENGTH;
 		len -= SHA1_DIGEST_LENGTH;
 	}
+	bzero(&base, sizeof base);
 }
 
 /*
@@ -322,13 +354,15 @@ ieee80211_kdf(const u_int8_t *key, size_t key_len, const u_int8_t *label,
               size_t label_len, const u_int8_t *context, size_t context_len,
               u_int8_t *output, size_t len)
 {
-	HMAC_SHA256_CTX ctx;
+	HMAC_SHA256_CTX base, ctx;
 	u_int8_t digest[SHA256_DIGEST_LENGTH];
 	u_int16_t i, iter, length;
     
+	/* the counter comes first, so only the keyed state can be reused */
+	HMAC_SHA256_Init(&base, key, key_len);
 	length = htole16(len * NBBY);
 	for (i = 1; len != 0; i++) {
-		HMAC_SHA256_Init(&ctx, key, key_len);
+		ctx = base;
 		iter = htole16(i);
 		HMAC_SHA256_Update(&ctx, (u_int8_t *)&iter, sizeof iter);
 		HMAC_SHA256_Update(&ctx, label, label_len);
@@ -344,6 +378,61 @@ ieee80211_kdf(const u_int8_t *key, size_t key_len, const u_int8_t *label,
 		output += SHA256_DIGEST_LENGTH;
 		len -= SHA256_DIGEST_LENGTH;
 	}
+	bzero(&base, sizeof base);
+}
+
+/*
+ * Derive the PSK for an SSID from a WPA passphrase (see M.4.1).  This
+ * takes 4096 PBKDF2 iterations, so results are kept in a small LRU cache
+ * keyed by SSID and a hash of the passphrase; reconnecting to a known
+ * network then costs a single SHA-256.
+ */
+int Voodoo80211Device::
+ieee80211_passphrase_to_pmk(struct ieee80211com *ic, const u_int8_t *essid,
+                            u_int esslen, const char *pass, size_t passlen, u_int8_t *pmk)
+{
+	struct ieee80211_psk_entry *e, *victim = NULL;
+	SHA2_CTX ctx;
+	u_int8_t hash[SHA256_DIGEST_LENGTH];
+	int i;
+    
+	if (passlen < 8 || passlen > 63 || esslen > IEEE80211_NWID_LEN)
+		return EINVAL;
+    
+	SHA256Init(&ctx);
+	SHA256Update(&ctx, (const u_int8_t *)pass, passlen);
+	SHA256Final(hash, &ctx);
+    
+	for (i = 0; i < IEEE80211_PSKCACHE_SIZE; i++) {
+		e = &ic->ic_pskcache[i];
+		if (e->psk_lastuse != 0 && e->psk_esslen == esslen &&
+		    memcmp(e->psk_essid, essid, esslen) == 0 &&
+		    memcmp(e->psk_passhash, hash, sizeof hash) == 0) {
+			memcpy(pmk, e->psk_pmk, IEEE80211_PMK_LEN);
+			e->psk_lastuse = ++ic->ic_pskcache_gen;
+			ic->ic_stats.is_psk_cache_hits++;
+			/*explicit_*/bzero(hash, sizeof hash);
+			return 0;
+		}
+		/* remember the least recently used (or a free) slot */
+		if (victim == NULL || e->psk_lastuse < victim->psk_lastuse)
+			victim = e;
+	}
+    
+	if (pkcs5_pbkdf2(pass, passlen, essid, esslen, pmk,
+	    IEEE80211_PMK_LEN, IEEE80211_PSK_ITERATIONS) != 0) {
+		/*explicit_*/bzero(hash, sizeof hash);
+		return EINVAL;
+	}
+	ic->ic_stats.is_psk_derivations++;
+    
+	memcpy(victim->psk_essid, essid, esslen);
+	victim->psk_esslen = esslen;
+	memcpy(victim->psk_passhash, hash, sizeof hash);
+	memcpy(victim->psk_pmk, pmk, IEEE80211_PMK_LEN);
+	victim->psk_lastuse = ++ic->ic_pskcache_gen;
+	/*explicit_*/bzero(hash, sizeof hash);
+	return 0;
 }
 
 /*
@@ -523,7 +612,35 @@ ieee80211_eapol_key_decrypt(struct ieee80211_eapol_key *key,
 }
 
 /*
- * Add a PMK entry to the PMKSA cache.
+ * Seconds since boot, used to expire PMKSA cache entries.
+ */
+static u_int32_t
+ieee80211_pmksa_now(void)
+{
+	clock_sec_t secs;
+	clock_usec_t usecs;
+
+	clock_get_system_microtime(&secs, &usecs);
+	return (u_int32_t)secs;
+}
+
+/*
+ * Unlink a PMK entry from the PMKSA cache and free it.
+ */
+void Voodoo80211Device::
+ieee80211_pmksa_remove(struct ieee80211com *ic, struct ieee80211_pmk *pmk)
+{
+	TAILQ_REMOVE(&ic->ic_pmksa, pmk, pmk_next);
+	LIST_REMOVE(pmk, pmk_hash);
+	LIST_REMOVE(pmk, pmk_idhash);
+	ic->ic_pmksa_count--;
+	bzero(pmk, sizeof(*pmk)); // XXX: was explicit_bzero
+	free(pmk);
+}
+
+/*
+ * Add a PMK entry to the PMKSA cache.  If the cache is full, the least
+ * recently used entry is recycled.
  */
 struct ieee80211_pmk * Voodoo80211Device::
 ieee80211_pmksa_add(struct ieee80211com *ic, enum ieee80211_akm akm,
@@ -532,30 +649,46 @@ ieee80211_pmksa_add(struct ieee80211com *ic, enum ieee80211_akm akm,
 	struct ieee80211_pmk *pmk;
     
 	/* check if an entry already exists for this (STA,AKMP) */
-	TAILQ_FOREACH(pmk, &ic->ic_pmksa, pmk_next) {
+	LIST_FOREACH(pmk, &ic->ic_pmksa_hash[IEEE80211_PMKSA_HASH(macaddr, akm)],
+	    pmk_hash) {
 		if (pmk->pmk_akm == akm &&
 		    IEEE80211_ADDR_EQ(pmk->pmk_macaddr, macaddr))
 			break;
 	}
 	if (pmk == NULL) {
+		if (ic->ic_pmksa_count >= ic->ic_pmksa_max &&
+		    !TAILQ_EMPTY(&ic->ic_pmksa))
+			ieee80211_pmksa_remove(ic, TAILQ_FIRST(&ic->ic_pmksa));
 		/* allocate a new PMKSA entry */
 		if ((pmk = (ieee80211_pmk*) malloc(sizeof(*pmk), M_DEVBUF, M_NOWAIT)) == NULL)
 			return NULL;
 		pmk->pmk_akm = akm;
 		IEEE80211_ADDR_COPY(pmk->pmk_macaddr, macaddr);
-		TAILQ_INSERT_TAIL(&ic->ic_pmksa, pmk, pmk_next);
+		LIST_INSERT_HEAD(&ic->ic_pmksa_hash[IEEE80211_PMKSA_HASH(macaddr,
+		    akm)], pmk, pmk_hash);
+		ic->ic_pmksa_count++;
+	} else {
+		/* the PMKID changes with the key; rehash it below */
+		LIST_REMOVE(pmk, pmk_idhash);
+		TAILQ_REMOVE(&ic->ic_pmksa, pmk, pmk_next);
 	}
+	TAILQ_INSERT_TAIL(&ic->ic_pmksa, pmk, pmk_next);
 	memcpy(pmk->pmk_key, key, IEEE80211_PMK_LEN);
-	pmk->pmk_lifetime = lifetime;	/* XXX not used yet */
+	pmk->pmk_lifetime = lifetime;
+	pmk->pmk_expire = (lifetime == IEEE80211_PMK_INFINITE) ? 0 :
+	    ieee80211_pmksa_now() + lifetime;
 	{
 		ieee80211_derive_pmkid(pmk->pmk_akm, pmk->pmk_key,
                                macaddr, ic->ic_myaddr, pmk->pmk_pmkid);
 	}
+	LIST_INSERT_HEAD(&ic->ic_pmksa_idhash[IEEE80211_PMKSA_IDHASH(
+	    pmk->pmk_pmkid)], pmk, pmk_idhash);
 	return pmk;
 }
 
 /*
  * Check if we have a cached PMK entry for the specified node and PMKID.
+ * Expired entries are dropped on the way.
  */
 struct ieee80211_pmk * Voodoo80211Device::
 ieee80211_pmksa_find(struct ieee80211com *ic, struct ieee80211_node *ni,
@@ -563,12 +696,34 @@ ieee80211_pmksa_find(struct ieee80211com *ic, struct ieee80211_node *ni,
 {
 	struct ieee80211_pmk *pmk;
     
-	TAILQ_FOREACH(pmk, &ic->ic_pmksa, pmk_next) {
-		if (pmk->pmk_akm == ni->ni_rsnakms &&
-		    IEEE80211_ADDR_EQ(pmk->pmk_macaddr, ni->ni_macaddr) &&
-		    (pmkid == NULL ||
-		     memcmp(pmk->pmk_pmkid, pmkid, IEEE80211_PMKID_LEN) == 0))
-			break;
+	if (pmkid != NULL) {
+		LIST_FOREACH(pmk,
+		    &ic->ic_pmksa_idhash[IEEE80211_PMKSA_IDHASH(pmkid)],
+		    pmk_idhash) {
+			if (memcmp(pmk->pmk_pmkid, pmkid,
+			    IEEE80211_PMKID_LEN) == 0 &&
+			    pmk->pmk_akm == ni->ni_rsnakms &&
+			    IEEE80211_ADDR_EQ(pmk->pmk_macaddr, ni->ni_macaddr))
+				break;
+		}
+	} else {
+		LIST_FOREACH(pmk, &ic->ic_pmksa_hash[IEEE80211_PMKSA_HASH(
+		    ni->ni_macaddr, ni->ni_rsnakms)], pmk_hash) {
+			if (pmk->pmk_akm == ni->ni_rsnakms &&
+			    IEEE80211_ADDR_EQ(pmk->pmk_macaddr, ni->ni_macaddr))
+				break;
+		}
+	}
+	if (pmk == NULL)
+		return NULL;
+    
+	if (pmk->pmk_expire != 0 &&
+	    (int32_t)(ieee80211_pmksa_now() - pmk->pmk_expire) >= 0) {
+		ieee80211_pmksa_remove(ic, pmk);
+		return NULL;
 	}
+	/* move to the most recently used end */
+	TAILQ_REMOVE(&ic->ic_pmksa, pmk, pmk_next);
+	TAILQ_INSERT_TAIL(&ic->ic_pmksa, pmk, pmk_next);
 	return pmk;
 }
\ No newline at end of file
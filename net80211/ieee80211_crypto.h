@@ -35,7 +35,9 @@ enum ieee80211_cipher {
 	IEEE80211_CIPHER_TKIP		= 0x00000004,
 	IEEE80211_CIPHER_CCMP		= 0x00000008,
 	IEEE80211_CIPHER_WEP104		= 0x00000010,
-	IEEE80211_CIPHER_BIP		= 0x00000020	/* 11w */
+	IEEE80211_CIPHER_BIP		= 0x00000020,	/* 11w */
+	IEEE80211_CIPHER_GCMP		= 0x00000040,	/* 11ad */
+	IEEE80211_CIPHER_GCMP_256	= 0x00000080
 };
 
 /*
@@ -63,6 +65,18 @@ ieee80211_is_sha256_akm(enum ieee80211_akm akm)
     akm == IEEE80211_AKM_SHA256_PSK;
 }
 
+/*
+ * Return non-zero for the AES-based data ciphers (CCMP, GCMP), which
+ * mandate the use of EAPOL-Key descriptor version 2.
+ */
+static __inline int
+ieee80211_is_aes_cipher(enum ieee80211_cipher cipher)
+{
+	return cipher == IEEE80211_CIPHER_CCMP ||
+    cipher == IEEE80211_CIPHER_GCMP ||
+    cipher == IEEE80211_CIPHER_GCMP_256;
+}
+
 #define	IEEE80211_KEYBUF_SIZE	16
 
 #define IEEE80211_TKIP_HDRLEN	8
@@ -70,6 +84,8 @@ ieee80211_is_sha256_akm(enum ieee80211_akm akm)
 #define IEEE80211_TKIP_ICVLEN	4
 #define IEEE80211_CCMP_HDRLEN	8
 #define IEEE80211_CCMP_MICLEN	8
+#define IEEE80211_GCMP_HDRLEN	8
+#define IEEE80211_GCMP_MICLEN	16
 
 #define IEEE80211_PMK_LEN	32
 
@@ -90,20 +106,76 @@ struct ieee80211_key {
 };
 
 /*
- * Entry in the PMKSA cache.
+ * Entry in the PMKSA cache.  Entries are hashed by (AA,AKMP) and by
+ * PMKID, and kept on a list in least recently used order so the oldest
+ * one can be recycled once the cache is full.
  */
+#define IEEE80211_PMKSA_HASHSIZE	16	/* must be a power of 2 */
+#define IEEE80211_PMKSA_MAX		32	/* default cap */
+
 struct ieee80211_pmk {
 	enum ieee80211_akm	pmk_akm;
-	u_int32_t		pmk_lifetime;
+	u_int32_t		pmk_lifetime;	/* seconds */
 #define IEEE80211_PMK_INFINITE	0
+	u_int32_t		pmk_expire;	/* uptime when it expires */
     
 	u_int8_t		pmk_pmkid[IEEE80211_PMKID_LEN];
 	u_int8_t		pmk_macaddr[IEEE80211_ADDR_LEN];
 	u_int8_t		pmk_key[IEEE80211_PMK_LEN];
     
-	TAILQ_ENTRY(ieee80211_pmk) pmk_next;
+	TAILQ_ENTRY(ieee80211_pmk) pmk_next;	/* LRU order */
+	LIST_ENTRY(ieee80211_pmk) pmk_hash;	/* by (AA,AKMP) */
+	LIST_ENTRY(ieee80211_pmk) pmk_idhash;	/* by PMKID */
+};
+
+#define IEEE80211_PMKSA_HASH(macaddr, akm)				\
+	(((macaddr)[3] ^ (macaddr)[4] ^ (macaddr)[5] ^ (akm)) &		\
+	 (IEEE80211_PMKSA_HASHSIZE - 1))
+#define IEEE80211_PMKSA_IDHASH(pmkid)					\
+	(((pmkid)[0] ^ (pmkid)[IEEE80211_PMKID_LEN - 1]) &		\
+	 (IEEE80211_PMKSA_HASHSIZE - 1))
+
+/*
+ * Entry in the cache of PMKs derived from a WPA passphrase.  Only a
+ * SHA-256 hash of the passphrase is kept, to tell apart entries for the
+ * same SSID.
+ */
+#define IEEE80211_PSKCACHE_SIZE	8
+#define IEEE80211_PSK_ITERATIONS	4096
+
+struct ieee80211_psk_entry {
+	u_int8_t		psk_essid[IEEE80211_NWID_LEN];
+	u_int8_t		psk_esslen;
+	u_int8_t		psk_passhash[32];
+	u_int8_t		psk_pmk[IEEE80211_PMK_LEN];
+	u_int32_t		psk_lastuse;	/* LRU stamp, 0 if unused */
 };
 
+/*
+ * Formats of the key an association request carries for a PSK network.
+ * A 32 character passphrase is as long as a PMK, so the requester has to
+ * say which one it passes.
+ */
+#define IEEE80211_PSK_PMK		0	/* the PMK itself */
+#define IEEE80211_PSK_PASSPHRASE	1	/* 8 to 63 characters (see M.4.1) */
+
+/*
+ * Check a PSK key against its format.  A PMK is copied to psk and 0 is
+ * returned, a passphrase returns 1 and has to be run through PBKDF2.
+ * Returns -1 if the key is not valid for its format.
+ */
+static __inline int
+ieee80211_psk_key(int format, const u_int8_t *key, size_t len, u_int8_t *psk)
+{
+	if (format == IEEE80211_PSK_PMK && len == IEEE80211_PMK_LEN) {
+		memcpy(psk, key, IEEE80211_PMK_LEN);
+		return 0;
+	}
+	if (format == IEEE80211_PSK_PASSPHRASE && len >= 8 && len <= 63)
+		return 1;
+	return -1;
+}
+
 /* forward references */
 struct	ieee80211com;
 struct	ieee80211_node;
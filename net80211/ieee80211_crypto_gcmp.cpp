@@ -0,0 +1,448 @@
+//
+//  ieee80211_crypto_gcmp.cpp
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+/*
+ * This code implements the Galois/Counter Mode Protocol (GCMP) defined in
+ * IEEE Std 802.11-2012 section 11.4.5, for both 128 and 256-bit keys.
+ *
+ * The frame layout (8 byte header carrying a 48-bit PN, AAD construction)
+ * is shared with CCMP; only the nonce, the counter mode and the 16 byte
+ * MIC computed with GHASH differ.
+ */
+
+#include <sys/param.h>
+#include <sys/systm.h>
+#include <sys/mbuf.h>
+#include <sys/malloc.h>
+#include <sys/kernel.h>
+#include <sys/socket.h>
+#include "sys/endian.h"
+
+#include <net/if.h>
+#include <net/if_dl.h>
+#include <net/if_media.h>
+#include <net/if_arp.h>
+#include <net/if_llc.h>
+
+#ifdef INET
+#include <netinet/in.h>
+#include <netinet/if_ether.h>
+#endif
+
+#include "Voodoo80211Device.h"
+
+#include "crypto/rijndael.h"
+#include "crypto/gmac.h"
+
+static const int MBUF_CLSIZE = 4096;
+
+/* GCMP software crypto context */
+struct ieee80211_gcmp_ctx {
+	rijndael_ctx	rijndael;
+	GHASH_KEY	ghash;
+};
+
+/*
+ * Initialize software crypto context.  This function can be overridden
+ * by drivers doing hardware crypto.
+ */
+int Voodoo80211Device::
+ieee80211_gcmp_set_key(struct ieee80211com *ic, struct ieee80211_key *k)
+{
+	struct ieee80211_gcmp_ctx *ctx;
+	u_int8_t H[GMAC_BLOCK_LEN];
+
+	ctx = (struct ieee80211_gcmp_ctx *)
+            malloc(sizeof(*ctx), M_DEVBUF, M_NOWAIT | M_ZERO);
+	if (ctx == NULL)
+		return ENOMEM;
+	rijndael_set_key_enc_only(&ctx->rijndael, k->k_key,
+	    ieee80211_cipher_keylen(k->k_cipher) * NBBY);
+	/* hash subkey H = E(K, 0^128) */
+	memset(H, 0, sizeof H);
+	rijndael_encrypt(&ctx->rijndael, H, H);
+	ghash_setkey(&ctx->ghash, H);
+	/*explicit_*/bzero(H, sizeof H);
+	k->k_priv = ctx;
+	return 0;
+}
+
+void Voodoo80211Device::
+ieee80211_gcmp_delete_key(struct ieee80211com *ic, struct ieee80211_key *k)
+{
+	if (k->k_priv != NULL) {
+		/*explicit_*/bzero(k->k_priv, sizeof(struct ieee80211_gcmp_ctx));
+		free(k->k_priv);
+	}
+	k->k_priv = NULL;
+}
+
+/*
+ * Construct the AAD (identical to CCMP's, without the l(a) prefix) and
+ * the pre-counter block J0 = A2 || PN || 0^31 || 1.  Returns the length
+ * of the AAD.
+ */
+static int
+ieee80211_gcmp_phase1(const struct ieee80211_frame *wh, u_int64_t pn,
+                      u_int8_t aad[30], u_int8_t j0[16])
+{
+	u_int8_t *p = aad;
+
+	*p = wh->i_fc[0];
+	/* 11w: conditionnally mask subtype field */
+	if ((wh->i_fc[0] & IEEE80211_FC0_TYPE_MASK) ==
+	    IEEE80211_FC0_TYPE_DATA)
+		*p &= ~IEEE80211_FC0_SUBTYPE_MASK;
+	p++;
+	/* protected bit is already set in wh */
+	*p = wh->i_fc[1];
+	*p &= ~(IEEE80211_FC1_RETRY | IEEE80211_FC1_PWR_MGT |
+            IEEE80211_FC1_MORE_DATA);
+	/* 11n: conditionnally mask order bit */
+	if (ieee80211_has_htc(wh))
+		*p &= ~IEEE80211_FC1_ORDER;
+	p++;
+	IEEE80211_ADDR_COPY(p, wh->i_addr1); p += IEEE80211_ADDR_LEN;
+	IEEE80211_ADDR_COPY(p, wh->i_addr2); p += IEEE80211_ADDR_LEN;
+	IEEE80211_ADDR_COPY(p, wh->i_addr3); p += IEEE80211_ADDR_LEN;
+	*p++ = wh->i_seq[0] & ~0xf0;
+	*p++ = 0;
+	if (ieee80211_has_addr4(wh)) {
+		IEEE80211_ADDR_COPY(p,
+                            ((const struct ieee80211_frame_addr4 *)wh)->i_addr4);
+		p += IEEE80211_ADDR_LEN;
+	}
+	if (ieee80211_has_qos(wh)) {
+		*p++ = ieee80211_get_qos(wh) & IEEE80211_QOS_TID;
+		*p++ = 0;
+	}
+
+	/* construct GCM nonce (A2 || PN) followed by a 32-bit counter of 1 */
+	IEEE80211_ADDR_COPY(&j0[0], wh->i_addr2);
+	j0[ 6] = pn >> 40;	/* PN5 */
+	j0[ 7] = pn >> 32;	/* PN4 */
+	j0[ 8] = pn >> 24;	/* PN3 */
+	j0[ 9] = pn >> 16;	/* PN2 */
+	j0[10] = pn >> 8;	/* PN1 */
+	j0[11] = pn;		/* PN0 */
+	j0[12] = j0[13] = j0[14] = 0;
+	j0[15] = 1;
+
+	return p - aad;
+}
+
+/* set the 32-bit counter part of a GCM counter block */
+static __inline void
+ieee80211_gcmp_setctr(u_int8_t a[16], u_int32_t ctr)
+{
+	a[12] = ctr >> 24;
+	a[13] = ctr >> 16;
+	a[14] = ctr >> 8;
+	a[15] = ctr;
+}
+
+mbuf_t Voodoo80211Device::
+ieee80211_gcmp_encrypt(struct ieee80211com *ic, mbuf_t m0,
+                       struct ieee80211_key *k)
+{
+	struct ieee80211_gcmp_ctx *ctx = (struct ieee80211_gcmp_ctx *)k->k_priv;
+	const struct ieee80211_frame *wh;
+	const u_int8_t *src;
+	u_int8_t *ivp, *mic, *dst;
+	u_int8_t aad[30], j0[16], a[16], s[16], tag[GMAC_DIGEST_LEN];
+	GHASH_CTX ghash;
+	mbuf_t n0 = NULL, m, n, n2;
+	int hdrlen, alen, left, moff, noff, len;
+	u_int32_t ctr;
+	int i, j;
+
+	if (mbuf_gethdr(MBUF_DONTWAIT, mbuf_type(m0), &n0) != 0)
+		goto nospace;
+	if (mbuf_copy_pkthdr(n0, m0) != 0)
+		goto nospace;
+	mbuf_pkthdr_adjustlen(n0, IEEE80211_GCMP_HDRLEN);
+	mbuf_setlen(n0, mbuf_get_mhlen());
+	if (mbuf_pkthdr_len(n0) >= mbuf_get_minclsize() - IEEE80211_GCMP_MICLEN) {
+		if (mbuf_getcluster(MBUF_DONTWAIT, mbuf_type(n0), MBUF_CLSIZE, &n0) != 0)
+			goto nospace;
+		mbuf_setlen(n0, MBUF_CLSIZE);
+	}
+	if (mbuf_len(n0) > mbuf_pkthdr_len(n0))
+		mbuf_setlen(n0, mbuf_pkthdr_len(n0));
+
+	/* copy 802.11 header */
+	wh = mtod(m0, struct ieee80211_frame *);
+	hdrlen = ieee80211_get_hdrlen(wh);
+	memcpy(mtod(n0, caddr_t), wh, hdrlen);
+
+	k->k_tsc++;	/* increment the 48-bit PN */
+
+	/* construct GCMP header (same layout as CCMP) */
+	ivp = mtod(n0, u_int8_t *) + hdrlen;
+	ivp[0] = k->k_tsc;		/* PN0 */
+	ivp[1] = k->k_tsc >> 8;		/* PN1 */
+	ivp[2] = 0;			/* Rsvd */
+	ivp[3] = k->k_id << 6 | IEEE80211_WEP_EXTIV;	/* KeyID | ExtIV */
+	ivp[4] = k->k_tsc >> 16;	/* PN2 */
+	ivp[5] = k->k_tsc >> 24;	/* PN3 */
+	ivp[6] = k->k_tsc >> 32;	/* PN4 */
+	ivp[7] = k->k_tsc >> 40;	/* PN5 */
+
+	/* authenticate the AAD */
+	alen = ieee80211_gcmp_phase1(wh, k->k_tsc, aad, j0);
+	ghash_init(&ghash, &ctx->ghash);
+	ghash_update(&ghash, aad, alen);
+	ghash_pad(&ghash);
+
+	/* construct first key stream block E(K, inc32(J0)) */
+	memcpy(a, j0, sizeof a);
+	ctr = 2;
+	ieee80211_gcmp_setctr(a, ctr);
+	rijndael_encrypt(&ctx->rijndael, a, s);
+
+	/* encrypt frame body and hash the cipher text */
+	j = 0;
+	m = m0;
+	n = n0;
+	moff = hdrlen;
+	noff = hdrlen + IEEE80211_GCMP_HDRLEN;
+	left = mbuf_pkthdr_len(m0) - moff;
+	while (left > 0) {
+		if (moff == mbuf_len(m)) {
+			/* nothing left to copy from m */
+			m = mbuf_next(m);
+			moff = 0;
+		}
+		if (noff == mbuf_len(n)) {
+			/* n is full and there's more data to copy */
+			if (mbuf_get(MBUF_DONTWAIT, mbuf_type(n), &n2) != 0)
+				goto nospace;
+			mbuf_setnext(n, n2);
+			n = n2;
+			mbuf_setlen(n, mbuf_get_mlen());
+			if (left >= mbuf_get_minclsize() - IEEE80211_GCMP_MICLEN) {
+				if (mbuf_getcluster(MBUF_DONTWAIT, mbuf_type(n), MBUF_CLSIZE, &n) != 0)
+					goto nospace;
+				mbuf_setlen(n, MBUF_CLSIZE);
+			}
+			if (mbuf_len(n) > left)
+				mbuf_setlen(n, left);
+			noff = 0;
+		}
+		len = min(mbuf_len(m) - moff, mbuf_len(n) - noff);
+
+		src = mtod(m, u_int8_t *) + moff;
+		dst = mtod(n, u_int8_t *) + noff;
+		for (i = 0; i < len; i++) {
+			/* encrypt message */
+			dst[i] = src[i] ^ s[j];
+			if (++j < 16)
+				continue;
+			/* construct a new key stream block */
+			ieee80211_gcmp_setctr(a, ++ctr);
+			rijndael_encrypt(&ctx->rijndael, a, s);
+			j = 0;
+		}
+		ghash_update(&ghash, dst, len);
+
+		moff += len;
+		noff += len;
+		left -= len;
+	}
+
+	/* T = GHASH(A, C) XOR E(K, J0) */
+	ghash_final(tag, &ghash, alen, mbuf_pkthdr_len(m0) - hdrlen);
+	rijndael_encrypt(&ctx->rijndael, j0, s);
+	for (i = 0; i < IEEE80211_GCMP_MICLEN; i++)
+		tag[i] ^= s[i];
+
+	/* reserve trailing space for MIC */
+	if (mbuf_trailingspace(n) < IEEE80211_GCMP_MICLEN) {
+		if (mbuf_get(MBUF_DONTWAIT, mbuf_type(n), &n2) != 0)
+			goto nospace;
+		mbuf_setnext(n, n2);
+		n = n2;
+		mbuf_setlen(n, 0);
+	}
+	mic = mtod(n, u_int8_t *) + mbuf_len(n);
+	memcpy(mic, tag, IEEE80211_GCMP_MICLEN);
+	mbuf_adjustlen(n, IEEE80211_GCMP_MICLEN);
+	mbuf_pkthdr_adjustlen(n0, IEEE80211_GCMP_MICLEN);
+
+	mbuf_freem(m0);
+	return n0;
+nospace:
+	ic->ic_stats.is_tx_nombuf++;
+	mbuf_freem(m0);
+	if (n0 != NULL)
+		mbuf_freem(n0);
+	return NULL;
+}
+
+mbuf_t Voodoo80211Device::
+ieee80211_gcmp_decrypt(struct ieee80211com *ic, mbuf_t m0,
+                       struct ieee80211_key *k)
+{
+	struct ieee80211_gcmp_ctx *ctx = (struct ieee80211_gcmp_ctx *)k->k_priv;
+	struct ieee80211_frame *wh;
+	u_int64_t pn, *prsc;
+	const u_int8_t *ivp, *src;
+	u_int8_t *dst;
+	u_int8_t mic0[IEEE80211_GCMP_MICLEN];
+	u_int8_t aad[30], j0[16], a[16], s[16], tag[GMAC_DIGEST_LEN];
+	GHASH_CTX ghash;
+	mbuf_t n0 = NULL, m, n, n2;
+	int hdrlen, alen, left, moff, noff, len;
+	u_int32_t ctr;
+	int i, j;
+
+	wh = mtod(m0, struct ieee80211_frame *);
+	hdrlen = ieee80211_get_hdrlen(wh);
+	ivp = (u_int8_t *)wh + hdrlen;
+
+	if (mbuf_pkthdr_len(m0) < hdrlen + IEEE80211_GCMP_HDRLEN +
+	    IEEE80211_GCMP_MICLEN) {
+		mbuf_freem(m0);
+		return NULL;
+	}
+	/* check that ExtIV bit is set */
+	if (!(ivp[3] & IEEE80211_WEP_EXTIV)) {
+		mbuf_freem(m0);
+		return NULL;
+	}
+
+	/* retrieve last seen packet number for this frame type/priority */
+	if ((wh->i_fc[0] & IEEE80211_FC0_TYPE_MASK) ==
+	    IEEE80211_FC0_TYPE_DATA) {
+		u_int8_t tid = ieee80211_has_qos(wh) ?
+        ieee80211_get_qos(wh) & IEEE80211_QOS_TID : 0;
+		prsc = &k->k_rsc[tid];
+	} else	/* 11w: management frames have their own counters */
+		prsc = &k->k_mgmt_rsc;
+
+	/* extract the 48-bit PN from the GCMP header */
+	pn = (u_int64_t)ivp[0]       |
+    (u_int64_t)ivp[1] <<  8 |
+    (u_int64_t)ivp[4] << 16 |
+    (u_int64_t)ivp[5] << 24 |
+    (u_int64_t)ivp[6] << 32 |
+    (u_int64_t)ivp[7] << 40;
+	if (pn <= *prsc) {
+		/* replayed frame, discard */
+		ic->ic_stats.is_gcmp_replays++;
+		mbuf_freem(m0);
+		return NULL;
+	}
+
+	if (mbuf_gethdr(MBUF_DONTWAIT, mbuf_type(m0), &n0) != 0)
+		goto nospace;
+	if (mbuf_copy_pkthdr(n0, m0) != 0)
+		goto nospace;
+	mbuf_pkthdr_adjustlen(n0, -(IEEE80211_GCMP_HDRLEN + IEEE80211_GCMP_MICLEN));
+	mbuf_setlen(n0, mbuf_get_mhlen());
+	if (mbuf_pkthdr_len(n0) >= mbuf_get_minclsize()) {
+		if (mbuf_getcluster(MBUF_DONTWAIT, mbuf_type(n0), MBUF_CLSIZE, &n0) != 0)
+			goto nospace;
+		mbuf_setlen(n0, MBUF_CLSIZE);
+	}
+	if (mbuf_len(n0) > mbuf_pkthdr_len(n0))
+		mbuf_setlen(n0, mbuf_pkthdr_len(n0));
+
+	/* authenticate the AAD */
+	alen = ieee80211_gcmp_phase1(wh, pn, aad, j0);
+	ghash_init(&ghash, &ctx->ghash);
+	ghash_update(&ghash, aad, alen);
+	ghash_pad(&ghash);
+
+	/* copy 802.11 header and clear protected bit */
+	memcpy(mtod(n0, caddr_t), wh, hdrlen);
+	wh = mtod(n0, struct ieee80211_frame *);
+	wh->i_fc[1] &= ~IEEE80211_FC1_PROTECTED;
+
+	/* construct first key stream block E(K, inc32(J0)) */
+	memcpy(a, j0, sizeof a);
+	ctr = 2;
+	ieee80211_gcmp_setctr(a, ctr);
+	rijndael_encrypt(&ctx->rijndael, a, s);
+
+	/* hash the cipher text and decrypt frame body */
+	j = 0;
+	m = m0;
+	n = n0;
+	moff = hdrlen + IEEE80211_GCMP_HDRLEN;
+	noff = hdrlen;
+	left = mbuf_pkthdr_len(n0) - noff;
+	while (left > 0) {
+		if (moff == mbuf_len(m)) {
+			/* nothing left to copy from m */
+			m = mbuf_next(m);
+			moff = 0;
+		}
+		if (noff == mbuf_len(n)) {
+			/* n is full and there's more data to copy */
+			if (mbuf_get(MBUF_DONTWAIT, mbuf_type(n), &n2) != 0)
+				goto nospace;
+			mbuf_setnext(n, n2);
+			n = n2;
+			mbuf_setlen(n, mbuf_get_mlen());
+			if (left >= mbuf_get_minclsize()) {
+				if (mbuf_getcluster(MBUF_DONTWAIT, mbuf_type(n), MBUF_CLSIZE, &n) != 0)
+					goto nospace;
+				mbuf_setlen(n, MBUF_CLSIZE);
+			}
+			if (mbuf_len(n) > left)
+				mbuf_setlen(n, left);
+			noff = 0;
+		}
+		len = min(mbuf_len(m) - moff, mbuf_len(n) - noff);
+
+		src = mtod(m, u_int8_t *) + moff;
+		dst = mtod(n, u_int8_t *) + noff;
+		ghash_update(&ghash, src, len);
+		for (i = 0; i < len; i++) {
+			/* decrypt message */
+			dst[i] = src[i] ^ s[j];
+			if (++j < 16)
+				continue;
+			/* construct a new key stream block */
+			ieee80211_gcmp_setctr(a, ++ctr);
+			rijndael_encrypt(&ctx->rijndael, a, s);
+			j = 0;
+		}
+
+		moff += len;
+		noff += len;
+		left -= len;
+	}
+
+	/* T = GHASH(A, C) XOR E(K, J0) */
+	ghash_final(tag, &ghash, alen, mbuf_pkthdr_len(n0) - hdrlen);
+	rijndael_encrypt(&ctx->rijndael, j0, s);
+	for (i = 0; i < IEEE80211_GCMP_MICLEN; i++)
+		tag[i] ^= s[i];
+
+	/* check that it matches the MIC in received frame */
+	mbuf_copydata(m, moff, IEEE80211_GCMP_MICLEN, mic0);
+	if (bcmp(mic0, tag, IEEE80211_GCMP_MICLEN) != 0) {
+		ic->ic_stats.is_gcmp_dec_errs++;
+		mbuf_freem(m0);
+		mbuf_freem(n0);
+		return NULL;
+	}
+
+	/* update last seen packet number (MIC is validated) */
+	*prsc = pn;
+
+	mbuf_freem(m0);
+	return n0;
+nospace:
+	ic->ic_stats.is_rx_nombuf++;
+	mbuf_freem(m0);
+	if (n0 != NULL)
+		mbuf_freem(n0);
+	return NULL;
+}
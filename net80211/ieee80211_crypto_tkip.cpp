@@ -0,0 +1,651 @@
+//
+//  ieee80211_crypto_tkip.cpp
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+/*
+ * This code implements the Temporal Key Integrity Protocol (TKIP) defined
+ * in IEEE Std 802.11-2007 section 8.3.2, in software.
+ *
+ * The per-packet key mixing is split in two phases: phase 1 only depends
+ * on the upper 32 bits of the TSC (IV32) and is cached per direction so
+ * that it runs once every 65536 frames; phase 2 runs for every frame.
+ */
+
+#include <sys/param.h>
+#include <sys/systm.h>
+#include <sys/mbuf.h>
+#include <sys/malloc.h>
+#include <sys/kernel.h>
+#include <sys/socket.h>
+#include "sys/endian.h"
+
+#include <net/if.h>
+#include <net/if_dl.h>
+#include <net/if_media.h>
+#include <net/if_arp.h>
+#include <net/if_llc.h>
+
+#ifdef INET
+#include <netinet/in.h>
+#include <netinet/if_ether.h>
+#endif
+
+#include "Voodoo80211Device.h"
+
+#include "crypto/arc4.h"
+#include "crypto/michael.h"
+
+#include <kern/clock.h>
+
+static const int MBUF_CLSIZE = 4096;
+
+/* shortcuts */
+#define IEEE80211_TKIP_TAILLEN	(IEEE80211_TKIP_MICLEN + IEEE80211_WEP_CRCLEN)
+#define IEEE80211_TKIP_OVHD	(IEEE80211_TKIP_HDRLEN + IEEE80211_TKIP_TAILLEN)
+
+/* TKIP software crypto context */
+struct ieee80211_tkip_ctx {
+	struct rc4_ctx	rc4;
+	const u_int8_t	*txmic;
+	const u_int8_t	*rxmic;
+	u_int16_t	txttak[5];	/* phase 1 output for txttak_iv32 */
+	u_int16_t	rxttak[5];	/* phase 1 output for rxttak_iv32 */
+	u_int32_t	txttak_iv32;
+	u_int32_t	rxttak_iv32;
+	u_int8_t	txttak_ok;
+	u_int8_t	rxttak_ok;
+};
+
+/*
+ * Initialize software crypto context.  This function can be overridden
+ * by drivers doing hardware crypto.
+ */
+int Voodoo80211Device::
+ieee80211_tkip_set_key(struct ieee80211com *ic, struct ieee80211_key *k)
+{
+	struct ieee80211_tkip_ctx *ctx;
+    
+	ctx = (struct ieee80211_tkip_ctx *)
+            malloc(sizeof(*ctx), M_DEVBUF, M_NOWAIT | M_ZERO);
+	if (ctx == NULL)
+		return ENOMEM;
+	/*
+	 * Use bits 128-191 as the Michael key for AA->SPA and bits
+	 * 192-255 as the Michael key for SPA->AA.
+	 */
+	ctx->rxmic = &k->k_key[16];
+	ctx->txmic = &k->k_key[24];
+	k->k_priv = ctx;
+	return 0;
+}
+
+void Voodoo80211Device::
+ieee80211_tkip_delete_key(struct ieee80211com *ic, struct ieee80211_key *k)
+{
+	if (k->k_priv != NULL) {
+		/*explicit_*/bzero(k->k_priv, sizeof(struct ieee80211_tkip_ctx));
+		free(k->k_priv);
+	}
+	k->k_priv = NULL;
+}
+
+/*
+ * Compute TKIP MIC over an mbuf chain starting "off" bytes from the
+ * beginning.  Each mbuf is fed to Michael in place; only a word that
+ * straddles two mbufs is assembled byte by byte.  This function does not
+ * use the software crypto context so that drivers doing hardware crypto
+ * but not MIC can call it.
+ */
+void Voodoo80211Device::
+ieee80211_tkip_mic(mbuf_t m0, int off, const u_int8_t *key,
+                   u_int8_t mic[IEEE80211_TKIP_MICLEN])
+{
+	const struct ieee80211_frame *wh;
+	u_int8_t wbuf[16];
+	MICHAEL_CTX ctx;
+	mbuf_t m;
+	int left, len;
+    
+	michael_init(&ctx);
+	michael_key(key, &ctx);
+    
+	/* construct the pseudo-header: DA, SA, priority, 3 reserved bytes */
+	wh = mtod(m0, struct ieee80211_frame *);
+	switch (wh->i_fc[1] & IEEE80211_FC1_DIR_MASK) {
+        case IEEE80211_FC1_DIR_NODS:
+            IEEE80211_ADDR_COPY(wbuf, wh->i_addr1);
+            IEEE80211_ADDR_COPY(wbuf + 6, wh->i_addr2);
+            break;
+        case IEEE80211_FC1_DIR_TODS:
+            IEEE80211_ADDR_COPY(wbuf, wh->i_addr3);
+            IEEE80211_ADDR_COPY(wbuf + 6, wh->i_addr2);
+            break;
+        case IEEE80211_FC1_DIR_FROMDS:
+            IEEE80211_ADDR_COPY(wbuf, wh->i_addr1);
+            IEEE80211_ADDR_COPY(wbuf + 6, wh->i_addr3);
+            break;
+        case IEEE80211_FC1_DIR_DSTODS:
+            IEEE80211_ADDR_COPY(wbuf, wh->i_addr3);
+            IEEE80211_ADDR_COPY(wbuf + 6,
+                                ((const struct ieee80211_frame_addr4 *)wh)->i_addr4);
+            break;
+	}
+	if (ieee80211_has_qos(wh))
+		wbuf[12] = ieee80211_get_qos(wh) & IEEE80211_QOS_TID;
+	else
+		wbuf[12] = 0;
+	wbuf[13] = wbuf[14] = wbuf[15] = 0;
+	michael_update(&ctx, wbuf, sizeof wbuf);
+    
+	left = mbuf_pkthdr_len(m0) - off;
+	m = m0;
+	while (m != NULL && off >= (int)mbuf_len(m)) {
+		off -= mbuf_len(m);
+		m = mbuf_next(m);
+	}
+	while (left > 0 && m != NULL) {
+		len = min(mbuf_len(m) - off, left);
+		michael_update(&ctx, mtod(m, u_int8_t *) + off, len);
+		left -= len;
+		m = mbuf_next(m);
+		off = 0;
+	}
+	michael_final(mic, &ctx);
+}
+
+/*
+ * CRC-32 used for the WEP ICV (same as the Ethernet FCS, LSB first).
+ */
+static u_int32_t
+ieee80211_tkip_crc32(u_int32_t crc, const u_int8_t *buf, size_t len)
+{
+	static const u_int32_t crctab[] = {
+		0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+		0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+		0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+		0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+	};
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		crc ^= buf[i];
+		crc = (crc >> 4) ^ crctab[crc & 0xf];
+		crc = (crc >> 4) ^ crctab[crc & 0xf];
+	}
+	return crc;
+}
+
+/*-
+ * TKIP key mixing functions (see 8.3.2.5).
+ */
+static const u_int16_t Sbox[256] = {
+	0xc6a5, 0xf884, 0xee99, 0xf68d, 0xff0d, 0xd6bd, 0xdeb1, 0x9154,
+	0x6050, 0x0203, 0xcea9, 0x567d, 0xe719, 0xb562, 0x4de6, 0xec9a,
+	0x8f45, 0x1f9d, 0x8940, 0xfa87, 0xef15, 0xb2eb, 0x8ec9, 0xfb0b,
+	0x41ec, 0xb367, 0x5ffd, 0x45ea, 0x23bf, 0x53f7, 0xe496, 0x9b5b,
+	0x75c2, 0xe11c, 0x3dae, 0x4c6a, 0x6c5a, 0x7e41, 0xf502, 0x834f,
+	0x685c, 0x51f4, 0xd134, 0xf908, 0xe293, 0xab73, 0x6253, 0x2a3f,
+	0x080c, 0x9552, 0x4665, 0x9d5e, 0x3028, 0x37a1, 0x0a0f, 0x2fb5,
+	0x0e09, 0x2436, 0x1b9b, 0xdf3d, 0xcd26, 0x4e69, 0x7fcd, 0xea9f,
+	0x121b, 0x1d9e, 0x5874, 0x342e, 0x362d, 0xdcb2, 0xb4ee, 0x5bfb,
+	0xa4f6, 0x764d, 0xb761, 0x7dce, 0x527b, 0xdd3e, 0x5e71, 0x1397,
+	0xa6f5, 0xb968, 0x0000, 0xc12c, 0x4060, 0xe31f, 0x79c8, 0xb6ed,
+	0xd4be, 0x8d46, 0x67d9, 0x724b, 0x94de, 0x98d4, 0xb0e8, 0x854a,
+	0xbb6b, 0xc52a, 0x4fe5, 0xed16, 0x86c5, 0x9ad7, 0x6655, 0x1194,
+	0x8acf, 0xe910, 0x0406, 0xfe81, 0xa0f0, 0x7844, 0x25ba, 0x4be3,
+	0xa2f3, 0x5dfe, 0x80c0, 0x058a, 0x3fad, 0x21bc, 0x7048, 0xf104,
+	0x63df, 0x77c1, 0xaf75, 0x4263, 0x2030, 0xe51a, 0xfd0e, 0xbf6d,
+	0x814c, 0x1814, 0x2635, 0xc32f, 0xbee1, 0x35a2, 0x88cc, 0x2e39,
+	0x9357, 0x55f2, 0xfc82, 0x7a47, 0xc8ac, 0xbae7, 0x322b, 0xe695,
+	0xc0a0, 0x1998, 0x9ed1, 0xa37f, 0x4466, 0x547e, 0x3bab, 0x0b83,
+	0x8cca, 0xc729, 0x6bd3, 0x283c, 0xa779, 0xbce2, 0x161d, 0xad76,
+	0xdb3b, 0x6456, 0x744e, 0x141e, 0x92db, 0x0c0a, 0x486c, 0xb8e4,
+	0x9f5d, 0xbd6e, 0x43ef, 0xc4a6, 0x39a8, 0x31a4, 0xd337, 0xf28b,
+	0xd532, 0x8b43, 0x6e59, 0xdab7, 0x018c, 0xb164, 0x9cd2, 0x49e0,
+	0xd8b4, 0xacfa, 0xf307, 0xcf25, 0xcaaf, 0xf48e, 0x47e9, 0x1018,
+	0x6fd5, 0xf088, 0x4a6f, 0x5c72, 0x3824, 0x57f1, 0x73c7, 0x9751,
+	0xcb23, 0xa17c, 0xe89c, 0x3e21, 0x96dd, 0x61dc, 0x0d86, 0x0f85,
+	0xe090, 0x7c42, 0x71c4, 0xccaa, 0x90d8, 0x0605, 0xf701, 0x1c12,
+	0xc2a3, 0x6a5f, 0xaef9, 0x69d0, 0x1791, 0x9958, 0x3a27, 0x27b9,
+	0xd938, 0xeb13, 0x2bb3, 0x2233, 0xd2bb, 0xa970, 0x0789, 0x33a7,
+	0x2db6, 0x3c22, 0x1592, 0xc920, 0x8749, 0xaaff, 0x5078, 0xa57a,
+	0x038f, 0x59f8, 0x0980, 0x1a17, 0x65da, 0xd731, 0x84c6, 0xd0b8,
+	0x82c3, 0x29b0, 0x5a77, 0x1e11, 0x7bcb, 0xa8fc, 0x6dd6, 0x2c3a,
+};
+
+#define Lo8(v)		((v) & 0xff)
+#define Hi8(v)		((v) >> 8)
+#define Lo16(v)		((v) & 0xffff)
+#define Hi16(v)		((v) >> 16)
+#define Mk16(hi, lo)	((lo) | (hi) << 8)
+#define RotR1(v)	((u_int16_t)(((v) >> 1) | ((v) << 15)))
+#define TK16(N)		Mk16(tk[2 * (N) + 1], tk[2 * (N)])
+#define _S_(v)		(Sbox[Lo8(v)] ^ swap16(Sbox[Hi8(v)]))
+
+static __inline u_int16_t
+swap16(u_int16_t v)
+{
+	return v << 8 | v >> 8;
+}
+
+/*
+ * Phase 1: mix the temporal key, transmitter address and IV32 into the
+ * 80-bit TTAK.
+ */
+static void
+Phase1(u_int16_t *p1k, const u_int8_t *tk, const u_int8_t *ta, u_int32_t iv32)
+{
+	int i;
+
+	p1k[0] = Lo16(iv32);
+	p1k[1] = Hi16(iv32);
+	p1k[2] = Mk16(ta[1], ta[0]);
+	p1k[3] = Mk16(ta[3], ta[2]);
+	p1k[4] = Mk16(ta[5], ta[4]);
+
+	/* unbalanced Feistel cipher with 80-bit block, 128-bit key */
+	for (i = 0; i < 8; i++) {
+		p1k[0] += _S_(p1k[4] ^ TK16((i & 1) + 0));
+		p1k[1] += _S_(p1k[0] ^ TK16((i & 1) + 2));
+		p1k[2] += _S_(p1k[1] ^ TK16((i & 1) + 4));
+		p1k[3] += _S_(p1k[2] ^ TK16((i & 1) + 6));
+		p1k[4] += _S_(p1k[3] ^ TK16((i & 1) + 0));
+		p1k[4] += i;	/* avoid "slide attacks" */
+	}
+}
+
+/*
+ * Phase 2: mix the TTAK and IV16 into the 128-bit per-packet WEP seed.
+ */
+static void
+Phase2(u_int8_t *rc4key, const u_int8_t *tk, const u_int16_t *p1k,
+    u_int16_t iv16)
+{
+	u_int16_t ppk[6];
+	int i;
+
+	ppk[0] = p1k[0];
+	ppk[1] = p1k[1];
+	ppk[2] = p1k[2];
+	ppk[3] = p1k[3];
+	ppk[4] = p1k[4];
+	ppk[5] = p1k[4] + iv16;
+
+	/* bijective non-linear mixing of the 96 bits of PPK */
+	ppk[0] += _S_(ppk[5] ^ TK16(0));
+	ppk[1] += _S_(ppk[0] ^ TK16(1));
+	ppk[2] += _S_(ppk[1] ^ TK16(2));
+	ppk[3] += _S_(ppk[2] ^ TK16(3));
+	ppk[4] += _S_(ppk[3] ^ TK16(4));
+	ppk[5] += _S_(ppk[4] ^ TK16(5));
+
+	/* final sweep: bijective, "linear"; rotates kill LSB correlations */
+	ppk[0] += RotR1((u_int16_t)(ppk[5] ^ TK16(6)));
+	ppk[1] += RotR1((u_int16_t)(ppk[0] ^ TK16(7)));
+	ppk[2] += RotR1(ppk[1]);
+	ppk[3] += RotR1(ppk[2]);
+	ppk[4] += RotR1(ppk[3]);
+	ppk[5] += RotR1(ppk[4]);
+
+	/* WEP seed = IV16 with the weak key avoidance byte, then PPK */
+	rc4key[0] = Hi8(iv16);
+	rc4key[1] = (Hi8(iv16) | 0x20) & 0x7f;
+	rc4key[2] = Lo8(iv16);
+	rc4key[3] = Lo8((u_int16_t)(ppk[5] ^ TK16(0)) >> 1);
+	for (i = 0; i < 6; i++) {
+		rc4key[4 + 2 * i] = Lo8(ppk[i]);
+		rc4key[5 + 2 * i] = Hi8(ppk[i]);
+	}
+	/*explicit_*/bzero(ppk, sizeof ppk);
+}
+
+mbuf_t Voodoo80211Device::
+ieee80211_tkip_encrypt(struct ieee80211com *ic, mbuf_t m0,
+                       struct ieee80211_key *k)
+{
+	struct ieee80211_tkip_ctx *ctx = (struct ieee80211_tkip_ctx *)k->k_priv;
+	u_int8_t wepseed[16];
+	const struct ieee80211_frame *wh;
+	u_int8_t *ivp, *mic, *icv;
+	mbuf_t n0 = NULL, m, n, n2;
+	u_int32_t crc, iv32;
+	int left, moff, noff, len, hdrlen;
+    
+	if (mbuf_gethdr(MBUF_DONTWAIT, mbuf_type(m0), &n0) != 0)
+		goto nospace;
+	if (mbuf_copy_pkthdr(n0, m0) != 0)
+		goto nospace;
+	mbuf_pkthdr_adjustlen(n0, IEEE80211_TKIP_HDRLEN);
+	mbuf_setlen(n0, mbuf_get_mhlen());
+	if (mbuf_pkthdr_len(n0) >= mbuf_get_minclsize() - IEEE80211_TKIP_TAILLEN) {
+		if (mbuf_getcluster(MBUF_DONTWAIT, mbuf_type(n0), MBUF_CLSIZE, &n0) != 0)
+			goto nospace;
+		mbuf_setlen(n0, MBUF_CLSIZE);
+	}
+	if (mbuf_len(n0) > mbuf_pkthdr_len(n0))
+		mbuf_setlen(n0, mbuf_pkthdr_len(n0));
+    
+	/* copy 802.11 header */
+	wh = mtod(m0, struct ieee80211_frame *);
+	hdrlen = ieee80211_get_hdrlen(wh);
+	memcpy(mtod(n0, caddr_t), wh, hdrlen);
+    
+	k->k_tsc++;	/* increment the 48-bit TSC */
+    
+	/* construct TKIP header */
+	ivp = mtod(n0, u_int8_t *) + hdrlen;
+	ivp[0] = k->k_tsc >> 8;		/* TSC1 */
+	/* WEP Seed = (TSC1 | 0x20) & 0x7f (see 8.3.2.2) */
+	ivp[1] = (ivp[0] | 0x20) & 0x7f;
+	ivp[2] = k->k_tsc;		/* TSC0 */
+	ivp[3] = k->k_id << 6 | IEEE80211_WEP_EXTIV;	/* KeyID | ExtIV */
+	ivp[4] = k->k_tsc >> 16;	/* TSC2 */
+	ivp[5] = k->k_tsc >> 24;	/* TSC3 */
+	ivp[6] = k->k_tsc >> 32;	/* TSC4 */
+	ivp[7] = k->k_tsc >> 40;	/* TSC5 */
+    
+	/* compute WEP seed, redoing phase 1 only when IV32 moves */
+	iv32 = (u_int32_t)(k->k_tsc >> 16);
+	if (!ctx->txttak_ok || ctx->txttak_iv32 != iv32) {
+		Phase1(ctx->txttak, k->k_key, wh->i_addr2, iv32);
+		ctx->txttak_iv32 = iv32;
+		ctx->txttak_ok = 1;
+	}
+	Phase2(wepseed, k->k_key, ctx->txttak, k->k_tsc & 0xffff);
+	rc4_keysetup(&ctx->rc4, wepseed, sizeof wepseed);
+	/*explicit_*/bzero(wepseed, sizeof wepseed);
+    
+	/* encrypt frame body and compute WEP ICV */
+	m = m0;
+	n = n0;
+	moff = hdrlen;
+	noff = hdrlen + IEEE80211_TKIP_HDRLEN;
+	left = mbuf_pkthdr_len(m0) - moff;
+	crc = ~0;
+	while (left > 0) {
+		if (moff == mbuf_len(m)) {
+			/* nothing left to copy from m */
+			m = mbuf_next(m);
+			moff = 0;
+		}
+		if (noff == mbuf_len(n)) {
+			/* n is full and there's more data to copy */
+			if (mbuf_get(MBUF_DONTWAIT, mbuf_type(n), &n2) != 0)
+				goto nospace;
+			mbuf_setnext(n, n2);
+			n = n2;
+			mbuf_setlen(n, mbuf_get_mlen());
+			if (left >= mbuf_get_minclsize() - IEEE80211_TKIP_TAILLEN) {
+				if (mbuf_getcluster(MBUF_DONTWAIT, mbuf_type(n), MBUF_CLSIZE, &n) != 0)
+					goto nospace;
+				mbuf_setlen(n, MBUF_CLSIZE);
+			}
+			if (mbuf_len(n) > left)
+				mbuf_setlen(n, left);
+			noff = 0;
+		}
+		len = min(mbuf_len(m) - moff, mbuf_len(n) - noff);
+        
+		crc = ieee80211_tkip_crc32(crc, mtod(m, u_int8_t *) + moff, len);
+		rc4_crypt(&ctx->rc4, mtod(m, u_int8_t *) + moff,
+		    mtod(n, u_int8_t *) + noff, len);
+        
+		moff += len;
+		noff += len;
+		left -= len;
+	}
+    
+	/* reserve trailing space for TKIP MIC and WEP ICV */
+	if (mbuf_trailingspace(n) < IEEE80211_TKIP_TAILLEN) {
+		if (mbuf_get(MBUF_DONTWAIT, mbuf_type(n), &n2) != 0)
+			goto nospace;
+		mbuf_setnext(n, n2);
+		n = n2;
+		mbuf_setlen(n, 0);
+	}
+    
+	/* compute TKIP MIC over clear text */
+	mic = mtod(n, u_int8_t *) + mbuf_len(n);
+	ieee80211_tkip_mic(m0, hdrlen, ctx->txmic, mic);
+	crc = ieee80211_tkip_crc32(crc, mic, IEEE80211_TKIP_MICLEN);
+	rc4_crypt(&ctx->rc4, mic, mic, IEEE80211_TKIP_MICLEN);
+	mbuf_adjustlen(n, IEEE80211_TKIP_MICLEN);
+    
+	/* finalize WEP ICV */
+	icv = mtod(n, u_int8_t *) + mbuf_len(n);
+	crc = ~crc;
+	icv[0] = crc;
+	icv[1] = crc >> 8;
+	icv[2] = crc >> 16;
+	icv[3] = crc >> 24;
+	rc4_crypt(&ctx->rc4, icv, icv, IEEE80211_WEP_CRCLEN);
+	mbuf_adjustlen(n, IEEE80211_WEP_CRCLEN);
+    
+	mbuf_pkthdr_adjustlen(n0, IEEE80211_TKIP_TAILLEN);
+    
+	mbuf_freem(m0);
+	return n0;
+nospace:
+	ic->ic_stats.is_tx_nombuf++;
+	mbuf_freem(m0);
+	if (n0 != NULL)
+		mbuf_freem(n0);
+	return NULL;
+}
+
+mbuf_t Voodoo80211Device::
+ieee80211_tkip_decrypt(struct ieee80211com *ic, mbuf_t m0,
+                       struct ieee80211_key *k)
+{
+	struct ieee80211_tkip_ctx *ctx = (struct ieee80211_tkip_ctx *)k->k_priv;
+	struct ieee80211_frame *wh;
+	u_int8_t wepseed[16];
+	u_int8_t buf[IEEE80211_TKIP_TAILLEN];
+	u_int8_t mic[IEEE80211_TKIP_MICLEN];
+	u_int64_t tsc, *prsc;
+	u_int32_t crc, iv32;
+	mbuf_t n0 = NULL, m, n, n2;
+	u_int8_t *ivp, *mic0, *crc0;
+	u_int8_t tid;
+	int hdrlen, left, moff, noff, len;
+    
+	wh = mtod(m0, struct ieee80211_frame *);
+	hdrlen = ieee80211_get_hdrlen(wh);
+    
+	if (mbuf_pkthdr_len(m0) < hdrlen + IEEE80211_TKIP_OVHD) {
+		mbuf_freem(m0);
+		return NULL;
+	}
+    
+	ivp = (u_int8_t *)wh + hdrlen;
+	/* check that ExtIV bit is set */
+	if (!(ivp[3] & IEEE80211_WEP_EXTIV)) {
+		mbuf_freem(m0);
+		return NULL;
+	}
+    
+	/* retrieve last seen packet number for this frame priority */
+	tid = ieee80211_has_qos(wh) ?
+	    ieee80211_get_qos(wh) & IEEE80211_QOS_TID : 0;
+	prsc = &k->k_rsc[tid];
+    
+	/* extract the 48-bit TSC from the TKIP header */
+	tsc = (u_int64_t)ivp[2]      |
+	      (u_int64_t)ivp[0] <<  8 |
+	      (u_int64_t)ivp[4] << 16 |
+	      (u_int64_t)ivp[5] << 24 |
+	      (u_int64_t)ivp[6] << 32 |
+	      (u_int64_t)ivp[7] << 40;
+	if (tsc <= *prsc) {
+		/* replayed frame, discard */
+		ic->ic_stats.is_tkip_replays++;
+		mbuf_freem(m0);
+		return NULL;
+	}
+    
+	/*
+	 * Compute WEP seed.  Phase 1 is a function of (TK, TA, IV32) only,
+	 * so the cached TTAK stays valid whatever the fate of this frame.
+	 */
+	iv32 = (u_int32_t)(tsc >> 16);
+	if (!ctx->rxttak_ok || ctx->rxttak_iv32 != iv32) {
+		Phase1(ctx->rxttak, k->k_key, wh->i_addr2, iv32);
+		ctx->rxttak_iv32 = iv32;
+		ctx->rxttak_ok = 1;
+	}
+	Phase2(wepseed, k->k_key, ctx->rxttak, tsc & 0xffff);
+	rc4_keysetup(&ctx->rc4, wepseed, sizeof wepseed);
+	/*explicit_*/bzero(wepseed, sizeof wepseed);
+    
+	if (mbuf_gethdr(MBUF_DONTWAIT, mbuf_type(m0), &n0) != 0)
+		goto nospace;
+	if (mbuf_copy_pkthdr(n0, m0) != 0)
+		goto nospace;
+	mbuf_pkthdr_adjustlen(n0, -IEEE80211_TKIP_OVHD);
+	mbuf_setlen(n0, mbuf_get_mhlen());
+	if (mbuf_pkthdr_len(n0) >= mbuf_get_minclsize()) {
+		if (mbuf_getcluster(MBUF_DONTWAIT, mbuf_type(n0), MBUF_CLSIZE, &n0) != 0)
+			goto nospace;
+		mbuf_setlen(n0, MBUF_CLSIZE);
+	}
+	if (mbuf_len(n0) > mbuf_pkthdr_len(n0))
+		mbuf_setlen(n0, mbuf_pkthdr_len(n0));
+    
+	/* copy 802.11 header and clear protected bit */
+	memcpy(mtod(n0, caddr_t), wh, hdrlen);
+	wh = mtod(n0, struct ieee80211_frame *);
+	wh->i_fc[1] &= ~IEEE80211_FC1_PROTECTED;
+    
+	/* decrypt frame body and compute WEP ICV */
+	m = m0;
+	n = n0;
+	moff = hdrlen + IEEE80211_TKIP_HDRLEN;
+	noff = hdrlen;
+	left = mbuf_pkthdr_len(n0) - noff;
+	crc = ~0;
+	while (left > 0) {
+		if (moff == mbuf_len(m)) {
+			/* nothing left to copy from m */
+			m = mbuf_next(m);
+			moff = 0;
+		}
+		if (noff == mbuf_len(n)) {
+			/* n is full and there's more data to copy */
+			if (mbuf_get(MBUF_DONTWAIT, mbuf_type(n), &n2) != 0)
+				goto nospace;
+			mbuf_setnext(n, n2);
+			n = n2;
+			mbuf_setlen(n, mbuf_get_mlen());
+			if (left >= mbuf_get_minclsize()) {
+				if (mbuf_getcluster(MBUF_DONTWAIT, mbuf_type(n), MBUF_CLSIZE, &n) != 0)
+					goto nospace;
+				mbuf_setlen(n, MBUF_CLSIZE);
+			}
+			if (mbuf_len(n) > left)
+				mbuf_setlen(n, left);
+			noff = 0;
+		}
+		len = min(mbuf_len(m) - moff, mbuf_len(n) - noff);
+        
+		rc4_crypt(&ctx->rc4, mtod(m, u_int8_t *) + moff,
+		    mtod(n, u_int8_t *) + noff, len);
+		crc = ieee80211_tkip_crc32(crc, mtod(n, u_int8_t *) + noff, len);
+        
+		moff += len;
+		noff += len;
+		left -= len;
+	}
+    
+	/* decrypt TKIP MIC and WEP ICV */
+	mbuf_copydata(m, moff, IEEE80211_TKIP_TAILLEN, buf);
+	rc4_crypt(&ctx->rc4, buf, buf, IEEE80211_TKIP_TAILLEN);
+    
+	/* include TKIP MIC in WEP ICV */
+	mic0 = buf;
+	crc = ieee80211_tkip_crc32(crc, mic0, IEEE80211_TKIP_MICLEN);
+	crc = ~crc;
+    
+	/* compare decrypted ICV with calculated ICV */
+	crc0 = buf + IEEE80211_TKIP_MICLEN;
+	if (crc0[0] != (u_int8_t)crc ||
+	    crc0[1] != (u_int8_t)(crc >> 8) ||
+	    crc0[2] != (u_int8_t)(crc >> 16) ||
+	    crc0[3] != (u_int8_t)(crc >> 24)) {
+		ic->ic_stats.is_tkip_icv_errs++;
+		mbuf_freem(m0);
+		mbuf_freem(n0);
+		return NULL;
+	}
+    
+	/* compute TKIP MIC over decrypted message */
+	ieee80211_tkip_mic(n0, hdrlen, ctx->rxmic, mic);
+	/* check that it matches the MIC in received frame */
+	if (bcmp(mic0, mic, IEEE80211_TKIP_MICLEN) != 0) {
+		mbuf_freem(m0);
+		mbuf_freem(n0);
+		ic->ic_stats.is_rx_locmicfail++;
+		ieee80211_michael_mic_failure(ic, tsc);
+		return NULL;
+	}
+    
+	/* update last seen packet number (MIC is validated) */
+	*prsc = tsc;
+    
+	mbuf_freem(m0);
+	return n0;
+nospace:
+	ic->ic_stats.is_rx_nombuf++;
+	mbuf_freem(m0);
+	if (n0 != NULL)
+		mbuf_freem(n0);
+	return NULL;
+}
+
+/*
+ * This function is called in HostAP mode to deauthenticate all STAs using
+ * TKIP as their pairwise or group cipher (as part of TKIP countermeasures).
+ * In STA mode, it reports a MIC failure and, if this is the second one
+ * within 60 seconds, starts the TKIP countermeasures (see 8.3.2.4).
+ */
+void Voodoo80211Device::
+ieee80211_michael_mic_failure(struct ieee80211com *ic, u_int64_t tsc)
+{
+	clock_sec_t now;
+	clock_usec_t usecs;
+    
+	clock_get_system_microtime(&now, &usecs);
+	IOLog("%s: Michael MIC failure\n", "net80211");
+    
+	/*
+	 * NB. do not send Michael MIC Failure reports as recommended since
+	 * these may be used as an oracle to verify CRC guesses as described
+	 * in Beck, M. and Tews S. "Practical attacks against WEP and WPA"
+	 * http://dl.aircrack-ng.org/breakingwepandwpa.pdf
+	 */
+    
+	/*
+	 * Activate TKIP countermeasures (see 8.3.2.4) only if less than 60
+	 * seconds have passed since the most recent previous MIC failure.
+	 */
+	if (ic->ic_tkip_micfail == 0 ||
+	    (int)now - ic->ic_tkip_micfail >= 60) {
+		ic->ic_tkip_micfail = (int)now;
+		ic->ic_tkip_micfail_last_tsc = tsc;
+		return;
+	}
+    
+	if (ic->ic_opmode == IEEE80211_M_STA) {
+		/* deauthenticate from the AP.. */
+		IEEE80211_SEND_MGMT(ic, ic->ic_bss,
+		    IEEE80211_FC0_SUBTYPE_DEAUTH,
+		    IEEE80211_REASON_MIC_FAILURE);
+		/* ..and find another one */
+		(void)ieee80211_newstate(ic, IEEE80211_S_SCAN, -1);
+	}
+    
+	ic->ic_tkip_micfail = (int)now;
+	ic->ic_tkip_micfail_last_tsc = tsc;
+}
@@ -75,6 +75,7 @@ ieee80211_input(struct ieee80211com *ic, mbuf_t m, struct ieee80211_node *ni,
 	int hdrlen, hasqos;
     
 	assert(ni != NULL);
+	latencyProbe(VOODOO80211_PROBE_INPUT);
     
 	/* in monitor mode, send everything directly to bpf */
 	if (ic->ic_opmode == IEEE80211_M_MONITOR)
@@ -556,8 +557,10 @@ ieee80211_deliver_data(struct ieee80211com *ic, mbuf_t m,
 	if ((ic->ic_flags & IEEE80211_F_RSNON) &&
 	    eh->ether_type == htons(ETHERTYPE_PAE))
 		ieee80211_eapol_key_input(ic, m, ni);
-	else
+	else {
+		latencyProbe(VOODOO80211_PROBE_DELIVER);
 		fInterface->inputPacket(m, 0, 0, 0);
+	}
 }
 
 #ifdef __STRICT_ALIGNMENT
@@ -847,6 +850,10 @@ ieee80211_parse_rsn_cipher(const u_int8_t selector[4])
                 return IEEE80211_CIPHER_WEP104;
             case 6:	/* BIP */
                 return IEEE80211_CIPHER_BIP;
+            case 8:	/* GCMP-128 */
+                return IEEE80211_CIPHER_GCMP;
+            case 9:	/* GCMP-256 */
+                return IEEE80211_CIPHER_GCMP_256;
 		}
 	}
 	return IEEE80211_CIPHER_NONE;	/* ignore unknown ciphers */
@@ -935,7 +942,7 @@ ieee80211_parse_rsn_body(struct ieee80211com *ic, const u_int8_t *frm,
 	if (rsn->rsn_ciphers & IEEE80211_CIPHER_USEGROUP) {
 		if (rsn->rsn_ciphers != IEEE80211_CIPHER_USEGROUP)
 			return IEEE80211_STATUS_BAD_PAIRWISE_CIPHER;
-		if (rsn->rsn_groupcipher == IEEE80211_CIPHER_CCMP)
+		if (ieee80211_is_aes_cipher(rsn->rsn_groupcipher))
 			return IEEE80211_STATUS_BAD_PAIRWISE_CIPHER;
 	}
     
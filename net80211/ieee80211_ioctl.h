@@ -99,6 +99,10 @@ struct ieee80211_stats {
 	u_int32_t	is_cmac_replays;
 	u_int32_t	is_cmac_icv_errs;
 	u_int32_t	is_pbac_errs;
+	u_int32_t	is_gcmp_replays;
+	u_int32_t	is_gcmp_dec_errs;
+	u_int32_t	is_psk_cache_hits;
+	u_int32_t	is_psk_derivations;
 };
 
 #define	SIOCG80211STATS		_IOWR('i', 242, struct ifreq)
@@ -234,6 +238,8 @@ struct ieee80211_wpapsk {
 #define IEEE80211_WPA_CIPHER_TKIP	0x04
 #define IEEE80211_WPA_CIPHER_CCMP	0x08
 #define IEEE80211_WPA_CIPHER_WEP104	0x10
+#define IEEE80211_WPA_CIPHER_GCMP	0x40
+#define IEEE80211_WPA_CIPHER_GCMP_256	0x80
 
 #define IEEE80211_WPA_AKM_PSK		0x01
 #define IEEE80211_WPA_AKM_8021X		0x02
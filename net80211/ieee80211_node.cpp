@@ -271,7 +271,9 @@ ieee80211_match_bss(struct ieee80211com *ic, struct ieee80211_node *ni)
 		if (ni->ni_rsngroupcipher != IEEE80211_CIPHER_WEP40 &&
 		    ni->ni_rsngroupcipher != IEEE80211_CIPHER_TKIP &&
 		    ni->ni_rsngroupcipher != IEEE80211_CIPHER_CCMP &&
-		    ni->ni_rsngroupcipher != IEEE80211_CIPHER_WEP104)
+		    ni->ni_rsngroupcipher != IEEE80211_CIPHER_WEP104 &&
+		    ni->ni_rsngroupcipher != IEEE80211_CIPHER_GCMP &&
+		    ni->ni_rsngroupcipher != IEEE80211_CIPHER_GCMP_256)
 			fail |= 0x40;
 		if ((ni->ni_rsnciphers & ic->ic_rsnciphers) == 0)
 			fail |= 0x40;
@@ -472,9 +474,16 @@ ieee80211_choose_rsnparams(struct ieee80211com *ic)
     
 	/* filter out unsupported pairwise ciphers */
 	ni->ni_rsnciphers &= ic->ic_rsnciphers;
-	/* prefer CCMP over TKIP */
+	/*
+	 * Prefer CCMP (which most drivers offload to hardware), then GCMP
+	 * over TKIP.
+	 */
 	if (ni->ni_rsnciphers & IEEE80211_CIPHER_CCMP)
 		ni->ni_rsnciphers = IEEE80211_CIPHER_CCMP;
+	else if (ni->ni_rsnciphers & IEEE80211_CIPHER_GCMP_256)
+		ni->ni_rsnciphers = IEEE80211_CIPHER_GCMP_256;
+	else if (ni->ni_rsnciphers & IEEE80211_CIPHER_GCMP)
+		ni->ni_rsnciphers = IEEE80211_CIPHER_GCMP;
 	else
 		ni->ni_rsnciphers = IEEE80211_CIPHER_TKIP;
 	ni->ni_rsncipher = (enum ieee80211_cipher) ni->ni_rsnciphers;
@@ -668,6 +668,12 @@ ieee80211_add_rsn_body(u_int8_t *frm, struct ieee80211com *ic,
 		case IEEE80211_CIPHER_WEP104:
 			*frm++ = 5;
 			break;
+		case IEEE80211_CIPHER_GCMP:
+			*frm++ = 8;
+			break;
+		case IEEE80211_CIPHER_GCMP_256:
+			*frm++ = 9;
+			break;
 		default:
 			/* can't get there */
 			panic("invalid group data cipher!");
@@ -691,6 +697,16 @@ ieee80211_add_rsn_body(u_int8_t *frm, struct ieee80211com *ic,
 		*frm++ = 4;
 		count++;
 	}
+	if (!wpa && (ni->ni_rsnciphers & IEEE80211_CIPHER_GCMP)) {
+		memcpy(frm, oui, 3); frm += 3;
+		*frm++ = 8;
+		count++;
+	}
+	if (!wpa && (ni->ni_rsnciphers & IEEE80211_CIPHER_GCMP_256)) {
+		memcpy(frm, oui, 3); frm += 3;
+		*frm++ = 9;
+		count++;
+	}
 	/* write Pairwise Cipher Suite Count field */
 	LE_WRITE_2(pcount, count);
 	
@@ -83,9 +83,9 @@ ieee80211_send_eapol_key(struct ieee80211com *ic, mbuf_t m,
 	/* use V3 descriptor if KDF is SHA256-based */
 	if (ieee80211_is_sha256_akm((enum ieee80211_akm)ni->ni_rsnakms))
 		info |= EAPOL_KEY_DESC_V3;
-	/* use V2 descriptor if pairwise or group cipher is CCMP */
-	else if (ni->ni_rsncipher == IEEE80211_CIPHER_CCMP ||
-		 ni->ni_rsngroupcipher == IEEE80211_CIPHER_CCMP)
+	/* use V2 descriptor if pairwise or group cipher is CCMP or GCMP */
+	else if (ieee80211_is_aes_cipher(ni->ni_rsncipher) ||
+		 ieee80211_is_aes_cipher(ni->ni_rsngroupcipher))
 		info |= EAPOL_KEY_DESC_V2;
 	else
 		info |= EAPOL_KEY_DESC_V1;
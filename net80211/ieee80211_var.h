@@ -257,7 +257,13 @@ struct ieee80211com {
 	int			ic_tkip_micfail;
 	u_int64_t		ic_tkip_micfail_last_tsc;
 
-	TAILQ_HEAD(, ieee80211_pmk) ic_pmksa;	/* PMKSA cache */
+	TAILQ_HEAD(, ieee80211_pmk) ic_pmksa;	/* PMKSA cache, LRU first */
+	LIST_HEAD(, ieee80211_pmk) ic_pmksa_hash[IEEE80211_PMKSA_HASHSIZE];
+	LIST_HEAD(, ieee80211_pmk) ic_pmksa_idhash[IEEE80211_PMKSA_HASHSIZE];
+	u_int			ic_pmksa_count;
+	u_int			ic_pmksa_max;
+	struct ieee80211_psk_entry ic_pskcache[IEEE80211_PSKCACHE_SIZE];
+	u_int32_t		ic_pskcache_gen;
 	u_int			ic_rsnprotos;
 	u_int			ic_rsnakms;
 	u_int			ic_rsnciphers;
@@ -339,5 +345,6 @@ extern struct ieee80211com_head ieee80211com_head;
 #define	IEEE80211_F_DODEL	0x00000008	/* delete ignore rate */
 
 extern	int ieee80211_cache_size;
+extern	int ieee80211_pmksa_max;
 
 #endif /* _NET80211_IEEE80211_VAR_H_ */
@@ -0,0 +1,97 @@
+//
+//  lz4.cpp
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+/*
+ * LZ4 block decoder.  A block is a sequence of
+ *
+ *	token, [literal length], literals, offset, [match length]
+ *
+ * where the high nibble of the token is the literal length and the low
+ * nibble the match length minus 4; a nibble of 15 is followed by bytes
+ * that are added to it until one is not 255.  The last sequence only has
+ * literals.  Every length and offset is checked against the input and
+ * output buffers so a corrupt image cannot write outside of dst.
+ */
+
+#include <sys/param.h>
+#include <sys/systm.h>
+
+#include "lz4.h"
+
+#define LZ4_MIN_MATCH	4
+
+/* read an extended length, returns 0 if the input ends first */
+static __inline int
+lz4_length(const u_int8_t **ip, const u_int8_t *iend, size_t *len)
+{
+	u_int8_t b;
+
+	do {
+		if (*ip >= iend)
+			return 0;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+	return 1;
+}
+
+int
+lz4_decompress(const u_int8_t *src, size_t srclen, u_int8_t *dst,
+    size_t dstlen)
+{
+	const u_int8_t *ip = src, *iend = src + srclen;
+	u_int8_t *op = dst, *oend = dst + dstlen;
+	const u_int8_t *match;
+	size_t len, offset;
+	u_int8_t token;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		/* literals */
+		len = token >> 4;
+		if (len == 15 && !lz4_length(&ip, iend, &len))
+			return -1;
+		if (len > (size_t)(iend - ip) || len > (size_t)(oend - op))
+			return -1;
+		memcpy(op, ip, len);
+		ip += len;
+		op += len;
+
+		/* the last sequence has no match */
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return -1;
+		offset = ip[0] | ip[1] << 8;
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dst))
+			return -1;
+		match = op - offset;
+
+		len = token & 15;
+		if (len == 15 && !lz4_length(&ip, iend, &len))
+			return -1;
+		len += LZ4_MIN_MATCH;
+		if (len > (size_t)(oend - op))
+			return -1;
+
+		/* copy 8 bytes at a time unless the match overlaps the output */
+		if (offset >= 8) {
+			while (len >= 8) {
+				memcpy(op, match, 8);
+				op += 8;
+				match += 8;
+				len -= 8;
+			}
+		}
+		while (len-- > 0)
+			*op++ = *match++;
+	}
+	return (int)(op - dst);
+}
@@ -0,0 +1,20 @@
+//
+//  lz4.h
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+#ifndef _LZ4_H_
+#define _LZ4_H_
+
+#include <sys/cdefs.h>
+
+/*
+ * Decoder for the LZ4 block format, used for firmware images that are
+ * compressed at build time (see tools/fwcompress.py).  Returns the number
+ * of bytes written to dst, or -1 if src is corrupt or does not fit.
+ */
+int	 lz4_decompress(const u_int8_t *, size_t, u_int8_t *, size_t);
+
+#endif /* _LZ4_H_ */
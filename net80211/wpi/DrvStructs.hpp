@@ -11,8 +11,17 @@
 #include "iwlwifi_headers/internals.h"
 #include "IntelWiFiDriver_mvm.hpp"
 #include "Firmware.hpp"
+#include "IntelWiFiDriver_notif.hpp"
+#include "MMIOTrace.hpp"
+#include <kern/thread.h>
+#include <libkern/OSKextLib.h>
 //#include "iwlwifi_headers/mvm.h"
 
+//The iwlwifi headers set #pragma pack without restoring it, which also caps the aligned
+//attributes below. Lay the driver structures out naturally, packed ones say so themselves
+#pragma pack(push)
+#pragma pack()
+
 #define MAX_TX_QUEUES 512 //Maximum number of transmit queues
 
 struct PCIDeviceStatus {
@@ -27,18 +36,36 @@ struct PCIDeviceStatus {
     bool PMI_TPower;            //STATUS_TPOWER_PMI
 };
 
+//Firmware error dumps are captured from the interrupt handler so the ring is allocated
+//up front. Each slot holds one dump in the iwl_fw_error_dump_file layout
+#define FW_ERROR_DUMP_SLOTS 4
+#define FW_ERROR_DUMP_SLOT_SIZE (32 * 1024)
+
+struct firmwareErrorDumpRing {
+    IOSimpleLock*   lock;       //Protects the slot bookkeeping, the slot contents are copied without it
+    uint8_t*        buffer;     //FW_ERROR_DUMP_SLOTS * FW_ERROR_DUMP_SLOT_SIZE
+    uint32_t        length[FW_ERROR_DUMP_SLOTS];    //Bytes in the slot, 0 while empty or being written
+    uint32_t        sequence[FW_ERROR_DUMP_SLOTS];  //Capture number of the slot
+    uint32_t        readers[FW_ERROR_DUMP_SLOTS];   //Copies out in progress, captures skip the slot
+    uint32_t        writing;    //Mask of slots a capture is filling
+    uint32_t        captured;
+    uint32_t        truncated;  //Captures that did not fit their slot
+    uint32_t        dropped;    //Captures with every slot busy
+    bool            errorCaptured; //The current NIC error is already in the ring
+};
+
 struct MVMSpecificConfig {
-    struct notificationWaiters{
-        IOSimpleLock* notifWaitLock;
-        LIST_HEAD(, notificationWaitEntry) firstWaitEntry;
-        IOLock* notifWaitQueue;
-    }notifWaits;
+    //Notification handlers and waiters, indexed by (group, opcode)
+    struct notificationDispatch notifs;
     
     //Firmware specific data
     struct FirmwareRuntimeData fwRuntimeData;
     struct FirmwareData        fwData;
+    uint8_t* firmwareImage;         //Copy of the firmware file fwData refers to
+    uint32_t firmwareImageSize;
     int8_t firmwareRestart;
-    uint8_t* errorRecoveryBuffer;
+    uint8_t* errorRecoveryBuffer;   //errorLogSize bytes, allocated with the firmware
+    struct firmwareErrorDumpRing errorDumps;
     
     MVMStatus status;
     
@@ -46,17 +73,103 @@ struct MVMSpecificConfig {
     bool RFKillSafeInitDone;
     
     IOCommandGate* rxSyncWaitQueue;
+    
+    //Asynchronous firmware request (requestFirmware), detach waits for the callback
+    IOLock* firmwareRequestLock;
+    OSKextRequestTag firmwareRequestTag;
+    uint32_t firmwareRequestAPI;    //API version of the file being requested
+    bool firmwareRequestPending;
+    bool firmwareRequestStopping;
+};
+
+//How the firmware image was handed to the device
+enum FirmwareLoadMethod {
+    chunkedFirmwareLoad,        //Sections pushed through the FH TX channel (iwl_pcie_load_given_ucode)
+    contextInfoFirmwareLoad,    //Context info self load (iwl_pcie_ctxt_info_init)
+    firmwareLoadMethodCount
+};
+
+//Register wait sites, pollBit keeps per-site wait statistics
+enum pollSite {
+    pollSiteNICAccess,          //MAC access grant, spun with interrupts off
+    pollSiteNICAccessUnlocked,  //MAC access grant, after dropping the NIC access lock
+    pollSiteHardwareReady,      //NIC ready after setting the ready bit
+    pollSiteMACClock,           //MAC clock ready after init done
+    pollSiteTxFlush,            //FH TX channels idle
+    pollSiteStopMaster,         //Bus master disabled
+    pollSiteCount
+};
+
+//Context info state for gen2 (22000) and gen3 (22560 and on) devices. The blocks are
+//kept between loads so the DRAM section table is only built once per firmware
+struct ContextInfoState {
+    struct FirmwareSectionDMA   contextInfo;    //iwl_context_info or iwl_context_info_gen3
+    struct FirmwareSectionDMA   prphScratch;    //Gen3 only
+    struct FirmwareSectionDMA   prphInfo;       //Gen3 only
+    struct FirmwareSectionDMA   iml;            //Gen3 only, image loader
+    uint32_t                    lmacSections;
+    uint32_t                    umacSections;
+    uint32_t                    pagingSections;
+    bool                        dramTableValid; //DRAM table matches the sections in fwRuntimeData
+};
+
+//Transport entry points instantiated for the device generation (IntelWiFiDriver_trans.hpp),
+//set once by selectTransport so the RX/TX paths don't test the device family
+struct TransportOps {
+    const char* name;
+    void (IntelWiFiDriver::*rxRestock)();
+    void (IntelWiFiDriver::*rxIncWritePointer)();
+    void (IntelWiFiDriver::*txqFreeTFD)(struct iwl_txq* txq);
+    void (IntelWiFiDriver::*unmapTFD)(struct iwl_cmd_meta* meta, struct iwl_txq* txq, int index);
+    void (IntelWiFiDriver::*stopDevice)(bool setLowPowerState);
+    bool restockOnAlive; //RX queue is restocked by the driver once the firmware is alive
 };
 
 //Contains all attrbutes of the device used by the driver
+//The struct is laid out by access frequency. The first cache line holds what the interrupt
+//handler and MMIO/NIC access paths touch, the next two hold the RX/TX queue state, everything
+//after that is only used while configuring the device. The MVM state is large and only read
+//on command/firmware paths so it lives in separately allocated blocks
+#define PCIDEVICE_CACHE_LINE 64
 struct PCIDevice {
+    //Interrupt and register access fast path, one cache line
+    volatile uint8_t*           deviceMemoryMapVAddr; //Cached BAR0 virtual address used by the inline MMIO accessors
+    PCIDeviceConfig*            deviceConfig;
+    IOSimpleLock*               NICAccessLock; //Lock for grabbing NIC access [reg_lock]
+    thread_t                    NICAccessOwner; //Thread currently holding NICAccessLock through a NIC access session
+    uint32_t                    NICAccessDepth; //Nesting depth of NIC access sessions on the lock owner
+    uint32_t                    intaBitMask;
+    uint32_t                    msixFHMask;
+    uint32_t                    msixHWMask;
+    bool                        msixEnabled;
+    bool                        holdNICAwake; //Status if a current command in flight is holding NIC awake
+    bool                        comandInFlight;
+    
+    //Contains the statuses of the driver
+    PCIDeviceStatus             status;
+    
+    //RX/TX fast path, two cache lines
+    iwl_rxq*                    rxq __attribute__((aligned(PCIDEVICE_CACHE_LINE)));
+    struct TransportOps         trans;
+    uint16_t                    tfdSize;
+    uint8_t                     maxTBS;
+    uint8_t                     commandQueue; //cmd_queue
+    uint8_t                     rxQCount; //num_rx_queues
+    
+    //Device communication queues
+    //iwlwifi also defines txq_memory which simply points to the allocated txqs in memory
+    //only a function in trans.c uses this later so we wont bother eek
+    iwl_txq*                    txQueues[MAX_TX_QUEUES] __attribute__((aligned(PCIDEVICE_CACHE_LINE)));
+    bool                        txqAllocated;
+    u_long                      txq_used[BITS_TO_LONGS(MAX_TX_QUEUES)];
+    u_long                      txq_stopped[BITS_TO_LONGS(MAX_TX_QUEUES)];
+    
+    //Cold from here on
     //NIC related variables
     IOPCIDevice*                device;
     IOWorkLoop*                 workLoop;
     int                         capabilitiesStructOffset;
     IOMemoryMap*                deviceMemoryMap;
-//    volatile void*              deviceMemoryMapVAddr;
-    PCIDeviceConfig*            deviceConfig;
     bool                        debugRFKill;
     bool                        opmodeDown;
     bool                        isDown;
@@ -67,67 +180,48 @@ struct PCIDevice {
     
     //Interrupt related variables
     IOEventSource*              interruptController;
-    uint32_t                    intaBitMask;
     
     //Firmware related varaibales
     IOLock*                     ucodeWriteWaitLock;
+    IOLock*                     pollWaitLock; //Sleeping pollBit waiters, woken from the interrupt handler
     bool                        ucodeWriteComplete = false;
-    
-    //Contains the statuses of the driver
-    PCIDeviceStatus             status;
+    struct ContextInfoState     ctxtInfo;
+    uint64_t                    firmwareLoadStart; //Uptime the image was handed to the device, 0 once ALIVE
+    enum FirmwareLoadMethod     firmwareLoadMethod;
     
     //MSIX related variables
-    bool                        msixEnabled;
     uint32_t                    msixFHInitMask;
-    uint32_t                    msixFHMask;
     uint32_t                    msixHWInitMask;
-    uint32_t                    msixHWMask;
     uint8_t                     sharedVecMask;
     uint32_t                    defIRQ; //Can we rename this to something more descriptive?
     
-    //Used for grabbing NIC access
-    bool                        holdNICAwake; //Status if a current command in flight is holding NIC awake
-    bool                        comandInFlight;
-    IOSimpleLock*               NICAccessLock; //Lock for grabbing NIC access [reg_lock]
-    
-    //Device communication queues
-    //iwlwifi also defines txq_memory which simply points to the allocated txqs in memory
-    //only a function in trans.c uses this later so we wont bother eek
-    iwl_txq*                    txQueues[MAX_TX_QUEUES];
-    bool                        txqAllocated;
-    u_long                      txq_used[BITS_TO_LONGS(MAX_TX_QUEUES)];
-    u_long                      txq_stopped[BITS_TO_LONGS(MAX_TX_QUEUES)];
-    iwl_rxq*                    rxq;
-    uint8_t                     commandQueue; //cmd_queue
-    uint16_t                    tfdSize;
-    uint8_t                     maxTBS;
-    uint8_t                     rxQCount; //num_rx_queues
-
     IOLock*                     waitCommandQueue;
     
     IOSimpleLock*               mutex; //Can we rename this to something more descriptive?
     
     //MVM related - replace with dvm when dvm implemented
-    struct MVMSpecificConfig    mvmConfig; //Will need replacing if we implement DVM cards
-    struct MVMConfig            mvm;
+    //Allocated in device_attach, see above
+    struct MVMSpecificConfig*   mvmConfig; //Will need replacing if we implement DVM cards
+    struct MVMConfig*           mvm;
     
     struct ieee80211com*        bsdIEEEStruct;
     
 };
 
-struct hardwareDebugStatisticsCounters {
-    uint32_t hardwareError;
-    uint32_t softwareError;
-    uint32_t schedulerFired;
-    uint32_t aliveRecieved;
-    uint32_t rfKillToggledOn;
-    uint32_t ctKill;
-    uint32_t wakeup;
-    uint32_t rx;
-    uint32_t tx;
-};
+//Layout check, fails the build if a field added to one of the fast path blocks pushes it
+//over its cache lines
+static_assert(offsetof(PCIDevice, status) + sizeof(PCIDeviceStatus) <= PCIDEVICE_CACHE_LINE,
+              "PCIDevice interrupt fast path spills out of its cache line");
+static_assert(offsetof(PCIDevice, rxq) == PCIDEVICE_CACHE_LINE,
+              "PCIDevice RX/TX fast path must start on the second cache line");
+static_assert(offsetof(PCIDevice, rxQCount) + sizeof(uint8_t) <= 3 * PCIDEVICE_CACHE_LINE,
+              "PCIDevice RX/TX fast path spills out of its two cache lines");
+static_assert(offsetof(PCIDevice, txQueues) == 3 * PCIDEVICE_CACHE_LINE,
+              "PCIDevice txQueues must start on its own cache line");
 
-enum hardwareDebugStatistics {
+//Always on hardware statistics, counted by updateHardwareStatistics and exported through
+//the debug.voodoo80211.hw_stats sysctl in this order
+enum hardwareStatistics {
     hardwareError,
     softwareError,
     schedulerFired,
@@ -135,8 +229,48 @@ enum hardwareDebugStatistics {
     rfKillToggledOn,
     ctKill,
     wakeup,
-    rxRecieved,
-    txRecieved
+    rxRecieved,         //FH RX interrupts
+    txRecieved,         //FH TX interrupts
+    interruptFired,
+    rxRestocked,        //RBDs handed back to the device
+    rxDoorbell,         //RX write pointer updates
+    NICGrabbed,         //NIC access grants that had to wake the NIC
+    NICError,           //NIC errors reported to the op mode
+    rxFrames,           //Packets passed to the notification dispatcher
+    txFrames,           //TFDs reclaimed
+    hardwareStatisticsCount
+};
+
+//Threads add to the block their thread pointer hashes to so concurrent updates rarely share
+//a cache line, readers sum all the blocks up. There is no supported way to get the current
+//CPU from a kext
+#define HW_STATS_STRIPE_BITS 6
+#define HW_STATS_STRIPES (1 << HW_STATS_STRIPE_BITS)
+struct hardwareStatisticsStripe {
+    uint64_t counters[hardwareStatisticsCount];
+} __attribute__((aligned(64)));
+
+//Debug only counters
+struct hardwareDebugStatisticsCounters {
+    //MMIO profile, compare against interrupts and rx + tx to get the number of
+    //register accesses per interrupt and per packet
+    uint64_t mmioReads;
+    uint64_t mmioWrites;
+    
+    //Time from handing the firmware to the device until ALIVE, per load method
+    uint32_t firmwareLoads[firmwareLoadMethodCount];
+    uint32_t lastAliveLatency[firmwareLoadMethodCount]; //us
+    uint64_t totalAliveLatency[firmwareLoadMethodCount]; //us
+    
+    //pollBit waits per site, spin time is CPU burned busy waiting (with interrupts
+    //off for pollSiteNICAccess), the rest of the wait was spent sleeping
+    uint32_t pollWaits[pollSiteCount];
+    uint32_t pollTimeouts[pollSiteCount];
+    uint32_t pollMaxWait[pollSiteCount]; //us
+    uint64_t pollTotalWait[pollSiteCount]; //us
+    uint64_t pollTotalSpin[pollSiteCount]; //us
 };
 
+#pragma pack(pop)
+
 #endif /* DrvStructs_h */
@@ -8,6 +8,22 @@
 #ifndef Firmware_h
 #define Firmware_h
 #include "uCode_api.hpp"
+
+class IOTimerEventSource;
+class IOBufferMemoryDescriptor;
+
+#ifndef BITS_TO_LONGS
+#define BITS_TO_LONGS(bits)     (((bits) + 8 * sizeof(u_long) - 1) / (8 * sizeof(u_long)))
+#endif
+
+#define UCODE_SECTION_MAX       16 //IWL_UCODE_SECTION_MAX
+#define UCODE_SECTION_DATA      0  //IWL_UCODE_SECTION_DATA
+#define UCODE_SECTION_INST      1  //IWL_UCODE_SECTION_INST
+#define UCODE_RTC_INST_BASE     0x00000000 //IWLAGN_RTC_INST_LOWER_BOUND
+#define UCODE_RTC_DATA_BASE     0x00800000 //IWLAGN_RTC_DATA_LOWER_BOUND
+#define UCODE_PAGING_PAGE_SIZE  4096 //FW_PAGING_SIZE
+#define UCODE_PAGING_MAX_SIZE   (32 * 8 * UCODE_PAGING_PAGE_SIZE) //MAX_PAGING_IMAGE_SIZE
+
 enum UCodeType {
     REGULAR,            //IWL_UCODE_REGUALR
     INIT,               //IWL_UCODE_INIT
@@ -40,17 +56,83 @@ struct UCodeCapabilities {
     u_long   api[BITS_TO_LONGS(NUM_UCODE_TLV_API)];
     u_long   capa[BITS_TO_LONGS(NUM_UCODE_TLV_CAPA)];
     
-    struct FirmwareCommandVersion commandVersions;
+    const struct FirmwareCommandVersion* commandVersions; //Points into FirmwareFile::data
     uint32_t commandVersionsCount;
 };
 
+/**
+ * struct FirmwareSection - a section of the firmware file
+ * @offset: offset of the section data in the firmware file
+ * @length: length of the section data
+ * @deviceOffset: address the section is loaded to in the device
+ *
+ * Sections are only recorded as a range of the file, the data is copied into
+ * DMA memory when the sections of a UCodeType are loaded
+ */
+struct FirmwareSection {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t deviceOffset;
+};
+
+//The sections making up one UCodeType (fw_img)
+struct FirmwareImage {
+    struct FirmwareSection sections[UCODE_SECTION_MAX];
+    uint32_t sectionCount;
+    bool     isDualCPUs;
+    uint32_t pagingMemSize;
+};
+
+//Everything parsed from a TLV firmware file, refers to the file rather than copying it
+struct FirmwareFile {
+    const uint8_t*          data;
+    size_t                  size;
+    
+    uint32_t                ucodeVersion;
+    uint32_t                build;
+    char                    humanReadable[UCODE_HUMAN_READABLE_SIZE + 1];
+    
+    struct FirmwareImage    images[TYPE_MAX];
+    struct FirmwareSection  iml; //Image loader, length is 0 if not present
+    
+    uint32_t                numberOfCPUs;
+    uint32_t                phySku;
+    bool                    enhanceSensitivityTable;
+    uint32_t                initEventLogPtr;
+    uint32_t                initEventLogSize;
+    uint32_t                initErrorLogPtr;
+    uint32_t                instEventLogPtr;
+    uint32_t                instEventLogSize;
+    uint32_t                instErrorLogPtr;
+    
+    uint32_t                errorOffset; //Offset of the TLV parsing failed at
+};
+
+//Parses a TLV firmware file in a single pass (FirmwareParser.cpp)
+int parseFirmwareFile(const uint8_t* data, size_t size, struct FirmwareFile* file,
+                      struct UCodeCapabilities* capabilities);
+
 struct FirmwareData {
     struct UCodeCapabilities uCodeCapabilities;
+    struct FirmwareFile      file;
+};
+
+//A section copied into DMA memory
+struct FirmwareSectionDMA {
+    IOBufferMemoryDescriptor* buffer;
+    void*                     vaddr;
+    uint32_t                  paddr;
+    uint32_t                  length;
+    uint32_t                  deviceOffset;
 };
 
 struct FirmwareRuntimeData {
     enum UCodeType microcodeType;
     
+    //Sections of microcodeType currently in DMA memory
+    struct FirmwareSectionDMA sectionDMA[UCODE_SECTION_MAX];
+    uint32_t                  sectionDMACount;
+    
     struct {
         IOTimerEventSource* periodicTrigger; //Seems to be similar to timer_list
     } dump;
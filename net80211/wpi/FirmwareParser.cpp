@@ -0,0 +1,269 @@
+//
+//  FirmwareParser.cpp
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+//Parser for iwlwifi TLV firmware files (iwl_parse_tlv_firmware)
+//
+//The file is validated and parsed in a single pass over the TLVs. Nothing is
+//allocated or copied: sections and the command version table are recorded as
+//ranges of the file, which has to stay around for as long as they are used.
+//This file only depends on Firmware.hpp so it can be built and run against real
+//.ucode files outside of the kernel
+
+#include <sys/types.h>
+#include <sys/errno.h>
+#include <string.h>
+
+#include "Firmware.hpp"
+
+#define UCODE_DEFAULT_MAX_PROBE_LENGTH      200
+#define UCODE_DEFAULT_SCAN_CHANNELS         40 //IWL_DEFAULT_SCAN_CHANNELS
+#define UCODE_DEFAULT_PHY_CALIBRATE_SIZE    18 //IWL_DEFAULT_STANDARD_PHY_CALIBRATE_TBL_SIZE
+
+static inline uint32_t readLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+//Sets bits index * 32 .. index * 32 + 31 of a bitmap from a TLV flags word, bits past
+//the end of the bitmap belong to API/capabilities we dont know about and are dropped
+static void setBitmapWord(u_long* bitmap, uint32_t bitmapBits, uint32_t index, uint32_t flags) {
+    const uint32_t bitsPerLong = 8 * sizeof(u_long);
+    for (uint32_t i = 0; i < 32; i++) {
+        uint32_t bit = index * 32 + i;
+        if (bit >= bitmapBits) return;
+        if (flags & (1U << i)) bitmap[bit / bitsPerLong] |= 1UL << (bit % bitsPerLong);
+    }
+}
+
+//Appends a section to an image (iwl_store_ucode_sec)
+static int addSection(struct FirmwareImage* image, uint32_t offset, uint32_t length, uint32_t deviceOffset) {
+    if (image->sectionCount >= UCODE_SECTION_MAX) return -E2BIG;
+    
+    struct FirmwareSection* section = &image->sections[image->sectionCount++];
+    section->offset = offset;
+    section->length = length;
+    section->deviceOffset = deviceOffset;
+    return 0;
+}
+
+//Stores one of the fixed INST/DATA sections of the old (pre SEC_*) layout
+static void setSection(struct FirmwareImage* image, uint32_t index, uint32_t offset, uint32_t length, uint32_t deviceOffset) {
+    image->sections[index].offset = offset;
+    image->sections[index].length = length;
+    image->sections[index].deviceOffset = deviceOffset;
+    if (image->sectionCount <= index) image->sectionCount = index + 1;
+}
+
+int parseFirmwareFile(const uint8_t* data, size_t size, struct FirmwareFile* file,
+                      struct UCodeCapabilities* capabilities) {
+    //iwl_parse_tlv_firmware
+    const struct TLVUCodeHeader* header = (const struct TLVUCodeHeader*)data;
+    
+    memset(file, 0, sizeof(*file));
+    memset(capabilities, 0, sizeof(*capabilities));
+    file->data = data;
+    file->size = size;
+    file->numberOfCPUs = 1;
+    capabilities->maxProbeLenght = UCODE_DEFAULT_MAX_PROBE_LENGTH;
+    capabilities->scanChannelsCount = UCODE_DEFAULT_SCAN_CHANNELS;
+    capabilities->standardPhyCalibrationSize = UCODE_DEFAULT_PHY_CALIBRATE_SIZE;
+    
+    if (size < sizeof(*header) ||
+        readLE32((const uint8_t*)&header->zero) != 0 ||
+        readLE32((const uint8_t*)&header->magic) != UCODE_TLV_MAGIC) {
+        return -EINVAL;
+    }
+    
+    file->ucodeVersion = readLE32((const uint8_t*)&header->version);
+    file->build = readLE32((const uint8_t*)&header->build);
+    memcpy(file->humanReadable, header->humanReadable, UCODE_HUMAN_READABLE_SIZE);
+    file->humanReadable[UCODE_HUMAN_READABLE_SIZE] = '\0';
+    
+    size_t offset = sizeof(*header);
+    while (size - offset >= sizeof(struct UCodeTLV)) {
+        const uint8_t* tlv = data + offset;
+        uint32_t type = readLE32(tlv);
+        uint32_t length = readLE32(tlv + 4);
+        uint32_t dataOffset = (uint32_t)(offset + sizeof(struct UCodeTLV));
+        const uint8_t* tlvData = data + dataOffset;
+        
+        file->errorOffset = (uint32_t)offset;
+        if (length > size - dataOffset) return -EINVAL;
+        
+        //TLVs holding a single 32 bit value
+        uint32_t value = 0;
+        switch (type) {
+            case UCODE_TLV_PROBE_MAX_LEN:
+            case UCODE_TLV_FLAGS:
+            case UCODE_TLV_RUNT_EVTLOG_PTR:
+            case UCODE_TLV_RUNT_EVTLOG_SIZE:
+            case UCODE_TLV_RUNT_ERRLOG_PTR:
+            case UCODE_TLV_INIT_EVTLOG_PTR:
+            case UCODE_TLV_INIT_EVTLOG_SIZE:
+            case UCODE_TLV_INIT_ERRLOG_PTR:
+            case UCODE_TLV_PHY_CALIBRATION_SIZE:
+            case UCODE_TLV_PHY_SKU:
+            case UCODE_TLV_NUM_OF_CPU:
+            case UCODE_TLV_N_SCAN_CHANNELS:
+            case UCODE_TLV_PAGING:
+                //FLAGS may be longer, only the first word is used
+                if (length < sizeof(uint32_t) || (type != UCODE_TLV_FLAGS && length != sizeof(uint32_t))) {
+                    return -EINVAL;
+                }
+                value = readLE32(tlvData);
+                break;
+        }
+        
+        switch (type) {
+            //Old style fixed sections
+            case UCODE_TLV_INST:
+                setSection(&file->images[REGULAR], UCODE_SECTION_INST, dataOffset, length, UCODE_RTC_INST_BASE);
+                break;
+            case UCODE_TLV_DATA:
+                setSection(&file->images[REGULAR], UCODE_SECTION_DATA, dataOffset, length, UCODE_RTC_DATA_BASE);
+                break;
+            case UCODE_TLV_INIT:
+                setSection(&file->images[INIT], UCODE_SECTION_INST, dataOffset, length, UCODE_RTC_INST_BASE);
+                break;
+            case UCODE_TLV_INIT_DATA:
+                setSection(&file->images[INIT], UCODE_SECTION_DATA, dataOffset, length, UCODE_RTC_DATA_BASE);
+                break;
+            case UCODE_TLV_WOWLAN_INST:
+                setSection(&file->images[WOWLAN], UCODE_SECTION_INST, dataOffset, length, UCODE_RTC_INST_BASE);
+                break;
+            case UCODE_TLV_WOWLAN_DATA:
+                setSection(&file->images[WOWLAN], UCODE_SECTION_DATA, dataOffset, length, UCODE_RTC_DATA_BASE);
+                break;
+                
+            //Sections prefixed with their load address in the device
+            case UCODE_TLV_SEC_RT:
+            case UCODE_TLV_SECURE_SEC_RT:
+            case UCODE_TLV_SEC_INIT:
+            case UCODE_TLV_SECURE_SEC_INIT:
+            case UCODE_TLV_SEC_WOWLAN:
+            case UCODE_TLV_SECURE_SEC_WOWLAN:
+            case UCODE_TLV_SEC_RT_USNIFFER: {
+                enum UCodeType ucodeType;
+                if (type == UCODE_TLV_SEC_RT || type == UCODE_TLV_SECURE_SEC_RT) {
+                    ucodeType = REGULAR;
+                } else if (type == UCODE_TLV_SEC_INIT || type == UCODE_TLV_SECURE_SEC_INIT) {
+                    ucodeType = INIT;
+                } else if (type == UCODE_TLV_SEC_WOWLAN || type == UCODE_TLV_SECURE_SEC_WOWLAN) {
+                    ucodeType = WOWLAN;
+                } else {
+                    ucodeType = REGULAR_USNIFFER;
+                }
+                
+                if (length < sizeof(uint32_t)) return -EINVAL;
+                int error = addSection(&file->images[ucodeType], dataOffset + sizeof(uint32_t),
+                                       length - sizeof(uint32_t), readLE32(tlvData));
+                if (error) return error;
+                break;
+            }
+                
+            case UCODE_TLV_BOOT:
+                //Not used by MVM devices
+                break;
+            case UCODE_TLV_PROBE_MAX_LEN:
+                capabilities->maxProbeLenght = value;
+                break;
+            case UCODE_TLV_PAN:
+                if (length) return -EINVAL;
+                capabilities->flags |= UCODE_TLV_FLAGS_PAN;
+                break;
+            case UCODE_TLV_FLAGS:
+                capabilities->flags = value;
+                break;
+            case UCODE_TLV_API_CHANGES_SET:
+                if (length != 2 * sizeof(uint32_t)) return -EINVAL;
+                setBitmapWord(capabilities->api, NUM_UCODE_TLV_API, readLE32(tlvData), readLE32(tlvData + 4));
+                break;
+            case UCODE_TLV_ENABLED_CAPABILITIES:
+                if (length != 2 * sizeof(uint32_t)) return -EINVAL;
+                setBitmapWord(capabilities->capa, NUM_UCODE_TLV_CAPA, readLE32(tlvData), readLE32(tlvData + 4));
+                break;
+            case UCODE_TLV_RUNT_EVTLOG_PTR:
+                file->instEventLogPtr = value;
+                break;
+            case UCODE_TLV_RUNT_EVTLOG_SIZE:
+                file->instEventLogSize = value;
+                break;
+            case UCODE_TLV_RUNT_ERRLOG_PTR:
+                file->instErrorLogPtr = value;
+                break;
+            case UCODE_TLV_INIT_EVTLOG_PTR:
+                file->initEventLogPtr = value;
+                break;
+            case UCODE_TLV_INIT_EVTLOG_SIZE:
+                file->initEventLogSize = value;
+                break;
+            case UCODE_TLV_INIT_ERRLOG_PTR:
+                file->initErrorLogPtr = value;
+                break;
+            case UCODE_TLV_ENHANCE_SENS_TBL:
+                if (length) return -EINVAL;
+                file->enhanceSensitivityTable = true;
+                break;
+            case UCODE_TLV_PHY_CALIBRATION_SIZE:
+                capabilities->standardPhyCalibrationSize = value;
+                break;
+            case UCODE_TLV_PHY_SKU:
+                file->phySku = value;
+                break;
+            case UCODE_TLV_NUM_OF_CPU:
+                if (value < 1 || value > 2) return -EINVAL;
+                file->numberOfCPUs = value;
+                if (value == 2) {
+                    file->images[REGULAR].isDualCPUs = true;
+                    file->images[INIT].isDualCPUs = true;
+                    file->images[WOWLAN].isDualCPUs = true;
+                }
+                break;
+            case UCODE_TLV_N_SCAN_CHANNELS:
+                capabilities->scanChannelsCount = value;
+                break;
+            case UCODE_TLV_PAGING:
+                if (value > UCODE_PAGING_MAX_SIZE || (value & (UCODE_PAGING_PAGE_SIZE - 1))) {
+                    return -EINVAL;
+                }
+                file->images[REGULAR].pagingMemSize = value;
+                file->images[REGULAR_USNIFFER].pagingMemSize = value;
+                break;
+            case UCODE_TLV_CMD_VERSIONS:
+                if (length % sizeof(struct FirmwareCommandVersion)) return -EINVAL;
+                capabilities->commandVersions = (const struct FirmwareCommandVersion*)tlvData;
+                capabilities->commandVersionsCount = length / sizeof(struct FirmwareCommandVersion);
+                break;
+            case UCODE_TLV_FW_RECOVERY_INFO:
+                //iwl_fw_dbg_recovery_info, where to read the error log from on recovery
+                if (length < 2 * sizeof(uint32_t)) return -EINVAL;
+                capabilities->errorLogAddress = readLE32(tlvData);
+                capabilities->errorLogSize = readLE32(tlvData + 4);
+                break;
+            case UCODE_TLV_IML:
+                file->iml.offset = dataOffset;
+                file->iml.length = length;
+                break;
+            default:
+                //Debug, cipher scheme, calibration defaults and unknown TLVs are skipped
+                break;
+        }
+        
+        //TLVs are padded to 4 bytes, the padding of the last one may be missing
+        size_t next = dataOffset + (((size_t)length + 3) & ~(size_t)3);
+        offset = next < size ? next : size;
+    }
+    
+    //Trailing bytes that dont make up a TLV header
+    file->errorOffset = (uint32_t)offset;
+    if (offset != size) return -EINVAL;
+    
+    //We need at least a runtime image to do anything
+    if (file->images[REGULAR].sectionCount == 0) return -ENOENT;
+    
+    file->errorOffset = 0;
+    return 0;
+}
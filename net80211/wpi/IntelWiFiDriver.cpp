@@ -23,6 +23,30 @@ bool IntelWiFiDriver::device_attach(void *aux) {
     
     deviceProps.device = dev;
     
+    //Cold MVM state is kept out of deviceProps so the fast path fields stay on few cache lines
+    deviceProps.mvmConfig = (struct MVMSpecificConfig*)IOMalloc(sizeof(struct MVMSpecificConfig));
+    deviceProps.mvm = (struct MVMConfig*)IOMalloc(sizeof(struct MVMConfig));
+    if (!deviceProps.mvmConfig || !deviceProps.mvm) {
+        LOG_ERROR("%s: Failed to allocate MVM state\n", DRVNAME);
+        releaseDeviceAllocs();
+        return false;
+    }
+    bzero(deviceProps.mvmConfig, sizeof(struct MVMSpecificConfig));
+    bzero(deviceProps.mvm, sizeof(struct MVMConfig));
+    
+    if (allocHardwareStatistics() || allocFirmwareErrorDumps() || allocMMIOTrace()) {
+        releaseDeviceAllocs();
+        return false;
+    }
+    
+    if (initNotificationDispatch()) {
+        releaseDeviceAllocs();
+        return false;
+    }
+    
+    //Without it pollBit simply keeps spinning
+    deviceProps.pollWaitLock = IOLockAlloc();
+    
     //Read vendor and device ID from both subsystem and system
     uint16_t vendorID = dev->configRead16(kIOPCIConfigVendorID);
     uint16_t deviceID = dev->configRead16(kIOPCIConfigDeviceID);
@@ -33,12 +57,14 @@ bool IntelWiFiDriver::device_attach(void *aux) {
     if (vendorID != PCI_VENDOR_ID_INTEL) {
         LOG_ERROR("%s: Provided device not compatible with driver, wrong vendor ID (vid:0x%04x, did:0x%04x)\n", \
                   DRVNAME, vendorID, deviceID);
+        releaseDeviceAllocs();
         return false;
     }
     
     if (ss_vendorID != PCI_VENDOR_ID_INTEL) {
         LOG_ERROR("%s: Found matching device with vendor ID 8086 but wrong subsytem vendor ID (did:0x%04x ss_vid:0x%04x ss_did:0x%04x)\n", \
                   DRVNAME, deviceID, ss_vendorID, ss_deviceID);
+        releaseDeviceAllocs();
         return false;
     }
     
@@ -48,37 +74,44 @@ bool IntelWiFiDriver::device_attach(void *aux) {
     int error = pci_get_capability(NULL, dev, PCI_CAP_PCIEXPRESS, &deviceProps.capabilitiesStructOffset, NULL);
     if (error == 0) {
         LOG_ERROR("%s: PCIe capability structure not found!\n", DRVNAME);
+        releaseDeviceAllocs();
         return false;
     }
     
     //Set our devices iwl_cfg structure
     error = setDeviceCFG(deviceID, ss_deviceID);
     if (error) {
+        releaseDeviceAllocs();
         return false;
     }
+    selectTransport();
     
     //Allocate our device memory and store the pointer to it in our structure
     deviceProps.deviceMemoryMap = dev->mapDeviceMemoryWithRegister(kIOPCIConfigBaseAddress0);
     if (!deviceProps.deviceMemoryMap) {
         LOG_ERROR("%s: Could not get memory map for device\n", DRVNAME);
+        releaseDeviceAllocs();
         return false;
     }
-//    deviceProps.deviceMemoryMapVAddr = reinterpret_cast<volatile void*>(deviceProps.deviceMemoryMap->getVirtualAddress());
+    deviceProps.deviceMemoryMapVAddr = reinterpret_cast<volatile uint8_t*>(deviceProps.deviceMemoryMap->getVirtualAddress());
     IO_LOG("%s: Mapped device memory at vmAddr:0x%llx, size:%llu\n", DRVNAME, deviceProps.deviceMemoryMap->getVirtualAddress(), \
            deviceProps.deviceMemoryMap->getSize());
     
     //Install our interrupt handler
     
+    //iwl_drv_start, the firmware is parsed when kextd answers
+    if (requestFirmware()) {
+        releaseDeviceAllocs();
+        return false;
+    }
+    
     return true;
 }
 
 int IntelWiFiDriver::setDeviceCFG(uint16_t deviceID, uint16_t ss_deviceID) {
-    UInt32 i;
-    const struct iwl_cfg* devCfg;
-    for(i=0; i<sizeof(wifi_card_ids) / sizeof(wifi_card); i++) {
-        if(wifi_card_ids[i].device == deviceID && wifi_card_ids[i].subdevice == ss_deviceID)
-            devCfg = wifi_card_ids[i].config;
-    }
+    //iwl_pci_probe, wifi_card_ids is sorted so binary search it
+    const struct wifi_card* card = findWifiCard(wifi_card_ids, WIFI_CARD_COUNT, deviceID, ss_deviceID);
+    const struct iwl_cfg* devCfg = card ? card->config : NULL;
     
     if (!devCfg) {
         LOG_ERROR("%s: Failed to get cards config, might not be an MVM compatible card!", DRVNAME);
@@ -96,18 +129,50 @@ int IntelWiFiDriver::device_detach(int flags) {
 }
 
 void IntelWiFiDriver::releaseDeviceAllocs() {
+    //Nothing else is allocated before the MVM state
+    if (!deviceProps.mvmConfig || !deviceProps.mvm) {
+        if (deviceProps.mvmConfig) IOFree(deviceProps.mvmConfig, sizeof(struct MVMSpecificConfig));
+        if (deviceProps.mvm) IOFree(deviceProps.mvm, sizeof(struct MVMConfig));
+        deviceProps.mvmConfig = NULL;
+        deviceProps.mvm = NULL;
+        return;
+    }
+    
     if (DEBUG) printRefCounts();
+    if (DEBUG) printMMIOProfile();
+    if (DEBUG) printFirmwareLoadProfile();
+    if (DEBUG) printNotificationProfile();
+    if (DEBUG) printPollProfile();
+    if (DEBUG) printFirmwareErrorDumps();
+    
+    freeHardwareStatistics();
+    freeFirmwareErrorDumps();
+    freeMMIOTrace();
+    freeNotificationDispatch();
+    if (deviceProps.pollWaitLock) {
+        IOLockFree(deviceProps.pollWaitLock);
+        deviceProps.pollWaitLock = NULL;
+    }
+    cancelFirmwareRequest();
+    ctxtInfoRelease();
+    freeFirmware();
     
     if (deviceProps.deviceMemoryMap) {
         deviceProps.deviceMemoryMap->release();
     }
     
     deviceProps.deviceMemoryMap = NULL;
+    deviceProps.deviceMemoryMapVAddr = NULL;
     deviceProps.deviceConfig = NULL;
     deviceProps.workLoop = NULL;
     deviceProps.device = NULL;
     deviceProps.capabilitiesStructOffset = NULL;
     
+    IOFree(deviceProps.mvmConfig, sizeof(struct MVMSpecificConfig));
+    IOFree(deviceProps.mvm, sizeof(struct MVMConfig));
+    deviceProps.mvmConfig = NULL;
+    deviceProps.mvm = NULL;
+    
     IO_LOG("%s: Released all items in device struct", DRVNAME);
 }
 
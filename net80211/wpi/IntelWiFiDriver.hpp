@@ -19,12 +19,16 @@
 #include "iwlwifi_headers/linux-pci_regs.h"
 #include "iwlwifi_headers/fw/iwl-img.h"
 #include "iwlwifi_headers/iwl-trans.h"
+#include "iwlwifi_headers/iwl-context-info.h"
 #include "iwlwifi_headers/mvm/iwl-sta.h"
 //#include "iwlwifi_headers/mvm.h"
 
 #include <os/log.h>
 #include <libkern/OSDebug.h>
+#include <libkern/OSKextLib.h>
 #include <IOKit/system.h>
+#include <kern/clock.h>
+
 //#include <IOKit/IOFilterInterruptEventSource.h>
 
 #define DRVNAME "net80211"
@@ -39,8 +43,29 @@
 #define DEBUG 0
 #endif
 
+class IntelWiFiDriver;
+
+//Scoped NIC access, grabs the NIC on construction and releases it when it goes out of
+//scope so a batch of PRPH/SHR/memory operations only pays for one grab. Sessions nest,
+//an inner session on the thread that already owns the NIC only counts its depth
+class NICAccessSession {
+public:
+    explicit NICAccessSession(IntelWiFiDriver* driver);
+    ~NICAccessSession();
+    bool isHeld() const { return held; }
+    
+private:
+    NICAccessSession(const NICAccessSession&);
+    NICAccessSession& operator=(const NICAccessSession&);
+    
+    IntelWiFiDriver*            driver;
+    IOInterruptState            flags;
+    bool                        held;
+};
+
 class IntelWiFiDriver : public Voodoo80211Device {
     OSDeclareDefaultStructors(IntelWiFiDriver)
+    friend class NICAccessSession;
     
 protected:
     virtual bool device_attach(void *aux);
@@ -64,11 +89,12 @@ private:
     void handleRxINT();
     
 #pragma mark IO functions (IntelWiFiDriver_io.cpp)
-    void busWrite32(uint32_t offset, uint32_t value);
-    void busWrite8(uint16_t offfset, uint8_t value);
-    uint32_t busRead32(uint32_t offset);
-//    void write32Direct(volatile void* base, uint32_t offset, uint32_t value);
-//    uint32_t read32Direct(volatile void* base, uint32_t offset);
+    inline void busWrite32(uint32_t offset, uint32_t value);
+    inline void busWrite8(uint16_t offset, uint8_t value);
+    inline uint32_t busRead32(uint32_t offset);
+    inline void busBarrierRead();
+    inline void busBarrierWrite();
+    inline void busBarrierReadWrite();
     uint32_t busReadShr(uint32_t address);
     void busWriteShr(uint32_t address, uint32_t value);
     void busSetBit(uint32_t offset, uint8_t bitPosition);
@@ -76,7 +102,8 @@ private:
     void busSetBits(uint32_t offset, uint32_t bitPositions);
     void busClearBits(uint32_t offset, uint32_t bitPositions);
     uint16_t pcieCapabilityRead16(uint32_t offset);
-    int pollBit(uint32_t offset, uint32_t bits, uint32_t mask, int timeout);
+    int pollBit(uint32_t offset, uint32_t bits, uint32_t mask, int timeout, enum pollSite site);
+    void wakePollWaiters();
     uint32_t readPRPH(uint32_t offset);
     void writePRPH(uint32_t offset, uint32_t value);
     uint32_t getPRPHMask();
@@ -85,10 +112,11 @@ private:
     void writeUMAC_PRPH(uint32_t offset, uint32_t value);
     void writePRPHNoGrab(uint32_t offset, uint32_t value);
     uint32_t readPRPHNoGrab(uint32_t offset);
+    void modifyPRPHNoGrab(uint32_t offset, uint32_t clearMask, uint32_t setMask);
     int readIOMemToBuffer(uint32_t address, void* buffer, int dwords);
     
 #pragma mark Device communication functions (IntelWiFiDriver_comms.cpp)
-    bool grabNICAccess(IOInterruptState flags);
+    bool grabNICAccess(IOInterruptState& flags);
     void releaseNICAccess(IOInterruptState flags);
     void restartHardware();
     bool isRFKillSet();
@@ -110,13 +138,27 @@ private:
     bool mvmHasNewTxAPI();
     int mvmIsStaticQueue(int queue);
     
-#pragma mark Notification wait helpers (IntelWiFiDriver_notif.cpp)
+#pragma mark Notification dispatch and wait helpers (IntelWiFiDriver_notif.cpp)
+    int initNotificationDispatch();
+    void freeNotificationDispatch();
+    int registerNotificationHandler(uint16_t cmdID, NotificationHandler handler);
+    void dispatchNotification(struct iwl_rx_packet* packet);
+    int initNotificationWait(struct notificationWaitEntry* entry, const uint16_t* cmdIDs, int noCmdIDs,
+                             NotificationWaitFn fn, void* data);
+    void removeNotificationWait(struct notificationWaitEntry* entry);
+    int waitNotification(struct notificationWaitEntry* entry, uint32_t timeout);
     void abortNotificationWaits();
     
 #pragma mark NIC operations (IntelWiFiDriver_opps.cpp)
     void reportScanAborted();
+    void selectTransport();
+    template <class Trans> void setTransportOps(const char* name);
+    template <class Trans> void rxMultiqueueRestockT();
+    template <class Trans> void rxQueueIncrementWritePointerT();
+    template <class Trans> typename Trans::TFD* getTFDT(struct iwl_txq* txq, int index);
+    template <class Trans> void txQFreeTFDT(struct iwl_txq* txq);
+    template <class Trans> void unmapTFDT(struct iwl_cmd_meta* meta, struct iwl_txq* txq, int index);
     void rxMultiqueueRestock();
-    void restockRBD(struct iwl_rx_mem_buffer* rxmb);
     void rxQueueIncrementWritePointer();
     void stopDeviceG2(bool setLowPowerSate);
     void stopDeviceG1(bool setLowPowerState);
@@ -139,10 +181,6 @@ private:
     void unmapTFD(struct iwl_cmd_meta* meta, struct iwl_txq* txq, int index);
     void mapRxCauses();
     void mapNonRxCauses();
-    void* getTFD(struct iwl_txq* txq, int index);
-    uint8_t TFDGetNumberOfTBS(void* __tfd);
-    bus_addr_t TFDGetTBAddress(void* __tfd, int index);
-    uint16_t TFDGetTBLength(void* __tfd, int index);
     int queueIncWrap(int index);
     void clearCommandInFlight();
     void apmStopMaster();
@@ -150,26 +188,138 @@ private:
     void wakeQueue(iwl_txq *txq);
     
 #pragma mark CTXT related stuff (IntelWiFiDriver_ctxt.cpp)
+    int ctxtInfoInit();
+    int ctxtInfoInitG3();
+    int ctxtInfoInitDRAM(struct iwl_context_info_dram* dram);
     void ctxtInfoFreePaging();
     void ctxtInfoFreeG3();
     void ctxtInfoFree();
+    void ctxtInfoRelease();
     
 #pragma mark Firmware relataed stuff (IntelWiFiDriver_firmware.cpp)
     bool checkFWCapabilities(iwl_ucode_tlv_capa capabilities);
+    int requestFirmware();
+    int requestFirmwareAPI();
+    static void firmwareRequestCallback(OSKextRequestTag tag, OSReturn result, const void* data,
+                                        uint32_t size, void* context);
+    void cancelFirmwareRequest();
+    int parseFirmware(const uint8_t* data, size_t size);
+    void freeFirmware();
+    int loadFirmwareSections(enum UCodeType ucodeType);
+    void freeFirmwareSections();
+    int allocSectionDMA(struct FirmwareSectionDMA* dma, uint32_t length);
+    void freeSectionDMA(struct FirmwareSectionDMA* dma);
     
 #pragma mark ieee80211 related functions (IntelWiFiDriver_ieee80211.cpp)
     virtual int ieee80211_newstate(struct ieee80211com *ic, enum ieee80211_state nstate, int mgt);
     
 #pragma mark Debugging (IntelWiFiDriver_debug.cpp)
     void printRefCounts();
+    void printMMIOProfile();
+    void startFirmwareLoadTimer(enum FirmwareLoadMethod method);
+    void stopFirmwareLoadTimer();
+    void printFirmwareLoadProfile();
+    void printNotificationProfile();
+    void recordPollWait(enum pollSite site, uint32_t waited, uint32_t slept, bool timedOut);
+    void printPollProfile();
     hardwareDebugStatisticsCounters hwStats;
-    void updateHardwareDebugStatistics(enum hardwareDebugStatistics updateStat, uint32_t value);
+    struct hardwareStatisticsStripe* hwStatsStripes;
+    inline void updateHardwareStatistics(enum hardwareStatistics stat, uint32_t count);
+    int allocHardwareStatistics();
+    void freeHardwareStatistics();
+    void readHardwareStatistics(uint64_t counters[hardwareStatisticsCount]);
+    virtual IOReturn device_hw_stats(struct voodoo80211_hw_stats_data* data);
     void dumpHardwareRegisters();
     void dumpNICErrorLog();
     void collectFirmwareErrorDetails();
     void firmwareDebugStopRecording();
+    int allocFirmwareErrorDumps();
+    void freeFirmwareErrorDumps();
+    void captureFirmwareError(enum iwl_fw_dbg_trigger trigger, bool NICAccess);
+    void printFirmwareErrorDumps();
+    virtual int device_fw_dump(struct voodoo80211_fw_dump_header* header, voodoo80211_fw_dump_copyout copyout, void* ctx);
+    struct mmioTrace mmioTrace;
+    int allocMMIOTrace();
+    void freeMMIOTrace();
+    void traceMMIO(enum mmioTraceOp op, uint32_t address, uint32_t value);
+    uint32_t replayMMIORead(uint32_t offset);
+    void replayMMIOWrite(enum mmioTraceOp op, uint32_t offset, uint32_t value);
+    virtual size_t device_mmio_trace_size();
+    virtual size_t device_mmio_trace_save(void* buffer, size_t length);
+    virtual int device_mmio_trace_load(const void* data, size_t length);
 //    void taggedRetain(const void* tag) const;
 //    void taggedRelease(const void* tag) const;
 };
 
+//==================================
+//      Inline MMIO accessors
+//==================================
+//These are hit for every CSR access (interrupt handling, pollBit, PRPH and doorbells) so they
+//access the cached BAR0 mapping directly rather than making a virtual call to
+//IOPCIDevice->ioReadx/ioWritex which looks up the memory map each time.
+//The mapping is uncached so the compiler barrier from volatile is all that is needed to keep
+//register accesses in program order, the busBarrier functions order them against DMA memory.
+inline void IntelWiFiDriver::busWrite32(uint32_t offset, uint32_t value) {
+    if (DEBUG) hwStats.mmioWrites++;
+    if (MMIO_TRACE == MMIO_TRACE_RECORD) traceMMIO(mmioWrite32, offset, value);
+    if (MMIO_TRACE == MMIO_TRACE_REPLAY) {
+        replayMMIOWrite(mmioWrite32, offset, value);
+        return;
+    }
+    *reinterpret_cast<volatile uint32_t*>(deviceProps.deviceMemoryMapVAddr + offset) = OSSwapHostToLittleInt32(value);
+}
+
+inline void IntelWiFiDriver::busWrite8(uint16_t offset, uint8_t value) {
+    if (DEBUG) hwStats.mmioWrites++;
+    if (MMIO_TRACE == MMIO_TRACE_RECORD) traceMMIO(mmioWrite8, offset, value);
+    if (MMIO_TRACE == MMIO_TRACE_REPLAY) {
+        replayMMIOWrite(mmioWrite8, offset, value);
+        return;
+    }
+    *(deviceProps.deviceMemoryMapVAddr + offset) = value;
+}
+
+inline uint32_t IntelWiFiDriver::busRead32(uint32_t offset) {
+    if (DEBUG) hwStats.mmioReads++;
+    if (MMIO_TRACE == MMIO_TRACE_REPLAY) return replayMMIORead(offset);
+    uint32_t value = OSSwapLittleToHostInt32(*reinterpret_cast<volatile uint32_t*>(deviceProps.deviceMemoryMapVAddr + offset));
+    if (MMIO_TRACE == MMIO_TRACE_RECORD) traceMMIO(mmioRead32, offset, value);
+    return value;
+}
+
+//Equivalent to rmb()/wmb()/mb() in linux
+inline void IntelWiFiDriver::busBarrierRead() {
+    __asm__ __volatile__("lfence" ::: "memory");
+}
+
+inline void IntelWiFiDriver::busBarrierWrite() {
+    __asm__ __volatile__("sfence" ::: "memory");
+}
+
+inline void IntelWiFiDriver::busBarrierReadWrite() {
+    __asm__ __volatile__("mfence" ::: "memory");
+}
+
+//Lock free, threads that land on the same stripe still add correctly through the atomics.
+//The thread pointer is hashed because its low bits are the same for every thread
+inline void IntelWiFiDriver::updateHardwareStatistics(enum hardwareStatistics stat, uint32_t count) {
+    if (!hwStatsStripes) return;
+    uint64_t hash = (uint64_t)(uintptr_t)current_thread() * 0x9e3779b97f4a7c15ULL;
+    __atomic_fetch_add(&hwStatsStripes[hash >> (64 - HW_STATS_STRIPE_BITS)].counters[stat], count,
+                       __ATOMIC_RELAXED);
+}
+//==================================
+
+//==================================
+//        NIC access session
+//==================================
+inline NICAccessSession::NICAccessSession(IntelWiFiDriver* driver) : driver(driver), flags(0) {
+    held = driver->grabNICAccess(flags);
+}
+
+inline NICAccessSession::~NICAccessSession() {
+    if (held) driver->releaseNICAccess(flags);
+}
+//==================================
+
 #endif /* IntelWiFiDriver_hpp */
@@ -8,19 +8,42 @@
 #include "IntelWiFiDriver.hpp"
 
 //Keep the NIC awake while we read a value from its registers
-bool IntelWiFiDriver::grabNICAccess(IOInterruptState flags) {
+//Prefer a NICAccessSession over calling this directly, it releases the NIC on scope exit
+bool IntelWiFiDriver::grabNICAccess(IOInterruptState& flags) {
+    //Nested grab from the thread that already holds the NIC, the lock is held and the
+    //NIC is awake so just go one level deeper
+    if (deviceProps.NICAccessOwner == current_thread()) {
+        deviceProps.NICAccessDepth++;
+        return true;
+    }
+    
     //Setup the lock and disbale interrupts
     flags = IOSimpleLockLockDisableInterrupt(deviceProps.NICAccessLock);
     
-    //Check if device is currently already being held awake
-    if (deviceProps.holdNICAwake) return true;
+    uint32_t accessBits = (uint32_t)BIT(deviceProps.deviceConfig->csr->flag_val_mac_access_en);
+    uint32_t accessMask = (uint32_t)(BIT(deviceProps.deviceConfig->csr->flag_mac_clock_ready) |
+                                     WPI_GP_CNTRL_REG_FLAG_GOING_TO_SLEEP);
     
     busSetBit(WPI_GP_CNTRL, deviceProps.deviceConfig->csr->flag_mac_access_req);
     if (deviceProps.deviceConfig->device_family >= IWL_DEVICE_FAMILY_8000) udelay(2);
     
-    int ret = pollBit(WPI_GP_CNTRL, (uint32_t)BIT(deviceProps.deviceConfig->csr->flag_val_mac_access_en),
-                      (uint32_t)(BIT(deviceProps.deviceConfig->csr->flag_mac_clock_ready) |
-                      WPI_GP_CNTRL_REG_FLAG_GOING_TO_SLEEP), 15000);
+    //An awake NIC grants access within a few us, only spin that long with interrupts off.
+    //A NIC coming out of sleep can take milliseconds, wait for that with interrupts enabled
+    //then take the lock again, iwlwifi spins the whole 15ms under the lock
+    int ret = pollBit(WPI_GP_CNTRL, accessBits, accessMask, NIC_ACCESS_SPIN_TIMEOUT, pollSiteNICAccess);
+    if (ret < 0) {
+        IOSimpleLockUnlockEnableInterrupt(deviceProps.NICAccessLock, flags);
+        ret = pollBit(WPI_GP_CNTRL, accessBits, accessMask, NIC_ACCESS_TIMEOUT - NIC_ACCESS_SPIN_TIMEOUT,
+                      pollSiteNICAccessUnlocked);
+        flags = IOSimpleLockLockDisableInterrupt(deviceProps.NICAccessLock);
+        
+        //A session that ran in between may have dropped the request, make sure it is still
+        //set and that access is still granted now that we hold the lock
+        if (ret >= 0) {
+            busSetBit(WPI_GP_CNTRL, deviceProps.deviceConfig->csr->flag_mac_access_req);
+            ret = pollBit(WPI_GP_CNTRL, accessBits, accessMask, NIC_ACCESS_SPIN_TIMEOUT, pollSiteNICAccess);
+        }
+    }
     if (ret < 0) {
         uint32_t ctrlReg = busRead32(WPI_GP_CNTRL);
         
@@ -41,15 +64,19 @@ bool IntelWiFiDriver::grabNICAccess(IOInterruptState flags) {
         IOSimpleLockUnlockEnableInterrupt(deviceProps.NICAccessLock, flags);
         return false;
     }
+    
+    deviceProps.NICAccessOwner = current_thread();
+    deviceProps.NICAccessDepth = 1;
+    updateHardwareStatistics(NICGrabbed, 1);
     return true;
 }
 
-//Release the NIC from keeping itself awake
+//Release the NIC from keeping itself awake, the outermost session lets it sleep and unlocks
 void IntelWiFiDriver::releaseNICAccess(IOInterruptState flags) {
-    if (!deviceProps.holdNICAwake) {
-        busClearBit(WPI_GP_CNTRL, deviceProps.deviceConfig->csr->flag_mac_access_req);
-    }
+    if (--deviceProps.NICAccessDepth > 0) return;
     
+    busClearBit(WPI_GP_CNTRL, deviceProps.deviceConfig->csr->flag_mac_access_req);
+    deviceProps.NICAccessOwner = NULL;
     IOSimpleLockUnlockEnableInterrupt(deviceProps.NICAccessLock, flags);
 }
 
@@ -119,7 +146,8 @@ int IntelWiFiDriver::setHardwareReady() {
     
     busSetBits(WPI_HW_IF_CONFIG, CSR_HW_IF_CONFIG_REG_BIT_NIC_READY);
     
-    int ret = pollBit(WPI_HW_IF_CONFIG, CSR_HW_IF_CONFIG_REG_BIT_NIC_READY, CSR_HW_IF_CONFIG_REG_BIT_NIC_READY, HW_READY_TIMEOUT);
+    int ret = pollBit(WPI_HW_IF_CONFIG, CSR_HW_IF_CONFIG_REG_BIT_NIC_READY, CSR_HW_IF_CONFIG_REG_BIT_NIC_READY, HW_READY_TIMEOUT,
+                      pollSiteHardwareReady);
     if (ret >= 0) busSetBits(WPI_MBOX_SET, CSR_MBOX_SET_REG_OS_ALIVE);
     
     if (DEBUG) printf("%s: harware%s read\n", DRVNAME, ret < 0 ? " not" : "");
@@ -163,7 +191,8 @@ int IntelWiFiDriver::finishNICInit() {
      * device-internal resources is supported, e.g. iwl_write_prph()
      * and accesses to uCode SRAM.
      */
-    int err = pollBit(WPI_GP_CNTRL, BIT(deviceProps.deviceConfig->csr->flag_mac_clock_ready), BIT(deviceProps.deviceConfig->csr->flag_mac_clock_ready), 25000);
+    int err = pollBit(WPI_GP_CNTRL, BIT(deviceProps.deviceConfig->csr->flag_mac_clock_ready), BIT(deviceProps.deviceConfig->csr->flag_mac_clock_ready), 25000,
+                      pollSiteMACClock);
     if (err < 0) LOG_ERROR("%s: Failed to wake NIC\n", DRVNAME);
     
     if (deviceProps.deviceConfig->bisr_workaround) {
@@ -6,19 +6,149 @@
 //
 
 #include "IntelWiFiDriver.hpp"
+#include "IntelWiFiDriver_ctxt.hpp"
+
+//Context info lets gen2/gen3 devices load the whole firmware image themselves. The driver
+//describes the image with a table of DRAM addresses (one entry per section) and kicks the
+//device once, instead of pushing every section through FH TX and waiting for each chunk.
+//The section copies and the table are kept between loads so restarts dont rebuild them
+
+int IntelWiFiDriver::ctxtInfoInitDRAM(struct iwl_context_info_dram* dram) {
+    //iwl_pcie_init_fw_sec, built once per firmware
+    struct ContextInfoState* ctxtInfo = &deviceProps.ctxtInfo;
+    struct FirmwareRuntimeData* runtime = &deviceProps.mvmConfig->fwRuntimeData;
+    int error;
+    
+    if ((error = loadFirmwareSections(REGULAR))) return error;
+    if (ctxtInfo->dramTableValid) return 0;
+    
+    if (!buildContextInfoDRAM(dram, runtime->sectionDMA, runtime->sectionDMACount, &ctxtInfo->lmacSections,
+                              &ctxtInfo->umacSections, &ctxtInfo->pagingSections)) {
+        LOG_ERROR("%s: Firmware image has no LMAC/UMAC split (%u/%u/%u)\n", DRVNAME,
+                  ctxtInfo->lmacSections, ctxtInfo->umacSections, ctxtInfo->pagingSections);
+        return -EINVAL;
+    }
+    
+    ctxtInfo->dramTableValid = true;
+    return 0;
+}
+
+int IntelWiFiDriver::ctxtInfoInit() {
+    //iwl_pcie_ctxt_info_init
+    struct ContextInfoState* ctxtInfo = &deviceProps.ctxtInfo;
+    iwl_txq* commandQueue = deviceProps.txQueues[deviceProps.commandQueue];
+    bool cached = ctxtInfo->contextInfo.buffer != NULL;
+    int error;
+    
+    if (!deviceProps.rxq || !commandQueue) return -EINVAL;
+    struct ContextInfoQueues queues = { deviceProps.rxq->bd_dma, deviceProps.rxq->used_bd_dma,
+                                        deviceProps.rxq->rb_stts_dma, commandQueue->dma_addr };
+    
+    //Allocate the context info once, it holds the DRAM table so it lives as long as the table
+    if (!cached) {
+        if (allocSectionDMA(&ctxtInfo->contextInfo, sizeof(struct iwl_context_info))) return -ENOMEM;
+        ctxtInfo->dramTableValid = false;
+    }
+    struct iwl_context_info* info = (struct iwl_context_info*)ctxtInfo->contextInfo.vaddr;
+    
+    if ((error = ctxtInfoInitDRAM(&info->dram))) return error;
+    
+    //The queues may have moved since the last load, these are always rewritten
+    fillContextInfo(info, (uint16_t)busRead32(WPI_HW_REV), &queues);
+    
+    enableCTXInfoINT();
+    
+    //Kick the firmware self load, the device reads everything else from the context info
+    startFirmwareLoadTimer(contextInfoFirmwareLoad);
+    busWrite32(CSR_CTXT_INFO_BA, ctxtInfo->contextInfo.paddr);
+    busWrite32(CSR_CTXT_INFO_BA + 4, 0);
+    writePRPH(UREG_CPU_INIT_RUN, 1);
+    
+    if (DEBUG) printf("%s: Context info load started (%u LMAC, %u UMAC, %u paging sections, %s)\n", DRVNAME,
+                      ctxtInfo->lmacSections, ctxtInfo->umacSections, ctxtInfo->pagingSections,
+                      cached ? "cached" : "built");
+    return 0;
+}
+
+int IntelWiFiDriver::ctxtInfoInitG3() {
+    //iwl_pcie_ctxt_info_gen3_init
+    struct ContextInfoState* ctxtInfo = &deviceProps.ctxtInfo;
+    struct FirmwareFile* file = &deviceProps.mvmConfig->fwData.file;
+    iwl_txq* commandQueue = deviceProps.txQueues[deviceProps.commandQueue];
+    int error;
+    
+    if (!deviceProps.rxq || !commandQueue) return -EINVAL;
+    if (!file->iml.length) {
+        LOG_ERROR("%s: Firmware has no image loader, cannot use context info gen3\n", DRVNAME);
+        return -EINVAL;
+    }
+    
+    //The PRPH scratch holds the DRAM table, like the gen2 context info it is kept between loads
+    if (!ctxtInfo->prphScratch.buffer) {
+        if (allocSectionDMA(&ctxtInfo->prphScratch, sizeof(struct iwl_prph_scratch))) return -ENOMEM;
+        ctxtInfo->dramTableValid = false;
+    }
+    if (!ctxtInfo->prphInfo.buffer && allocSectionDMA(&ctxtInfo->prphInfo, PAGE_SIZE)) return -ENOMEM;
+    if (!ctxtInfo->contextInfo.buffer &&
+        allocSectionDMA(&ctxtInfo->contextInfo, sizeof(struct iwl_context_info_gen3))) return -ENOMEM;
+    
+    struct iwl_prph_scratch* scratch = (struct iwl_prph_scratch*)ctxtInfo->prphScratch.vaddr;
+    struct iwl_context_info_gen3* info = (struct iwl_context_info_gen3*)ctxtInfo->contextInfo.vaddr;
+    struct ContextInfoQueues queues = { deviceProps.rxq->bd_dma, deviceProps.rxq->used_bd_dma,
+                                        deviceProps.rxq->rb_stts_dma, commandQueue->dma_addr };
+    
+    if ((error = ctxtInfoInitDRAM(&scratch->dram))) return error;
+    
+    fillContextInfoG3(info, scratch, (uint16_t)busRead32(WPI_HW_REV), &queues, ctxtInfo->prphScratch.paddr,
+                      ctxtInfo->prphInfo.paddr, PAGE_SIZE);
+    
+    //The image loader is only needed until ALIVE, it is freed again by ctxtInfoFreeG3
+    if (allocSectionDMA(&ctxtInfo->iml, file->iml.length)) return -ENOMEM;
+    memcpy(ctxtInfo->iml.vaddr, file->data + file->iml.offset, file->iml.length);
+    
+    enableCTXInfoINT();
+    
+    startFirmwareLoadTimer(contextInfoFirmwareLoad);
+    busWrite32(CSR_CTXT_INFO_ADDR, ctxtInfo->contextInfo.paddr);
+    busWrite32(CSR_CTXT_INFO_ADDR + 4, 0);
+    busWrite32(CSR_IML_DATA_ADDR, ctxtInfo->iml.paddr);
+    busWrite32(CSR_IML_DATA_ADDR + 4, 0);
+    busWrite32(CSR_IML_SIZE_ADDR, file->iml.length);
+    busSetBits(CSR_CTXT_INFO_BOOT_CTRL, CSR_AUTO_FUNC_INIT);
+    return 0;
+}
 
 void IntelWiFiDriver::ctxtInfoFreePaging() {
     //iwl_pcie_ctxt_info_free_paging
-    //TODO: Implement
+    //The paging sections are part of the cached image, so drop the whole image and its
+    //DRAM table rather than leaving holes in it
+    if (!deviceProps.ctxtInfo.pagingSections) return;
+    deviceProps.ctxtInfo.pagingSections = 0;
+    freeFirmwareSections();
 }
 
 void IntelWiFiDriver::ctxtInfoFreeG3() {
     //Gen3 device function
     //iwl_pcie_ctxt_info_gen3_free
-    //TODO: Implement
+    //Only the image loader is released, the PRPH scratch, PRPH info and context info hold
+    //the cached DRAM table and are kept for the next load (see ctxtInfoRelease)
+    freeSectionDMA(&deviceProps.ctxtInfo.iml);
+    deviceProps.firmwareLoadStart = 0;
 }
 
 void IntelWiFiDriver::ctxtInfoFree() {
     //iwl_pcie_ctxt_info_free
-    //TODO: Implement
+    //Nothing in the gen2 context info is per load, it is kept for the next load (see ctxtInfoRelease)
+    deviceProps.firmwareLoadStart = 0;
+}
+
+void IntelWiFiDriver::ctxtInfoRelease() {
+    //Releases the cached context info blocks, called when the device goes away
+    struct ContextInfoState* ctxtInfo = &deviceProps.ctxtInfo;
+    
+    freeSectionDMA(&ctxtInfo->iml);
+    freeSectionDMA(&ctxtInfo->contextInfo);
+    freeSectionDMA(&ctxtInfo->prphScratch);
+    freeSectionDMA(&ctxtInfo->prphInfo);
+    ctxtInfo->dramTableValid = false;
 }
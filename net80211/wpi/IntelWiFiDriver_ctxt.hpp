@@ -0,0 +1,113 @@
+//
+//  IntelWiFiDriver_ctxt.hpp
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+#ifndef IntelWiFiDriver_ctxt_h
+#define IntelWiFiDriver_ctxt_h
+
+#include "iwlwifi_headers/iwl-fh.h"
+#include "iwlwifi_headers/iwl-context-info.h"
+#include "iwlwifi_headers/firmware-defs.h"
+#include "Firmware.hpp"
+
+//Contents of the blocks the gen2/gen3 firmware self load reads. IntelWiFiDriver_ctxt.cpp
+//allocates the blocks and kicks the device, everything written into them is built here so
+//the layout can be checked without IOKit
+
+//DMA addresses of the queues the context info points the device at
+struct ContextInfoQueues {
+    uint64_t    freeRBD;        //rxq->bd_dma
+    uint64_t    usedRBD;        //rxq->used_bd_dma
+    uint64_t    rbStatus;       //rxq->rb_stts_dma
+    uint64_t    commandQueue;   //TFDs of the command queue
+};
+
+static inline uint32_t countContextInfoSections(const struct FirmwareSectionDMA* sections, uint32_t count,
+                                                uint32_t start) {
+    //iwl_pcie_get_num_sections
+    uint32_t i = 0;
+
+    while (start < count &&
+           sections[start].deviceOffset != CPU1_CPU2_SEPARATOR_SECTION &&
+           sections[start].deviceOffset != PAGING_SEPARATOR_SECTION) {
+        start++;
+        i++;
+    }
+    return i;
+}
+
+//iwl_pcie_init_fw_sec
+//Sections are laid out as LMAC, separator, UMAC, separator, paging. Returns false without
+//touching dram if the image has no LMAC/UMAC split or a part does not fit the table
+static inline bool buildContextInfoDRAM(struct iwl_context_info_dram* dram, const struct FirmwareSectionDMA* sections,
+                                        uint32_t count, uint32_t* lmac, uint32_t* umac, uint32_t* paging) {
+    *lmac = countContextInfoSections(sections, count, 0);
+    *umac = countContextInfoSections(sections, count, *lmac + 1);
+    *paging = countContextInfoSections(sections, count, *lmac + *umac + 2);
+    if (!*lmac || !*umac || *lmac > IWL_MAX_DRAM_ENTRY || *umac > IWL_MAX_DRAM_ENTRY ||
+        *paging > IWL_MAX_DRAM_ENTRY) {
+        return false;
+    }
+
+    memset(dram, 0, sizeof(*dram));
+    for (uint32_t i = 0; i < *lmac; i++) {
+        dram->lmac_img[i] = cpu_to_le64(sections[i].paddr);
+    }
+    sections += *lmac + 1;
+    for (uint32_t i = 0; i < *umac; i++) {
+        dram->umac_img[i] = cpu_to_le64(sections[i].paddr);
+    }
+    sections += *umac + 1;
+    for (uint32_t i = 0; i < *paging; i++) {
+        dram->virtual_img[i] = cpu_to_le64(sections[i].paddr);
+    }
+    return true;
+}
+
+//iwl_pcie_ctxt_info_init without the DRAM table, which is cached between loads
+static inline void fillContextInfo(struct iwl_context_info* info, uint16_t macID, const struct ContextInfoQueues* queues) {
+    info->version.mac_id = cpu_to_le16(macID);
+    //FW will ignore the version in case the context info is not supported
+    info->version.version = 0;
+    info->version.size = cpu_to_le16(sizeof(*info) / 4);
+    info->control.control_flags = cpu_to_le32(IWL_CTXT_INFO_TFD_FORMAT_LONG |
+                                              RX_QUEUE_CB_SIZE(MQ_RX_TABLE_SIZE) << IWL_CTXT_INFO_RB_CB_SIZE_POS |
+                                              IWL_CTXT_INFO_RB_SIZE_4K << IWL_CTXT_INFO_RB_SIZE_POS);
+
+    info->rbd_cfg.free_rbd_addr = cpu_to_le64(queues->freeRBD);
+    info->rbd_cfg.used_rbd_addr = cpu_to_le64(queues->usedRBD);
+    info->rbd_cfg.status_wr_ptr = cpu_to_le64(queues->rbStatus);
+    info->hcmd_cfg.cmd_queue_addr = cpu_to_le64(queues->commandQueue);
+    info->hcmd_cfg.cmd_queue_size = TFD_QUEUE_CB_SIZE(IWL_CMD_QUEUE_SIZE);
+}
+
+//iwl_pcie_ctxt_info_gen3_init without the DRAM table in the PRPH scratch. The TR and CR tail
+//arrays live in the second half of the PRPH info block, which is prphInfoSize bytes long
+static inline void fillContextInfoG3(struct iwl_context_info_gen3* info, struct iwl_prph_scratch* scratch,
+                                     uint16_t macID, const struct ContextInfoQueues* queues,
+                                     uint64_t prphScratch, uint64_t prphInfo, uint32_t prphInfoSize) {
+    scratch->ctrl_cfg.version.version = 0;
+    scratch->ctrl_cfg.version.mac_id = cpu_to_le16(macID);
+    scratch->ctrl_cfg.version.size = cpu_to_le16(sizeof(*scratch) / 4);
+    scratch->ctrl_cfg.control.control_flags = cpu_to_le32(IWL_PRPH_SCRATCH_RB_SIZE_4K |
+                                                          IWL_PRPH_SCRATCH_MTR_MODE |
+                                                          (IWL_PRPH_MTR_FORMAT_256B & IWL_PRPH_SCRATCH_MTR_FORMAT));
+    scratch->ctrl_cfg.rbd_cfg.free_rbd_addr = cpu_to_le64(queues->freeRBD);
+
+    memset(info, 0, sizeof(*info));
+    info->prph_info_base_addr = cpu_to_le64(prphInfo);
+    info->prph_scratch_base_addr = cpu_to_le64(prphScratch);
+    info->prph_scratch_size = cpu_to_le32(sizeof(*scratch));
+    info->cr_head_idx_arr_base_addr = cpu_to_le64(queues->rbStatus);
+    info->tr_tail_idx_arr_base_addr = cpu_to_le64(prphInfo + prphInfoSize / 2);
+    info->cr_tail_idx_arr_base_addr = cpu_to_le64(prphInfo + 3 * prphInfoSize / 4);
+    info->mtr_base_addr = cpu_to_le64(queues->commandQueue);
+    info->mcr_base_addr = cpu_to_le64(queues->usedRBD);
+    info->mtr_size = cpu_to_le16(TFD_QUEUE_CB_SIZE(IWL_CMD_QUEUE_SIZE));
+    info->mcr_size = cpu_to_le16(RX_QUEUE_CB_SIZE(MQ_RX_TABLE_SIZE));
+}
+
+#endif /* IntelWiFiDriver_ctxt_h */
@@ -7,63 +7,480 @@
 
 #include "IntelWiFiDriver.hpp"
 
-void IntelWiFiDriver::updateHardwareDebugStatistics(enum hardwareDebugStatistics updateStat, uint32_t value) {
-    if (!DEBUG) {
+int IntelWiFiDriver::allocHardwareStatistics() {
+    hwStatsStripes = (struct hardwareStatisticsStripe*)IOMallocAligned(sizeof(struct hardwareStatisticsStripe) * HW_STATS_STRIPES,
+                                                                       sizeof(struct hardwareStatisticsStripe));
+    if (!hwStatsStripes) {
+        LOG_ERROR("%s: Failed to allocate hardware statistics\n", DRVNAME);
+        return -ENOMEM;
+    }
+    bzero(hwStatsStripes, sizeof(struct hardwareStatisticsStripe) * HW_STATS_STRIPES);
+    return 0;
+}
+
+void IntelWiFiDriver::freeHardwareStatistics() {
+    if (hwStatsStripes) {
+        IOFreeAligned(hwStatsStripes, sizeof(struct hardwareStatisticsStripe) * HW_STATS_STRIPES);
+        hwStatsStripes = NULL;
+    }
+}
+
+//Sum the stripes, a counter may be a few increments behind if another thread is updating it
+void IntelWiFiDriver::readHardwareStatistics(uint64_t counters[hardwareStatisticsCount]) {
+    bzero(counters, sizeof(uint64_t) * hardwareStatisticsCount);
+    if (!hwStatsStripes) return;
+    
+    for (int stripe = 0; stripe < HW_STATS_STRIPES; stripe++) {
+        for (int i = 0; i < hardwareStatisticsCount; i++) {
+            counters[i] += __atomic_load_n(&hwStatsStripes[stripe].counters[i], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static_assert(hardwareStatisticsCount <= VOODOO80211_HW_STATS_MAX, "Too many hardware statistics to export");
+
+IOReturn IntelWiFiDriver::device_hw_stats(struct voodoo80211_hw_stats_data* data) {
+    uint64_t counters[hardwareStatisticsCount];
+    
+    readHardwareStatistics(counters);
+    data->count = hardwareStatisticsCount;
+    for (int i = 0; i < hardwareStatisticsCount; i++) {
+        data->counters[i] = counters[i];
+    }
+    return kIOReturnSuccess;
+}
+
+void IntelWiFiDriver::printMMIOProfile() {
+    if (!DEBUG) return;
+    
+    //Integer averages scaled by 100 so we dont need floating point in the kernel
+    uint64_t counters[hardwareStatisticsCount];
+    readHardwareStatistics(counters);
+    uint64_t accesses = hwStats.mmioReads + hwStats.mmioWrites;
+    uint64_t interrupts = counters[interruptFired];
+    uint64_t packets = counters[rxFrames] + counters[txFrames];
+    IO_LOG("%s: MMIO profile: reads=%llu writes=%llu interrupts=%llu packets=%llu\n", DRVNAME,
+           hwStats.mmioReads, hwStats.mmioWrites, interrupts, packets);
+    if (interrupts) {
+        IO_LOG("%s: MMIO accesses per interrupt: %llu.%02llu\n", DRVNAME,
+               accesses / interrupts, (accesses * 100 / interrupts) % 100);
+    }
+    if (packets) {
+        IO_LOG("%s: MMIO accesses per packet: %llu.%02llu\n", DRVNAME,
+               accesses / packets, (accesses * 100 / packets) % 100);
+    }
+    if (MMIO_TRACE == MMIO_TRACE_RECORD || MMIO_TRACE == MMIO_TRACE_REPLAY) {
+        IO_LOG("%s: MMIO trace: read32=%llu write32=%llu write8=%llu prph=%llu/%llu shr=%llu/%llu mismatches=%u\n",
+               DRVNAME, mmioTrace.ops[mmioRead32], mmioTrace.ops[mmioWrite32], mmioTrace.ops[mmioWrite8],
+               mmioTrace.ops[mmioReadPRPH], mmioTrace.ops[mmioWritePRPH], mmioTrace.ops[mmioReadShr],
+               mmioTrace.ops[mmioWriteShr], mmioTrace.mismatches);
+    }
+}
+
+int IntelWiFiDriver::allocMMIOTrace() {
+    if (MMIO_TRACE != MMIO_TRACE_RECORD && MMIO_TRACE != MMIO_TRACE_REPLAY) return 0;
+    
+    bzero(&mmioTrace, sizeof(mmioTrace));
+    mmioTrace.entries = (struct mmioTraceEntry*)IOMalloc(MMIO_TRACE_ENTRIES * sizeof(struct mmioTraceEntry));
+    if (!mmioTrace.entries) {
+        LOG_ERROR("%s: Failed to allocate MMIO trace\n", DRVNAME);
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+void IntelWiFiDriver::freeMMIOTrace() {
+    if (mmioTrace.entries) {
+        IOFree(mmioTrace.entries, MMIO_TRACE_ENTRIES * sizeof(struct mmioTraceEntry));
+        mmioTrace.entries = NULL;
+    }
+}
+
+//Record backend, called for every register access so it only takes a slot in the ring.
+//Accesses from different threads interleave in the order they got their slot
+void IntelWiFiDriver::traceMMIO(enum mmioTraceOp op, uint32_t address, uint32_t value) {
+    uint64_t now, last, nanoseconds = 0;
+    
+    if (!mmioTrace.entries) return;
+    
+    clock_get_uptime(&now);
+    last = __atomic_exchange_n(&mmioTrace.last, now, __ATOMIC_RELAXED);
+    if (last && now > last) absolutetime_to_nanoseconds(now - last, &nanoseconds);
+    recordMMIOAccess(&mmioTrace, op, address, value, nanoseconds);
+}
+
+//Replay backend, reads past the end of the trace look like a removed device
+uint32_t IntelWiFiDriver::replayMMIORead(uint32_t offset) {
+    return replayMMIOAccess(&mmioTrace, mmioRead32, offset, 0);
+}
+
+void IntelWiFiDriver::replayMMIOWrite(enum mmioTraceOp op, uint32_t offset, uint32_t value) {
+    replayMMIOAccess(&mmioTrace, op, offset, value);
+}
+
+//Size and save are called on the command gate, accesses from the work loop wait for the copy
+size_t IntelWiFiDriver::device_mmio_trace_size() {
+    if (MMIO_TRACE != MMIO_TRACE_RECORD) return 0;
+    return savedMMIOTraceSize(&mmioTrace);
+}
+
+size_t IntelWiFiDriver::device_mmio_trace_save(void* buffer, size_t length) {
+    if (MMIO_TRACE != MMIO_TRACE_RECORD) return 0;
+    return saveMMIOTrace(&mmioTrace, buffer, length);
+}
+
+//Called on the command gate so the trace is not swapped under an access from the work loop
+int IntelWiFiDriver::device_mmio_trace_load(const void* data, size_t length) {
+    if (MMIO_TRACE != MMIO_TRACE_REPLAY) return ENOTSUP;
+    return -loadMMIOTrace(&mmioTrace, data, length);
+}
+
+void IntelWiFiDriver::recordPollWait(enum pollSite site, uint32_t waited, uint32_t slept, bool timedOut) {
+    if (!DEBUG) return;
+    
+    hwStats.pollWaits[site]++;
+    if (timedOut) hwStats.pollTimeouts[site]++;
+    if (waited > hwStats.pollMaxWait[site]) hwStats.pollMaxWait[site] = waited;
+    hwStats.pollTotalWait[site] += waited;
+    hwStats.pollTotalSpin[site] += waited > slept ? waited - slept : 0;
+}
+
+void IntelWiFiDriver::printPollProfile() {
+    if (!DEBUG) return;
+    
+    static const char* siteNames[pollSiteCount] = {
+        "NIC access", "NIC access (unlocked)", "hardware ready", "MAC clock", "TX flush", "stop master"
+    };
+    for (int i = 0; i < pollSiteCount; i++) {
+        if (!hwStats.pollWaits[i]) continue;
+        IO_LOG("%s: Wait %s: waits=%u timeouts=%u max=%uus average=%lluus spun=%lluus\n", DRVNAME, siteNames[i],
+               hwStats.pollWaits[i], hwStats.pollTimeouts[i], hwStats.pollMaxWait[i],
+               hwStats.pollTotalWait[i] / hwStats.pollWaits[i], hwStats.pollTotalSpin[i]);
+    }
+}
+
+void IntelWiFiDriver::startFirmwareLoadTimer(enum FirmwareLoadMethod method) {
+    //Called right before the device is told to start loading the image
+    clock_get_uptime(&deviceProps.firmwareLoadStart);
+    deviceProps.firmwareLoadMethod = method;
+}
+
+void IntelWiFiDriver::stopFirmwareLoadTimer() {
+    //Called on ALIVE, only the first ALIVE after a load is counted
+    uint64_t now, nanoseconds;
+    
+    if (!deviceProps.firmwareLoadStart) return;
+    clock_get_uptime(&now);
+    absolutetime_to_nanoseconds(now - deviceProps.firmwareLoadStart, &nanoseconds);
+    deviceProps.firmwareLoadStart = 0;
+    
+    enum FirmwareLoadMethod method = deviceProps.firmwareLoadMethod;
+    hwStats.firmwareLoads[method]++;
+    hwStats.lastAliveLatency[method] = (uint32_t)(nanoseconds / 1000);
+    hwStats.totalAliveLatency[method] += nanoseconds / 1000;
+    if (DEBUG) printf("%s: Firmware ALIVE %u us after %s load\n", DRVNAME, hwStats.lastAliveLatency[method],
+                      method == contextInfoFirmwareLoad ? "context info" : "chunked");
+}
+
+void IntelWiFiDriver::printFirmwareLoadProfile() {
+    if (!DEBUG) return;
+    
+    static const char* methodNames[firmwareLoadMethodCount] = { "chunked", "context info" };
+    for (int i = 0; i < firmwareLoadMethodCount; i++) {
+        if (!hwStats.firmwareLoads[i]) continue;
+        IO_LOG("%s: Firmware load (%s): loads=%u last=%uus average=%lluus\n", DRVNAME, methodNames[i],
+               hwStats.firmwareLoads[i], hwStats.lastAliveLatency[i],
+               hwStats.totalAliveLatency[i] / hwStats.firmwareLoads[i]);
+    }
+}
+
+void IntelWiFiDriver::printNotificationProfile() {
+    if (!DEBUG) return;
+    
+    struct notificationDispatch* notifs = &deviceProps.mvmConfig->notifs;
+    IO_LOG("%s: Notifications: slots=%u/%u unhandled=%u\n", DRVNAME,
+           notifs->slotsUsed, NOTIF_TABLE_SIZE, notifs->unhandled);
+    for (int i = 0; i < NOTIF_TABLE_SIZE; i++) {
+        struct notificationSlot* slot = &notifs->table[i];
+        if (!slot->inUse || !slot->received) continue;
+        
+        //Report the bucket holding the median and the slowest non-empty bucket
+        uint32_t total = 0, seen = 0, median = 0, slowest = 0;
+        for (int b = 0; b < NOTIF_LATENCY_BUCKETS; b++) total += slot->latency[b];
+        for (int b = 0; b < NOTIF_LATENCY_BUCKETS; b++) {
+            if (!slot->latency[b]) continue;
+            if (seen * 2 < total) median = b;
+            seen += slot->latency[b];
+            slowest = b;
+        }
+        IO_LOG("%s: Notification 0x%04x: received=%u woken=%u median<%uus max<%uus\n", DRVNAME,
+               slot->cmdID, slot->received, slot->waitersWoken, 1 << median, 1 << slowest);
+    }
+}
+
+//CSR range copied into dumps, IWL_CSR_TO_DUMP
+#define ERROR_DUMP_CSR_SIZE 0x250
+
+static_assert(FW_ERROR_DUMP_SLOT_SIZE <= VOODOO80211_FW_DUMP_MAX, "Firmware error dump slot does not fit the sysctl");
+static_assert(FW_ERROR_DUMP_SLOTS <= 32, "Firmware error dump slots do not fit the writing mask");
+
+//Write position in the dump slot being filled
+struct errorDumpCursor {
+    uint8_t*    base;
+    uint32_t    offset;
+    bool        truncated;
+};
+
+//Reserve a section of between minimum and *length bytes, *length is set to what was granted.
+//Returns NULL if not even minimum fits
+static struct iwl_fw_error_dump_data* errorDumpSection(struct errorDumpCursor* cursor, uint32_t type,
+                                                       uint32_t* length, uint32_t minimum) {
+    uint32_t space = FW_ERROR_DUMP_SLOT_SIZE - cursor->offset;
+    struct iwl_fw_error_dump_data* section;
+    
+    if (space < sizeof(*section) + minimum) {
+        cursor->truncated = true;
+        return NULL;
+    }
+    space -= sizeof(*section);
+    if (*length > space) {
+        //Keep whole dwords, sections are mostly register and SRAM contents
+        *length = space & ~3;
+        cursor->truncated = true;
+    }
+    
+    section = (struct iwl_fw_error_dump_data*)(cursor->base + cursor->offset);
+    section->type = cpu_to_le32(type);
+    section->len = cpu_to_le32(*length);
+    cursor->offset += sizeof(*section) + *length;
+    return section;
+}
+
+int IntelWiFiDriver::allocFirmwareErrorDumps() {
+    struct firmwareErrorDumpRing* dumps = &deviceProps.mvmConfig->errorDumps;
+    
+    dumps->lock = IOSimpleLockAlloc();
+    dumps->buffer = (uint8_t*)IOMalloc(FW_ERROR_DUMP_SLOTS * FW_ERROR_DUMP_SLOT_SIZE);
+    if (!dumps->lock || !dumps->buffer) {
+        LOG_ERROR("%s: Failed to allocate firmware error dump ring\n", DRVNAME);
+        freeFirmwareErrorDumps();
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+void IntelWiFiDriver::freeFirmwareErrorDumps() {
+    struct firmwareErrorDumpRing* dumps = &deviceProps.mvmConfig->errorDumps;
+    
+    if (dumps->buffer) {
+        IOFree(dumps->buffer, FW_ERROR_DUMP_SLOTS * FW_ERROR_DUMP_SLOT_SIZE);
+        dumps->buffer = NULL;
+    }
+    if (dumps->lock) {
+        IOSimpleLockFree(dumps->lock);
+        dumps->lock = NULL;
+    }
+}
+
+//Copy the device state into the oldest ring slot as an iwlwifi dump file (iwl_fw_error_dump).
+//Nothing is allocated or logged so this is safe from the interrupt handler. Without NICAccess
+//only the CSRs are read, for callers that already hold or cannot get the NIC
+void IntelWiFiDriver::captureFirmwareError(enum iwl_fw_dbg_trigger trigger, bool NICAccess) {
+    struct firmwareErrorDumpRing* dumps = &deviceProps.mvmConfig->errorDumps;
+    struct UCodeCapabilities* capabilities = &deviceProps.mvmConfig->fwData.uCodeCapabilities;
+    struct iwl_fw_error_dump_data* section;
+    struct errorDumpCursor cursor;
+    uint32_t slot, length;
+    
+    if (!dumps->buffer) return;
+    
+    //Claim the oldest slot nobody is copying out, readers skip it until its length is set again
+    IOSimpleLockLock(dumps->lock);
+    slot = FW_ERROR_DUMP_SLOTS;
+    for (uint32_t i = 0; i < FW_ERROR_DUMP_SLOTS; i++) {
+        if (dumps->readers[i] || (dumps->writing & (1 << i))) continue;
+        if (slot == FW_ERROR_DUMP_SLOTS ||
+            dumps->captured - dumps->sequence[i] > dumps->captured - dumps->sequence[slot]) {
+            slot = i;
+        }
+    }
+    if (slot == FW_ERROR_DUMP_SLOTS) {
+        dumps->dropped++;
+        IOSimpleLockUnlock(dumps->lock);
         return;
     }
+    dumps->sequence[slot] = ++dumps->captured;
+    dumps->length[slot] = 0;
+    dumps->writing |= 1 << slot;
+    IOSimpleLockUnlock(dumps->lock);
+    
+    cursor.base = dumps->buffer + slot * FW_ERROR_DUMP_SLOT_SIZE;
+    cursor.offset = sizeof(struct iwl_fw_error_dump_file);
+    cursor.truncated = false;
+    
+    length = sizeof(struct iwl_fw_error_dump_info);
+    section = errorDumpSection(&cursor, IWL_FW_ERROR_DUMP_DEV_FW_INFO, &length, length);
+    if (section) {
+        struct iwl_fw_error_dump_info* info = (struct iwl_fw_error_dump_info*)section->data;
+        uint32_t hardwareRevision = busRead32(WPI_HW_REV);
+        
+        bzero(info, sizeof(*info));
+        info->hw_type = cpu_to_le32((hardwareRevision & 0xfff0) >> 4);
+        info->hw_step = cpu_to_le32((hardwareRevision & 0xc) >> 2);
+        strlcpy((char*)info->fw_human_readable, deviceProps.mvmConfig->fwData.file.humanReadable,
+                sizeof(info->fw_human_readable));
+        if (deviceProps.deviceConfig->name) {
+            strlcpy((char*)info->dev_human_readable, deviceProps.deviceConfig->name,
+                    sizeof(info->dev_human_readable));
+        }
+        strlcpy((char*)info->bus_human_readable, "PCI", sizeof(info->bus_human_readable));
+    }
+    
+    length = sizeof(struct iwl_fw_error_dump_trigger_desc);
+    section = errorDumpSection(&cursor, IWL_FW_ERROR_DUMP_ERROR_INFO, &length, length);
+    if (section) {
+        ((struct iwl_fw_error_dump_trigger_desc*)section->data)->type = cpu_to_le32(trigger);
+    }
+    
+    //CSRs sit in the BAR and can be read without waking the NIC
+    length = ERROR_DUMP_CSR_SIZE;
+    section = errorDumpSection(&cursor, IWL_FW_ERROR_DUMP_CSR, &length, 0);
+    if (section) {
+        uint32_t* registers = (uint32_t*)section->data;
+        for (uint32_t i = 0; i < length / 4; i++) {
+            registers[i] = cpu_to_le32(busRead32(i * 4));
+        }
+    }
     
-    //If debugging is enabled for the kext we will update the stats of the driver + card
-    //We arent really bothered about using this if debugging is not enabled
-    switch (updateStat) {
-        case hardwareError:
-            hwStats.hardwareError++;
-            break;
-        case softwareError:
-            hwStats.softwareError++;
-            break;
-        case schedulerFired:
-            hwStats.schedulerFired++;
-            break;
-        case aliveRecieved:
-            hwStats.aliveRecieved++;
-            break;
-        case rfKillToggledOn:
-            hwStats.rfKillToggledOn++;
-            break;
-        case ctKill:
-            hwStats.ctKill++;
-            break;
-        case wakeup:
-            hwStats.wakeup++;
-            break;
-        case rxRecieved:
-            hwStats.rx++;
-            break;
-        case txRecieved:
-            hwStats.tx++;
-            break;
+    if (NICAccess) {
+        NICAccessSession nic(this);
+        
+        //iwl_trans_pcie_fh_regs_dump, gen2 moved the FH registers into the periphery
+        if (nic.isHeld()) {
+            bool gen2 = deviceProps.deviceConfig->gen2;
+            uint32_t start = gen2 ? FH_MEM_LOWER_BOUND_GEN2 : FH_MEM_LOWER_BOUND;
+            uint32_t end = gen2 ? FH_MEM_UPPER_BOUND_GEN2 : FH_MEM_UPPER_BOUND;
+            
+            length = end - start;
+            section = errorDumpSection(&cursor, IWL_FW_ERROR_DUMP_FH_REGS, &length, 0);
+            if (section) {
+                uint32_t* registers = (uint32_t*)section->data;
+                for (uint32_t i = 0; i < length / 4; i++) {
+                    registers[i] = cpu_to_le32(gen2 ? readPRPHNoGrab(start + i * 4) : busRead32(start + i * 4));
+                }
+            }
+        }
+        
+        //The firmware error log, read in one burst through the auto incrementing SRAM window
+        if (nic.isHeld() && capabilities->errorLogSize) {
+            length = sizeof(struct iwl_fw_error_dump_mem) + capabilities->errorLogSize;
+            section = errorDumpSection(&cursor, IWL_FW_ERROR_DUMP_MEM, &length,
+                                       sizeof(struct iwl_fw_error_dump_mem));
+            if (section) {
+                struct iwl_fw_error_dump_mem* memory = (struct iwl_fw_error_dump_mem*)section->data;
+                memory->type = cpu_to_le32(IWL_FW_ERROR_DUMP_MEM_SRAM);
+                memory->offset = cpu_to_le32(capabilities->errorLogAddress);
+                readIOMemToBuffer(capabilities->errorLogAddress, memory->data,
+                                  (length - sizeof(*memory)) / 4);
+            }
+        }
     }
+    
+    struct iwl_fw_error_dump_file* file = (struct iwl_fw_error_dump_file*)cursor.base;
+    file->barker = cpu_to_le32(IWL_FW_ERROR_DUMP_BARKER);
+    file->file_len = cpu_to_le32(cursor.offset);
+    
+    IOSimpleLockLock(dumps->lock);
+    dumps->length[slot] = cursor.offset;
+    dumps->writing &= ~(1 << slot);
+    if (cursor.truncated) dumps->truncated++;
+    IOSimpleLockUnlock(dumps->lock);
 }
 
-void IntelWiFiDriver::dumpHardwareRegisters() {
-    //iwl_trans_pcie_dump_regs
+//Slot holding the index-th newest complete dump, FW_ERROR_DUMP_SLOTS if there is none.
+//Called with the ring lock held
+static uint32_t errorDumpSlot(const struct firmwareErrorDumpRing* dumps, uint32_t index) {
+    for (uint32_t slot = 0; slot < FW_ERROR_DUMP_SLOTS; slot++) {
+        if (!dumps->length[slot]) continue;
+        uint32_t newer = 0;
+        for (uint32_t other = 0; other < FW_ERROR_DUMP_SLOTS; other++) {
+            if (dumps->length[other] && (int32_t)(dumps->sequence[other] - dumps->sequence[slot]) > 0) newer++;
+        }
+        if (newer == index) return slot;
+    }
+    return FW_ERROR_DUMP_SLOTS;
+}
+
+//The slot is pinned rather than copied under the simple lock, copyout may fault on the
+//user buffer. captureFirmwareError leaves pinned slots alone
+int IntelWiFiDriver::device_fw_dump(struct voodoo80211_fw_dump_header* header, voodoo80211_fw_dump_copyout copyout,
+                                    void* ctx) {
+    struct firmwareErrorDumpRing* dumps = &deviceProps.mvmConfig->errorDumps;
+    uint32_t slot;
+    int error;
+    
+    if (!dumps->buffer || header->index >= FW_ERROR_DUMP_SLOTS) return ENOENT;
+    
+    IOSimpleLockLock(dumps->lock);
+    slot = errorDumpSlot(dumps, header->index);
+    if (slot < FW_ERROR_DUMP_SLOTS) {
+        dumps->readers[slot]++;
+        header->sequence = dumps->sequence[slot];
+        header->len = dumps->length[slot];
+    }
+    IOSimpleLockUnlock(dumps->lock);
+    if (slot == FW_ERROR_DUMP_SLOTS) return ENOENT;
+    
+    error = copyout(ctx, header, dumps->buffer + slot * FW_ERROR_DUMP_SLOT_SIZE);
+    
+    IOSimpleLockLock(dumps->lock);
+    dumps->readers[slot]--;
+    IOSimpleLockUnlock(dumps->lock);
+    return error;
+}
+
+void IntelWiFiDriver::printFirmwareErrorDumps() {
     if (!DEBUG) return;
     
-    //TODO:Get registers from NIC and write out to log buffer
+    struct firmwareErrorDumpRing* dumps = &deviceProps.mvmConfig->errorDumps;
+    if (!dumps->captured) return;
+    IO_LOG("%s: Firmware error dumps: captured=%u truncated=%u dropped=%u\n", DRVNAME, dumps->captured,
+           dumps->truncated, dumps->dropped);
 }
 
+void IntelWiFiDriver::dumpHardwareRegisters() {
+    //iwl_trans_pcie_dump_regs
+    //Called with the NIC access lock held after failing to wake the NIC, so only the CSRs
+    captureFirmwareError(FW_DBG_TRIGGER_DRIVER, false);
+}
 
 void IntelWiFiDriver::dumpNICErrorLog() {
     //iwl_mvm_dump_nic_error_log
-    //TODO: Dump the error log from the NIC
+    captureFirmwareError(FW_DBG_TRIGGER_FW_ASSERT, true);
+    deviceProps.mvmConfig->errorDumps.errorCaptured = true;
 }
 
 void IntelWiFiDriver::collectFirmwareErrorDetails() {
-    //iwl_fw_error_correct
-    //TODO: Implement collecting the error log from the firmware
+    //iwl_fw_error_collect
+    firmwareDebugStopRecording();
+    
+    //receivedNICError already captured the error if it could still reach the NIC
+    if (!deviceProps.mvmConfig->errorDumps.errorCaptured) {
+        captureFirmwareError(FW_DBG_TRIGGER_FW_ASSERT, deviceProps.status.deviceEnabled);
+    }
+    deviceProps.mvmConfig->errorDumps.errorCaptured = false;
 }
 
 void IntelWiFiDriver::firmwareDebugStopRecording() {
     //iwl_fw_dbg_stop_recording
-    //TODO: Implement
+    if (deviceProps.deviceConfig->device_family == IWL_DEVICE_FAMILY_7000) {
+        setBitsPRPH(MON_BUFF_SAMPLE_CTL, 0x100);
+        return;
+    }
+    //The debug controller is in the UMAC periphery, which 22560 moves up by umac_prph_offset.
+    //Later kernels stop it with a host command when ini debug TLVs were loaded, this driver
+    //never loads them so the register writes are all that is needed
+    writeUMAC_PRPH(DBGC_IN_SAMPLE, 0);
+    udelay(100);
+    writeUMAC_PRPH(DBGC_OUT_CTRL, 0);
 }
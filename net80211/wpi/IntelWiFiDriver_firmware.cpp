@@ -9,5 +9,242 @@
 
 bool IntelWiFiDriver::checkFWCapabilities(iwl_ucode_tlv_capa capabilities) {
     //fw_has_capa
-    return test_bit(capabilities, deviceProps.mvm.fw->ucode_capa._capa);
+    return test_bit(capabilities, deviceProps.mvm->fw->ucode_capa._capa);
+}
+
+//iwl_request_firmware, asks kextd for the newest file the device supports from the kext's
+//Resources. The answer comes back on firmwareRequestCallback, which steps down one API
+//version at a time until a file is found that parses
+int IntelWiFiDriver::requestFirmware() {
+    struct MVMSpecificConfig* mvmConfig = deviceProps.mvmConfig;
+    
+    if (!mvmConfig->firmwareRequestLock) {
+        mvmConfig->firmwareRequestLock = IOLockAlloc();
+        if (!mvmConfig->firmwareRequestLock) {
+            LOG_ERROR("%s: Failed to allocate firmware request lock\n", DRVNAME);
+            return -ENOMEM;
+        }
+    }
+    
+    IOLockLock(mvmConfig->firmwareRequestLock);
+    mvmConfig->firmwareRequestAPI = deviceProps.deviceConfig->ucode_api_max;
+    mvmConfig->firmwareRequestStopping = false;
+    int error = requestFirmwareAPI();
+    IOLockUnlock(mvmConfig->firmwareRequestLock);
+    return error;
+}
+
+//Requests the file for firmwareRequestAPI, called with firmwareRequestLock held
+int IntelWiFiDriver::requestFirmwareAPI() {
+    struct MVMSpecificConfig* mvmConfig = deviceProps.mvmConfig;
+    char name[64];
+    
+    snprintf(name, sizeof(name), "%s%u.ucode", deviceProps.deviceConfig->fw_name_pre, mvmConfig->firmwareRequestAPI);
+    OSReturn ret = OSKextRequestResource(OSKextGetCurrentIdentifier(), name, firmwareRequestCallback,
+                                         this, &mvmConfig->firmwareRequestTag);
+    if (ret != kOSReturnSuccess) {
+        LOG_ERROR("%s: Could not request firmware %s (0x%08x)\n", DRVNAME, name, ret);
+        mvmConfig->firmwareRequestPending = false;
+        return -EIO;
+    }
+    
+    IO_LOG("%s: Requested firmware %s", DRVNAME, name);
+    mvmConfig->firmwareRequestPending = true;
+    return 0;
+}
+
+void IntelWiFiDriver::firmwareRequestCallback(OSKextRequestTag tag, OSReturn result, const void* data,
+                                              uint32_t size, void* context) {
+    //iwl_req_fw_callback
+    IntelWiFiDriver* driver = (IntelWiFiDriver*)context;
+    struct MVMSpecificConfig* mvmConfig = driver->deviceProps.mvmConfig;
+    const struct iwl_cfg* config = driver->deviceProps.deviceConfig;
+    
+    IOLockLock(mvmConfig->firmwareRequestLock);
+    mvmConfig->firmwareRequestPending = false;
+    
+    //kextd frees data once we return so parseFirmware keeps its own copy
+    if (result == kOSReturnSuccess && data && driver->parseFirmware((const uint8_t*)data, size) == 0) {
+        IO_LOG("%s: Loaded firmware API %u", DRVNAME, mvmConfig->firmwareRequestAPI);
+    } else if (!mvmConfig->firmwareRequestStopping && mvmConfig->firmwareRequestAPI > config->ucode_api_min) {
+        mvmConfig->firmwareRequestAPI--;
+        driver->requestFirmwareAPI();
+    } else if (!mvmConfig->firmwareRequestStopping) {
+        LOG_ERROR("%s: No usable firmware found for API %u to %u\n", DRVNAME, config->ucode_api_max,
+                  config->ucode_api_min);
+    }
+    
+    if (!mvmConfig->firmwareRequestPending) {
+        IOLockWakeup(mvmConfig->firmwareRequestLock, &mvmConfig->firmwareRequestPending, false);
+    }
+    IOLockUnlock(mvmConfig->firmwareRequestLock);
+}
+
+//Like iwl_drv_stop waiting on request_firmware_complete. A request kextd has not answered
+//is cancelled without its callback running, one being answered is waited for
+void IntelWiFiDriver::cancelFirmwareRequest() {
+    struct MVMSpecificConfig* mvmConfig = deviceProps.mvmConfig;
+    
+    if (!mvmConfig->firmwareRequestLock) return;
+    
+    IOLockLock(mvmConfig->firmwareRequestLock);
+    mvmConfig->firmwareRequestStopping = true;
+    if (mvmConfig->firmwareRequestPending) {
+        OSKextRequestTag tag = mvmConfig->firmwareRequestTag;
+        
+        //Not called under our lock in case OSKext holds its own while running the callback
+        IOLockUnlock(mvmConfig->firmwareRequestLock);
+        OSReturn ret = OSKextCancelRequest(tag, NULL);
+        IOLockLock(mvmConfig->firmwareRequestLock);
+        
+        if (ret == kOSReturnSuccess && mvmConfig->firmwareRequestTag == tag) {
+            mvmConfig->firmwareRequestPending = false;
+        }
+    }
+    while (mvmConfig->firmwareRequestPending) {
+        IOLockSleep(mvmConfig->firmwareRequestLock, &mvmConfig->firmwareRequestPending, THREAD_UNINT);
+    }
+    IOLockUnlock(mvmConfig->firmwareRequestLock);
+    
+    IOLockFree(mvmConfig->firmwareRequestLock);
+    mvmConfig->firmwareRequestLock = NULL;
+}
+
+int IntelWiFiDriver::parseFirmware(const uint8_t* data, size_t size) {
+    //iwl_parse_tlv_firmware
+    //The file is copied, the sections and the command version table refer to the copy
+    //which is kept until the firmware is freed
+    struct MVMSpecificConfig* mvmConfig = deviceProps.mvmConfig;
+    struct FirmwareFile* file = &mvmConfig->fwData.file;
+    uint64_t start, end, nanoseconds;
+    
+    if (size == 0 || size > UINT32_MAX) return -EINVAL;
+    
+    uint8_t* image = (uint8_t*)IOMalloc(size);
+    if (!image) {
+        LOG_ERROR("%s: Failed to allocate %zu bytes for the firmware\n", DRVNAME, size);
+        return -ENOMEM;
+    }
+    memcpy(image, data, size);
+    
+    //Everything still around belongs to the previous file
+    freeFirmware();
+    mvmConfig->firmwareImage = image;
+    mvmConfig->firmwareImageSize = (uint32_t)size;
+    
+    clock_get_uptime(&start);
+    int error = parseFirmwareFile(image, size, file, &mvmConfig->fwData.uCodeCapabilities);
+    clock_get_uptime(&end);
+    absolutetime_to_nanoseconds(end - start, &nanoseconds);
+    
+    if (error) {
+        LOG_ERROR("%s: Invalid firmware file (%d) at offset %u\n", DRVNAME, error, file->errorOffset);
+        freeFirmware();
+        return error;
+    }
+    
+    //Filled by forceNICRestart from the interrupt handler, so it cannot be allocated there
+    uint32_t errorLogSize = mvmConfig->fwData.uCodeCapabilities.errorLogSize;
+    if (errorLogSize) {
+        mvmConfig->errorRecoveryBuffer = (uint8_t*)IOMalloc(errorLogSize);
+        if (!mvmConfig->errorRecoveryBuffer) {
+            LOG_ERROR("%s: Failed to allocate recovery buffer\n", DRVNAME);
+            freeFirmware();
+            return -ENOMEM;
+        }
+        bzero(mvmConfig->errorRecoveryBuffer, errorLogSize);
+    }
+    
+    if (DEBUG) printf("%s: Parsed firmware %s (%zu bytes) in %llu us using %lu bytes\n", DRVNAME,
+                      file->humanReadable, size, nanoseconds / 1000, sizeof(struct FirmwareFile));
+    return 0;
+}
+
+void IntelWiFiDriver::freeFirmware() {
+    struct MVMSpecificConfig* mvmConfig = deviceProps.mvmConfig;
+    
+    freeFirmwareSections();
+    if (mvmConfig->errorRecoveryBuffer) {
+        IOFree(mvmConfig->errorRecoveryBuffer, mvmConfig->fwData.uCodeCapabilities.errorLogSize);
+        mvmConfig->errorRecoveryBuffer = NULL;
+    }
+    if (mvmConfig->firmwareImage) {
+        IOFree(mvmConfig->firmwareImage, mvmConfig->firmwareImageSize);
+        mvmConfig->firmwareImage = NULL;
+        mvmConfig->firmwareImageSize = 0;
+    }
+    bzero(&mvmConfig->fwData, sizeof(mvmConfig->fwData));
+}
+
+int IntelWiFiDriver::loadFirmwareSections(enum UCodeType ucodeType) {
+    //Copy only the sections of the image we are about to run into DMA memory, the copies
+    //are kept until the firmware or the image changes so reloading the same image is free
+    struct FirmwareFile* file = &deviceProps.mvmConfig->fwData.file;
+    struct FirmwareRuntimeData* runtime = &deviceProps.mvmConfig->fwRuntimeData;
+    const struct FirmwareImage* image = &file->images[ucodeType];
+    
+    if (file->data == NULL || image->sectionCount == 0) return -ENOENT;
+    if (runtime->sectionDMACount && runtime->microcodeType == ucodeType) return 0;
+    
+    freeFirmwareSections();
+    for (uint32_t i = 0; i < image->sectionCount; i++) {
+        const struct FirmwareSection* section = &image->sections[i];
+        struct FirmwareSectionDMA* dma = &runtime->sectionDMA[i];
+        
+        runtime->sectionDMACount = i + 1;
+        dma->deviceOffset = section->deviceOffset;
+        
+        //Separators and old style images with an empty DATA slot have nothing to copy
+        if (section->length == 0) continue;
+        
+        if (allocSectionDMA(dma, section->length)) {
+            LOG_ERROR("%s: Could not allocate DMA memory for firmware section %u\n", DRVNAME, i);
+            freeFirmwareSections();
+            return -ENOMEM;
+        }
+        memcpy(dma->vaddr, file->data + section->offset, section->length);
+    }
+    
+    runtime->microcodeType = ucodeType;
+    return 0;
+}
+
+void IntelWiFiDriver::freeFirmwareSections() {
+    struct FirmwareRuntimeData* runtime = &deviceProps.mvmConfig->fwRuntimeData;
+    
+    for (uint32_t i = 0; i < runtime->sectionDMACount; i++) {
+        freeSectionDMA(&runtime->sectionDMA[i]);
+    }
+    runtime->sectionDMACount = 0;
+    
+    //The context info DRAM table points at these sections
+    deviceProps.ctxtInfo.dramTableValid = false;
+}
+
+int IntelWiFiDriver::allocSectionDMA(struct FirmwareSectionDMA* dma, uint32_t length) {
+    //Page aligned, like dma_alloc_coherent, the device maps firmware DRAM in pages.
+    //A block that is already big enough is cleared and reused
+    if (dma->buffer && dma->length >= length) {
+        bzero(dma->vaddr, dma->length);
+        return 0;
+    }
+    
+    freeSectionDMA(dma);
+    dma->buffer = allocDmaMemory(length, PAGE_SIZE, &dma->vaddr, &dma->paddr);
+    if (dma->buffer == NULL) return -ENOMEM;
+    
+    bzero(dma->vaddr, length);
+    dma->length = length;
+    return 0;
+}
+
+void IntelWiFiDriver::freeSectionDMA(struct FirmwareSectionDMA* dma) {
+    if (dma->buffer) {
+        dma->buffer->complete();
+        dma->buffer->release();
+    }
+    dma->buffer = NULL;
+    dma->vaddr = NULL;
+    dma->paddr = 0;
+    dma->length = 0;
 }
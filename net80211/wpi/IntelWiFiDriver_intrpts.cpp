@@ -23,6 +23,8 @@ int IntelWiFiDriver::interruptHandler(OSObject* owner, IOInterruptEventSource* s
      */
     uint32_t inta;
     Boolean receivedFHTX, receivedRFKill, recievedAlive_FHRX;
+    updateHardwareStatistics(interruptFired, 1);
+    latencyProbe(VOODOO80211_PROBE_INTR);
     //Disable interrupts
 //    bus_space_write_4(NULL, deviceBusMap, WPI_MASK, 0);
     busWrite32(WPI_MASK, 0);
@@ -57,7 +59,7 @@ int IntelWiFiDriver::interruptHandler(OSObject* owner, IOInterruptEventSource* s
         
         //Completely disable interrupts and log it to the driver stats
         disableInterrupts();
-        updateHardwareDebugStatistics(hardwareError, 0);
+        updateHardwareStatistics(hardwareError, 1);
         
         //Pass off to our handler function
         handleHardwareErrorINT();
@@ -68,13 +70,14 @@ int IntelWiFiDriver::interruptHandler(OSObject* owner, IOInterruptEventSource* s
         //Apparently not used:
         /* "NIC fires this, but we don't use it, redundant with WAKEUP" */
         //Just update hardware stats for debug
-        updateHardwareDebugStatistics(schedulerFired, 0);
+        updateHardwareStatistics(schedulerFired, 1);
     }
     
     if (inta & WPI_INT_ALIVE) {
         //Device calling back alive
-        updateHardwareDebugStatistics(aliveRecieved, 0);
-        if (deviceProps.deviceConfig->gen2) {
+        updateHardwareStatistics(aliveRecieved, 1);
+        stopFirmwareLoadTimer();
+        if (deviceProps.trans.restockOnAlive) {
             rxMultiqueueRestock();
         }
     }
@@ -90,20 +93,20 @@ int IntelWiFiDriver::interruptHandler(OSObject* owner, IOInterruptEventSource* s
     if (inta & WPI_INT_CT_KILL) {
         //Hardware overheated
         printf("%s: Hardware has stopped itself due to overheat INTA=0x%08x", DRVNAME, inta);
-        updateHardwareDebugStatistics(ctKill, 0);
+        updateHardwareStatistics(ctKill, 1);
     }
     
     if (inta & WPI_INT_SW_ERR) {
         //uCode detected a software error
         printf("%s: Hardware detected software error INTA=0x%08x", DRVNAME, inta);
-        updateHardwareDebugStatistics(softwareError, 0);
+        updateHardwareStatistics(softwareError, 1);
         
         handleHardwareErrorINT();
     }
     
     if (inta & WPI_INT_WAKEUP) {
         //Wakeup after "power-down" sleep
-        updateHardwareDebugStatistics(wakeup, 0);
+        updateHardwareStatistics(wakeup, 1);
         
         handleWakeupINT();
     }
@@ -121,7 +124,7 @@ int IntelWiFiDriver::interruptHandler(OSObject* owner, IOInterruptEventSource* s
         //2. Disable periodic interrupt using write8
         //3. Something about enabling in 8msec? nothing seems to make sure its 8msec
         
-        updateHardwareDebugStatistics(rxRecieved, 0);
+        updateHardwareStatistics(rxRecieved, 1);
         handleRxINT();
     }
     
@@ -130,7 +133,7 @@ int IntelWiFiDriver::interruptHandler(OSObject* owner, IOInterruptEventSource* s
 //        bus_space_write_4(NULL, deviceBusMap, WPI_FH_INT, WPI_FH_INT_TX_MASK);
         busWrite32(WPI_FH_INT, WPI_FH_INT_TX_MASK);
         
-        updateHardwareDebugStatistics(txRecieved, 0);
+        updateHardwareStatistics(txRecieved, 1);
         
         //Notify any waiting locks that we have finally loaded the microcode
         //Not sure the lock should be locked by us here?
@@ -141,6 +144,11 @@ int IntelWiFiDriver::interruptHandler(OSObject* owner, IOInterruptEventSource* s
         receivedFHTX = true;
     }
     
+    //Let sleeping register waits recheck now rather than at their next timeout
+    if (inta & (WPI_INT_ALIVE | WPI_INT_FH_TX | WPI_INT_WAKEUP)) {
+        wakePollWaiters();
+    }
+    
     if (!deviceProps.status.interruptsEnabled) {
         enableInterrupts();
     } else if (receivedFHTX) {
@@ -287,7 +295,7 @@ void IntelWiFiDriver::handleRFKillINT() {
     
     if (DEBUG) printf("%s: RF Kill toggled %s\n", DRVNAME, rfKillSet ? "on" : "off");
     
-    updateHardwareDebugStatistics(rfKillToggledOn, 0);
+    updateHardwareStatistics(rfKillToggledOn, 1);
     
     if (prev != ret) {
         setHardwareRFKillState(ret);
@@ -315,4 +323,5 @@ void IntelWiFiDriver::handleWakeupINT() {
 
 void IntelWiFiDriver::handleRxINT() {
     //TODO: Implement handling Rx interrupt
+    //Every non-frame packet pulled off the RX queue goes through dispatchNotification
 }
@@ -40,27 +40,19 @@ const struct iwl_csr_params iwl_csr_v2 = {
 //==================================
 //         Wrapper functions
 //==================================
-//Wrappers around IOPCIDevice->writex and IOPCIDevice->readx so we dont have to keep supplying memory map
-void IntelWiFiDriver::busWrite32(uint32_t offset, uint32_t value) {
-    deviceProps.device->ioWrite32(offset, value, deviceProps.deviceMemoryMap);
-}
-
-void IntelWiFiDriver::busWrite8(uint16_t offest, uint8_t value) {
-    deviceProps.device->ioWrite8(offest, value, deviceProps.deviceMemoryMap);
-}
-
-uint32_t IntelWiFiDriver::busRead32(uint32_t offset) {
-    return deviceProps.device->ioRead32(offset, deviceProps.deviceMemoryMap);
-}
-
+//busRead32, busWrite32 and busWrite8 are inline in IntelWiFiDriver.hpp, they access the
+//mapped BAR directly instead of going through IOPCIDevice->ioReadx/ioWritex
 uint32_t IntelWiFiDriver::busReadShr(uint32_t address) {
     busWrite32(HEEP_CTRL_WRD_PCIEX_CRTL_REG, ((address & 0x0000ffff) | (2 << 28)));
-    return busRead32(HEEP_CTRL_WRD_PCIEX_DATA_REG);
+    uint32_t value = busRead32(HEEP_CTRL_WRD_PCIEX_DATA_REG);
+    if (MMIO_TRACE == MMIO_TRACE_RECORD) traceMMIO(mmioReadShr, address, value);
+    return value;
 }
 
 void IntelWiFiDriver::busWriteShr(uint32_t address, uint32_t value) {
     busWrite32(HEEP_CTRL_WRD_PCIEX_DATA_REG, value);
     busWrite32(HEEP_CTRL_WRD_PCIEX_CRTL_REG, ((address & 0x0000ffff) | (3 << 28)));
+    if (MMIO_TRACE == MMIO_TRACE_RECORD) traceMMIO(mmioWriteShr, address, value);
 }
 
 uint16_t IntelWiFiDriver::pcieCapabilityRead16(uint32_t offset) {
@@ -113,52 +105,97 @@ void IntelWiFiDriver::busClearBits(uint32_t offset, uint32_t bitPositions) {
     busWrite32(offset, value);
 }
 
-int IntelWiFiDriver::pollBit(uint32_t offset, uint32_t bits, uint32_t mask, int timeout) {
-#define POLL_INTERVAL 10
-    int t = 0;
-    do {
+//The first reads come quickly as most bits flip within a few us, long waits back off to
+//POLL_BACKOFF_MAX between reads so they stop hammering the bus
+#define POLL_BACKOFF_MIN 1
+#define POLL_BACKOFF_MAX 64
+//Once a wait at a sleepable site has spun this long it sleeps on pollWaitLock instead,
+//woken by the next ALIVE/FH_TX/wakeup interrupt or after POLL_SLEEP_MAX
+#define POLL_SPIN_LIMIT 200
+#define POLL_SLEEP_MAX 1000
+
+//Sites that are only ever reached from thread context with no locks held
+static const bool pollSiteSleepable[pollSiteCount] = {
+    false,  //pollSiteNICAccess
+    false,  //pollSiteNICAccessUnlocked
+    false,  //pollSiteHardwareReady
+    true,   //pollSiteMACClock
+    false,  //pollSiteTxFlush
+    false,  //pollSiteStopMaster
+};
+
+//Returns the number of us waited or -ETIMEDOUT
+int IntelWiFiDriver::pollBit(uint32_t offset, uint32_t bits, uint32_t mask, int timeout, enum pollSite site) {
+    bool sleepable = pollSiteSleepable[site] && deviceProps.pollWaitLock;
+    uint32_t delay = POLL_BACKOFF_MIN;
+    uint64_t start, now, deadline, slept = 0, elapsed;
+    
+    clock_get_uptime(&start);
+    nanoseconds_to_absolutetime((uint64_t)timeout * 1000, &deadline);
+    deadline += start;
+    
+    for (;;) {
         if ((busRead32(offset) & mask) == (bits & mask)) {
-            return t;
+            clock_get_uptime(&now);
+            absolutetime_to_nanoseconds(now - start, &elapsed);
+            recordPollWait(site, (uint32_t)(elapsed / 1000), (uint32_t)(slept / 1000), false);
+            return (int)(elapsed / 1000);
         }
-        udelay(POLL_INTERVAL);
-        t += POLL_INTERVAL;
-    } while (t < timeout);
+        
+        clock_get_uptime(&now);
+        if (now >= deadline) break;
+        absolutetime_to_nanoseconds(now - start, &elapsed);
+        
+        if (sleepable && elapsed / 1000 >= POLL_SPIN_LIMIT) {
+            uint64_t wake, sleepStart = now, sleptNow;
+            clock_interval_to_deadline(POLL_SLEEP_MAX, kMicrosecondScale, &wake);
+            if (wake > deadline) wake = deadline;
+            
+            IOLockLock(deviceProps.pollWaitLock);
+            IOLockSleepDeadline(deviceProps.pollWaitLock, &deviceProps.pollWaitLock,
+                                *reinterpret_cast<AbsoluteTime*>(&wake), THREAD_UNINT);
+            IOLockUnlock(deviceProps.pollWaitLock);
+            
+            clock_get_uptime(&now);
+            absolutetime_to_nanoseconds(now - sleepStart, &sleptNow);
+            slept += sleptNow;
+        } else {
+            udelay(delay);
+            if (delay < POLL_BACKOFF_MAX) delay <<= 1;
+        }
+    }
+    
+    recordPollWait(site, timeout, (uint32_t)(slept / 1000), true);
     return -ETIMEDOUT;
 }
+
+void IntelWiFiDriver::wakePollWaiters() {
+    if (!deviceProps.pollWaitLock) return;
+    IOLockLock(deviceProps.pollWaitLock);
+    IOLockWakeup(deviceProps.pollWaitLock, &deviceProps.pollWaitLock, false);
+    IOLockUnlock(deviceProps.pollWaitLock);
+}
 //===================================
 
 
 //===================================
 //          PRPH Related
 //===================================
+//The functions below each open their own NIC access session, when doing several PRPH
+//operations back to back open a NICAccessSession in the caller and use the NoGrab variants
+//(or nest these, an inner session on the same thread only takes a reference)
 uint32_t IntelWiFiDriver::readPRPH(uint32_t offset) {
     //iwl_read_prph
-    //iwl_trans_pcie_read_prph
-    IOInterruptState flags;
-    uint32_t value = 0x5a5a5a5a;
+    NICAccessSession nic(this);
+    if (!nic.isHeld()) return 0x5a5a5a5a;
     
-    if (grabNICAccess(flags)) {
-        uint32_t mask = getPRPHMask();
-        busWrite32(WPI_PRPH_RADDR, ((offset & mask) | 3 << 24));
-        value = busRead32(WPI_PRPH_RDATA);
-        releaseNICAccess(flags);
-    }
-    return value;
+    return readPRPHNoGrab(offset);
 }
 
 void IntelWiFiDriver::writePRPH(uint32_t offset, uint32_t value) {
     //iwl_write_prph
-    //iwl_trans_pcie_write_prph
-    IOInterruptState flags;
-    if (grabNICAccess(flags)) {
-        //Makes a call to iwl_write_prph_no_grap which calls a debug trace function
-        //then calls tans->ops->write_prph which is set to iwl_trans_pcie_write_prph
-        //iwl_trans_pcie_write_prph:
-        uint32_t mask = getPRPHMask();
-        busWrite32(WPI_PRPH_WADDR, (offset & mask) | (3 << 24));
-        busWrite32(WPI_PRPH_WDATA, value);
-        releaseNICAccess(flags);
-    }
+    NICAccessSession nic(this);
+    if (nic.isHeld()) writePRPHNoGrab(offset, value);
 }
 
 uint32_t IntelWiFiDriver::getPRPHMask() {
@@ -176,58 +213,58 @@ void IntelWiFiDriver::writeUMAC_PRPH(uint32_t offset, uint32_t value) {
 
 void IntelWiFiDriver::setBitsPRPH(uint32_t offset, uint32_t mask) {
     //iwl_set_bits_prph
-    IOInterruptState flags;
-    if (grabNICAccess(flags)) {
-        writePRPHNoGrab(offset,
-                        readPRPHNoGrab(offset) | mask);
-        releaseNICAccess(flags);
-    }
+    NICAccessSession nic(this);
+    if (nic.isHeld()) modifyPRPHNoGrab(offset, 0, mask);
 }
 
 void IntelWiFiDriver::clearBitsPRPH(uint32_t offset, uint32_t mask) {
     //iwl_clear_bits_prph
-    IOInterruptState flags;
-    if (grabNICAccess(flags)) {
-        uint32_t value = readPRPHNoGrab(offset);
-        writePRPHNoGrab(offset, (value & ~mask));
-        releaseNICAccess(flags);
-    }
+    NICAccessSession nic(this);
+    if (nic.isHeld()) modifyPRPHNoGrab(offset, mask, 0);
 }
 
+//The NoGrab variants must be called with the NIC held (inside a NICAccessSession)
 void IntelWiFiDriver::writePRPHNoGrab(uint32_t offset, uint32_t value) {
     //iwl_write_prph_no_grab
+    //iwl_trans_pcie_write_prph
 
-    //They trace the event first, this might be useful
-    //TODO: Possibly trace
-    writePRPH(offset, value);
+    uint32_t mask = getPRPHMask();
+    busWrite32(WPI_PRPH_WADDR, (offset & mask) | (3 << 24));
+    busWrite32(WPI_PRPH_WDATA, value);
+    if (MMIO_TRACE == MMIO_TRACE_RECORD) traceMMIO(mmioWritePRPH, offset, value);
 }
 
 uint32_t IntelWiFiDriver::readPRPHNoGrab(uint32_t offset) {
     //iwl_read_prph_no_grab
-    //TODO: Implement
+    //iwl_trans_pcie_read_prph
     
-    //Another trace here
-    //TODO: Possibly trace
-    return readPRPH(offset);
+    uint32_t mask = getPRPHMask();
+    busWrite32(WPI_PRPH_RADDR, ((offset & mask) | 3 << 24));
+    uint32_t value = busRead32(WPI_PRPH_RDATA);
+    if (MMIO_TRACE == MMIO_TRACE_RECORD) traceMMIO(mmioReadPRPH, offset, value);
+    return value;
+}
+
+//Read-modify-write of a PRPH register, clears clearMask then sets setMask
+void IntelWiFiDriver::modifyPRPHNoGrab(uint32_t offset, uint32_t clearMask, uint32_t setMask) {
+    //iwl_set_bits_mask_prph
+    uint32_t value = readPRPHNoGrab(offset);
+    writePRPHNoGrab(offset, (value & ~clearMask) | setMask);
 }
 
 //===================================
 
 int IntelWiFiDriver::readIOMemToBuffer(uint32_t address, void* buffer, int dwords) {
-    IOInterruptState flags;
+    NICAccessSession nic(this);
+    if (!nic.isHeld()) return -EBUSY;
     
-    if (grabNICAccess(flags)) {
-        //Might seem as though reading from WPI_MEM_RDATA would keep returning the same
-        //values, but once WPI_MEM_RADDR is set, each time WPI_MEM_RDATA is read the
-        //value is incremented by one dword
-        busWrite32(WPI_MEM_RADDR, address);
-        uint32_t* buff = (uint32_t*)buffer;
-        for (int offsets = 0; offsets < dwords; offsets++) {
-            buff[offsets] = busRead32(WPI_MEM_RDATA);
-        }
-        releaseNICAccess(flags);
-    } else {
-        return -EBUSY;
+    //Might seem as though reading from WPI_MEM_RDATA would keep returning the same
+    //values, but once WPI_MEM_RADDR is set, each time WPI_MEM_RDATA is read the
+    //value is incremented by one dword
+    busWrite32(WPI_MEM_RADDR, address);
+    uint32_t* buff = (uint32_t*)buffer;
+    for (int offsets = 0; offsets < dwords; offsets++) {
+        buff[offsets] = busRead32(WPI_MEM_RDATA);
     }
     return 0;
 }
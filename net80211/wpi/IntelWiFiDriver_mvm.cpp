@@ -20,6 +20,7 @@ void IntelWiFiDriver::receivedNICError() {
         return;
     }
     deviceProps.status.FWError = true;
+    updateHardwareStatistics(NICError, 1);
     if (deviceProps.status.deviceEnabled) {
         //We should print out NIC error log so long as we still have
         //a communication channel with the NIC
@@ -31,7 +32,7 @@ void IntelWiFiDriver::receivedNICError() {
 
 void IntelWiFiDriver::forceNICRestart(bool firmwareError) {
     //iwl_mvm_nic_restart
-    MVMSpecificConfig* mvmConfig = &deviceProps.mvmConfig;
+    MVMSpecificConfig* mvmConfig = deviceProps.mvmConfig;
     abortNotificationWaits();
     //Cancel the periodic dump trigger as we are restarting it
     mvmConfig->fwRuntimeData.dump.periodicTrigger->cancelTimeout();
@@ -68,16 +69,11 @@ void IntelWiFiDriver::forceNICRestart(bool firmwareError) {
         if (mvmConfig->fwData.uCodeCapabilities.errorLogSize) {
             uint32_t srcSize = mvmConfig->fwData.uCodeCapabilities.errorLogSize;
             uint32_t srcAddress = mvmConfig->fwData.uCodeCapabilities.errorLogAddress;
-            uint8_t* errorLogBuffer = (uint8_t*)IOMalloc(srcSize);
             
-            if (!errorLogBuffer) {
-                printf("%s: Failed to allocate recovery buffer", DRVNAME);
-            } else {
-                bzero(errorLogBuffer, srcSize);
-                mvmConfig->errorRecoveryBuffer = errorLogBuffer;
-                
-                //Read the entire error log from io memory into our buffer
-                readIOMemToBuffer(srcAddress, errorLogBuffer, srcSize);
+            //Read the entire error log from io memory into the buffer allocated with the firmware,
+            //we may be in the interrupt handler here
+            if (mvmConfig->errorRecoveryBuffer) {
+                readIOMemToBuffer(srcAddress, mvmConfig->errorRecoveryBuffer, srcSize / 4);
             }
             
             collectFirmwareErrorDetails();
@@ -98,11 +94,11 @@ void IntelWiFiDriver::setHardwareRFKillState(bool status) {
     //this is to detect and thus eliminate race conditions
     //I am unsure whether a similar thing exists in xnu
     //TODO: read normally for now
-    bool rfKillSafe = deviceProps.mvmConfig.RFKillSafeInitDone;
+    bool rfKillSafe = deviceProps.mvmConfig->RFKillSafeInitDone;
     bool unifiedUCode = deviceHasUnifiedUCode(deviceProps.deviceConfig);
     bool ret;
     //Update our local status value
-    deviceProps.mvmConfig.status.HWRFKill = status;
+    deviceProps.mvmConfig->status.HWRFKill = status;
     
     setRFKillState(status);
     
@@ -113,30 +109,26 @@ void IntelWiFiDriver::setHardwareRFKillState(bool status) {
     if (unifiedUCode) {
         ret =  false;
     } else {
-        ret = status && (deviceProps.mvmConfig.fwRuntimeData.microcodeType != INIT ||
+        ret = status && (deviceProps.mvmConfig->fwRuntimeData.microcodeType != INIT ||
                          rfKillSafe);
     }
     
     if (ret) {
-        if (deviceProps.deviceConfig->gen2) {
-            stopDeviceG2(true);
-        } else {
-            stopDeviceG1(true);
-        }
+        (this->*deviceProps.trans.stopDevice)(true);
     }
 }
 
 void IntelWiFiDriver::setRFKillState(bool status) {
     //iwl_mvm_set_rfkill_state
-    bool currentStatus = isRadioKilled(deviceProps.mvmConfig.status);
+    bool currentStatus = isRadioKilled(deviceProps.mvmConfig->status);
     
     if (currentStatus) {
         //TODO: Check this when implementing rxSyncWaitQ
-//        IOLockLock(deviceProps.mvmConfig.rxSyncWaitQueue);
-//        IOLockWakeup(deviceProps.mvmConfig.rxSyncWaitQueue, NULL, true);
-//        IOLockUnlock(deviceProps.mvmConfig.rxSyncWaitQueue);
-        deviceProps.mvmConfig.rxSyncWaitQueue->commandWakeup((void*)(deviceProps.mvm.queueSyncCounter == 0 ||
-                                                             isRadioKilled(deviceProps.mvm.status)));
+//        IOLockLock(deviceProps.mvmConfig->rxSyncWaitQueue);
+//        IOLockWakeup(deviceProps.mvmConfig->rxSyncWaitQueue, NULL, true);
+//        IOLockUnlock(deviceProps.mvmConfig->rxSyncWaitQueue);
+        deviceProps.mvmConfig->rxSyncWaitQueue->commandWakeup((void*)(deviceProps.mvm->queueSyncCounter == 0 ||
+                                                             isRadioKilled(deviceProps.mvm->status)));
     }
     //iwlwifi here makes a call to wiphy_rfkill_set_hw_state
     //which internally makes a call to rfkill_set_hw_state
@@ -163,30 +155,30 @@ void IntelWiFiDriver::reportScanAborted() {
         }
         
         uid = mvmScanUIDByStatus(IWL_MVM_SCAN_SCHED);
-        if (uid >= 0 && !deviceProps.mvm.firmwareRestart) {
+        if (uid >= 0 && !deviceProps.mvm->firmwareRestart) {
             //Reset the scan
             deviceProps.bsdIEEEStruct->ic_scan_lock = IEEE80211_SCAN_UNLOCKED;
             ieee80211_newstate(deviceProps.bsdIEEEStruct, IEEE80211_S_INIT, -1);
         }
         
-        for (int i = 0; i < deviceProps.mvm.maxScans; i++) {
-            if (deviceProps.mvm.scanUIDStatus[i]) {
+        for (int i = 0; i < deviceProps.mvm->maxScans; i++) {
+            if (deviceProps.mvm->scanUIDStatus[i]) {
                 LOG_ERROR("%s: UMAC scan UID %d status not cleared\n", DRVNAME, i);
-                deviceProps.mvm.scanUIDStatus[i] = 0;
+                deviceProps.mvm->scanUIDStatus[i] = 0;
             }
         }
     } else {
-        if (deviceProps.mvm.scanStatus & IWL_MVM_SCAN_REGULAR) {
+        if (deviceProps.mvm->scanStatus & IWL_MVM_SCAN_REGULAR) {
             //Reset the scan
             deviceProps.bsdIEEEStruct->ic_scan_lock = IEEE80211_SCAN_UNLOCKED;
             ieee80211_newstate(deviceProps.bsdIEEEStruct, IEEE80211_S_INIT, -1);
         }
         
-        if ((deviceProps.mvm.scanStatus & IWL_MVM_SCAN_SCHED) && !deviceProps.mvm.firmwareRestart) {
+        if ((deviceProps.mvm->scanStatus & IWL_MVM_SCAN_SCHED) && !deviceProps.mvm->firmwareRestart) {
             //Reset the scan
             deviceProps.bsdIEEEStruct->ic_scan_lock = IEEE80211_SCAN_UNLOCKED;
             ieee80211_newstate(deviceProps.bsdIEEEStruct, IEEE80211_S_INIT, -1);
-            deviceProps.mvm.schedScanPassAll = SCHED_SCAN_PASS_ALL_DISABLED;
+            deviceProps.mvm->schedScanPassAll = SCHED_SCAN_PASS_ALL_DISABLED;
         }
     }
 }
@@ -207,8 +199,8 @@ void IntelWiFiDriver::mvmWakeSWQueue(int txqID) {
 
 int IntelWiFiDriver::mvmScanUIDByStatus(int status) {
     //iwl_mvm_scan_uid_by_status
-    for (int i = 0; i < deviceProps.mvm.maxScans; i++) {
-        if (deviceProps.mvm.scanUIDStatus[i] == status) {
+    for (int i = 0; i < deviceProps.mvm->maxScans; i++) {
+        if (deviceProps.mvm->scanUIDStatus[i] == status) {
             return i;
         }
     }
@@ -221,12 +213,12 @@ void IntelWiFiDriver::mvmQueueStateChange(int hwQueue, bool start) {
     //TODO: Fix station mode, currently only using our driver based data structures
     //for station mode, at some point in the future we need to fix this
     
-    uint8_t stationID = mvmHasNewTxAPI() ? deviceProps.mvm.tvqmInfo[hwQueue].sta_id : deviceProps.mvm.queueInfo[hwQueue].ra_sta_id;
-    if (stationID >= ARRAY_SIZE(deviceProps.mvm.stationData)) {
+    uint8_t stationID = mvmHasNewTxAPI() ? deviceProps.mvm->tvqmInfo[hwQueue].sta_id : deviceProps.mvm->queueInfo[hwQueue].ra_sta_id;
+    if (stationID >= ARRAY_SIZE(deviceProps.mvm->stationData)) {
         return;
     }
     
-    struct iwl_mvm_sta* sta = deviceProps.mvm.stationData[stationID];
+    struct iwl_mvm_sta* sta = deviceProps.mvm->stationData[stationID];
     if (sta == NULL) {
         return;
     }
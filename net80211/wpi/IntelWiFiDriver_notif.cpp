@@ -7,19 +7,247 @@
 
 #include "IntelWiFiDriver.hpp"
 
+//Legacy commands are sent in the long group but the firmware may answer in either,
+//fold them together so both find the same slot
+static inline uint16_t notificationID(uint16_t cmdID) {
+    if ((cmdID >> 8) == IWL_ALWAYS_LONG_GROUP) {
+        return cmdID & 0xff;
+    }
+    return cmdID;
+}
+
+static inline uint32_t notificationHash(uint16_t cmdID) {
+    //Legacy opcodes (group 0) land on their own index, other groups are spread out
+    return ((cmdID & 0xff) + (cmdID >> 8) * 37) & (NOTIF_TABLE_SIZE - 1);
+}
+
+//Find the slot for cmdID, claiming a free one if create is set. Caller holds the dispatch lock
+static struct notificationSlot* lookupNotificationSlot(struct notificationDispatch* notifs, uint16_t cmdID, bool create) {
+    uint32_t index = notificationHash(cmdID);
+
+    for (uint32_t probe = 0; probe < NOTIF_TABLE_SIZE; probe++) {
+        struct notificationSlot* slot = &notifs->table[(index + probe) & (NOTIF_TABLE_SIZE - 1)];
+        if (!slot->inUse) {
+            //Slots are never released while the table is live so an empty slot ends the probe
+            if (!create) return NULL;
+            slot->inUse = true;
+            slot->cmdID = cmdID;
+            LIST_INIT(&slot->waiters);
+            notifs->slotsUsed++;
+            return slot;
+        }
+        if (slot->cmdID == cmdID) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static inline uint32_t latencyBucket(uint64_t microseconds) {
+    uint32_t bucket = 0;
+    while (microseconds && bucket < NOTIF_LATENCY_BUCKETS - 1) {
+        microseconds >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+int IntelWiFiDriver::initNotificationDispatch() {
+    //iwl_notification_wait_init
+    struct notificationDispatch* notifs = &deviceProps.mvmConfig->notifs;
+
+    bzero(notifs, sizeof(*notifs));
+    LIST_INIT(&notifs->waitEntries);
+    notifs->lock = IOSimpleLockAlloc();
+    notifs->waitQueue = IOLockAlloc();
+    if (!notifs->lock || !notifs->waitQueue) {
+        LOG_ERROR("%s: Failed to allocate notification locks\n", DRVNAME);
+        freeNotificationDispatch();
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+void IntelWiFiDriver::freeNotificationDispatch() {
+    struct notificationDispatch* notifs = &deviceProps.mvmConfig->notifs;
+
+    if (notifs->lock && notifs->waitQueue) {
+        abortNotificationWaits();
+    }
+    if (notifs->lock) {
+        IOSimpleLockFree(notifs->lock);
+        notifs->lock = NULL;
+    }
+    if (notifs->waitQueue) {
+        IOLockFree(notifs->waitQueue);
+        notifs->waitQueue = NULL;
+    }
+}
+
+int IntelWiFiDriver::registerNotificationHandler(uint16_t cmdID, NotificationHandler handler) {
+    struct notificationDispatch* notifs = &deviceProps.mvmConfig->notifs;
+
+    IOSimpleLockLock(notifs->lock);
+    struct notificationSlot* slot = lookupNotificationSlot(notifs, notificationID(cmdID), true);
+    if (slot) {
+        slot->handler = handler;
+    }
+    IOSimpleLockUnlock(notifs->lock);
+
+    if (!slot) {
+        LOG_ERROR("%s: Notification table full, cannot register 0x%04x\n", DRVNAME, cmdID);
+        return -ENOSPC;
+    }
+    return 0;
+}
+
+void IntelWiFiDriver::dispatchNotification(struct iwl_rx_packet* packet) {
+    //iwl_notification_wait_notify and iwl_mvm_rx_common
+    struct notificationDispatch* notifs = &deviceProps.mvmConfig->notifs;
+    uint16_t cmdID = notificationID(WIDE_ID(packet->hdr.group_id, packet->hdr.cmd));
+    NotificationHandler handler;
+    bool hasWaiters;
+    uint64_t start, end, nanoseconds;
+
+    updateHardwareStatistics(rxFrames, 1);
+    clock_get_uptime(&start);
+
+    //Only registering a handler or a waiter claims a slot, so opcodes nobody listens for
+    //cannot fill the table
+    IOSimpleLockLock(notifs->lock);
+    struct notificationSlot* slot = lookupNotificationSlot(notifs, cmdID, false);
+    if (!slot) {
+        notifs->unhandled++;
+        IOSimpleLockUnlock(notifs->lock);
+        return;
+    }
+    slot->received++;
+    handler = slot->handler;
+    hasWaiters = !LIST_EMPTY(&slot->waiters);
+    if (!handler && !hasWaiters) {
+        notifs->unhandled++;
+        IOSimpleLockUnlock(notifs->lock);
+        return;
+    }
+    IOSimpleLockUnlock(notifs->lock);
+
+    //Only the waiters linked to this opcode are looked at and woken
+    if (hasWaiters) {
+        struct notificationWaitLink* link;
+
+        IOLockLock(notifs->waitQueue);
+        IOSimpleLockLock(notifs->lock);
+        LIST_FOREACH(link, &slot->waiters, list) {
+            struct notificationWaitEntry* entry = link->entry;
+
+            if (entry->triggered || entry->aborted) {
+                continue;
+            }
+            if (!entry->fn || entry->fnDisabled || entry->fn(packet, entry->fn_data)) {
+                entry->triggered = true;
+                slot->waitersWoken++;
+                IOLockWakeup(notifs->waitQueue, entry, false);
+            }
+        }
+        IOSimpleLockUnlock(notifs->lock);
+        IOLockUnlock(notifs->waitQueue);
+    }
+
+    if (handler) {
+        (this->*handler)(packet);
+    }
+
+    //Only the RX path writes the histogram so it is updated without the lock
+    clock_get_uptime(&end);
+    absolutetime_to_nanoseconds(end - start, &nanoseconds);
+    slot->latency[latencyBucket(nanoseconds / 1000)]++;
+}
+
+int IntelWiFiDriver::initNotificationWait(struct notificationWaitEntry* entry, const uint16_t* cmdIDs, int noCmdIDs,
+                                          NotificationWaitFn fn, void* data) {
+    //iwl_init_notification_wait
+    struct notificationDispatch* notifs = &deviceProps.mvmConfig->notifs;
+    struct notificationSlot* slots[MAX_NOTIF_CMDS];
+
+    if (noCmdIDs > MAX_NOTIF_CMDS) {
+        return -EINVAL;
+    }
+
+    bzero(entry, sizeof(*entry));
+    entry->fn = fn;
+    entry->fn_data = data;
+    entry->noCmdIDs = noCmdIDs;
+
+    IOSimpleLockLock(notifs->lock);
+    for (int i = 0; i < noCmdIDs; i++) {
+        entry->cmdIDs[i] = notificationID(cmdIDs[i]);
+        slots[i] = lookupNotificationSlot(notifs, entry->cmdIDs[i], true);
+        if (!slots[i]) {
+            IOSimpleLockUnlock(notifs->lock);
+            LOG_ERROR("%s: Notification table full, cannot wait for 0x%04x\n", DRVNAME, cmdIDs[i]);
+            return -ENOSPC;
+        }
+    }
+    for (int i = 0; i < noCmdIDs; i++) {
+        entry->links[i].entry = entry;
+        LIST_INSERT_HEAD(&slots[i]->waiters, &entry->links[i], list);
+    }
+    LIST_INSERT_HEAD(&notifs->waitEntries, entry, list);
+    IOSimpleLockUnlock(notifs->lock);
+    return 0;
+}
+
+void IntelWiFiDriver::removeNotificationWait(struct notificationWaitEntry* entry) {
+    //iwl_remove_notification
+    struct notificationDispatch* notifs = &deviceProps.mvmConfig->notifs;
+
+    IOSimpleLockLock(notifs->lock);
+    if (entry->list.le_prev) {
+        for (int i = 0; i < entry->noCmdIDs; i++) {
+            LIST_REMOVE(&entry->links[i], list);
+        }
+        LIST_REMOVE(entry, list);
+        entry->list.le_prev = NULL;
+    }
+    IOSimpleLockUnlock(notifs->lock);
+}
+
+int IntelWiFiDriver::waitNotification(struct notificationWaitEntry* entry, uint32_t timeout) {
+    //iwl_wait_notification, timeout is in milliseconds
+    struct notificationDispatch* notifs = &deviceProps.mvmConfig->notifs;
+    AbsoluteTime deadline;
+    int ret = 0;
+
+    clock_interval_to_deadline(timeout, kMillisecondScale, reinterpret_cast<uint64_t*>(&deadline));
+
+    IOLockLock(notifs->waitQueue);
+    while (!entry->triggered && !entry->aborted) {
+        if (IOLockSleepDeadline(notifs->waitQueue, entry, deadline, THREAD_UNINT) == THREAD_TIMED_OUT) {
+            ret = -ETIMEDOUT;
+            break;
+        }
+    }
+    IOLockUnlock(notifs->waitQueue);
+
+    removeNotificationWait(entry);
+
+    if (entry->aborted) {
+        return -EIO;
+    }
+    return entry->triggered ? 0 : ret;
+}
+
 void IntelWiFiDriver::abortNotificationWaits() {
-    IOSimpleLockLock(deviceProps.mvmConfig.notifWaits.notifWaitLock);
-    //Get the first entry in the list
-    notificationWaitEntry* notifWaitEntry = deviceProps.mvmConfig.notifWaits.firstWaitEntry.lh_first;
-    //While there are still entries left set them as aborted
-    do {
-        notifWaitEntry->aborted = true;
-    } while ((notifWaitEntry = LIST_NEXT(notifWaitEntry, list)));
-    IOSimpleLockUnlock(deviceProps.mvmConfig.notifWaits.notifWaitLock);
-    
-    //From what I believe passing false should wake up all threads not just one?
-    //TODO: Might need to pass an event here
-    IOLockLock(deviceProps.mvmConfig.notifWaits.notifWaitQueue);
-    IOLockWakeup(deviceProps.mvmConfig.notifWaits.notifWaitQueue, NULL, false);
-    IOLockUnlock(deviceProps.mvmConfig.notifWaits.notifWaitQueue);
+    //iwl_abort_notification_waits
+    struct notificationDispatch* notifs = &deviceProps.mvmConfig->notifs;
+    struct notificationWaitEntry* entry;
+
+    IOLockLock(notifs->waitQueue);
+    IOSimpleLockLock(notifs->lock);
+    LIST_FOREACH(entry, &notifs->waitEntries, list) {
+        entry->aborted = true;
+        IOLockWakeup(notifs->waitQueue, entry, false);
+    }
+    IOSimpleLockUnlock(notifs->lock);
+    IOLockUnlock(notifs->waitQueue);
 }
@@ -12,18 +12,60 @@
 
 #define MAX_NOTIF_CMDS 5
 
+//Size of the (group, opcode) dispatch table, must be a power of two. There are far fewer
+//notifications in use than this so the open addressed table stays sparse
+#define NOTIF_TABLE_SIZE 256
+//Handler run time histogram, bucket n counts runs taking [2^(n-1), 2^n) us
+#define NOTIF_LATENCY_BUCKETS 16
+
+class IntelWiFiDriver;
+struct iwl_rx_packet;
+struct notificationWaitEntry;
+
+//Handler registered for a (group, opcode) pair, run for every matching notification
+typedef void (IntelWiFiDriver::*NotificationHandler)(struct iwl_rx_packet* packet);
+
+//Waiter callback, return true once the wait is satisfied (iwl_notif_wait_data.fn)
+typedef bool (*NotificationWaitFn)(struct iwl_rx_packet* packet, void* data);
+
+//Links a waiter into the waiter list of one of the opcodes it waits for
+struct notificationWaitLink {
+    LIST_ENTRY(notificationWaitLink) list;
+    struct notificationWaitEntry* entry;
+};
+
 struct notificationWaitEntry {
     LIST_ENTRY(notificationWaitEntry) list;
-    
-    //iwlwifi specifies a pointer to function fn, but well
-    //add that later on
 
-    void*       fn_data;
-    
+    NotificationWaitFn  fn;
+    void*               fn_data;
+
     uint16_t    cmdIDs[MAX_NOTIF_CMDS];
+    struct notificationWaitLink links[MAX_NOTIF_CMDS];
     uint8_t     noCmdIDs;
     bool        triggered, aborted, fnDisabled;
-    
+
+};
+
+struct notificationSlot {
+    uint16_t            cmdID;  //WIDE_ID(group, opcode), valid if inUse
+    bool                inUse;
+    NotificationHandler handler;
+    LIST_HEAD(, notificationWaitLink) waiters;
+
+    uint32_t            received;
+    uint32_t            waitersWoken;
+    uint32_t            latency[NOTIF_LATENCY_BUCKETS];
+};
+
+struct notificationDispatch {
+    IOSimpleLock*       lock;       //Protects the table and all waiter lists
+    IOLock*             waitQueue;  //Waiters sleep on their entry
+    LIST_HEAD(, notificationWaitEntry) waitEntries; //Every waiter, for aborting
+
+    struct notificationSlot table[NOTIF_TABLE_SIZE];
+    uint32_t            slotsUsed;
+    uint32_t            unhandled;  //Notifications with neither a handler nor a waiter
 };
 
 #endif /* IntelWiFiDriver_notif_h */
@@ -8,65 +8,87 @@
 #include "IntelWiFiDriver.hpp"
 #include "iwlwifi_headers/iwl-fh.h"
 #include "IntelWiFiDriver_ops.hpp"
+#include "IntelWiFiDriver_trans.hpp"
+
+//===================================
+//     Transport specialisations
+//===================================
+//Pick the transport instantiation for this device, everything the RX/TX paths would
+//otherwise test the device family for is resolved here
+void IntelWiFiDriver::selectTransport() {
+    PCIDeviceConfig* config = deviceProps.deviceConfig;
+    
+    if (config->device_family >= IWL_DEVICE_FAMILY_22560) {
+        setTransportOps<TransGen3>("gen3");
+    } else if (config->use_tfh) {
+        setTransportOps<TransGen2>("gen2");
+    } else if (config->mq_rx_supported) {
+        setTransportOps<TransGen1MQ>("gen1 multiqueue");
+    } else {
+        setTransportOps<TransGen1>("gen1");
+    }
+    IO_LOG("%s: Using %s transport\n", DRVNAME, deviceProps.trans.name);
+}
+
+template <class Trans>
+void IntelWiFiDriver::setTransportOps(const char* name) {
+    struct TransportOps* ops = &deviceProps.trans;
+    
+    ops->name = name;
+    ops->rxRestock = &IntelWiFiDriver::rxMultiqueueRestockT<Trans>;
+    ops->rxIncWritePointer = &IntelWiFiDriver::rxQueueIncrementWritePointerT<Trans>;
+    ops->txqFreeTFD = &IntelWiFiDriver::txQFreeTFDT<Trans>;
+    ops->unmapTFD = &IntelWiFiDriver::unmapTFDT<Trans>;
+    ops->stopDevice = Trans::gen2 ? &IntelWiFiDriver::stopDeviceG2 : &IntelWiFiDriver::stopDeviceG1;
+    ops->restockOnAlive = Trans::restockOnAlive;
+}
 
 void IntelWiFiDriver::rxMultiqueueRestock() {
+    (this->*deviceProps.trans.rxRestock)();
+}
+
+void IntelWiFiDriver::rxQueueIncrementWritePointer() {
+    (this->*deviceProps.trans.rxIncWritePointer)();
+}
+
+void IntelWiFiDriver::txQFreeTDF(struct iwl_txq* txq) {
+    (this->*deviceProps.trans.txqFreeTFD)(txq);
+}
+
+void IntelWiFiDriver::unmapTFD(struct iwl_cmd_meta* meta, struct iwl_txq* txq, int index) {
+    (this->*deviceProps.trans.unmapTFD)(meta, txq, index);
+}
+
+template <class Trans>
+void IntelWiFiDriver::rxMultiqueueRestockT() {
     //iwl_pcie_rxmq_restock
-    struct iwl_rx_mem_buffer* rxmb;
     struct iwl_rxq* rxq = deviceProps.rxq;
+    uint32_t misaligned = 0;
+    uint32_t restocked;
     if (!deviceProps.status.deviceEnabled) {
         return;
     }
     
     IOSimpleLockLock(rxq->lock);
-    rxmb = TAILQ_FIRST(rxq->rx_free);
-    while (rxq->free_count) {
-        //Remove the current element
-        TAILQ_REMOVE(rxq->rx_free, rxmb, list);
-        
-        rxmb->invalid = false;
-        //Check that 12 first bits are expected to be empty
-        //Might be worth adding some sort of reference here to trace this back
-        if (!(rxmb->page_dma & DMA_BIT_MASK(12))) printf("%s: rx_mem_buffer page_dma first 12 bits not empty\n", DRVNAME);
-        //"Point to Rx buffer ia next RBD in circular buffer"
-        restockRBD(rxmb);
-        rxq->write = (rxq->write + 1) & MQ_RX_TABLE_MASK;
-        rxq->free_count--;
-        //Get the next element
-        rxmb = TAILQ_NEXT(rxmb, list);
-    }
+    restocked = restockRxQueue<Trans>(rxq, &misaligned);
     IOSimpleLockUnlock(rxq->lock);
+    if (misaligned) printf("%s: %u rx_mem_buffer page_dma not aligned for the RBD\n", DRVNAME, misaligned);
+    if (DEBUG) printf("%s: Restocked %u RBDs on queue %d, write index %d\n", DRVNAME, restocked, rxq->id, rxq->write);
+    if (restocked) updateHardwareStatistics(rxRestocked, restocked);
     
     //Tell the device if we have added more space for firmware to place data
     //Increment write pointer in multiples of 8
     if (rxq->write_actual != (rxq->write & ~0x7)) {
         IOSimpleLockLock(rxq->lock);
-        rxQueueIncrementWritePointer();
+        rxQueueIncrementWritePointerT<Trans>();
         IOSimpleLockUnlock(rxq->lock);
     }
 }
 
-void IntelWiFiDriver::restockRBD(struct iwl_rx_mem_buffer* rxmb) {
-    //iwl_pcie_restock_bd
-    struct iwl_rxq* rxq = deviceProps.rxq;
-    if (deviceProps.deviceConfig->device_family >= IWL_DEVICE_FAMILY_22560) {
-        struct iwl_rx_transfer_desc* bd = (iwl_rx_transfer_desc*)rxq->bd;
-        
-        //iwlwifi uses BUILD_BUG_ON to check sizing of bd
-        
-        bd[rxq->write].addr = cpu_to_le64(rxmb->page_dma);
-        bd[rxq->write].rbid = cpu_to_le16(rxmb->vid);
-    } else {
-        unsigned long long* bd = (unsigned long long*)rxq->bd;
-        
-        bd[rxq->write] = cpu_to_le64(rxmb->page_dma | rxmb->vid);
-    }
-    
-    if (DEBUG) printf("%s: Assigned virtual RB ID %u to queue %d index %d\n", DRVNAME,
-                      (uint32_t)rxmb->vid, rxq->id, rxq->write);
-}
-
-void IntelWiFiDriver::rxQueueIncrementWritePointer() {
+template <class Trans>
+void IntelWiFiDriver::rxQueueIncrementWritePointerT() {
     //iwl_pcie_rxq_inc_wr_ptr
+    struct iwl_rxq* rxq = deviceProps.rxq;
     
     if (!deviceProps.deviceConfig->base_params->shadow_reg_enable &&
         deviceProps.status.deviceAsleep) {
@@ -81,21 +103,79 @@ void IntelWiFiDriver::rxQueueIncrementWritePointer() {
         if (reg & WPI_UCODE_DRV_GP1_BIT_MAC_SLEEP) {
             if (DEBUG) printf("%s: RX queue requesting wakeup, GP1=0x%x\n", DRVNAME, reg);
             busSetBit(WPI_GP_CNTRL, deviceProps.deviceConfig->csr->flag_mac_access_req);
-            deviceProps.rxq->need_update = true;
+            rxq->need_update = true;
             return;
         }
+    }
+    
+    rxq->write_actual = round_down(rxq->write, 8);
+    //Make sure the RBD writes land before the device sees the new write pointer
+    busBarrierWrite();
+    busWrite32(Trans::rxWritePointerOffset(rxq), Trans::rxWritePointerValue(rxq));
+    updateHardwareStatistics(rxDoorbell, 1);
+}
+
+template <class Trans>
+typename Trans::TFD* IntelWiFiDriver::getTFDT(struct iwl_txq* txq, int index) {
+    //iwl_pcie_get_tfd
+    return (typename Trans::TFD*)txq->tfds + Trans::tfdIndex(txq, index);
+}
+
+template <class Trans>
+void IntelWiFiDriver::txQFreeTFDT(struct iwl_txq* txq) {
+    //iwl_pcie_txq_free_tfd
+    int readPointer = txq->read_ptr;
+    int commandIndex = getCommandIndex(txq, readPointer);
+    
+    unmapTFDT<Trans>(&txq->entries[commandIndex].meta, txq, readPointer);
+    
+    //free mbuf_t
+    if (txq->entries) {
+        mbuf_t skb;
+        skb = txq->entries[commandIndex].skb;
         
-        deviceProps.rxq->write_actual = round_down(deviceProps.rxq->write, 8);
-        if (deviceProps.deviceConfig->device_family == IWL_DEVICE_FAMILY_22560) {
-            busWrite32(WPI_HBUS_TARG_WRPTR, deviceProps.rxq->write_actual |
-                       ((FIRST_RX_QUEUE + deviceProps.rxq->id) << 16));
-        } else if (deviceProps.deviceConfig->mq_rx_supported){
-            busWrite32(RFH_Q_FRBDCB_WIDX_TRG(deviceProps.rxq->id), deviceProps.rxq->write_actual);
+        if (skb) {
+            //TODO: Update for DVM
+            //Using MVM version for freeing SKBs by default, will need to update
+            //if adding DVM functionality
+            
+//            freeSKB(skb);
+            mbuf_freem_list(skb);
+            txq->entries[commandIndex].skb = NULL;
+            updateHardwareStatistics(txFrames, 1);
+        }
+    }
+}
+
+template <class Trans>
+void IntelWiFiDriver::unmapTFDT(struct iwl_cmd_meta* meta, struct iwl_txq* txq, int index) {
+    //iwl_pcie_tfd_unmap
+    typename Trans::TFD* tfd = getTFDT<Trans>(txq, index);
+    int numberTBS = Trans::numTBS(tfd);
+    
+    if (numberTBS > deviceProps.maxTBS) {
+        LOG_ERROR("%s: Too many TBSs [index: %d, count: %d]\n", DRVNAME, index, numberTBS);
+        //TODO: Issue fatal error
+        return;
+    }
+    
+    //First TB is never freed, its the bidirectional DMA data
+    
+    for (int i = 1; i < numberTBS; i++) {
+        //TODO: Check if IOFree commands are right
+        if (meta->tbs & BIT(i)) {
+            IOFreePageable((void*)Trans::tbAddress(tfd, i), Trans::tbLength(tfd, i));
         } else {
-            busWrite32(FH_RSCSR_CHNL0_WPTR, deviceProps.rxq->write_actual);
+            IOFree((void*)Trans::tbAddress(tfd, i), Trans::tbLength(tfd, i));
         }
     }
+    
+    meta->tbs = 0;
+    Trans::clearTBS(tfd);
 }
+//===================================
+
+
 //===================================
 //      Gen2 device operations
 //===================================
@@ -291,7 +371,7 @@ void IntelWiFiDriver::freeTFDG2(struct iwl_txq* txq) {
     //idx is bounded by n_widow
     int idx = getCommandIndex(txq, txq->id);
     
-    unmapTFDG2(&txq->entries[idx].meta, (iwl_tfh_tfd*)getTFD(txq, idx));
+    unmapTFDG2(&txq->entries[idx].meta, getTFDT<TransGen2>(txq, idx));
     
     if (txq->entries) {
         mbuf_t skb = txq->entries[idx].skb;
@@ -323,7 +403,7 @@ void IntelWiFiDriver::unmapTFDG2(struct iwl_cmd_meta* meta, struct iwl_tfh_tfd*
 
 int IntelWiFiDriver::getNumTBSG2(struct iwl_tfh_tfd* tfd) {
     //iwl_pcie_gen2_get_num_tbs
-    return le16_to_cpu(tfd->num_tbs) & 0x1f;
+    return TransGen2::numTBS(tfd);
 }
 //===================================
 
@@ -415,24 +495,24 @@ void IntelWiFiDriver::txStopG1() {
     
     //[iwl_pcie_tx_stop_fh START]
     //Spinlock irq_lock
-    IOInterruptState flags;
-    uint32_t mask;
-    if (!grabNICAccess(flags)) {
-        return;
-    }
-    
-    for (int ch = 0; ch < FH_TCSR_CHNL_NUM; ch++) {
-        busWrite32(FH_TCSR_CHNL_TX_CONFIG_REG(ch), 0);
-        mask |= FH_TSSR_TX_STATUS_REG_MSK_CHNL_IDLE(ch);
-    }
-    
-    int ret = pollBit(FH_TSSR_TX_STATUS_REG, mask, mask, 5000);
-    if (ret < 0 ) {
-        LOG_ERROR("%s: Failing on timeout while stopping DMA channel [0x%08x]\n", DRVNAME, busRead32(FH_TSSR_TX_STATUS_REG));
+    {
+        uint32_t mask = 0;
+        NICAccessSession nic(this);
+        if (!nic.isHeld()) {
+            return;
+        }
+        
+        for (int ch = 0; ch < FH_TCSR_CHNL_NUM; ch++) {
+            busWrite32(FH_TCSR_CHNL_TX_CONFIG_REG(ch), 0);
+            mask |= FH_TSSR_TX_STATUS_REG_MSK_CHNL_IDLE(ch);
+        }
+        
+        int ret = pollBit(FH_TSSR_TX_STATUS_REG, mask, mask, 5000, pollSiteTxFlush);
+        if (ret < 0 ) {
+            LOG_ERROR("%s: Failing on timeout while stopping DMA channel [0x%08x]\n", DRVNAME, busRead32(FH_TSSR_TX_STATUS_REG));
+        }
     }
     
-    releaseNICAccess(flags);
-    
     //Spinunlock irq_lock
     //[iwl_pcie_tx_stop_fh END]
     
@@ -545,11 +625,14 @@ int IntelWiFiDriver::apmInitG1() {
          * just to discard the value. But that's the way the hardware
          * seems to like it.
          */
-        readPRPH(OSC_CLK);
-        readPRPH(OSC_CLK);
-        setBitsPRPH(OSC_CLK, OSC_CLK_FORCE_CONTROL);
-        readPRPH(OSC_CLK);
-        readPRPH(OSC_CLK);
+        NICAccessSession nic(this);
+        if (nic.isHeld()) {
+            readPRPHNoGrab(OSC_CLK);
+            readPRPHNoGrab(OSC_CLK);
+            modifyPRPHNoGrab(OSC_CLK, 0, OSC_CLK_FORCE_CONTROL);
+            readPRPHNoGrab(OSC_CLK);
+            readPRPHNoGrab(OSC_CLK);
+        }
     }
     
     /*
@@ -563,11 +646,15 @@ int IntelWiFiDriver::apmInitG1() {
         writePRPH(APMG_CLK_EN_REG, APMG_CLK_VAL_DMA_CLK_RQT);
         IOSleep(1);
         
-        //Disable L1 active
-        setBitsPRPH(APMG_PCIDEV_STT_REG, APMG_PCIDEV_STT_VAL_L1_ACT_DIS);
-        
-        //Clear the interrupt in APMG if the NIC is in RFKILL
-        writePRPH(APMG_RTC_INT_STT_REG, APMG_RTC_INT_STT_RFKILL);
+        //Cant sleep while holding the NIC so the session starts after the delay
+        NICAccessSession nic(this);
+        if (nic.isHeld()) {
+            //Disable L1 active
+            modifyPRPHNoGrab(APMG_PCIDEV_STT_REG, 0, APMG_PCIDEV_STT_VAL_L1_ACT_DIS);
+            
+            //Clear the interrupt in APMG if the NIC is in RFKILL
+            writePRPHNoGrab(APMG_RTC_INT_STT_REG, APMG_RTC_INT_STT_RFKILL);
+        }
     }
     
     deviceProps.status.deviceEnabled = true;
@@ -719,125 +806,6 @@ void IntelWiFiDriver::freeTSOPage(mbuf_t skb) {
     //TODO: Needs adapting for xnu
 }
 
-void IntelWiFiDriver::txQFreeTDF(struct iwl_txq* txq) {
-    //iwl_pcie_txq_free_tfd
-    int readPointer = txq->read_ptr;
-    int commandIndex = getCommandIndex(txq, readPointer);
-    
-    unmapTFD(&txq->entries[commandIndex].meta, txq, readPointer);
-    
-    //free mbuf_t
-    if (txq->entries) {
-        mbuf_t skb;
-        skb = txq->entries[commandIndex].skb;
-        
-        if (skb) {
-            //TODO: Update for DVM
-            //Using MVM version for freeing SKBs by default, will need to update
-            //if adding DVM functionality
-            
-//            freeSKB(skb);
-            mbuf_freem_list(skb);
-            txq->entries[commandIndex].skb = NULL;
-        }
-    }
-}
-
-void IntelWiFiDriver::unmapTFD(struct iwl_cmd_meta* meta, struct iwl_txq* txq, int index) {
-    //iwl_pcie_tfd_unmap
-    void* tfd = getTFD(txq, index);
-    int numberTBS = TFDGetNumberOfTBS(tfd);
-    
-    if (numberTBS > deviceProps.maxTBS) {
-        LOG_ERROR("%s: Too many TBSs [index: %d, count: %d]\n", DRVNAME, index, numberTBS);
-        //TODO: Issue fatal error
-        return;
-    }
-    
-    //First TB is never freed, its the bidirectional DMA data
-    
-    for (int i = 1; i < numberTBS; i++) {
-        //TODO: Check if IOFree commands are right
-        if (meta->tbs & BIT(i)) {
-            IOFreePageable((void*)TFDGetTBAddress(tfd, i), TFDGetTBLength(tfd, i));
-        } else {
-            IOFree((void*)TFDGetTBAddress(tfd, i), TFDGetTBLength(tfd, i));
-        }
-    }
-    
-    meta->tbs = 0;
-    
-    if (deviceProps.deviceConfig->use_tfh) {
-        struct iwl_tfh_tfd* tfd_fh = (iwl_tfh_tfd*)tfd;
-        tfd_fh->num_tbs = 0;
-    } else {
-        struct iwl_tfd* tfd_fh = (iwl_tfd*)tfd;
-        tfd_fh->num_tbs = 0;
-    }
-}
-
-void* IntelWiFiDriver::getTFD(struct iwl_txq* txq, int index) {
-    //iwl_pcie_get_tfd
-    //Takes a different approach, in iwlwifi they do arithmetic to
-    //void* which is illegal, using the code from iwl_pcie_tfd_get_num_tbs
-    //we know what type to cast to for the situation and thus we can do safe
-    //pointer maths
-    if (deviceProps.deviceConfig->use_tfh) {
-        index = getCommandIndex(txq, index);
-        return (iwl_tfh_tfd*)txq->tfds + deviceProps.tfdSize * index;
-    }
-    return (iwl_tfd*)txq->tfds + deviceProps.tfdSize * index;
-}
-
-uint8_t IntelWiFiDriver::TFDGetNumberOfTBS(void* __tfd) {
-    if (deviceProps.deviceConfig->use_tfh) {
-        struct iwl_tfh_tfd* tfd = (iwl_tfh_tfd*)__tfd;
-        return le16_to_cpu(tfd->num_tbs) & 0x1f;
-    } else {
-        struct iwl_tfd* tfd = (iwl_tfd*)__tfd;
-        return tfd->num_tbs & 0x1f;
-    }
-}
-
-bus_addr_t IntelWiFiDriver::TFDGetTBAddress(void* __tfd, int index) {
-    //iwl_pcie_tfd_tb_get_addr
-    if (deviceProps.deviceConfig->use_tfh) {
-        struct iwl_tfh_tfd* tfd = (iwl_tfh_tfd*)__tfd;
-        //TODO: Check here when implementing DMA
-        struct iwl_tfh_tb* tb = &tfd->tbs[index];
-        
-        return tb->addr;
-    } else {
-        struct iwl_tfd* tfd = (iwl_tfd*)__tfd;
-        struct iwl_tfd_tb* tb = &tfd->tbs[index];
-        
-        //Warning for unaligned pointer value, doesnt matter
-        dma_addr_t addr = le32_to_cpus(&tb->lo);
-        dma_addr_t hi_len;
-        
-        if (sizeof(dma_addr_t) <= sizeof(uint32_t)) {
-            return addr;
-        }
-        hi_len = le16_to_cpu(tb->hi_n_len) & TB_HI_N_LEN_ADDR_HI_MSK;
-        return addr | (hi_len << 32);
-    }
-}
-
-uint16_t IntelWiFiDriver::TFDGetTBLength(void* __tfd, int index) {
-    if (deviceProps.deviceConfig->use_tfh) {
-        struct iwl_tfh_tfd* tfd = (iwl_tfh_tfd*)__tfd;
-        //TODO: Check here when implementing DMA
-        struct iwl_tfh_tb* tb = &tfd->tbs[index];
-        
-        return le16_to_cpu(tb->tb_len);
-    } else {
-        struct iwl_tfd* tfd = (iwl_tfd*)__tfd;
-        struct iwl_tfd_tb* tb = &tfd->tbs[index];
-        
-        return le16_to_cpu(tb->hi_n_len) >> 4;
-    }
-}
-
 void IntelWiFiDriver::mapRxCauses() {
     //iwl_pcie_map_rx_causes
     uint32_t offset = deviceProps.sharedVecMask & IWL_SHARED_IRQ_FIRST_RSS ? 1 : 0;
@@ -909,7 +877,7 @@ void IntelWiFiDriver::apmStopMaster() {
     //iwl_pcie_apm_stop_master
     busSetBit(deviceProps.deviceConfig->csr->addr_sw_reset, deviceProps.deviceConfig->csr->flag_stop_master);
     
-    int ret = pollBit(deviceProps.deviceConfig->csr->addr_sw_reset, BIT(deviceProps.deviceConfig->csr->flag_master_dis), BIT(deviceProps.deviceConfig->csr->flag_master_dis), 100);
+    int ret = pollBit(deviceProps.deviceConfig->csr->addr_sw_reset, BIT(deviceProps.deviceConfig->csr->flag_master_dis), BIT(deviceProps.deviceConfig->csr->flag_master_dis), 100, pollSiteStopMaster);
     if (ret < 0) LOG_ERROR("%s: Master disable timed out\n", DRVNAME);
     
     if (DEBUG) printf("%s: Stop master\n", DRVNAME);
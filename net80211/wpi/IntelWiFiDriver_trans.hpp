@@ -0,0 +1,159 @@
+//
+//  IntelWiFiDriver_trans.hpp
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+#ifndef IntelWiFiDriver_trans_h
+#define IntelWiFiDriver_trans_h
+
+#include "iwlwifi_headers/iwl-fh.h"
+
+//Descriptor and register layout of each transport generation. The transport templates in
+//IntelWiFiDriver_ops.cpp are instantiated once per policy and selectTransport picks the
+//instantiation in device_attach, so the RX/TX paths never look at the device family.
+//Each generation only redefines what differs from the one it derives from
+
+//7000 and 8000 families: legacy TFDs, 32 bit RBDs and a single RX queue
+struct TransGen1 {
+    typedef struct iwl_tfd TFD;
+    static const bool gen2 = false;
+    static const bool restockOnAlive = false;
+    static const uint32_t rxQueueMask = RX_QUEUE_MASK;
+    //The RBD holds the buffer address shifted down by 8
+    static const uint64_t rbdAddressMask = DMA_BIT_MASK(8);
+
+    static inline void restockRBD(struct iwl_rxq* rxq, struct iwl_rx_mem_buffer* rxmb) {
+        //iwl_pcie_rxsq_restock, iwl_pcie_dma_addr2rbd_ptr
+        __le32* bd = (__le32*)rxq->bd;
+        bd[rxq->write] = cpu_to_le32((uint32_t)(rxmb->page_dma >> 8));
+        rxq->queue[rxq->write] = rxmb;
+    }
+
+    static inline uint32_t rxWritePointerOffset(struct iwl_rxq* rxq) {
+        return FH_RSCSR_CHNL0_WPTR;
+    }
+
+    static inline uint32_t rxWritePointerValue(struct iwl_rxq* rxq) {
+        return rxq->write_actual;
+    }
+
+    //Index of the TFD backing queue entry index
+    static inline int tfdIndex(struct iwl_txq* txq, int index) {
+        return index;
+    }
+
+    static inline uint8_t numTBS(TFD* tfd) {
+        return tfd->num_tbs & 0x1f;
+    }
+
+    static inline void clearTBS(TFD* tfd) {
+        tfd->num_tbs = 0;
+    }
+
+    static inline bus_addr_t tbAddress(TFD* tfd, int index) {
+        //iwl_pcie_tfd_tb_get_addr
+        struct iwl_tfd_tb* tb = &tfd->tbs[index];
+        dma_addr_t addr = le32_to_cpu(tb->lo);
+        dma_addr_t hi_len;
+
+        if (sizeof(dma_addr_t) <= sizeof(uint32_t)) {
+            return addr;
+        }
+        hi_len = le16_to_cpu(tb->hi_n_len) & TB_HI_N_LEN_ADDR_HI_MSK;
+        return addr | (hi_len << 32);
+    }
+
+    static inline uint16_t tbLength(TFD* tfd, int index) {
+        return le16_to_cpu(tfd->tbs[index].hi_n_len) >> 4;
+    }
+};
+
+//9000 family: legacy TFDs with the multi queue RX hardware and 64 bit RBDs
+struct TransGen1MQ : TransGen1 {
+    static const uint32_t rxQueueMask = MQ_RX_TABLE_MASK;
+    //The virtual RB ID goes in the low 12 bits of the RBD
+    static const uint64_t rbdAddressMask = DMA_BIT_MASK(12);
+
+    static inline void restockRBD(struct iwl_rxq* rxq, struct iwl_rx_mem_buffer* rxmb) {
+        //iwl_pcie_restock_bd
+        __le64* bd = (__le64*)rxq->bd;
+        bd[rxq->write] = cpu_to_le64(rxmb->page_dma | rxmb->vid);
+    }
+
+    static inline uint32_t rxWritePointerOffset(struct iwl_rxq* rxq) {
+        return RFH_Q_FRBDCB_WIDX_TRG(rxq->id);
+    }
+};
+
+//22000 family: TFH TFDs, queues only have n_window TFDs
+struct TransGen2 : TransGen1MQ {
+    typedef struct iwl_tfh_tfd TFD;
+    static const bool gen2 = true;
+    static const bool restockOnAlive = true;
+
+    static inline int tfdIndex(struct iwl_txq* txq, int index) {
+        return getCommandIndex(txq, index);
+    }
+
+    static inline uint8_t numTBS(TFD* tfd) {
+        return le16_to_cpu(tfd->num_tbs) & 0x1f;
+    }
+
+    static inline void clearTBS(TFD* tfd) {
+        tfd->num_tbs = 0;
+    }
+
+    static inline bus_addr_t tbAddress(TFD* tfd, int index) {
+        //TODO: Check here when implementing DMA
+        return tfd->tbs[index].addr;
+    }
+
+    static inline uint16_t tbLength(TFD* tfd, int index) {
+        return le16_to_cpu(tfd->tbs[index].tb_len);
+    }
+};
+
+//22560 family: RX transfer descriptors and the RX write pointer moved to HBUS
+struct TransGen3 : TransGen2 {
+    static inline void restockRBD(struct iwl_rxq* rxq, struct iwl_rx_mem_buffer* rxmb) {
+        //iwl_pcie_restock_bd
+        struct iwl_rx_transfer_desc* bd = (struct iwl_rx_transfer_desc*)rxq->bd;
+        bd[rxq->write].addr = cpu_to_le64(rxmb->page_dma);
+        bd[rxq->write].rbid = cpu_to_le16(rxmb->vid);
+    }
+
+    static inline uint32_t rxWritePointerOffset(struct iwl_rxq* rxq) {
+        return WPI_HBUS_TARG_WRPTR;
+    }
+
+    static inline uint32_t rxWritePointerValue(struct iwl_rxq* rxq) {
+        return rxq->write_actual | ((FIRST_RX_QUEUE + rxq->id) << 16);
+    }
+};
+
+//iwl_pcie_rxmq_restock and iwl_pcie_rxsq_restock, moves every buffer on rx_free into the
+//ring. The caller holds rxq->lock. Buffers whose address overlaps the bits the RBD needs
+//are counted in misaligned, they are still handed over like iwlwifi does after its WARN_ON
+template <class Trans>
+static inline uint32_t restockRxQueue(struct iwl_rxq* rxq, uint32_t* misaligned) {
+    struct iwl_rx_mem_buffer* rxmb;
+    uint32_t restocked = 0;
+
+    while (rxq->free_count && (rxmb = TAILQ_FIRST(rxq->rx_free))) {
+        TAILQ_REMOVE(rxq->rx_free, rxmb, list);
+        rxmb->invalid = false;
+        if (rxmb->page_dma & Trans::rbdAddressMask) {
+            (*misaligned)++;
+        }
+        //"Point to Rx buffer via next RBD in circular buffer"
+        Trans::restockRBD(rxq, rxmb);
+        rxq->write = (rxq->write + 1) & Trans::rxQueueMask;
+        rxq->free_count--;
+        restocked++;
+    }
+    return restocked;
+}
+
+#endif /* IntelWiFiDriver_trans_h */
@@ -0,0 +1,102 @@
+//
+//  MMIOTrace.cpp
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+//Record and replay of driver register accesses
+//
+//Recording only claims a slot in a ring, the owner times the accesses and
+//exports the ring with saveMMIOTrace. A saved trace loaded with loadMMIOTrace
+//then stands in for the device: CSR reads return the traced values and CSR
+//writes are checked against it. PRPH and SHR annotations describe the CSR
+//accesses before them and are skipped on replay.
+//This file only depends on MMIOTrace.hpp so the replay can be run on the host
+
+#include <sys/types.h>
+#include <sys/errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "MMIOTrace.hpp"
+
+void recordMMIOAccess(struct mmioTrace* trace, enum mmioTraceOp op, uint32_t address, uint32_t value,
+                      uint64_t nanoseconds) {
+    uint64_t index = __atomic_fetch_add(&trace->head, 1, __ATOMIC_RELAXED);
+    struct mmioTraceEntry* entry = &trace->entries[index & (MMIO_TRACE_ENTRIES - 1)];
+    
+    entry->delta = nanoseconds > UINT32_MAX ? UINT32_MAX : (uint32_t)nanoseconds;
+    entry->address = (op << 24) | (address & 0x00ffffff);
+    entry->value = value;
+    __atomic_fetch_add(&trace->ops[op], 1, __ATOMIC_RELAXED);
+}
+
+uint32_t replayMMIOAccess(struct mmioTrace* trace, enum mmioTraceOp op, uint32_t offset, uint32_t value) {
+    trace->ops[op]++;
+    while (trace->head < trace->count) {
+        struct mmioTraceEntry* entry = &trace->entries[trace->head++];
+        uint32_t entryOp = entry->address >> 24;
+        
+        if (entryOp >= mmioReadPRPH) continue;
+        if (entryOp != op || (entry->address & 0x00ffffff) != offset ||
+            (op != mmioRead32 && entry->value != value)) {
+            trace->mismatches++;
+        }
+        return entry->value;
+    }
+    trace->mismatches++;
+    return ~0U;
+}
+
+int loadMMIOTrace(struct mmioTrace* trace, const void* data, size_t length) {
+    const struct mmioTraceHeader* header = (const struct mmioTraceHeader*)data;
+    
+    if (!trace->entries) return -ENOMEM;
+    if (length < sizeof(*header) || header->magic != MMIO_TRACE_MAGIC ||
+        header->version != MMIO_TRACE_VERSION || header->entrySize != sizeof(struct mmioTraceEntry)) {
+        return -EINVAL;
+    }
+    if (header->count > MMIO_TRACE_ENTRIES ||
+        header->count > (length - sizeof(*header)) / sizeof(struct mmioTraceEntry)) {
+        return -E2BIG;
+    }
+    
+    memcpy(trace->entries, header + 1, header->count * sizeof(struct mmioTraceEntry));
+    trace->count = header->count;
+    trace->head = 0;
+    trace->mismatches = 0;
+    memset(trace->ops, 0, sizeof(trace->ops));
+    return 0;
+}
+
+size_t savedMMIOTraceSize(const struct mmioTrace* trace) {
+    if (!trace->entries) return 0;
+    
+    uint64_t head = __atomic_load_n(&trace->head, __ATOMIC_RELAXED);
+    uint64_t count = head < MMIO_TRACE_ENTRIES ? head : MMIO_TRACE_ENTRIES;
+    
+    return sizeof(struct mmioTraceHeader) + count * sizeof(struct mmioTraceEntry);
+}
+
+size_t saveMMIOTrace(const struct mmioTrace* trace, void* buffer, size_t length) {
+    struct mmioTraceHeader* header = (struct mmioTraceHeader*)buffer;
+    struct mmioTraceEntry* entries = (struct mmioTraceEntry*)(header + 1);
+    
+    if (!trace->entries || length < sizeof(*header)) return 0;
+    
+    uint64_t head = __atomic_load_n(&trace->head, __ATOMIC_RELAXED);
+    uint64_t room = (length - sizeof(*header)) / sizeof(struct mmioTraceEntry);
+    uint64_t count = head < MMIO_TRACE_ENTRIES ? head : MMIO_TRACE_ENTRIES;
+    if (count > room) count = room;
+    for (uint64_t i = 0; i < count; i++) {
+        entries[i] = trace->entries[(head - count + i) & (MMIO_TRACE_ENTRIES - 1)];
+    }
+    
+    header->magic = MMIO_TRACE_MAGIC;
+    header->version = MMIO_TRACE_VERSION;
+    header->entrySize = sizeof(struct mmioTraceEntry);
+    header->count = (uint32_t)count;
+    header->dropped = head - count > UINT32_MAX ? UINT32_MAX : (uint32_t)(head - count);
+    return sizeof(*header) + count * sizeof(struct mmioTraceEntry);
+}
@@ -0,0 +1,80 @@
+//
+//  MMIOTrace.hpp
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+#ifndef MMIOTrace_h
+#define MMIOTrace_h
+#include <sys/types.h>
+
+//MMIO trace backend, picked at build time with -DMMIO_TRACE=MMIO_TRACE_RECORD or
+//MMIO_TRACE_REPLAY. Record logs every register access, replay serves register reads from a
+//loaded trace and checks the writes against it without touching the device
+#define MMIO_TRACE_OFF      0
+#define MMIO_TRACE_RECORD   1
+#define MMIO_TRACE_REPLAY   2
+#ifndef MMIO_TRACE
+#define MMIO_TRACE MMIO_TRACE_OFF
+#endif
+
+#define MMIO_TRACE_ENTRIES  (64 * 1024) //Must be a power of two, the record ring wraps
+#define MMIO_TRACE_MAGIC    0x4d4d494f  //"MMIO"
+#define MMIO_TRACE_VERSION  1
+
+enum mmioTraceOp {
+    mmioRead32,
+    mmioWrite32,
+    mmioWrite8,
+    //Annotations, recorded after the CSR accesses that make them up and skipped on replay
+    mmioReadPRPH,
+    mmioWritePRPH,
+    mmioReadShr,
+    mmioWriteShr,
+    mmioTraceOpCount
+};
+
+//One register access, 12 bytes
+struct mmioTraceEntry {
+    uint32_t delta;     //ns since the previous entry, saturates
+    uint32_t address;   //mmioTraceOp << 24 | CSR, PRPH or SHR address
+    uint32_t value;
+} __packed;
+
+//Saved trace layout, the header is followed by count entries oldest first
+struct mmioTraceHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entrySize;
+    uint32_t count;
+    uint32_t dropped;   //Entries overwritten in the ring before the trace was saved
+} __packed;
+
+struct mmioTrace {
+    struct mmioTraceEntry*  entries;    //MMIO_TRACE_ENTRIES, allocated by the owner
+    uint64_t                head;       //Entries recorded, or consumed on replay
+    uint64_t                last;       //Uptime of the previous entry
+    uint32_t                count;      //Entries loaded for replay
+    uint32_t                mismatches; //Replayed accesses that differ from the trace
+    uint64_t                ops[mmioTraceOpCount];
+};
+
+//Record and replay engine (MMIOTrace.cpp). It does not allocate, lock or read the clock so
+//the same code runs in the kext and in the host replay driver
+
+//Append an access to the record ring, safe to call from several threads at once
+void recordMMIOAccess(struct mmioTrace* trace, enum mmioTraceOp op, uint32_t address, uint32_t value,
+                      uint64_t nanoseconds);
+//Take the next CSR access from the loaded trace. Returns the traced value, ~0 past the end
+//like a removed device, and counts a mismatch if op, offset or a written value differ
+uint32_t replayMMIOAccess(struct mmioTrace* trace, enum mmioTraceOp op, uint32_t offset, uint32_t value);
+//Load a saved trace for replay, starting it from the first entry. Returns 0 or -errno
+int loadMMIOTrace(struct mmioTrace* trace, const void* data, size_t length);
+//Bytes saveMMIOTrace needs for the whole recorded ring
+size_t savedMMIOTraceSize(const struct mmioTrace* trace);
+//Save the recorded trace, keeping the newest entries if it does not all fit.
+//Returns the number of bytes written to buffer
+size_t saveMMIOTrace(const struct mmioTrace* trace, void* buffer, size_t length);
+
+#endif /* MMIOTrace_h */
@@ -30,6 +30,7 @@ protected:
 	virtual int	device_activate(int);
 	virtual void	device_netreset();
 	virtual bool	device_powered_on();
+	virtual IOReturn	device_hw_stats(struct voodoo80211_hw_stats_data *);
 	virtual struct ieee80211com* getIeee80211com();
 	virtual UInt32		outputPacket		( mbuf_t m, void* param );
 	
@@ -38,8 +39,22 @@ private:
 	bool		fPoweredOn;
 	IOInterruptEventSource* fInterrupt;
 	IOMemoryMap*	fMap;
+	
+	typedef int	(VoodooIntel3945::*wpi_notif_handler_t)(struct wpi_softc *,
+			    struct wpi_rx_desc *, struct wpi_rx_data *);
+	struct wpi_notif_handler {
+		uint8_t			type;
+		wpi_notif_handler_t	handler;
+		const char		*name;
+	};
+	static const struct wpi_notif_handler wpi_notif_handlers[WPI_NOTIF_NSLOTS];
+	uint8_t		fNotifSlot[256];	/* notification type -> handler */
+	
 	void		wpi_resume();
 	int		wpi_nic_lock(struct wpi_softc *);
+	int		wpi_poll(struct wpi_softc *, int, uint32_t, uint32_t, uint32_t, int);
+	void		wpi_poll_stats(struct wpi_softc *);
+	void		wpi_phase_stats(struct wpi_softc *, int, int);
 	int		wpi_read_prom_data(struct wpi_softc *, uint32_t, void *, int);
 	int		wpi_dma_contig_alloc(bus_dma_tag_t, struct wpi_dma_info *, void **, bus_size_t, bus_size_t);
 	void		wpi_dma_contig_free(struct wpi_dma_info *);
@@ -53,9 +68,12 @@ private:
 	int		wpi_alloc_tx_ring(struct wpi_softc *, struct wpi_tx_ring *, int);
 	void		wpi_reset_tx_ring(struct wpi_softc *, struct wpi_tx_ring *);
 	void		wpi_free_tx_ring(struct wpi_softc *, struct wpi_tx_ring *);
+	int		wpi_alloc_cmd_pool(struct wpi_softc *);
+	void		wpi_free_cmd_pool(struct wpi_softc *);
 	int		wpi_read_eeprom(struct wpi_softc *);
-	void		wpi_read_eeprom_channels(struct wpi_softc *, int);
-	void		wpi_read_eeprom_group(struct wpi_softc *, int);
+	void		wpi_apply_eeprom(struct wpi_softc *);
+	void		wpi_parse_eeprom_channels(struct wpi_softc *, int);
+	void		wpi_parse_eeprom_group(struct wpi_softc *, int);
 	int		wpi_media_change();
 	void		wpi_iter_func(void *, struct ieee80211_node *);
 	void		wpi_calib_timeout(void *);
@@ -63,20 +81,36 @@ private:
 	void		wpi_rx_done(struct wpi_softc *, struct wpi_rx_desc *, struct wpi_rx_data *);
 	void		wpi_tx_done(struct wpi_softc *, struct wpi_rx_desc *);
 	void		wpi_cmd_done(struct wpi_softc *, struct wpi_rx_desc *);
+	void		wpi_notif_init();
+	int		wpi_notif_rx_done(struct wpi_softc *, struct wpi_rx_desc *, struct wpi_rx_data *);
+	int		wpi_notif_tx_done(struct wpi_softc *, struct wpi_rx_desc *, struct wpi_rx_data *);
+	int		wpi_notif_uc_ready(struct wpi_softc *, struct wpi_rx_desc *, struct wpi_rx_data *);
+	int		wpi_notif_state_changed(struct wpi_softc *, struct wpi_rx_desc *, struct wpi_rx_data *);
+	int		wpi_notif_start_scan(struct wpi_softc *, struct wpi_rx_desc *, struct wpi_rx_data *);
+	int		wpi_notif_stop_scan(struct wpi_softc *, struct wpi_rx_desc *, struct wpi_rx_data *);
 	void		wpi_notif_intr(struct wpi_softc *);
+	void		wpi_notif_stats(struct wpi_softc *);
 	void		wpi_fatal_intr(struct wpi_softc *);
 	int		wpi_intr(OSObject *ih, IOInterruptEventSource *, int count);
 	int		wpi_tx(struct wpi_softc *, mbuf_t, struct ieee80211_node *);
 	void		wpi_start();
 	void		wpi_watchdog();
 	int		wpi_ioctl(struct ieee80211com *, u_long, caddr_t);
+	int		wpi_cmd_submit(struct wpi_softc *, int, const void *, int,
+			    wpi_cmd_cb_t, void *);
+	void		wpi_cmd_kick(struct wpi_softc *);
+	void		wpi_cmd_reclaim(struct wpi_softc *, int);
+	int		wpi_cmd_wait_all(struct wpi_softc *);
+	void		wpi_cmd_begin(struct wpi_softc *);
+	int		wpi_cmd_end(struct wpi_softc *, int);
 	int		wpi_cmd(struct wpi_softc *, int, const void *, int, int);
 	int		wpi_mrr_setup(struct wpi_softc *);
 	void		wpi_set_led(struct wpi_softc *, uint8_t, uint8_t, uint8_t);
 	int		wpi_set_timing(struct wpi_softc *, struct ieee80211_node *);
 	void		wpi_power_calibration(struct wpi_softc *);
+	void		wpi_txpower_init(struct wpi_softc *);
+	void		wpi_txpower_update(struct wpi_softc *);
 	int		wpi_set_txpower(struct wpi_softc *, int);
-	int		wpi_get_power_index(struct wpi_softc *, struct wpi_power_group *, struct ieee80211_channel *, int);
 	int		wpi_set_pslevel(struct wpi_softc *, int, int, int);
 	int		wpi_config(struct wpi_softc *);
 	int		wpi_scan(struct wpi_softc *, uint16_t);
@@ -84,6 +118,8 @@ private:
 	int		wpi_run(struct wpi_softc *);
 	int		wpi_post_alive(struct wpi_softc *);
 	int		wpi_load_bootcode(struct wpi_softc *, const uint8_t *, int);
+	int		wpi_fw_decompress(struct wpi_softc *, uint8_t *,
+			    const uint8_t *, uint32_t, uint32_t);
 	int		wpi_load_firmware(struct wpi_softc *);
 	int		wpi_read_firmware(struct wpi_softc *);
 	int		wpi_clock_wait(struct wpi_softc *);
@@ -32,6 +32,7 @@
 #include "../compat.h"
 
 #include <machine/endian.h>
+#include <kern/clock.h>
 
 #include <net/if.h>
 #include <net/if_arp.h>
@@ -45,6 +46,7 @@
 #include <netinet/if_ether.h>
 #include <netinet/ip.h>
 
+#include "../lz4.h"
 #include "VoodooIntel3945.h"
 #include "Firmware.h"
 
@@ -65,6 +67,27 @@ int wpi_debug = 0;
 
 #define abs(x)	(x) < 0 ? (0 - (x)) : (x)
 
+/* Monotonic time in microseconds, for the firmware load metrics. */
+static __inline uint64_t
+wpi_uptime_us(void)
+{
+	uint64_t abstime, ns;
+	
+	clock_get_uptime(&abstime);
+	absolutetime_to_nanoseconds(abstime, &ns);
+	return ns / 1000;
+}
+
+/* Account the time since *t to an attach/resume phase and restart *t. */
+static __inline void
+wpi_phase_mark(struct wpi_softc *sc, int phase, uint64_t *t)
+{
+	uint64_t now = wpi_uptime_us();
+	
+	sc->phase_time[phase] = now - *t;
+	*t = now;
+}
+
 #if 0
 struct cfdriver wpi_cd = {
 	NULL, "wpi", DV_IFNET
@@ -84,6 +107,7 @@ device_attach(void *aux)
 	struct pci_attach_args *pa = (struct pci_attach_args*)aux;
 	pci_intr_handle_t ih;
 	pcireg_t memtype, reg;
+	uint64_t t;
 	int i, error;
 	
 	sc->sc_pct = pa->pa_pc;
@@ -130,6 +154,8 @@ device_attach(void *aux)
 	    fMap->getVirtualAddress(), fMap->getSize()));
 	sc->sc_sh = reinterpret_cast<caddr_t> (fMap->getVirtualAddress());
 	sc->sc_sz = fMap->getSize();
+	
+	wpi_notif_init();
 
 	/* Install interrupt handler. */
 	fInterrupt = IOInterruptEventSource::interruptEventSource(this, OSMemberFunctionCast(IOInterruptEventSource::Action, this, &VoodooIntel3945::wpi_intr));
@@ -147,16 +173,20 @@ device_attach(void *aux)
 	fInterrupt->enable();
 	
 	/* Power ON adapter. */
+	t = wpi_uptime_us();
 	if ((error = wpi_apm_init(sc)) != 0) {
 		printf(": could not power ON adapter\n");
 		return false;
 	}
+	wpi_phase_mark(sc, WPI_PHASE_APM, &t);
 	
 	/* Read MAC address, channels, etc from EEPROM. */
 	if ((error = wpi_read_eeprom(sc)) != 0) {
 		printf(": could not read EEPROM\n");
 		return false;
 	}
+	wpi_txpower_init(sc);
+	wpi_phase_mark(sc, WPI_PHASE_EEPROM, &t);
 	
 	/* Allocate DMA memory for firmware transfers. */
 	if ((error = wpi_alloc_fwmem(sc)) != 0) {
@@ -178,6 +208,12 @@ device_attach(void *aux)
 		}
 	}
 	
+	/* Allocate host command buffers. */
+	if ((error = wpi_alloc_cmd_pool(sc)) != 0) {
+		printf(": could not allocate command buffers\n");
+		goto fail2;
+	}
+	
 	/* Allocate RX ring. */
 	if ((error = wpi_alloc_rx_ring(sc, &sc->rxq)) != 0) {
 		printf(": could not allocate Rx ring\n");
@@ -188,6 +224,7 @@ device_attach(void *aux)
 	wpi_apm_stop(sc);
 	/* Clear pending interrupts. */
 	WPI_WRITE(sc, WPI_INT, 0xffffffff);
+	wpi_phase_mark(sc, WPI_PHASE_DMA, &t);
 	
 	ic->ic_phytype = IEEE80211_T_OFDM;	/* not only, but not used */
 	ic->ic_opmode = IEEE80211_M_STA;	/* default to BSS mode */
@@ -224,6 +261,8 @@ device_attach(void *aux)
 	bcopy("voodoo3945\0", sc->sc_dev.dv_xname, IFNAMSIZ);
 	
 	ieee80211_media_init(&sc->sc_ic); // TODO: define media_change and media_status overloaded functions
+	wpi_phase_mark(sc, WPI_PHASE_IFATTACH, &t);
+	wpi_phase_stats(sc, WPI_PHASE_APM, WPI_PHASE_IFATTACH);
 	
 	sc->amrr.amrr_min_success_threshold =  1;
 	sc->amrr.amrr_max_success_threshold = 15;
@@ -232,7 +271,8 @@ device_attach(void *aux)
 	return true;
 	
 	/* Free allocated memory if something failed during attachment. */
-fail2:	while (--i >= 0)
+fail2:	wpi_free_cmd_pool(sc);
+	while (--i >= 0)
 	wpi_free_tx_ring(sc, &sc->txq[i]);
 	wpi_free_shared(sc);
 fail1:	wpi_free_fwmem(sc);
@@ -246,6 +286,8 @@ device_detach(int flags)
 	int qid;
 	
 	timeout_del(sc->calib_to);
+	wpi_notif_stats(sc);
+	wpi_poll_stats(sc);
 	
 	/* Uninstall interrupt handler. */
 	if (fInterrupt != 0) {
@@ -258,6 +300,7 @@ device_detach(int flags)
 	wpi_free_rx_ring(sc, &sc->rxq);
 	for (qid = 0; qid < WPI_NTXQUEUES; qid++)
 		wpi_free_tx_ring(sc, &sc->txq[qid]);
+	wpi_free_cmd_pool(sc);
 	wpi_free_shared(sc);
 	wpi_free_fwmem(sc);
 	
@@ -291,6 +334,7 @@ wpi_resume()
 {
 	struct wpi_softc *sc = &fSelfData;
 	pcireg_t reg;
+	uint64_t t;
 	int s, count = 20;
 	
 	/* Clear device-specific "PCI retry timeout" register (41h). */
@@ -303,8 +347,11 @@ wpi_resume()
 		tsleep(&sc->sc_flags, 0, "wpipwr", 0);
 	sc->sc_flags |= WPI_FLAG_BUSY;
 	
+	t = wpi_uptime_us();
 	//if (getInterface()->getFlags() & IFF_UP)
 		wpi_init();
+	wpi_phase_mark(sc, WPI_PHASE_INIT, &t);
+	wpi_phase_stats(sc, WPI_PHASE_INIT, WPI_PHASE_INIT);
 	
 	sc->sc_flags &= ~WPI_FLAG_BUSY;
 	wakeupOn(&sc->sc_flags);
@@ -314,20 +361,13 @@ wpi_resume()
 int VoodooIntel3945::
 wpi_nic_lock(struct wpi_softc *sc)
 {
-	int ntries;
-	
 	/* Request exclusive access to NIC. */
 	WPI_SETBITS(sc, WPI_GP_CNTRL, WPI_GP_CNTRL_MAC_ACCESS_REQ);
 	
 	/* Spin until we actually get the lock. */
-	for (ntries = 0; ntries < 1000; ntries++) {
-		if ((WPI_READ(sc, WPI_GP_CNTRL) &
-		     (WPI_GP_CNTRL_MAC_ACCESS_ENA | WPI_GP_CNTRL_SLEEP)) ==
-		    WPI_GP_CNTRL_MAC_ACCESS_ENA)
-			return 0;
-		IODelay(10);
-	}
-	return ETIMEDOUT;
+	return wpi_poll(sc, WPI_POLL_NIC_LOCK, WPI_GP_CNTRL,
+			WPI_GP_CNTRL_MAC_ACCESS_ENA | WPI_GP_CNTRL_SLEEP,
+			WPI_GP_CNTRL_MAC_ACCESS_ENA, 10000);
 }
 
 static __inline void
@@ -364,12 +404,21 @@ wpi_prph_clrbits(struct wpi_softc *sc, uint32_t addr, uint32_t mask)
 	wpi_prph_write(sc, addr, wpi_prph_read(sc, addr) & ~mask);
 }
 
+/*
+ * The PRPH port does not auto-increment so every word needs its own address
+ * write, but device memory is uncached and accesses to it are not reordered:
+ * the write barrier wpi_prph_write() issues between the address and the data
+ * is not needed when streaming a region.
+ */
 static __inline void
 wpi_prph_write_region_4(struct wpi_softc *sc, uint32_t addr,
 			const uint32_t *data, int count)
 {
-	for (; count > 0; count--, data++, addr += 4)
-		wpi_prph_write(sc, addr, *data);
+	for (; count > 0; count--, data++, addr += 4) {
+		WPI_WRITE(sc, WPI_PRPH_WADDR, WPI_PRPH_DWORD | addr);
+		WPI_WRITE(sc, WPI_PRPH_WDATA, *data);
+	}
+	WPI_BARRIER_WRITE(sc);
 }
 
 static __inline uint32_t
@@ -388,12 +437,146 @@ wpi_mem_write(struct wpi_softc *sc, uint32_t addr, uint32_t data)
 	WPI_WRITE(sc, WPI_MEM_WDATA, data);
 }
 
+/*
+ * The target memory port auto-increments: once WPI_MEM_RADDR/WPI_MEM_WADDR
+ * is set, every read of the data register moves on to the next word.
+ */
 static __inline void
 wpi_mem_read_region_4(struct wpi_softc *sc, uint32_t addr, uint32_t *data,
 		      int count)
 {
-	for (; count > 0; count--, addr += 4)
-		*data++ = wpi_mem_read(sc, addr);
+	WPI_WRITE(sc, WPI_MEM_RADDR, addr);
+	WPI_BARRIER_READ_WRITE(sc);
+	for (; count > 0; count--)
+		*data++ = WPI_READ(sc, WPI_MEM_RDATA);
+}
+
+/*
+ * Register wait sites.  Waits are polled with exponential backoff, starting
+ * 1us apart and settling at WPI_POLL_BACKOFF_MAX.  Sites only reached from
+ * thread context stop spinning after WPI_POLL_SPIN_LIMIT and yield the CPU
+ * between reads instead.
+ */
+#define WPI_POLL_BACKOFF_MAX	64	/* us */
+#define WPI_POLL_SPIN_LIMIT	200	/* us */
+
+static const struct {
+	const char	*name;
+	int		prph;	/* register is behind the PRPH port */
+	int		sleep;	/* may sleep once past the spin limit */
+} wpi_poll_sites[WPI_POLL_NSITES] = {
+	{ "nic lock",		0, 0 },
+	{ "eeprom",		0, 0 },
+	{ "clock",		0, 1 },
+	{ "power source",	0, 1 },
+	{ "bootcode",		1, 0 },
+	{ "stop master",	0, 0 }
+};
+
+/*
+ * Wait at most timo microseconds for (reg & mask) == bits.
+ */
+int VoodooIntel3945::
+wpi_poll(struct wpi_softc *sc, int site, uint32_t reg, uint32_t mask,
+	 uint32_t bits, int timo)
+{
+	uint64_t start, elapsed;
+	uint32_t val, delay = 1;
+	int error = 0;
+	
+	start = wpi_uptime_us();
+	for (;;) {
+		val = wpi_poll_sites[site].prph ?
+		    wpi_prph_read(sc, reg) : WPI_READ(sc, reg);
+		if ((val & mask) == bits)
+			break;
+		elapsed = wpi_uptime_us() - start;
+		if (elapsed >= (uint64_t)timo) {
+			error = ETIMEDOUT;
+			break;
+		}
+		if (wpi_poll_sites[site].sleep &&
+		    elapsed >= WPI_POLL_SPIN_LIMIT) {
+			IOSleep(1);
+		} else {
+			IODelay(delay);
+			if (delay < WPI_POLL_BACKOFF_MAX)
+				delay <<= 1;
+		}
+	}
+	
+	elapsed = wpi_uptime_us() - start;
+	sc->poll_waits[site]++;
+	sc->poll_total[site] += elapsed;
+	if (elapsed > sc->poll_max[site])
+		sc->poll_max[site] = (uint32_t)elapsed;
+	if (error != 0)
+		sc->poll_timeouts[site]++;
+	return error;
+}
+
+void VoodooIntel3945::
+wpi_poll_stats(struct wpi_softc *sc)
+{
+	int i;
+	
+	for (i = 0; i < WPI_POLL_NSITES; i++) {
+		if (sc->poll_waits[i] == 0)
+			continue;
+		DPRINTF(("%s: wait %s: %u waits, %u timeouts, max %uus, "
+			 "%lluus total\n", sc->sc_dev.dv_xname,
+			 wpi_poll_sites[i].name, sc->poll_waits[i],
+			 sc->poll_timeouts[i], sc->poll_max[i],
+			 sc->poll_total[i]));
+	}
+}
+
+static_assert(WPI_POLL_NSITES * WPI_POLL_NSTATS <= VOODOO80211_HW_STATS_MAX,
+    "Too many wait statistics to export");
+
+/*
+ * Only the workloop updates the wait statistics.  The sysctl reads them
+ * without the gate, aligned 32 and 64 bit loads cannot tear on x86_64.
+ */
+IOReturn VoodooIntel3945::
+device_hw_stats(struct voodoo80211_hw_stats_data *data)
+{
+	struct wpi_softc *sc = &fSelfData;
+	u_int64_t *counters = data->counters;
+	int i;
+	
+	for (i = 0; i < WPI_POLL_NSITES; i++) {
+		counters[WPI_POLL_STAT_WAITS] = sc->poll_waits[i];
+		counters[WPI_POLL_STAT_TIMEOUTS] = sc->poll_timeouts[i];
+		counters[WPI_POLL_STAT_MAX] = sc->poll_max[i];
+		counters[WPI_POLL_STAT_TOTAL] = sc->poll_total[i];
+		counters += WPI_POLL_NSTATS;
+	}
+	data->count = WPI_POLL_NSITES * WPI_POLL_NSTATS;
+	return kIOReturnSuccess;
+}
+
+static const char * const wpi_phase_names[WPI_PHASE_NPHASES] = {
+	"power on",
+	"EEPROM",
+	"DMA setup",
+	"net80211 attach",
+	"init"
+};
+
+void VoodooIntel3945::
+wpi_phase_stats(struct wpi_softc *sc, int first, int last)
+{
+	uint32_t total = 0;
+	int i;
+	
+	for (i = first; i <= last; i++) {
+		DPRINTF(("%s: %s: %uus\n", sc->sc_dev.dv_xname,
+			 wpi_phase_names[i], sc->phase_time[i]));
+		total += sc->phase_time[i];
+	}
+	DPRINTF(("%s: %s took %uus\n", sc->sc_dev.dv_xname,
+		 first == WPI_PHASE_APM ? "attach" : "resume", total));
 }
 
 int VoodooIntel3945::
@@ -401,7 +584,7 @@ wpi_read_prom_data(struct wpi_softc *sc, uint32_t addr, void *data, int count)
 {
 	uint8_t *out = (uint8_t*)data;
 	uint32_t val;
-	int error, ntries;
+	int error;
 	
 	if ((error = wpi_nic_lock(sc)) != 0)
 		return error;
@@ -410,17 +593,15 @@ wpi_read_prom_data(struct wpi_softc *sc, uint32_t addr, void *data, int count)
 		WPI_WRITE(sc, WPI_EEPROM, addr << 2);
 		WPI_CLRBITS(sc, WPI_EEPROM, WPI_EEPROM_CMD);
 		
-		for (ntries = 0; ntries < 10; ntries++) {
-			val = WPI_READ(sc, WPI_EEPROM);
-			if (val & WPI_EEPROM_READ_VALID)
-				break;
-			IODelay(5);
-		}
-		if (ntries == 10) {
+		error = wpi_poll(sc, WPI_POLL_EEPROM, WPI_EEPROM,
+				 WPI_EEPROM_READ_VALID, WPI_EEPROM_READ_VALID, 50);
+		if (error != 0) {
 			printf("%s: could not read EEPROM\n",
 			       sc->sc_dev.dv_xname);
-			return ETIMEDOUT;
+			wpi_nic_unlock(sc);
+			return error;
 		}
+		val = WPI_READ(sc, WPI_EEPROM);
 		*out++ = val >> 16;
 		if (count > 1)
 			*out++ = val >> 24;
@@ -630,6 +811,7 @@ wpi_alloc_tx_ring(struct wpi_softc *sc, struct wpi_tx_ring *ring, int qid)
 		struct wpi_tx_data *data = &ring->data[i];
 		
 		data->cmd_paddr = paddr;
+		data->cmd_pool = -1;
 		paddr += sizeof (struct wpi_tx_cmd);
 		
 		error = bus_dmamap_create(sc->sc_dmat, MCLBYTES,
@@ -659,12 +841,23 @@ wpi_reset_tx_ring(struct wpi_softc *sc, struct wpi_tx_ring *ring)
 			mbuf_freem(data->m);
 			data->m = NULL;
 		}
+		data->cmd_cb = NULL;
+		data->cmd_pool = -1;
+		data->cmd_busy = 0;
 	}
 	/* Clear TX descriptors. */
 	memset(ring->desc, 0, ring->desc_dma.size);
 	sc->qfullmsk &= ~(1 << ring->qid);
 	ring->queued = 0;
 	ring->cur = 0;
+	
+	if (ring->qid == 4) {
+		/* Commands in flight will never be acked, release waiters. */
+		sc->cmd_pool_free = (1 << WPI_CMD_POOL_COUNT) - 1;
+		sc->cmd_pending = 0;
+		sc->cmd_queued = 0;
+		wakeupOn(&sc->cmd_pending);
+	}
 }
 
 void VoodooIntel3945::
@@ -686,12 +879,35 @@ wpi_free_tx_ring(struct wpi_softc *sc, struct wpi_tx_ring *ring)
 	}
 }
 
+int VoodooIntel3945::
+wpi_alloc_cmd_pool(struct wpi_softc *sc)
+{
+	int error;
+	
+	error = wpi_dma_contig_alloc(sc->sc_dmat, &sc->cmd_pool_dma, NULL,
+				     WPI_CMD_POOL_COUNT * WPI_CMD_POOL_BUFSZ, 4);
+	if (error != 0)
+		return error;
+	sc->cmd_pool_free = (1 << WPI_CMD_POOL_COUNT) - 1;
+	return 0;
+}
+
+void VoodooIntel3945::
+wpi_free_cmd_pool(struct wpi_softc *sc)
+{
+	wpi_dma_contig_free(&sc->cmd_pool_dma);
+	sc->cmd_pool_free = 0;
+}
+
+/*
+ * Read everything we need from EEPROM into the cache and parse it.
+ */
 int VoodooIntel3945::
 wpi_read_eeprom(struct wpi_softc *sc)
 {
-	struct ieee80211com *ic = &sc->sc_ic;
-	char domain[4];
-	int i;
+	struct wpi_eeprom_cache *cache = &sc->eeprom;
+	const struct wpi_chan_band *band;
+	int i, error;
 	
 	if ((WPI_READ(sc, WPI_EEPROM_GP) & 0x6) == 0) {
 		printf("%s: bad EEPROM signature\n", sc->sc_dev.dv_xname);
@@ -700,43 +916,79 @@ wpi_read_eeprom(struct wpi_softc *sc)
 	/* Clear HW ownership of EEPROM. */
 	WPI_CLRBITS(sc, WPI_EEPROM_GP, WPI_EEPROM_GP_IF_OWNER);
 	
-	wpi_read_prom_data(sc, WPI_EEPROM_CAPABILITIES, &sc->cap, 1);
-	wpi_read_prom_data(sc, WPI_EEPROM_REVISION, &sc->rev, 2);
-	wpi_read_prom_data(sc, WPI_EEPROM_TYPE, &sc->type, 1);
+	memset(cache, 0, sizeof *cache);
+	if ((error = wpi_read_prom_data(sc, WPI_EEPROM_CAPABILITIES,
+					&cache->cap, 1)) != 0 ||
+	    (error = wpi_read_prom_data(sc, WPI_EEPROM_REVISION,
+					&cache->rev, 2)) != 0 ||
+	    (error = wpi_read_prom_data(sc, WPI_EEPROM_TYPE,
+					&cache->type, 1)) != 0 ||
+	    (error = wpi_read_prom_data(sc, WPI_EEPROM_DOMAIN,
+					cache->domain, 4)) != 0 ||
+	    (error = wpi_read_prom_data(sc, WPI_EEPROM_MAC,
+					cache->macaddr, IEEE80211_ADDR_LEN)) != 0)
+		return error;
+	
+	/* Read the list of authorized channels. */
+	for (i = 0; i < WPI_CHAN_BANDS_COUNT; i++) {
+		band = &wpi_bands[i];
+		error = wpi_read_prom_data(sc, band->addr, cache->chans[i],
+		    band->nchan * sizeof (struct wpi_eeprom_chan));
+		if (error != 0)
+			return error;
+	}
+	
+	/* Read the list of TX power groups. */
+	for (i = 0; i < WPI_POWER_GROUPS_COUNT; i++) {
+		error = wpi_read_prom_data(sc, WPI_EEPROM_POWER_GRP + i * 32,
+		    &cache->groups[i], sizeof (struct wpi_eeprom_group));
+		if (error != 0)
+			return error;
+	}
+	
+	/* Print regulatory domain (4 ASCII characters.) */
+	printf(", %.4s", cache->domain);
+	
+	wpi_apply_eeprom(sc);
+	return 0;
+}
+
+/*
+ * Set MAC address, channels and TX power groups from the EEPROM cache.
+ */
+void VoodooIntel3945::
+wpi_apply_eeprom(struct wpi_softc *sc)
+{
+	struct ieee80211com *ic = &sc->sc_ic;
+	struct wpi_eeprom_cache *cache = &sc->eeprom;
+	int i;
+	
+	sc->cap = cache->cap;
+	sc->rev = cache->rev;
+	sc->type = cache->type;
 	
 	DPRINTF(("cap=%x rev=%x type=%x\n", sc->cap, letoh16(sc->rev),
 		 sc->type));
 	
-	/* Read and print regulatory domain (4 ASCII characters.) */
-	wpi_read_prom_data(sc, WPI_EEPROM_DOMAIN, domain, 4);
-	printf(", %.4s", domain);
-	
-	/* Read and print MAC address. */
-	wpi_read_prom_data(sc, WPI_EEPROM_MAC, ic->ic_myaddr, 6);
+	/* Set MAC address. */
+	IEEE80211_ADDR_COPY(ic->ic_myaddr, cache->macaddr);
 	// TODO printf(", address %s\n", ether_sprintf(ic->ic_myaddr));
 	
-	/* Read the list of authorized channels. */
 	for (i = 0; i < WPI_CHAN_BANDS_COUNT; i++)
-		wpi_read_eeprom_channels(sc, i);
+		wpi_parse_eeprom_channels(sc, i);
 	
-	/* Read the list of TX power groups. */
 	for (i = 0; i < WPI_POWER_GROUPS_COUNT; i++)
-		wpi_read_eeprom_group(sc, i);
-	
-	return 0;
+		wpi_parse_eeprom_group(sc, i);
 }
 
 void VoodooIntel3945::
-wpi_read_eeprom_channels(struct wpi_softc *sc, int n)
+wpi_parse_eeprom_channels(struct wpi_softc *sc, int n)
 {
 	struct ieee80211com *ic = &sc->sc_ic;
 	const struct wpi_chan_band *band = &wpi_bands[n];
-	struct wpi_eeprom_chan channels[WPI_MAX_CHAN_PER_BAND];
+	const struct wpi_eeprom_chan *channels = sc->eeprom.chans[n];
 	int chan, i;
 	
-	wpi_read_prom_data(sc, band->addr, channels,
-			   band->nchan * sizeof (struct wpi_eeprom_chan));
-	
 	for (i = 0; i < band->nchan; i++) {
 		if (!(channels[i].flags & WPI_EEPROM_CHAN_VALID))
 			continue;
@@ -780,27 +1032,24 @@ wpi_read_eeprom_channels(struct wpi_softc *sc, int n)
 }
 
 void VoodooIntel3945::
-wpi_read_eeprom_group(struct wpi_softc *sc, int n)
+wpi_parse_eeprom_group(struct wpi_softc *sc, int n)
 {
 	struct wpi_power_group *group = &sc->groups[n];
-	struct wpi_eeprom_group rgroup;
+	const struct wpi_eeprom_group *rgroup = &sc->eeprom.groups[n];
 	int i;
 	
-	wpi_read_prom_data(sc, WPI_EEPROM_POWER_GRP + n * 32, &rgroup,
-			   sizeof rgroup);
-	
 	/* Save TX power group information. */
-	group->chan   = rgroup.chan;
-	group->maxpwr = rgroup.maxpwr;
+	group->chan   = rgroup->chan;
+	group->maxpwr = rgroup->maxpwr;
 	/* Retrieve temperature at which the samples were taken. */
-	group->temp   = (int16_t)letoh16(rgroup.temp);
+	group->temp   = (int16_t)letoh16(rgroup->temp);
 	
 	DPRINTF(("power group %d: chan=%d maxpwr=%d temp=%d\n", n,
 		 group->chan, group->maxpwr, group->temp));
 	
 	for (i = 0; i < WPI_SAMPLES_COUNT; i++) {
-		group->samples[i].index = rgroup.samples[i].index;
-		group->samples[i].power = rgroup.samples[i].power;
+		group->samples[i].index = rgroup->samples[i].index;
+		group->samples[i].power = rgroup->samples[i].power;
 		
 		DPRINTF(("\tsample %d: index=%d power=%d\n", i,
 			 group->samples[i].index, group->samples[i].power));
@@ -1019,6 +1268,8 @@ wpi_rx_done(struct wpi_softc *sc, struct wpi_rx_desc *desc,
 	uint32_t flags;
 	int error;
 	
+	latencyProbe(VOODOO80211_PROBE_RXDESC);
+	
 	stat = (struct wpi_rx_stat *)(desc + 1);
 	
 	if (stat->len > WPI_STAT_MAXLEN) {
@@ -1159,132 +1410,239 @@ wpi_cmd_done(struct wpi_softc *sc, struct wpi_rx_desc *desc)
 {
 	struct wpi_tx_ring *ring = &sc->txq[4];
 	struct wpi_tx_data *data;
+	wpi_cmd_cb_t cb;
 	
 	if ((desc->qid & 7) != 4)
 		return;	/* Not a command ack. */
 	
 	data = &ring->data[desc->idx];
+	if (!data->cmd_busy)
+		return;	/* Reclaimed after a timeout, already accounted for. */
+	data->cmd_busy = 0;
 	
-	/* If the command was mapped in an mbuf, free it. */
-	if (data->m != NULL) {
-		mbuf_freem(data->m);
-		data->m = NULL;
+	/* If the command was copied to a pool buffer, release it. */
+	if (data->cmd_pool >= 0) {
+		sc->cmd_pool_free |= 1 << data->cmd_pool;
+		data->cmd_pool = -1;
+	}
+	if ((cb = data->cmd_cb) != NULL) {
+		data->cmd_cb = NULL;
+		(*cb)(sc, data->cmd_arg, desc);
 	}
 	wakeupOn(&ring->cmd[desc->idx]);
+	
+	if (sc->cmd_pending > 0 && --sc->cmd_pending == 0)
+		wakeupOn(&sc->cmd_pending);
 }
 
+/*
+ * Handlers for the notifications we care about, indexed through fNotifSlot
+ * by descriptor type.  A non-zero return stops processing of the ring.
+ */
+const struct VoodooIntel3945::wpi_notif_handler
+VoodooIntel3945::wpi_notif_handlers[WPI_NOTIF_NSLOTS] = {
+	{ 0,			NULL,					"other" },
+	{ WPI_RX_DONE,		&VoodooIntel3945::wpi_notif_rx_done,	"rx done" },
+	{ WPI_TX_DONE,		&VoodooIntel3945::wpi_notif_tx_done,	"tx done" },
+	{ WPI_UC_READY,		&VoodooIntel3945::wpi_notif_uc_ready,	"uc ready" },
+	{ WPI_STATE_CHANGED,	&VoodooIntel3945::wpi_notif_state_changed, "state changed" },
+	{ WPI_START_SCAN,	&VoodooIntel3945::wpi_notif_start_scan,	"start scan" },
+	{ WPI_STOP_SCAN,	&VoodooIntel3945::wpi_notif_stop_scan,	"stop scan" }
+};
+
 void VoodooIntel3945::
-wpi_notif_intr(struct wpi_softc *sc)
+wpi_notif_init()
+{
+	int i;
+	
+	memset(fNotifSlot, WPI_NOTIF_OTHER, sizeof fNotifSlot);
+	for (i = 1; i < WPI_NOTIF_NSLOTS; i++)
+		fNotifSlot[wpi_notif_handlers[i].type] = i;
+}
+
+int VoodooIntel3945::
+wpi_notif_rx_done(struct wpi_softc *sc, struct wpi_rx_desc *desc,
+		  struct wpi_rx_data *data)
+{
+	/* An 802.11 frame has been received. */
+	wpi_rx_done(sc, desc, data);
+	return 0;
+}
+
+int VoodooIntel3945::
+wpi_notif_tx_done(struct wpi_softc *sc, struct wpi_rx_desc *desc,
+		  struct wpi_rx_data *data)
+{
+	/* An 802.11 frame has been transmitted. */
+	wpi_tx_done(sc, desc);
+	return 0;
+}
+
+int VoodooIntel3945::
+wpi_notif_uc_ready(struct wpi_softc *sc, struct wpi_rx_desc *desc,
+		   struct wpi_rx_data *data)
+{
+	struct wpi_ucode_info *uc = (struct wpi_ucode_info *)(desc + 1);
+	
+	/* The microcontroller is ready. */
+	DPRINTF(("microcode alive notification version %x alive %x\n",
+		 letoh32(uc->version), letoh32(uc->valid)));
+	
+	if (letoh32(uc->valid) != 1) {
+		printf("%s: microcontroller initialization failed\n",
+		       sc->sc_dev.dv_xname);
+	}
+	if (uc->subtype != WPI_UCODE_INIT) {
+		/* Save the address of the error log. */
+		sc->errptr = letoh32(uc->errptr);
+	}
+	return 0;
+}
+
+int VoodooIntel3945::
+wpi_notif_state_changed(struct wpi_softc *sc, struct wpi_rx_desc *desc,
+			struct wpi_rx_data *data)
+{
+	uint32_t *status = (uint32_t *)(desc + 1);
+	
+	/* Enabled/disabled notification. */
+	DPRINTF(("state changed to %x\n", letoh32(*status)));
+	
+	if (letoh32(*status) & 1) {
+		/* The radio button has to be pushed. */
+		printf("%s: Radio transmitter is off\n", sc->sc_dev.dv_xname);
+		/* Turn the interface down. */
+		// XXX ifp->if_flags &= ~IFF_UP;
+		getInterface()->setLinkState(kIO80211NetworkLinkDown, 0);
+		wpi_stop(1);
+		return 1;	/* No further processing. */
+	}
+	return 0;
+}
+
+int VoodooIntel3945::
+wpi_notif_start_scan(struct wpi_softc *sc, struct wpi_rx_desc *desc,
+		     struct wpi_rx_data *data)
 {
 	struct ieee80211com *ic = &sc->sc_ic;
-	uint32_t hw;
+	struct wpi_start_scan *scan = (struct wpi_start_scan *)(desc + 1);
 	
-	hw = letoh32(sc->shared->next);
-	while (sc->rxq.cur != hw) {
-		struct wpi_rx_data *data = &sc->rxq.data[sc->rxq.cur];
-		struct wpi_rx_desc *desc;
+	DPRINTF(("scanning channel %d status %x\n",
+		 scan->chan, letoh32(scan->status)));
+	
+	/* Fix current channel. */
+	ic->ic_bss->ni_chan = &ic->ic_channels[scan->chan];
+	return 0;
+}
 
-		desc = mtod(data->m, struct wpi_rx_desc *);
-		
-		DPRINTF(("rx notification qid=%x idx=%d flags=%x type=%d "
-			     "len=%d\n", desc->qid, desc->idx, desc->flags, desc->type,
-			     letoh32(desc->len)));
-		
-		if (!(desc->qid & 0x80))	/* Reply to a command. */
-			wpi_cmd_done(sc, desc);
-		
-		switch (desc->type) {
-			case WPI_RX_DONE:
-				/* An 802.11 frame has been received. */
-				wpi_rx_done(sc, desc, data);
-				break;
-				
-			case WPI_TX_DONE:
-				/* An 802.11 frame has been transmitted. */
-				wpi_tx_done(sc, desc);
-				break;
-				
-			case WPI_UC_READY:
-			{
-				struct wpi_ucode_info *uc =
-				(struct wpi_ucode_info *)(desc + 1);
-				
-				/* The microcontroller is ready. */
-				DPRINTF(("microcode alive notification version %x "
-					 "alive %x\n", letoh32(uc->version),
-					 letoh32(uc->valid)));
-				
-				if (letoh32(uc->valid) != 1) {
-					printf("%s: microcontroller initialization "
-					       "failed\n", sc->sc_dev.dv_xname);
-				}
-				if (uc->subtype != WPI_UCODE_INIT) {
-					/* Save the address of the error log. */
-					sc->errptr = letoh32(uc->errptr);
-				}
-				break;
-			}
-			case WPI_STATE_CHANGED:
-			{
-				uint32_t *status = (uint32_t *)(desc + 1);
-				
-				/* Enabled/disabled notification. */
-				DPRINTF(("state changed to %x\n", letoh32(*status)));
-				
-				if (letoh32(*status) & 1) {
-					/* The radio button has to be pushed. */
-					printf("%s: Radio transmitter is off\n",
-					       sc->sc_dev.dv_xname);
-					/* Turn the interface down. */
-					// XXX ifp->if_flags &= ~IFF_UP;
-					getInterface()->setLinkState(kIO80211NetworkLinkDown, 0);
-					wpi_stop(1);
-					return;	/* No further processing. */
-				}
-				break;
-			}
-			case WPI_START_SCAN:
-			{
-				struct wpi_start_scan *scan =
-				(struct wpi_start_scan *)(desc + 1);
-				
-				DPRINTF(("scanning channel %d status %x\n",
-					     scan->chan, letoh32(scan->status)));
-				
-				/* Fix current channel. */
-				ic->ic_bss->ni_chan = &ic->ic_channels[scan->chan];
-				break;
+int VoodooIntel3945::
+wpi_notif_stop_scan(struct wpi_softc *sc, struct wpi_rx_desc *desc,
+		    struct wpi_rx_data *data)
+{
+	struct ieee80211com *ic = &sc->sc_ic;
+	struct wpi_stop_scan *scan = (struct wpi_stop_scan *)(desc + 1);
+	
+	DPRINTF(("scan finished nchan=%d status=%d chan=%d\n",
+		 scan->nchan, scan->status, scan->chan));
+	
+	if (scan->status == 1 && scan->chan <= 14 &&
+	    (sc->sc_flags & WPI_FLAG_HAS_5GHZ)) {
+		/*
+		 * We just finished scanning 2GHz channels,
+		 * start scanning 5GHz ones.
+		 */
+		if (wpi_scan(sc, IEEE80211_CHAN_5GHZ) == 0)
+			return 0;
+	}
+	ieee80211_end_scan(ic);
+	return 0;
+}
+
+void VoodooIntel3945::
+wpi_notif_intr(struct wpi_softc *sc)
+{
+	struct wpi_rx_ring *ring = &sc->rxq;
+	uint64_t start, end;
+	uint32_t hw, ndesc = 0;
+	int next, slot, stop = 0;
+	
+	hw = letoh32(sc->shared->next);
+	while (ring->cur != hw && !stop) {
+		do {
+			struct wpi_rx_data *data = &ring->data[ring->cur];
+			struct wpi_rx_desc *desc;
+			
+			/* Pull in the next descriptor while this one is handled. */
+			next = (ring->cur + 1) % WPI_RX_RING_COUNT;
+			if (next != hw) {
+				__builtin_prefetch(&ring->data[next]);
+				__builtin_prefetch(mtod(ring->data[next].m, void *));
 			}
-			case WPI_STOP_SCAN:
-			{
-				struct wpi_stop_scan *scan =
-				(struct wpi_stop_scan *)(desc + 1);
-				
-				DPRINTF(("scan finished nchan=%d status=%d chan=%d\n",
-					 scan->nchan, scan->status, scan->chan));
-				
-				if (scan->status == 1 && scan->chan <= 14 &&
-				    (sc->sc_flags & WPI_FLAG_HAS_5GHZ)) {
-					/*
-					 * We just finished scanning 2GHz channels,
-					 * start scanning 5GHz ones.
-					 */
-					if (wpi_scan(sc, IEEE80211_CHAN_5GHZ) == 0)
-						break;
-				}
-				ieee80211_end_scan(ic);
+			
+			desc = mtod(data->m, struct wpi_rx_desc *);
+			
+			DPRINTF(("rx notification qid=%x idx=%d flags=%x type=%d "
+				 "len=%d\n", desc->qid, desc->idx, desc->flags,
+				 desc->type, letoh32(desc->len)));
+			
+			if (!(desc->qid & 0x80))	/* Reply to a command. */
+				wpi_cmd_done(sc, desc);
+			
+			slot = fNotifSlot[desc->type];
+			clock_get_uptime(&start);
+			if (slot != WPI_NOTIF_OTHER)
+				stop = (this->*wpi_notif_handlers[slot].handler)(sc,
+				    desc, data);
+			clock_get_uptime(&end);
+			sc->notif_count[slot]++;
+			sc->notif_time[slot] += end - start;
+			ndesc++;
+			
+			if (stop)
 				break;
-			}
-		}
+			ring->cur = next;
+		} while (ring->cur != hw);
 		
-		sc->rxq.cur = (sc->rxq.cur + 1) % WPI_RX_RING_COUNT;
+		/* Pick up descriptors that arrived while we were busy. */
+		if (!stop)
+			hw = letoh32(sc->shared->next);
+	}
+	
+	if (ndesc != 0) {
+		sc->notif_intrs++;
+		sc->notif_descs += ndesc;
+		if (ndesc > sc->notif_descs_max)
+			sc->notif_descs_max = ndesc;
 	}
+	if (stop)
+		return;	/* The rings have been reset. */
 	
 	/* Tell the firmware what we have processed. */
 	hw = (hw == 0) ? WPI_RX_RING_COUNT - 1 : hw - 1;
 	WPI_WRITE(sc, WPI_FH_RX_WPTR, hw & ~7);
 }
 
+void VoodooIntel3945::
+wpi_notif_stats(struct wpi_softc *sc)
+{
+	uint64_t ns;
+	int i;
+	
+	if (sc->notif_intrs == 0)
+		return;
+	DPRINTF(("%s: %u notifications in %u interrupts, max %u\n",
+		 sc->sc_dev.dv_xname, sc->notif_descs, sc->notif_intrs,
+		 sc->notif_descs_max));
+	for (i = 0; i < WPI_NOTIF_NSLOTS; i++) {
+		if (sc->notif_count[i] == 0)
+			continue;
+		absolutetime_to_nanoseconds(sc->notif_time[i], &ns);
+		DPRINTF(("%s: %s: %u, %llu us total\n", sc->sc_dev.dv_xname,
+			 wpi_notif_handlers[i].name, sc->notif_count[i],
+			 ns / 1000));
+	}
+}
+
 /*
  * Dump the error log of the firmware when a firmware panic occurs.  Although
  * we can't debug the firmware because it is neither open source nor free, it
@@ -1373,6 +1731,8 @@ wpi_intr(OSObject *ih, IOInterruptEventSource *, int count)
 	if (r1 == 0xffffffff || (r1 & 0xfffffff0) == 0xa5a5a5a0)
 		return 0;	/* Hardware gone! */
 	
+	latencyProbe(VOODOO80211_PROBE_INTR);
+	
 	/* Acknowledge interrupts. */
 	WPI_WRITE(sc, WPI_INT, r1);
 	WPI_WRITE(sc, WPI_FH_INT, r2);
@@ -1780,18 +2140,22 @@ wpi_ioctl(struct ieee80211com *ifp, u_long cmd, caddr_t data)
 }
 
 /*
- * Send a command to the firmware.
+ * Queue a command to the firmware without ringing the doorbell.  The
+ * optional callback is run from wpi_cmd_done() once the firmware acks it.
  */
 int VoodooIntel3945::
-wpi_cmd(struct wpi_softc *sc, int code, const void *buf, int size, int async)
+wpi_cmd_submit(struct wpi_softc *sc, int code, const void *buf, int size,
+	       wpi_cmd_cb_t cb, void *arg)
 {
 	struct wpi_tx_ring *ring = &sc->txq[4];
 	struct wpi_tx_desc *desc;
 	struct wpi_tx_data *data;
 	struct wpi_tx_cmd *cmd;
-	mbuf_t m;
 	bus_addr_t paddr;
-	int totlen, error;
+	int totlen, slot;
+	
+	if (sc->cmd_pending >= WPI_TX_RING_COUNT - 1)
+		return EBUSY;
 	
 	desc = &ring->desc[ring->cur];
 	data = &ring->data[ring->cur];
@@ -1799,30 +2163,24 @@ wpi_cmd(struct wpi_softc *sc, int code, const void *buf, int size, int async)
 	
 	if (size > sizeof cmd->data) {
 		/* Command is too large to fit in a descriptor. */
-		if (totlen > MCLBYTES)
+		if (totlen > WPI_CMD_POOL_BUFSZ)
 			return EINVAL;
-		mbuf_gethdr(MBUF_DONTWAIT, MT_DATA, &m);
-		if (m == NULL)
-			return ENOMEM;
-		if (totlen > mbuf_get_mhlen()) {
-			mbuf_getcluster(MBUF_DONTWAIT, MT_DATA, MCLBYTES, &m);
-			if (!(mbuf_flags(m) & MBUF_EXT)) {
-				mbuf_freem(m);
-				return ENOMEM;
-			}
-		}
-		cmd = mtod(m, struct wpi_tx_cmd *);
-		error = bus_dmamap_load(data->map, m);
-		if (error != 0) {
-			mbuf_freem(m);
-			return error;
-		}
-		data->m = m;
-		paddr = data->map->dm_segs[0].location;
+		if (sc->cmd_pool_free == 0)
+			return ENOBUFS;
+		for (slot = 0; !(sc->cmd_pool_free & (1 << slot)); slot++);
+		sc->cmd_pool_free &= ~(1 << slot);
+		cmd = (struct wpi_tx_cmd *)(sc->cmd_pool_dma.vaddr +
+					    slot * WPI_CMD_POOL_BUFSZ);
+		paddr = sc->cmd_pool_dma.paddr + slot * WPI_CMD_POOL_BUFSZ;
 	} else {
+		slot = -1;
 		cmd = &ring->cmd[ring->cur];
 		paddr = data->cmd_paddr;
 	}
+	data->cmd_pool = slot;
+	data->cmd_cb = cb;
+	data->cmd_arg = arg;
+	data->cmd_busy = 1;
 	
 	cmd->code = code;
 	cmd->flags = 0;
@@ -1834,11 +2192,110 @@ wpi_cmd(struct wpi_softc *sc, int code, const void *buf, int size, int async)
 	desc->segs[0].addr = htole32(paddr);
 	desc->segs[0].len  = htole32(totlen);
 	
-	/* Kick command ring. */
 	ring->cur = (ring->cur + 1) % WPI_TX_RING_COUNT;
+	sc->cmd_pending++;
+	sc->cmd_queued++;
+	return 0;
+}
+
+/*
+ * Kick command ring, handing every queued command to the firmware at once.
+ */
+void VoodooIntel3945::
+wpi_cmd_kick(struct wpi_softc *sc)
+{
+	struct wpi_tx_ring *ring = &sc->txq[4];
+	
+	if (sc->cmd_queued == 0)
+		return;
 	WPI_WRITE(sc, WPI_HBUS_TARG_WRPTR, ring->qid << 8 | ring->cur);
+	sc->cmd_queued = 0;
+}
+
+/*
+ * Give up on a command the firmware did not ack in time: release its pool
+ * buffer and callback and stop counting it as pending.  wpi_cmd_done()
+ * ignores the ack if it shows up later.
+ */
+void VoodooIntel3945::
+wpi_cmd_reclaim(struct wpi_softc *sc, int idx)
+{
+	struct wpi_tx_data *data = &sc->txq[4].data[idx];
 	
-	return async ? 0 : tsleep(cmd, PCATCH, "wpicmd", 1000);
+	if (!data->cmd_busy)
+		return;
+	data->cmd_busy = 0;
+	
+	if (data->cmd_pool >= 0) {
+		sc->cmd_pool_free |= 1 << data->cmd_pool;
+		data->cmd_pool = -1;
+	}
+	data->cmd_cb = NULL;
+	
+	if (sc->cmd_pending > 0 && --sc->cmd_pending == 0)
+		wakeupOn(&sc->cmd_pending);
+}
+
+/*
+ * Wait until the firmware has acked every command submitted so far.
+ */
+int VoodooIntel3945::
+wpi_cmd_wait_all(struct wpi_softc *sc)
+{
+	int i;
+	
+	while (sc->cmd_pending > 0) {
+		if (tsleep(&sc->cmd_pending, PCATCH, "wpicmdq", 1000) != 0) {
+			for (i = 0; i < WPI_TX_RING_COUNT; i++)
+				wpi_cmd_reclaim(sc, i);
+			return ETIMEDOUT;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Commands sent between wpi_cmd_begin() and wpi_cmd_end() share a single
+ * doorbell write; synchronous ones are only waited for in wpi_cmd_end().
+ */
+void VoodooIntel3945::
+wpi_cmd_begin(struct wpi_softc *sc)
+{
+	sc->cmd_batch++;
+}
+
+int VoodooIntel3945::
+wpi_cmd_end(struct wpi_softc *sc, int wait)
+{
+	if (sc->cmd_batch > 0 && --sc->cmd_batch > 0)
+		return 0;
+	wpi_cmd_kick(sc);
+	return wait ? wpi_cmd_wait_all(sc) : 0;
+}
+
+/*
+ * Send a command to the firmware.
+ */
+int VoodooIntel3945::
+wpi_cmd(struct wpi_softc *sc, int code, const void *buf, int size, int async)
+{
+	struct wpi_tx_ring *ring = &sc->txq[4];
+	int idx, error;
+	
+	idx = ring->cur;
+	if ((error = wpi_cmd_submit(sc, code, buf, size, NULL, NULL)) != 0)
+		return error;
+	if (sc->cmd_batch > 0)
+		return 0;
+	
+	wpi_cmd_kick(sc);
+	if (async)
+		return 0;
+	if (tsleep(&ring->cmd[idx], PCATCH, "wpicmd", 1000) != 0) {
+		wpi_cmd_reclaim(sc, idx);
+		return ETIMEDOUT;
+	}
+	return 0;
 }
 
 /*
@@ -1975,6 +2432,46 @@ wpi_power_calibration(struct wpi_softc *sc)
 	}
 }
 
+/*
+ * Build the (channel x rate) TX power table from the EEPROM channel and
+ * power group data, see if_wpi_txpower.h.  Only the temperature
+ * compensation depends on runtime state, wpi_txpower_update() finishes the
+ * table whenever the calibrated temperature changes.
+ */
+static_assert(WPI_PWR_NCHANS == IEEE80211_CHAN_MAX + 1,
+    "TX power table rows are not indexed by IEEE channel number");
+
+void VoodooIntel3945::
+wpi_txpower_init(struct wpi_softc *sc)
+{
+	struct ieee80211com *ic = &sc->sc_ic;
+	struct ieee80211_channel *c;
+	u_int chan;
+	int grp;
+	
+	wpi_txpower_table_init(&sc->pwr);
+	for (chan = 1; chan <= IEEE80211_CHAN_MAX; chan++) {
+		c = &ic->ic_channels[chan];
+		if (c->ic_flags == 0)
+			continue;	/* Not enabled in EEPROM. */
+		grp = wpi_power_group(sc->groups, chan,
+		    IEEE80211_IS_CHAN_5GHZ(c));
+		if (wpi_txpower_table_add(&sc->pwr, sc->groups, chan, grp,
+		    sc->maxpwr[chan], IEEE80211_IS_CHAN_2GHZ(c)) < 0)
+			break;
+	}
+}
+
+/*
+ * Bring the TX power table to the current calibration temperature.
+ */
+void VoodooIntel3945::
+wpi_txpower_update(struct wpi_softc *sc)
+{
+	wpi_txpower_table_update(&sc->pwr, sc->groups, sc->temp);
+	DPRINTF(("TX power table updated for temperature %d\n", sc->temp));
+}
+
 /*
  * Set TX power for current channel (each rate has its own power settings).
  */
@@ -1983,122 +2480,33 @@ wpi_set_txpower(struct wpi_softc *sc, int async)
 {
 	struct ieee80211com *ic = &sc->sc_ic;
 	struct ieee80211_channel *ch;
-	struct wpi_power_group *group;
 	struct wpi_cmd_txpower cmd;
 	u_int chan;
-	int idx, i;
+	int row, i;
 	
 	/* Retrieve current channel from last RXON. */
 	chan = sc->rxon.chan;
 	DPRINTF(("setting TX power for channel %d\n", chan));
 	ch = &ic->ic_channels[chan];
 	
-	/* Find the TX power group to which this channel belongs. */
-	if (IEEE80211_IS_CHAN_5GHZ(ch)) {
-		for (group = &sc->groups[1]; group < &sc->groups[4]; group++)
-			if (chan <= group->chan)
-				break;
-	} else
-		group = &sc->groups[0];
+	if ((row = sc->pwr.row[chan]) == 0xff)
+		return EINVAL;
+	if (!sc->pwr.valid || sc->pwr.temp != sc->temp)
+		wpi_txpower_update(sc);
 	
 	memset(&cmd, 0, sizeof cmd);
 	cmd.band = IEEE80211_IS_CHAN_5GHZ(ch) ? 0 : 1;
 	cmd.chan = htole16(chan);
 	
 	/* Set TX power for all OFDM and CCK rates. */
-	for (i = 0; i <= WPI_RIDX_MAX ; i++) {
-		/* Retrieve TX power for this channel/rate. */
-		idx = wpi_get_power_index(sc, group, ch, i);
-		
+	for (i = 0; i <= WPI_RIDX_MAX; i++) {
 		cmd.rates[i].plcp = wpi_rates[i].plcp;
-		
-		if (IEEE80211_IS_CHAN_5GHZ(ch)) {
-			cmd.rates[i].rf_gain = wpi_rf_gain_5ghz[idx];
-			cmd.rates[i].dsp_gain = wpi_dsp_gain_5ghz[idx];
-		} else {
-			cmd.rates[i].rf_gain = wpi_rf_gain_2ghz[idx];
-			cmd.rates[i].dsp_gain = wpi_dsp_gain_2ghz[idx];
-		}
-		DPRINTF(("chan %d/rate %d: power index %d\n", chan,
-			 wpi_rates[i].rate, idx));
+		cmd.rates[i].rf_gain = sc->pwr.gain[row][i].rf_gain;
+		cmd.rates[i].dsp_gain = sc->pwr.gain[row][i].dsp_gain;
 	}
 	return wpi_cmd(sc, WPI_CMD_TXPOWER, &cmd, sizeof cmd, async);
 }
 
-/*
- * Determine TX power index for a given channel/rate combination.
- * This takes into account the regulatory information from EEPROM and the
- * current temperature.
- */
-int VoodooIntel3945::
-wpi_get_power_index(struct wpi_softc *sc, struct wpi_power_group *group,
-		    struct ieee80211_channel *c, int ridx)
-{
-	/* Fixed-point arithmetic division using a n-bit fractional part. */
-#define fdivround(a, b, n)	\
-((((1 << n) * (a)) / (b) + (1 << n) / 2) / (1 << n))
-	
-	/* Linear interpolation. */
-#define interpolate(x, x1, y1, x2, y2, n)	\
-((y1) + fdivround(((x) - (x1)) * ((y2) - (y1)), (x2) - (x1), n))
-	
-	struct ieee80211com *ic = &sc->sc_ic;
-	struct wpi_power_sample *sample;
-	int pwr, idx;
-	u_int chan;
-	
-	/* Get channel number. */
-	chan = ieee80211_chan2ieee(ic, c);
-	
-	/* Default TX power is group maximum TX power minus 3dB. */
-	pwr = group->maxpwr / 2;
-	
-	/* Decrease TX power for highest OFDM rates to reduce distortion. */
-	switch (ridx) {
-		case WPI_RIDX_OFDM36:
-			pwr -= IEEE80211_IS_CHAN_2GHZ(c) ? 0 :  5;
-			break;
-		case WPI_RIDX_OFDM48:
-			pwr -= IEEE80211_IS_CHAN_2GHZ(c) ? 7 : 10;
-			break;
-		case WPI_RIDX_OFDM54:
-			pwr -= IEEE80211_IS_CHAN_2GHZ(c) ? 9 : 12;
-			break;
-	}
-	
-	/* Never exceed the channel maximum allowed TX power. */
-	pwr = MIN(pwr, sc->maxpwr[chan]);
-	
-	/* Retrieve TX power index into gain tables from samples. */
-	for (sample = group->samples; sample < &group->samples[3]; sample++)
-		if (pwr > sample[1].power)
-			break;
-	/* Fixed-point linear interpolation using a 19-bit fractional part. */
-	idx = interpolate(pwr, sample[0].power, sample[0].index,
-			  sample[1].power, sample[1].index, 19);
-	
-	/*-
-	 * Adjust power index based on current temperature:
-	 * - if cooler than factory-calibrated: decrease output power
-	 * - if warmer than factory-calibrated: increase output power
-	 */
-	idx -= (sc->temp - group->temp) * 11 / 100;
-	
-	/* Decrease TX power for CCK rates (-5dB). */
-	if (ridx >= WPI_RIDX_CCK1)
-		idx += 10;
-	
-	/* Make sure idx stays in a valid range. */
-	if (idx < 0)
-		idx = 0;
-	else if (idx > WPI_MAX_PWR_INDEX)
-		idx = WPI_MAX_PWR_INDEX;
-	return idx;
-	
-#undef interpolate
-#undef fdivround
-}
-
 /*
  * Set STA mode power saving level (between 0 and 5).
  * Level 0 is CAM (Continuously Aware Mode), 5 is for maximum power saving.
@@ -2158,11 +2566,14 @@ wpi_config(struct wpi_softc *sc)
 	struct wpi_node_info node;
 	int error;
 	
+	/* Send the whole configuration with a single doorbell. */
+	wpi_cmd_begin(sc);
+	
 	/* Set power saving level to CAM during initialization. */
 	if ((error = wpi_set_pslevel(sc, 0, 0, 0)) != 0) {
 		printf("%s: could not set power saving level\n",
 		       sc->sc_dev.dv_xname);
-		return error;
+		goto fail;
 	}
 	
 	/* Configure bluetooth coexistence. */
@@ -2174,7 +2585,7 @@ wpi_config(struct wpi_softc *sc)
 	if (error != 0) {
 		printf("%s: could not configure bluetooth coexistence\n",
 		       sc->sc_dev.dv_xname);
-		return error;
+		goto fail;
 	}
 	
 	/* Configure adapter. */
@@ -2207,13 +2618,13 @@ wpi_config(struct wpi_softc *sc)
 			0);
 	if (error != 0) {
 		printf("%s: RXON command failed\n", sc->sc_dev.dv_xname);
-		return error;
+		goto fail;
 	}
 	
 	/* Configuration has changed, set TX power accordingly. */
 	if ((error = wpi_set_txpower(sc, 0)) != 0) {
 		printf("%s: could not set TX power\n", sc->sc_dev.dv_xname);
-		return error;
+		goto fail;
 	}
 	
 	/* Add broadcast node. */
@@ -2227,14 +2638,22 @@ wpi_config(struct wpi_softc *sc)
 	if (error != 0) {
 		printf("%s: could not add broadcast node\n",
 		       sc->sc_dev.dv_xname);
-		return error;
+		goto fail;
 	}
 	
 	if ((error = wpi_mrr_setup(sc)) != 0) {
 		printf("%s: could not setup MRR\n", sc->sc_dev.dv_xname);
+		goto fail;
+	}
+	if ((error = wpi_cmd_end(sc, 1)) != 0) {
+		printf("%s: configuration commands timed out\n",
+		       sc->sc_dev.dv_xname);
 		return error;
 	}
 	return 0;
+	
+fail:	(void)wpi_cmd_end(sc, 0);
+	return error;
 }
 
 int VoodooIntel3945::
@@ -2355,6 +2774,9 @@ wpi_auth(struct wpi_softc *sc)
 	struct wpi_node_info node;
 	int error;
 	
+	sc->assoc_start = wpi_uptime_us();
+	wpi_cmd_begin(sc);
+	
 	/* Update adapter configuration. */
 	IEEE80211_ADDR_COPY(sc->rxon.bssid, ni->ni_bssid);
 	sc->rxon.chan = ieee80211_chan2ieee(ic, ni->ni_chan);
@@ -2384,13 +2806,13 @@ wpi_auth(struct wpi_softc *sc)
 			1);
 	if (error != 0) {
 		printf("%s: RXON command failed\n", sc->sc_dev.dv_xname);
-		return error;
+		goto fail;
 	}
 	
 	/* Configuration has changed, set TX power accordingly. */
 	if ((error = wpi_set_txpower(sc, 1)) != 0) {
 		printf("%s: could not set TX power\n", sc->sc_dev.dv_xname);
-		return error;
+		goto fail;
 	}
 	/*
 	 * Reconfiguring RXON clears the firmware nodes table so we must
@@ -2407,9 +2829,23 @@ wpi_auth(struct wpi_softc *sc)
 	if (error != 0) {
 		printf("%s: could not add broadcast node\n",
 		       sc->sc_dev.dv_xname);
-		return error;
+		goto fail;
 	}
-	return 0;
+	return wpi_cmd_end(sc, 0);
+	
+fail:	(void)wpi_cmd_end(sc, 0);
+	return error;
+}
+
+/*
+ * Called when the firmware acks the BSS node, the last step of joining.
+ */
+static void
+wpi_assoc_done(struct wpi_softc *sc, void *arg, struct wpi_rx_desc *desc)
+{
+	sc->assoc_time = (uint32_t)(wpi_uptime_us() - sc->assoc_start);
+	DPRINTF(("%s: associated in %uus\n", sc->sc_dev.dv_xname,
+		 sc->assoc_time));
 }
 
 int VoodooIntel3945::
@@ -2425,9 +2861,11 @@ wpi_run(struct wpi_softc *sc)
 		wpi_set_led(sc, WPI_LED_LINK, 5, 5);
 		return 0;
 	}
+	wpi_cmd_begin(sc);
+	
 	if ((error = wpi_set_timing(sc, ni)) != 0) {
 		printf("%s: could not set timing\n", sc->sc_dev.dv_xname);
-		return error;
+		goto fail;
 	}
 	
 	/* Update adapter configuration. */
@@ -2444,13 +2882,13 @@ wpi_run(struct wpi_softc *sc)
 			1);
 	if (error != 0) {
 		printf("%s: RXON command failed\n", sc->sc_dev.dv_xname);
-		return error;
+		goto fail;
 	}
 	
 	/* Configuration has changed, set TX power accordingly. */
 	if ((error = wpi_set_txpower(sc, 1)) != 0) {
 		printf("%s: could not set TX power\n", sc->sc_dev.dv_xname);
-		return error;
+		goto fail;
 	}
 	
 	/* Fake a join to init the TX rate. */
@@ -2466,10 +2904,11 @@ wpi_run(struct wpi_softc *sc)
 	node.action = htole32(WPI_ACTION_SET_RATE);
 	node.antenna = WPI_ANTENNA_BOTH;
 	DPRINTF(("adding BSS node\n"));
-	error = wpi_cmd(sc, WPI_CMD_ADD_NODE, &node, sizeof node, 1);
+	error = wpi_cmd_submit(sc, WPI_CMD_ADD_NODE, &node, sizeof node,
+			       wpi_assoc_done, NULL);
 	if (error != 0) {
 		printf("%s: could not add BSS node\n", sc->sc_dev.dv_xname);
-		return error;
+		goto fail;
 	}
 	
 	/* Start periodic calibration timer. */
@@ -2483,7 +2922,10 @@ wpi_run(struct wpi_softc *sc)
 	if (sc->sc_ic.ic_flags & IEEE80211_F_PMGTON)
 		(void)wpi_set_pslevel(sc, 0, 3, 1);
 	
-	return 0;
+	return wpi_cmd_end(sc, 0);
+	
+fail:	(void)wpi_cmd_end(sc, 0);
+	return error;
 }
 
 /*
@@ -2574,11 +3016,15 @@ wpi_post_alive(struct wpi_softc *sc)
 /*
  * The firmware boot code is small and is intended to be copied directly into
  * the NIC internal memory (no DMA transfer.)
+ * The BSM SRAM only sits behind the PRPH port, not the auto-incrementing
+ * target memory port, so the image is streamed one address/data pair per word.
+ * The BSM copy of at most 1KB completes within a few microseconds, so the
+ * completion is polled at a finer granularity than the original 10us.
  */
 int VoodooIntel3945::
 wpi_load_bootcode(struct wpi_softc *sc, const uint8_t *ucode, int size)
 {
-	int error, ntries;
+	int error;
 	
 	size /= sizeof (uint32_t);
 	
@@ -2596,14 +3042,10 @@ wpi_load_bootcode(struct wpi_softc *sc, const uint8_t *ucode, int size)
 	/* Start boot load now. */
 	wpi_prph_write(sc, WPI_BSM_WR_CTRL, WPI_BSM_WR_CTRL_START);
 	
-	/* Wait for transfer to complete. */
-	for (ntries = 0; ntries < 1000; ntries++) {
-		if (!(wpi_prph_read(sc, WPI_BSM_WR_CTRL) &
-		      WPI_BSM_WR_CTRL_START))
-			break;
-		IODelay(10);
-	}
-	if (ntries == 1000) {
+	/* Wait at most 10ms for transfer to complete. */
+	error = wpi_poll(sc, WPI_POLL_BOOTCODE, WPI_BSM_WR_CTRL,
+			 WPI_BSM_WR_CTRL_START, 0, 10000);
+	if (error != 0) {
 		printf("%s: could not load boot firmware\n",
 		       sc->sc_dev.dv_xname);
 		wpi_nic_unlock(sc);
@@ -2617,17 +3059,41 @@ wpi_load_bootcode(struct wpi_softc *sc, const uint8_t *ucode, int size)
 	return 0;
 }
 
+/*
+ * Decompress a firmware section straight into DMA-safe memory.
+ */
+int VoodooIntel3945::
+wpi_fw_decompress(struct wpi_softc *sc, uint8_t *dst, const uint8_t *src,
+		  uint32_t csize, uint32_t size)
+{
+	uint64_t start;
+	int len;
+	
+	start = wpi_uptime_us();
+	len = lz4_decompress(src, csize, dst, size);
+	sc->fw_decomp_time += (uint32_t)(wpi_uptime_us() - start);
+	if (len != (int)size) {
+		printf("%s: corrupt firmware section\n", sc->sc_dev.dv_xname);
+		return EINVAL;
+	}
+	return 0;
+}
+
 int VoodooIntel3945::
 wpi_load_firmware(struct wpi_softc *sc)
 {
 	struct wpi_fw_info *fw = &sc->fw;
 	struct wpi_dma_info *dma = &sc->fw_dma;
+	uint64_t start;
 	int error;
 	
-	/* Copy initialization sections into pre-allocated DMA-safe memory. */
-	memcpy(dma->vaddr, fw->init.data, fw->init.datasz);
-	memcpy(dma->vaddr + WPI_FW_DATA_MAXSZ,
-	       fw->init.text, fw->init.textsz);
+	/* Decompress initialization sections into pre-allocated DMA-safe memory. */
+	sc->fw_decomp_time = 0;
+	if ((error = wpi_fw_decompress(sc, (uint8_t *)dma->vaddr, fw->init.data,
+	    fw->init.datacsz, fw->init.datasz)) != 0 ||
+	    (error = wpi_fw_decompress(sc, (uint8_t *)dma->vaddr + WPI_FW_DATA_MAXSZ,
+	    fw->init.text, fw->init.textcsz, fw->init.textsz)) != 0)
+		return error;
 	
 	/* Tell adapter where to find initialization sections. */
 	if ((error = wpi_nic_lock(sc)) != 0)
@@ -2640,12 +3106,14 @@ wpi_load_firmware(struct wpi_softc *sc)
 	wpi_nic_unlock(sc);
 	
 	/* Load firmware boot code. */
+	start = wpi_uptime_us();
 	error = wpi_load_bootcode(sc, fw->boot.text, fw->boot.textsz);
 	if (error != 0) {
 		printf("%s: could not load boot firmware\n",
 		       sc->sc_dev.dv_xname);
 		return error;
 	}
+	sc->fw_boot_time = (uint32_t)(wpi_uptime_us() - start);
 	/* Now press "execute". */
 	WPI_WRITE(sc, WPI_RESET, 0);
 	
@@ -2656,10 +3124,12 @@ wpi_load_firmware(struct wpi_softc *sc)
 		return error;
 	}
 	
-	/* Copy runtime sections into pre-allocated DMA-safe memory. */
-	memcpy(dma->vaddr, fw->main.data, fw->main.datasz);
-	memcpy(dma->vaddr + WPI_FW_DATA_MAXSZ,
-	       fw->main.text, fw->main.textsz);
+	/* Decompress runtime sections into pre-allocated DMA-safe memory. */
+	if ((error = wpi_fw_decompress(sc, (uint8_t *)dma->vaddr, fw->main.data,
+	    fw->main.datacsz, fw->main.datasz)) != 0 ||
+	    (error = wpi_fw_decompress(sc, (uint8_t *)dma->vaddr + WPI_FW_DATA_MAXSZ,
+	    fw->main.text, fw->main.textcsz, fw->main.textsz)) != 0)
+		return error;
 	
 	/* Tell adapter where to find runtime sections. */
 	if ((error = wpi_nic_lock(sc)) != 0)
@@ -2680,13 +3150,15 @@ wpi_read_firmware(struct wpi_softc *sc)
 {
 	struct wpi_fw_info *fw = &sc->fw;
 	const struct wpi_firmware_hdr *hdr;
+	const struct wpi_firmware_lz4_hdr *lz4;
 	size_t size;
 	//int error;
 	
-	/* Read firmware image from filesystem. */
-	// pvaibhav
-	//bcopy(Intel3945FirmwareImage, fw->data, Intel3945FirmwareImage_len);
-	fw->data = (u_char*)Intel3945FirmwareImage;
+	/*
+	 * The firmware is embedded with its sections compressed, they are
+	 * decompressed into the DMA buffer by wpi_load_firmware().
+	 */
+	fw->data = Intel3945FirmwareImage;
 	size = Intel3945FirmwareImage_len;
 	/* TODO Not needed for now
 	if ((error = loadfirmware("wpi-3945abg", &fw->data, &size)) != 0) {
@@ -2694,66 +3166,71 @@ wpi_read_firmware(struct wpi_softc *sc)
 		       sc->sc_dev.dv_xname, error, "wpi-3945abg");
 		return error;
 	} */
-	if (size < sizeof (*hdr)) {
+	if (size < sizeof (*hdr) + sizeof (*lz4)) {
 		printf("%s: truncated firmware header: %d bytes\n",
 		       sc->sc_dev.dv_xname, (int)size);
-		free(fw->data);
 		return EINVAL;
 	}
 	/* Extract firmware header information. */
-	hdr = (struct wpi_firmware_hdr *)fw->data;
+	hdr = (const struct wpi_firmware_hdr *)fw->data;
+	lz4 = (const struct wpi_firmware_lz4_hdr *)(hdr + 1);
 	fw->main.textsz = letoh32(hdr->main_textsz);
 	fw->main.datasz = letoh32(hdr->main_datasz);
 	fw->init.textsz = letoh32(hdr->init_textsz);
 	fw->init.datasz = letoh32(hdr->init_datasz);
 	fw->boot.textsz = letoh32(hdr->boot_textsz);
 	fw->boot.datasz = 0;
+	fw->main.textcsz = letoh32(lz4->main_textcsz);
+	fw->main.datacsz = letoh32(lz4->main_datacsz);
+	fw->init.textcsz = letoh32(lz4->init_textcsz);
+	fw->init.datacsz = letoh32(lz4->init_datacsz);
+	fw->boot.textcsz = fw->boot.textsz;
+	fw->boot.datacsz = 0;
 	
 	/* Sanity-check firmware header. */
-	if (fw->main.textsz > WPI_FW_TEXT_MAXSZ ||
+	if (letoh32(lz4->magic) != WPI_FW_LZ4_MAGIC ||
+	    fw->main.textsz > WPI_FW_TEXT_MAXSZ ||
 	    fw->main.datasz > WPI_FW_DATA_MAXSZ ||
 	    fw->init.textsz > WPI_FW_TEXT_MAXSZ ||
 	    fw->init.datasz > WPI_FW_DATA_MAXSZ ||
 	    fw->boot.textsz > WPI_FW_BOOT_TEXT_MAXSZ ||
 	    (fw->boot.textsz & 3) != 0) {
 		printf("%s: invalid firmware header\n", sc->sc_dev.dv_xname);
-		free(fw->data);
 		return EINVAL;
 	}
 	
 	/* Check that all firmware sections fit. */
-	if (size < sizeof (*hdr) + fw->main.textsz + fw->main.datasz +
-	    fw->init.textsz + fw->init.datasz + fw->boot.textsz) {
+	if (size < sizeof (*hdr) + sizeof (*lz4) +
+	    (uint64_t)fw->main.textcsz + fw->main.datacsz +
+	    fw->init.textcsz + fw->init.datacsz + fw->boot.textsz) {
 		printf("%s: firmware file too short: %d bytes\n",
 		       sc->sc_dev.dv_xname, (int)size);
-		free(fw->data);
 		return EINVAL;
 	}
 	
 	/* Get pointers to firmware sections. */
-	fw->main.text = (const uint8_t *)(hdr + 1);
-	fw->main.data = fw->main.text + fw->main.textsz;
-	fw->init.text = fw->main.data + fw->main.datasz;
-	fw->init.data = fw->init.text + fw->init.textsz;
-	fw->boot.text = fw->init.data + fw->init.datasz;
-	
+	fw->main.text = (const uint8_t *)(lz4 + 1);
+	fw->main.data = fw->main.text + fw->main.textcsz;
+	fw->init.text = fw->main.data + fw->main.datacsz;
+	fw->init.data = fw->init.text + fw->init.textcsz;
+	fw->boot.text = fw->init.data + fw->init.datacsz;
+	
+	DPRINTF(("firmware: %u bytes resident, %u bytes uncompressed\n",
+	    (u_int)size, (u_int)Intel3945FirmwareImage_rawlen));
 	return 0;
 }
 
 int VoodooIntel3945::
 wpi_clock_wait(struct wpi_softc *sc)
 {
-	int ntries;
-	
 	/* Set "initialization complete" bit. */
 	WPI_SETBITS(sc, WPI_GP_CNTRL, WPI_GP_CNTRL_INIT_DONE);
 	
 	/* Wait for clock stabilization. */
-	for (ntries = 0; ntries < 25000; ntries++) {
-		if (WPI_READ(sc, WPI_GP_CNTRL) & WPI_GP_CNTRL_MAC_CLOCK_READY)
-			return 0;
-		IODelay(100);
-	}
+	if (wpi_poll(sc, WPI_POLL_CLOCK, WPI_GP_CNTRL,
+		     WPI_GP_CNTRL_MAC_CLOCK_READY, WPI_GP_CNTRL_MAC_CLOCK_READY,
+		     2500000) == 0)
+		return 0;
 	printf("%s: timeout waiting for clock stabilization\n",
 	       sc->sc_dev.dv_xname);
 	return ETIMEDOUT;
@@ -2788,19 +3265,15 @@ wpi_apm_init(struct wpi_softc *sc)
 void VoodooIntel3945::
 wpi_apm_stop_master(struct wpi_softc *sc)
 {
-	int ntries;
-	
 	WPI_SETBITS(sc, WPI_RESET, WPI_RESET_STOP_MASTER);
 	
 	if ((WPI_READ(sc, WPI_GP_CNTRL) & WPI_GP_CNTRL_PS_MASK) ==
 	    WPI_GP_CNTRL_MAC_PS)
 		return;	/* Already asleep. */
 	
-	for (ntries = 0; ntries < 100; ntries++) {
-		if (WPI_READ(sc, WPI_RESET) & WPI_RESET_MASTER_DISABLED)
-			return;
-		IODelay(10);
-	}
+	if (wpi_poll(sc, WPI_POLL_MASTER, WPI_RESET, WPI_RESET_MASTER_DISABLED,
+		     WPI_RESET_MASTER_DISABLED, 1000) == 0)
+		return;
 	printf("%s: timeout waiting for master\n", sc->sc_dev.dv_xname);
 }
 
@@ -2840,7 +3313,8 @@ wpi_nic_config(struct wpi_softc *sc)
 int VoodooIntel3945::
 wpi_hw_init(struct wpi_softc *sc)
 {
-	int chnl, ntries, error;
+	uint64_t start;
+	int chnl, error;
 	
 	/* Clear pending interrupts. */
 	WPI_WRITE(sc, WPI_INT, 0xffffffff);
@@ -2857,12 +3331,9 @@ wpi_hw_init(struct wpi_softc *sc)
 	wpi_prph_clrbits(sc, WPI_APMG_PS, WPI_APMG_PS_PWR_SRC_MASK);
 	wpi_nic_unlock(sc);
 	/* Spin until VMAIN gets selected. */
-	for (ntries = 0; ntries < 5000; ntries++) {
-		if (WPI_READ(sc, WPI_GPIO_IN) & WPI_GPIO_IN_VMAIN)
-			break;
-		IODelay(10);
-	}
-	if (ntries == 5000) {
+	error = wpi_poll(sc, WPI_POLL_POWER, WPI_GPIO_IN, WPI_GPIO_IN_VMAIN,
+			 WPI_GPIO_IN_VMAIN, 50000);
+	if (error != 0) {
 		printf("%s: timeout selecting power source\n",
 		       sc->sc_dev.dv_xname);
 		return ETIMEDOUT;
@@ -2930,6 +3401,7 @@ wpi_hw_init(struct wpi_softc *sc)
 	WPI_WRITE(sc, WPI_UCODE_GP1_CLR, WPI_UCODE_GP1_RFKILL);
 	WPI_WRITE(sc, WPI_UCODE_GP1_CLR, WPI_UCODE_GP1_RFKILL);
 	
+	start = wpi_uptime_us();
 	if ((error = wpi_load_firmware(sc)) != 0) {
 		printf("%s: could not load firmware\n", sc->sc_dev.dv_xname);
 		return error;
@@ -2940,6 +3412,11 @@ wpi_hw_init(struct wpi_softc *sc)
 		       sc->sc_dev.dv_xname);
 		return error;
 	}
+	/* Firmware load time, from boot code upload to runtime alive. */
+	sc->fw_load_time = (uint32_t)(wpi_uptime_us() - start);
+	DPRINTF(("firmware loaded in %uus (boot code %uus, "
+	    "decompression %uus)\n", sc->fw_load_time, sc->fw_boot_time,
+	    sc->fw_decomp_time));
 	/* Do post-firmware initialization. */
 	return wpi_post_alive(sc);
 }
@@ -3019,7 +3496,6 @@ wpi_init()
 	
 	/* Initialize hardware and upload firmware. */
 	error = wpi_hw_init(sc);
-	free(sc->fw.data);
 	if (error != 0) {
 		printf("%s: could not initialize hardware\n",
 		       sc->sc_dev.dv_xname);
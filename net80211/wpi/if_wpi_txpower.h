@@ -0,0 +1,212 @@
+/*
+ * Precomputed TX power table of the 3945.
+ *
+ * The EEPROM interpolation only depends on the channel and rate, so it is
+ * done once per channel when the table is built.  Temperature compensation
+ * and the gain table lookup are applied to the whole table when the
+ * calibrated temperature changes, and the TXPOWER command copies a row.
+ * Nothing here touches the softc so the table can be built on the host.
+ * Needs if_wpireg.h.
+ */
+
+#ifndef __h__if_wpi_txpower
+#define __h__if_wpi_txpower
+
+struct wpi_power_sample {
+	uint8_t	index;
+	int8_t	power;
+};
+
+struct wpi_power_group {
+#define WPI_SAMPLES_COUNT	5
+	struct	wpi_power_sample samples[WPI_SAMPLES_COUNT];
+	uint8_t	chan;
+	int8_t	maxpwr;
+	int16_t	temp;
+};
+
+struct wpi_txpower_gain {
+	uint8_t	rf_gain;
+	uint8_t	dsp_gain;
+};
+
+/* Rows of the precomputed TX power table, enough for all EEPROM bands. */
+#define WPI_PWR_MAXCHAN	64
+/* IEEE channel numbers, IEEE80211_CHAN_MAX + 1. */
+#define WPI_PWR_NCHANS	256
+
+struct wpi_txpower_table {
+	uint8_t			row[WPI_PWR_NCHANS];	/* 0xff: none */
+	uint8_t			group[WPI_PWR_MAXCHAN];	/* 0: 2GHz band */
+	int16_t			base[WPI_PWR_MAXCHAN][WPI_RIDX_MAX + 1];
+	struct wpi_txpower_gain	gain[WPI_PWR_MAXCHAN][WPI_RIDX_MAX + 1];
+	int			nrows;
+	int			temp;	/* temperature of gain */
+	int			valid;
+};
+
+/*
+ * Find the TX power group to which a channel belongs.
+ */
+static inline int
+wpi_power_group(const struct wpi_power_group *groups, u_int chan, int is5ghz)
+{
+	int grp;
+
+	if (!is5ghz)
+		return 0;
+	for (grp = 1; grp < 4; grp++)
+		if (chan <= groups[grp].chan)
+			break;
+	return grp;
+}
+
+/*
+ * Determine the temperature independent TX power index for a given
+ * channel/rate combination from the regulatory information in EEPROM.
+ * The result is not clamped, wpi_txpower_table_update() does that after
+ * temperature compensation.
+ */
+static inline int
+wpi_power_index(const struct wpi_power_group *group, int maxpwr, int is2ghz,
+		int ridx)
+{
+	/* Fixed-point arithmetic division using a n-bit fractional part. */
+#define fdivround(a, b, n)	\
+((((1 << n) * (a)) / (b) + (1 << n) / 2) / (1 << n))
+
+	/* Linear interpolation. */
+#define interpolate(x, x1, y1, x2, y2, n)	\
+((y1) + fdivround(((x) - (x1)) * ((y2) - (y1)), (x2) - (x1), n))
+
+	const struct wpi_power_sample *sample;
+	int pwr, idx;
+
+	/* Default TX power is group maximum TX power minus 3dB. */
+	pwr = group->maxpwr / 2;
+
+	/* Decrease TX power for highest OFDM rates to reduce distortion. */
+	switch (ridx) {
+		case WPI_RIDX_OFDM36:
+			pwr -= is2ghz ? 0 :  5;
+			break;
+		case WPI_RIDX_OFDM48:
+			pwr -= is2ghz ? 7 : 10;
+			break;
+		case WPI_RIDX_OFDM54:
+			pwr -= is2ghz ? 9 : 12;
+			break;
+	}
+
+	/* Never exceed the channel maximum allowed TX power. */
+	if (pwr > maxpwr)
+		pwr = maxpwr;
+
+	/* Retrieve TX power index into gain tables from samples. */
+	for (sample = group->samples; sample < &group->samples[3]; sample++)
+		if (pwr > sample[1].power)
+			break;
+	/* Fixed-point linear interpolation using a 19-bit fractional part. */
+	idx = interpolate(pwr, sample[0].power, sample[0].index,
+			  sample[1].power, sample[1].index, 19);
+
+	/* Decrease TX power for CCK rates (-5dB). */
+	if (ridx >= WPI_RIDX_CCK1)
+		idx += 10;
+	return idx;
+
+#undef interpolate
+#undef fdivround
+}
+
+/*
+ * Clamp a temperature compensated power index and look up its gains.
+ */
+static inline void
+wpi_power_gain(int idx, int is5ghz, struct wpi_txpower_gain *gain)
+{
+	/* Make sure idx stays in a valid range. */
+	if (idx < 0)
+		idx = 0;
+	else if (idx > WPI_MAX_PWR_INDEX)
+		idx = WPI_MAX_PWR_INDEX;
+
+	if (is5ghz) {
+		gain->rf_gain = wpi_rf_gain_5ghz[idx];
+		gain->dsp_gain = wpi_dsp_gain_5ghz[idx];
+	} else {
+		gain->rf_gain = wpi_rf_gain_2ghz[idx];
+		gain->dsp_gain = wpi_dsp_gain_2ghz[idx];
+	}
+}
+
+/*
+ * Power index adjustment for the current temperature:
+ * - if cooler than factory-calibrated: decrease output power
+ * - if warmer than factory-calibrated: increase output power
+ */
+static inline int
+wpi_power_delta(const struct wpi_power_group *group, int temp)
+{
+	return (temp - group->temp) * 11 / 100;
+}
+
+static inline void
+wpi_txpower_table_init(struct wpi_txpower_table *pwr)
+{
+	memset(pwr->row, 0xff, sizeof pwr->row);
+	pwr->nrows = 0;
+	/* Force wpi_txpower_table_update() on first use. */
+	pwr->valid = 0;
+}
+
+/*
+ * Add a row for channel chan, which belongs to power group grp.  Returns
+ * the row, or -1 once the table is full.
+ */
+static inline int
+wpi_txpower_table_add(struct wpi_txpower_table *pwr,
+		      const struct wpi_power_group *groups, u_int chan, int grp,
+		      int maxpwr, int is2ghz)
+{
+	int row, ridx;
+
+	if (pwr->nrows == WPI_PWR_MAXCHAN || chan >= WPI_PWR_NCHANS)
+		return -1;
+	row = pwr->nrows++;
+	pwr->row[chan] = row;
+	pwr->group[row] = grp;
+	for (ridx = 0; ridx <= WPI_RIDX_MAX; ridx++) {
+		pwr->base[row][ridx] = wpi_power_index(&groups[grp], maxpwr,
+		    is2ghz, ridx);
+	}
+	pwr->valid = 0;
+	return row;
+}
+
+/*
+ * Apply temperature compensation to the precomputed TX power indices and
+ * convert them to gains.
+ */
+static inline void
+wpi_txpower_table_update(struct wpi_txpower_table *pwr,
+			 const struct wpi_power_group *groups, int temp)
+{
+	int delta[WPI_POWER_GROUPS_COUNT];
+	int row, ridx, idx;
+
+	for (idx = 0; idx < WPI_POWER_GROUPS_COUNT; idx++)
+		delta[idx] = wpi_power_delta(&groups[idx], temp);
+
+	for (row = 0; row < pwr->nrows; row++) {
+		for (ridx = 0; ridx <= WPI_RIDX_MAX; ridx++) {
+			wpi_power_gain(pwr->base[row][ridx] -
+			    delta[pwr->group[row]], pwr->group[row] != 0,
+			    &pwr->gain[row][ridx]);
+		}
+	}
+	pwr->temp = temp;
+	pwr->valid = 1;
+}
+
+#endif /* __h__if_wpi_txpower */
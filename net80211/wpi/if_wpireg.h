@@ -50,6 +50,7 @@
 #define WPI_GPIO_IN		0x018
 #define WPI_RESET		0x020
 #define WPI_GP_CNTRL		0x024
+#define WPI_HW_REV		0x028
 #define WPI_EEPROM		0x02c
 #define WPI_EEPROM_GP		0x030
 #define CSR_GIO_REG         0x03c
@@ -144,6 +145,8 @@
 #define CSR_HW_IF_CONFIG_REG_PERSIST_MODE      (0x40000000) /* PERSISTENCE */
 #define CSR_HW_IF_CONFIG_REG_BIT_NIC_READY    (0x00400000)
 #define HW_READY_TIMEOUT            (50) //Timeout for poll bit
+#define NIC_ACCESS_TIMEOUT          (15000) //Total wait for MAC access
+#define NIC_ACCESS_SPIN_TIMEOUT     (100) //Part of it spent with interrupts off
 
 //flags for register MBOX_SET
 #define CSR_MBOX_SET_REG_OS_ALIVE        BIT(5)
@@ -752,6 +755,20 @@ struct wpi_firmware_hdr {
 	uint32_t	boot_textsz;
 } __packed;
 
+/*
+ * Embedded firmware images follow the header above with this one; the
+ * main and init sections are LZ4 blocks of the given sizes while the boot
+ * code is stored as is.
+ */
+struct wpi_firmware_lz4_hdr {
+	uint32_t	magic;
+#define WPI_FW_LZ4_MAGIC	0x345a4c57	/* "WLZ4" */
+	uint32_t	main_textcsz;
+	uint32_t	main_datacsz;
+	uint32_t	init_textcsz;
+	uint32_t	init_datacsz;
+} __packed;
+
 #define WPI_FW_TEXT_MAXSZ	(80 * 1024)
 #define WPI_FW_DATA_MAXSZ	(32 * 1024)
 #define WPI_FW_BOOT_TEXT_MAXSZ	1024
@@ -22,6 +22,7 @@
 
 #include "../VoodooTimeout.h"
 #include "../compat.h"
+#include "if_wpi_txpower.h"
 
 struct wpi_dma_info {
 	IOBufferMemoryDescriptor* buffer;
@@ -30,11 +31,21 @@ struct wpi_dma_info {
 	bus_size_t		size;
 };
 
+struct wpi_softc;
+
+/* Host command completion callback, run from wpi_cmd_done(). */
+typedef void (*wpi_cmd_cb_t)(struct wpi_softc *, void *, struct wpi_rx_desc *);
+
 struct wpi_tx_data {
 	bus_dmamap_t		map;
 	bus_addr_t		cmd_paddr;
 	mbuf_t			m;
 	struct ieee80211_node	*ni;
+	/* Command ring only. */
+	wpi_cmd_cb_t		cmd_cb;
+	void			*cmd_arg;
+	int			cmd_pool;	/* pool buffer or -1 */
+	int			cmd_busy;	/* submitted, not acked or reclaimed */
 };
 
 struct wpi_tx_ring {
@@ -48,13 +59,48 @@ struct wpi_tx_ring {
 	int			cur;
 };
 
-struct wpi_softc;
+/*
+ * Commands too large for their descriptor slot are copied into one of
+ * these preallocated buffers instead of a freshly allocated cluster.
+ */
+#define WPI_CMD_POOL_COUNT	4
+#define WPI_CMD_POOL_BUFSZ	MCLBYTES
 
 struct wpi_rx_data {
 	mbuf_t		m;
 	bus_dmamap_t	map;
 };
 
+/* Register wait sites, see wpi_poll(). */
+#define WPI_POLL_NIC_LOCK	0
+#define WPI_POLL_EEPROM		1
+#define WPI_POLL_CLOCK		2
+#define WPI_POLL_POWER		3
+#define WPI_POLL_BOOTCODE	4
+#define WPI_POLL_MASTER		5
+#define WPI_POLL_NSITES		6
+/*
+ * Wait statistics exported through debug.voodoo80211.hw_stats, one group
+ * per wait site in site order.
+ */
+#define WPI_POLL_STAT_WAITS	0
+#define WPI_POLL_STAT_TIMEOUTS	1
+#define WPI_POLL_STAT_MAX	2	/* us */
+#define WPI_POLL_STAT_TOTAL	3	/* us */
+#define WPI_POLL_NSTATS		4
+
+/* Attach and resume phases, see wpi_phase_mark(). */
+#define WPI_PHASE_APM		0
+#define WPI_PHASE_EEPROM	1
+#define WPI_PHASE_DMA		2
+#define WPI_PHASE_IFATTACH	3
+#define WPI_PHASE_INIT		4
+#define WPI_PHASE_NPHASES	5
+
+/* RX notification handler slots; slot 0 collects types nobody handles. */
+#define WPI_NOTIF_OTHER		0
+#define WPI_NOTIF_NSLOTS	7
+
 struct wpi_rx_ring {
 	struct wpi_dma_info	desc_dma;
 	uint32_t		*desc;
@@ -69,28 +115,31 @@ struct wpi_node {
 	uint8_t				ridx[IEEE80211_RATE_MAXSIZE];
 };
 
-struct wpi_power_sample {
-	uint8_t	index;
-	int8_t	power;
-};
-
-struct wpi_power_group {
-#define WPI_SAMPLES_COUNT	5
-	struct	wpi_power_sample samples[WPI_SAMPLES_COUNT];
-	uint8_t	chan;
-	int8_t	maxpwr;
-	int16_t	temp;
-};
+/*
+ * Raw copy of the EEPROM contents the driver uses, read once at attach and
+ * parsed from here.
+ */
+struct wpi_eeprom_cache {
+	uint16_t		rev;
+	uint8_t			macaddr[IEEE80211_ADDR_LEN];
+	uint8_t			cap;
+	uint8_t			type;
+	char			domain[4];
+	struct wpi_eeprom_chan	chans[WPI_CHAN_BANDS_COUNT][WPI_MAX_CHAN_PER_BAND];
+	struct wpi_eeprom_group	groups[WPI_POWER_GROUPS_COUNT];
+} __packed;
 
 struct wpi_fw_part {
 	const uint8_t	*text;
 	uint32_t	textsz;
+	uint32_t	textcsz;	/* compressed size */
 	const uint8_t	*data;
 	uint32_t	datasz;
+	uint32_t	datacsz;	/* compressed size */
 };
 
 struct wpi_fw_info {
-	u_char			*data;
+	const u_char		*data;
 	struct wpi_fw_part	init;
 	struct wpi_fw_part	main;
 	struct wpi_fw_part	boot;
@@ -123,6 +172,28 @@ struct wpi_softc {
 	struct wpi_tx_ring	txq[WPI_NTXQUEUES];
 	struct wpi_rx_ring	rxq;
 	
+	/* RX notification demux statistics. */
+	uint32_t		notif_intrs;	/* interrupts with descriptors */
+	uint32_t		notif_descs;	/* descriptors processed */
+	uint32_t		notif_descs_max;	/* most in one interrupt */
+	uint32_t		notif_count[WPI_NOTIF_NSLOTS];
+	uint64_t		notif_time[WPI_NOTIF_NSLOTS];	/* abstime units */
+	
+	/* Register wait statistics, per wait site. */
+	uint32_t		poll_waits[WPI_POLL_NSITES];
+	uint32_t		poll_timeouts[WPI_POLL_NSITES];
+	uint32_t		poll_max[WPI_POLL_NSITES];	/* us */
+	uint64_t		poll_total[WPI_POLL_NSITES];	/* us */
+	
+	/* Host command pipeline. */
+	struct wpi_dma_info	cmd_pool_dma;
+	uint32_t		cmd_pool_free;	/* bitmap of free pool buffers */
+	int			cmd_pending;	/* submitted but not acked yet */
+	int			cmd_queued;	/* submitted since last doorbell */
+	int			cmd_batch;	/* doorbell deferred while > 0 */
+	uint64_t		assoc_start;
+	uint32_t		assoc_time;	/* auth to BSS node added (us) */
+	
 	bus_space_tag_t		sc_st;
 	bus_space_handle_t	sc_sh;
 	void 			*sc_ih;
@@ -136,6 +207,10 @@ struct wpi_softc {
 	
 	struct wpi_fw_info	fw;
 	uint32_t		errptr;
+	uint32_t		fw_boot_time;	/* boot code upload (us) */
+	uint32_t		fw_load_time;	/* upload to runtime alive (us) */
+	uint32_t		fw_decomp_time;	/* section decompression (us) */
+	uint32_t		phase_time[WPI_PHASE_NPHASES];	/* last run (us) */
 	
 	struct wpi_rxon		rxon;
 	int			temp;
@@ -146,6 +221,10 @@ struct wpi_softc {
 	uint8_t			type;
 	struct wpi_power_group	groups[WPI_POWER_GROUPS_COUNT];
 	int8_t			maxpwr[IEEE80211_CHAN_MAX];
+	struct wpi_eeprom_cache	eeprom;
+	
+	/* Precomputed TX power, see wpi_txpower_init(). */
+	struct wpi_txpower_table	pwr;
 	
 	int			sc_tx_timer;
 	struct workq_task	sc_resume_wqt;
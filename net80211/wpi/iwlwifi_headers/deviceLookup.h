@@ -0,0 +1,43 @@
+//
+//  deviceLookup.h
+//  net80211
+//
+//  Created by Administrator on 19/10/2026.
+//
+
+//Ordering check and lookup for PCI ID tables sorted by (device, subdevice). They only use
+//the device and subdevice members so they work on any entry type, wifi_card in the driver
+
+#ifndef deviceLookup_h
+#define deviceLookup_h
+
+template <typename Card>
+static constexpr bool wifiCardsSorted(const Card* cards, size_t count) {
+    //Strictly increasing, so there are no duplicate IDs either
+    return count < 2 || ((cards[0].device < cards[1].device ||
+                          (cards[0].device == cards[1].device && cards[0].subdevice < cards[1].subdevice)) &&
+                         wifiCardsSorted(cards + 1, count - 1));
+}
+
+//Binary search for (device, subdevice), NULL if the card is not in the table
+template <typename Card>
+static inline const Card* findWifiCard(const Card* cards, size_t count, uint16_t device, uint16_t subdevice) {
+    uint32_t key = (uint32_t)device << 16 | subdevice;
+    size_t low = 0, high = count;
+    
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        uint32_t midKey = (uint32_t)cards[mid].device << 16 | cards[mid].subdevice;
+        if (midKey == key) {
+            return &cards[mid];
+        }
+        if (midKey < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+#endif /* deviceLookup_h */
@@ -71,7 +71,7 @@
 struct iwl_fw_ini_header {
     __le32 tlv_version;
     __le32 apply_point;
-    u8 data[];
+    u8 data[0]; /* [] is only accepted at the end of the outer struct */
 } __packed; /* FW_DEBUG_TLV_HEADER_S */
 
 /**
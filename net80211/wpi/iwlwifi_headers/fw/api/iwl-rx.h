@@ -833,7 +833,7 @@ struct iwl_mvm_internal_rxq_notif {
     u16 type;
     u16 sync;
     u32 cookie;
-    u8 data[];
+    u8 data[0]; /* [] is only accepted at the end of the outer struct */
 } __packed;
 
 /**
@@ -126,6 +126,7 @@ const typeof( ((type *)0)->member ) *__mptr = (ptr);                       \
 #define BIT_WORD(nr)            ((nr) / BITS_PER_LONG)
 #define BITS_PER_BYTE           8
 #define BITS_TO_LONGS(bits)     (((bits)+BITS_PER_LONG-1)/BITS_PER_LONG)
+#define ilog2(n)                (31 - __builtin_clz((u32)(n))) //Only used on non zero 32 bit values
 
 #define DMA_BIT_MASK(n)    (((n) == 64) ? ~0ULL : ((1ULL<<(n))-1))
 #define DMA_MASK_NONE    0x0ULL
@@ -224,4 +224,83 @@ enum ucode_tlv_capa {
     
     NUM_UCODE_TLV_CAPA
 };
+
+/*
+ * TLV uCode file layout (iwl-file.h)
+ *
+ * The file starts with a TLVUCodeHeader followed by TLVs, each TLV is a
+ * UCodeTLV header followed by length bytes of data padded to a multiple of 4.
+ * All values are little endian.
+ */
+#define UCODE_TLV_MAGIC                 0x0a4c5749 //IWL_TLV_UCODE_MAGIC
+#define UCODE_HUMAN_READABLE_SIZE       64 //FW_VER_HUMAN_READABLE_SZ
+
+struct TLVUCodeHeader {
+    uint32_t zero;
+    uint32_t magic;
+    uint8_t  humanReadable[UCODE_HUMAN_READABLE_SIZE];
+    uint32_t version;
+    uint32_t build;
+    uint64_t ignore;
+} __packed;
+
+struct UCodeTLV {
+    uint32_t type;
+    uint32_t length; //Not including the type/length fields
+} __packed;
+
+/**
+ * enum UCodeTLVType - TLV types of the uCode file (iwl_ucode_tlv_type)
+ */
+enum UCodeTLVType {
+    UCODE_TLV_INVALID                   = 0,
+    UCODE_TLV_INST                      = 1,
+    UCODE_TLV_DATA                      = 2,
+    UCODE_TLV_INIT                      = 3,
+    UCODE_TLV_INIT_DATA                 = 4,
+    UCODE_TLV_BOOT                      = 5,
+    UCODE_TLV_PROBE_MAX_LEN             = 6,
+    UCODE_TLV_PAN                       = 7,
+    UCODE_TLV_RUNT_EVTLOG_PTR           = 8,
+    UCODE_TLV_RUNT_EVTLOG_SIZE          = 9,
+    UCODE_TLV_RUNT_ERRLOG_PTR           = 10,
+    UCODE_TLV_INIT_EVTLOG_PTR           = 11,
+    UCODE_TLV_INIT_EVTLOG_SIZE          = 12,
+    UCODE_TLV_INIT_ERRLOG_PTR           = 13,
+    UCODE_TLV_ENHANCE_SENS_TBL          = 14,
+    UCODE_TLV_PHY_CALIBRATION_SIZE      = 15,
+    UCODE_TLV_WOWLAN_INST               = 16,
+    UCODE_TLV_WOWLAN_DATA               = 17,
+    UCODE_TLV_FLAGS                     = 18,
+    UCODE_TLV_SEC_RT                    = 19,
+    UCODE_TLV_SEC_INIT                  = 20,
+    UCODE_TLV_SEC_WOWLAN                = 21,
+    UCODE_TLV_DEF_CALIB                 = 22,
+    UCODE_TLV_PHY_SKU                   = 23,
+    UCODE_TLV_SECURE_SEC_RT             = 24,
+    UCODE_TLV_SECURE_SEC_INIT           = 25,
+    UCODE_TLV_SECURE_SEC_WOWLAN         = 26,
+    UCODE_TLV_NUM_OF_CPU                = 27,
+    UCODE_TLV_CSCHEME                   = 28,
+    UCODE_TLV_API_CHANGES_SET           = 29,
+    UCODE_TLV_ENABLED_CAPABILITIES      = 30,
+    UCODE_TLV_N_SCAN_CHANNELS           = 31,
+    UCODE_TLV_PAGING                    = 32,
+    UCODE_TLV_SEC_RT_USNIFFER           = 34,
+    UCODE_TLV_FW_VERSION                = 36,
+    UCODE_TLV_FW_DBG_DEST               = 38,
+    UCODE_TLV_FW_DBG_CONF               = 39,
+    UCODE_TLV_FW_DBG_TRIGGER            = 40,
+    UCODE_TLV_CMD_VERSIONS              = 48,
+    UCODE_TLV_FW_GSCAN_CAPA             = 50,
+    UCODE_TLV_FW_MEM_SEG                = 51,
+    UCODE_TLV_IML                       = 52,
+    UCODE_TLV_UMAC_DEBUG_ADDRS          = 54,
+    UCODE_TLV_LMAC_DEBUG_ADDRS          = 55,
+    UCODE_TLV_FW_RECOVERY_INFO          = 57,
+    UCODE_TLV_FW_FSEQ_VERSION           = 60
+};
+
+//Flags set by UCODE_TLV_PAN (iwl_ucode_tlv_flag)
+#define UCODE_TLV_FLAGS_PAN             (1 << 0)
 #endif /* uCode_api_h */
@@ -0,0 +1,111 @@
+//
+//  crypto_bench.cpp
+//  net80211 host tests
+//
+//  Throughput of the CCMP and GCMP cipher cores on this host. The mbuf walking
+//  and header construction of ieee80211_crypto_{ccmp,gcmp}.cpp is left out, each
+//  loop is the per block work of the encrypt path: CTR plus CBC-MAC for CCMP,
+//  CTR plus GHASH for GCMP
+//
+
+#include <sys/types.h>
+
+#include "hosttest.h"
+#include "crypto/cpufeat.h"
+#include "crypto/rijndael.h"
+#include "crypto/gmac.h"
+
+#define FRAME_LEN   1500
+#define ITERATIONS  20000
+
+static void setCounter(uint8_t a[16], uint32_t counter) {
+    a[12] = counter >> 24;
+    a[13] = counter >> 16;
+    a[14] = counter >> 8;
+    a[15] = counter;
+}
+
+static void ccmpFrame(rijndael_ctx* aes, uint8_t* frame, size_t length, uint8_t mic[16]) {
+    uint8_t a[16] = { 0x01 }, b[16] = { 0x59 }, s[16];
+
+    rijndael_encrypt(aes, b, b);
+    for (uint32_t counter = 1; length > 0; counter++) {
+        size_t n = length < 16 ? length : 16;
+        for (size_t i = 0; i < n; i++) {
+            b[i] ^= frame[i];
+        }
+        rijndael_encrypt(aes, b, b);
+        setCounter(a, counter);
+        rijndael_encrypt(aes, a, s);
+        for (size_t i = 0; i < n; i++) {
+            frame[i] ^= s[i];
+        }
+        frame += n;
+        length -= n;
+    }
+    memcpy(mic, b, 16);
+}
+
+static void gcmpFrame(rijndael_ctx* aes, const GHASH_KEY* key, uint8_t* frame, size_t length, uint8_t tag[16]) {
+    uint8_t a[16] = { 0 }, s[16];
+    size_t total = length;
+    GHASH_CTX ghash;
+
+    ghash_init(&ghash, key);
+    for (uint32_t counter = 2; length > 0; counter++) {
+        size_t n = length < 16 ? length : 16;
+        setCounter(a, counter);
+        rijndael_encrypt(aes, a, s);
+        for (size_t i = 0; i < n; i++) {
+            frame[i] ^= s[i];
+        }
+        ghash_update(&ghash, frame, n);
+        frame += n;
+        length -= n;
+    }
+    ghash_final(tag, &ghash, 0, total);
+}
+
+static void report(const char* name, uint64_t nanoseconds) {
+    double bytes = (double)FRAME_LEN * ITERATIONS;
+    printf("%-14s %8.1f MB/s %8.0f ns/frame\n", name, bytes * 1000.0 / nanoseconds,
+           (double)nanoseconds / ITERATIONS);
+}
+
+int main() {
+    static uint8_t frame[FRAME_LEN];
+    uint8_t key[16] = { 0 }, H[16] = { 0 }, tag[16];
+    rijndael_ctx aes;
+    GHASH_KEY ghashKey;
+    uint64_t start;
+
+    rijndael_set_key_enc_only(&aes, key, 128);
+    rijndael_encrypt(&aes, H, H);
+    ghash_setkey(&ghashKey, H);
+    bool clmul = ghashKey.use_clmul;
+
+    printf("%d byte frames, %d iterations\n", FRAME_LEN, ITERATIONS);
+
+    start = monotonicNanoseconds();
+    for (int i = 0; i < ITERATIONS; i++) {
+        ccmpFrame(&aes, frame, sizeof(frame), tag);
+    }
+    report("CCMP", monotonicNanoseconds() - start);
+
+    ghashKey.use_clmul = 0;
+    start = monotonicNanoseconds();
+    for (int i = 0; i < ITERATIONS; i++) {
+        gcmpFrame(&aes, &ghashKey, frame, sizeof(frame), tag);
+    }
+    report("GCMP (table)", monotonicNanoseconds() - start);
+
+    if (clmul) {
+        ghashKey.use_clmul = 1;
+        start = monotonicNanoseconds();
+        for (int i = 0; i < ITERATIONS; i++) {
+            gcmpFrame(&aes, &ghashKey, frame, sizeof(frame), tag);
+        }
+        report("GCMP (clmul)", monotonicNanoseconds() - start);
+    }
+    return 0;
+}
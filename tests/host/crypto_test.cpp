@@ -0,0 +1,375 @@
+//
+//  crypto_test.cpp
+//  net80211 host tests
+//
+//  Known answer tests for the crypto kernels, run on both the accelerated and
+//  the portable paths, and a check that the accelerated kernels leave the
+//  vector registers of their caller untouched
+//
+
+#include <sys/types.h>
+#include <stdlib.h>
+
+#include "hosttest.h"
+#include "crypto/cpufeat.h"
+
+#include "crypto/gmac.h"
+#include "crypto/md5.h"
+#include "crypto/sha1.h"
+#include "crypto/sha2.h"
+#include "crypto/hmac.h"
+#include "crypto/pbkdf2.h"
+
+//sys/endian.h defines the BSD names over the ones glibc already made visible, see wpireg.h
+#undef htobe16
+#undef htobe32
+#undef htobe64
+#undef htole16
+#undef htole32
+#undef htole64
+#include "ieee80211.h"
+#include "ieee80211_crypto.h"
+
+#ifdef CRYPTO_NO_SIMD
+#define TEST_NAME "crypto_test_portable"
+#else
+#define TEST_NAME "crypto_test"
+#endif
+
+#ifdef CRYPTO_X86
+//Fill every XMM register with a known pattern, run fn and check the pattern survived
+static bool preservesXMM(void (*fn)(void*), void* arg) {
+    struct crypto_xmm_state before, after;
+
+    for (int r = 0; r < CRYPTO_XMM_REGS; r++) {
+        for (int i = 0; i < 16; i++) {
+            before.xmm[r][i] = (uint8_t)(0xa5 ^ (r * 16 + i));
+        }
+    }
+    crypto_xmm_restore(&before);
+    fn(arg);
+    crypto_xmm_save(&after);
+    return !memcmp(&before, &after, sizeof(before));
+}
+#endif
+
+//GCM specification test case 2: K = 0, P = 0^128
+static const char* ghashH = "66e94bd4ef8a2c3b884cfa59ca342b2e";
+static const char* ghashC = "0388dace60b6a392f328c2b971b2fe78";
+static const char* ghashOut = "f38cbb1ad69223dcc3457ae5b6b0f885";
+
+static void ghashDigest(const GHASH_KEY* key, const uint8_t* data, size_t length, uint8_t digest[GMAC_DIGEST_LEN]) {
+    GHASH_CTX ctx;
+
+    ghash_init(&ctx, key);
+    ghash_update(&ctx, data, length);
+    ghash_final(digest, &ctx, 0, length);
+}
+
+struct ghashRun {
+    GHASH_CTX ctx;
+    const uint8_t* data;
+    size_t length;
+};
+
+//Whole blocks go straight to the multiply kernel, init and final use libc which
+//is free to use vector registers on the host
+static void ghashRunFn(void* arg) {
+    struct ghashRun* run = (struct ghashRun*)arg;
+    ghash_update(&run->ctx, run->data, run->length);
+}
+
+static void testGHASH() {
+    uint8_t H[GMAC_BLOCK_LEN], C[GMAC_BLOCK_LEN], digest[GMAC_DIGEST_LEN];
+    GHASH_KEY key;
+    bool clmul;
+
+    hexDecode(ghashH, H, sizeof(H));
+    hexDecode(ghashC, C, sizeof(C));
+    ghash_setkey(&key, H);
+    clmul = key.use_clmul;
+
+    ghashDigest(&key, C, sizeof(C), digest);
+    CHECK(hexEqual(digest, ghashOut, sizeof(digest)), "GHASH test case 2 (%s)", clmul ? "clmul" : "table");
+    key.use_clmul = 0;
+    ghashDigest(&key, C, sizeof(C), digest);
+    CHECK(hexEqual(digest, ghashOut, sizeof(digest)), "GHASH test case 2 (table)");
+
+    if (!clmul) {
+#ifndef CRYPTO_NO_SIMD
+        printf(TEST_NAME ": no PCLMULQDQ, only the table GHASH was run\n");
+#endif
+        return;
+    }
+
+    //Both kernels must agree on every length, including partial blocks
+    uint8_t data[1024];
+    srand(1);
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)rand();
+    }
+    for (size_t length = 0; length <= sizeof(data); length += 7) {
+        uint8_t table[GMAC_DIGEST_LEN], accel[GMAC_DIGEST_LEN];
+        key.use_clmul = 0;
+        ghashDigest(&key, data, length, table);
+        key.use_clmul = 1;
+        ghashDigest(&key, data, length, accel);
+        CHECK(!memcmp(table, accel, sizeof(table)), "GHASH clmul and table differ at length %zu", length);
+    }
+
+#ifdef CRYPTO_X86
+    struct ghashRun run;
+    ghash_init(&run.ctx, &key);
+    run.data = data;
+    run.length = sizeof(data);
+    CHECK(preservesXMM(ghashRunFn, &run), "GHASH clmul clobbered the caller's XMM registers");
+#endif
+}
+
+//FIPS 180-2 appendix A and B
+static const char* shaMessages[] = {
+    "abc",
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+    NULL,   //One million 'a'
+};
+static const char* sha1Digests[] = {
+    "a9993e364706816aba3e25717850c26c9cd0d89d",
+    "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+    "34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+};
+static const char* sha256Digests[] = {
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+    "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+    "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+};
+
+static void testSHA() {
+    static uint8_t million[1000000];
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+
+    memset(million, 'a', sizeof(million));
+    for (int i = 0; i < 3; i++) {
+        const uint8_t* message = shaMessages[i] ? (const uint8_t*)shaMessages[i] : million;
+        size_t length = shaMessages[i] ? strlen(shaMessages[i]) : sizeof(million);
+        SHA1_CTX sha1;
+        SHA2_CTX sha256;
+
+        SHA1Init(&sha1);
+        //Uneven chunks so the buffered and the direct block paths both run
+        for (size_t done = 0; done < length; done += 1000) {
+            SHA1Update(&sha1, message + done, (unsigned int)(length - done < 1000 ? length - done : 1000));
+        }
+        SHA1Final(digest, &sha1);
+        CHECK(hexEqual(digest, sha1Digests[i], SHA1_DIGEST_LENGTH), "SHA-1 vector %d", i);
+
+        SHA256Init(&sha256);
+        for (size_t done = 0; done < length; done += 1000) {
+            SHA256Update(&sha256, message + done, length - done < 1000 ? length - done : 1000);
+        }
+        SHA256Final(digest, &sha256);
+        CHECK(hexEqual(digest, sha256Digests[i], SHA256_DIGEST_LENGTH), "SHA-256 vector %d", i);
+    }
+}
+
+//RFC 2202 and RFC 4231 test cases 1, 2 and 6
+struct hmacVector {
+    uint8_t keyByte;
+    size_t keyLength;
+    const char* key;
+    const char* data;
+    const char* sha1;
+    const char* sha256;
+};
+
+static const struct hmacVector hmacVectors[] = {
+    { 0x0b, 20, NULL, "Hi There",
+      "b617318655057264e28bc0b6fb378c8ef146be00",
+      "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+    { 0, 4, "Jefe", "what do ya want for nothing?",
+      "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79",
+      "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+    { 0xaa, 0, NULL, "Test Using Larger Than Block-Size Key - Hash Key First",
+      "aa4ae5e15272d00e95705637ce8a3b55ed402112",
+      "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+};
+
+static void testHMAC() {
+    uint8_t key[131], digest[SHA256_DIGEST_LENGTH];
+
+    for (size_t i = 0; i < sizeof(hmacVectors) / sizeof(hmacVectors[0]); i++) {
+        const struct hmacVector* v = &hmacVectors[i];
+        const uint8_t* data = (const uint8_t*)v->data;
+        u_int dataLength = (u_int)strlen(v->data);
+        HMAC_SHA1_CTX sha1, sha1Copy;
+        HMAC_SHA256_CTX sha256, sha256Copy;
+        //RFC 2202 uses an 80 byte key for test case 6, RFC 4231 a 131 byte one
+        size_t sha1KeyLength = v->key ? v->keyLength : (v->keyLength ? v->keyLength : 80);
+        size_t sha256KeyLength = v->key ? v->keyLength : (v->keyLength ? v->keyLength : 131);
+
+        if (v->key) {
+            memcpy(key, v->key, v->keyLength);
+        } else {
+            memset(key, v->keyByte, sizeof(key));
+        }
+
+        //A keyed context is copied and reused the way ieee80211_prf/kdf do
+        HMAC_SHA1_Init(&sha1, key, (u_int)sha1KeyLength);
+        for (int round = 0; round < 2; round++) {
+            sha1Copy = sha1;
+            HMAC_SHA1_Update(&sha1Copy, data, dataLength);
+            HMAC_SHA1_Final(digest, &sha1Copy);
+            CHECK(hexEqual(digest, v->sha1, SHA1_DIGEST_LENGTH), "HMAC-SHA1 test case %zu round %d", i, round);
+        }
+
+        HMAC_SHA256_Init(&sha256, key, (u_int)sha256KeyLength);
+        for (int round = 0; round < 2; round++) {
+            sha256Copy = sha256;
+            HMAC_SHA256_Update(&sha256Copy, data, dataLength);
+            HMAC_SHA256_Final(digest, &sha256Copy);
+            CHECK(hexEqual(digest, v->sha256, SHA256_DIGEST_LENGTH), "HMAC-SHA256 test case %zu round %d", i, round);
+        }
+    }
+}
+
+//RFC 6070 plus the IEEE 802.11 passphrase example, which takes two output blocks
+struct pbkdf2Vector {
+    const char* pass;
+    size_t passLength;
+    const char* salt;
+    size_t saltLength;
+    u_int rounds;
+    const char* key;
+};
+
+static const struct pbkdf2Vector pbkdf2Vectors[] = {
+    { "password", 8, "salt", 4, 1, "0c60c80f961f0e71f3a9b524af6012062fe037a6" },
+    { "password", 8, "salt", 4, 2, "ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957" },
+    { "password", 8, "salt", 4, 4096, "4b007901b765489abead49d926f721d065a429c1" },
+    { "passwordPASSWORDpassword", 24, "saltSALTsaltSALTsaltSALTsaltSALTsalt", 36, 4096,
+      "3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038" },
+    { "pass\0word", 9, "sa\0lt", 5, 4096, "56fa6aa75548099dcc37d7f03425e0c3" },
+    { "password", 8, "IEEE", 4, 4096, "f42c6fc52df0ebef9ebb4b90b38a5f902e83fe1b135a70e23aed762e9710a12e" },
+};
+
+static void testPBKDF2() {
+    uint8_t key[32];
+
+    for (size_t i = 0; i < sizeof(pbkdf2Vectors) / sizeof(pbkdf2Vectors[0]); i++) {
+        const struct pbkdf2Vector* v = &pbkdf2Vectors[i];
+        size_t keyLength = strlen(v->key) / 2;
+
+        CHECK(pkcs5_pbkdf2(v->pass, v->passLength, (const uint8_t*)v->salt, v->saltLength,
+                           key, keyLength, v->rounds) == 0, "PBKDF2 vector %zu failed", i);
+        CHECK(hexEqual(key, v->key, keyLength), "PBKDF2 vector %zu", i);
+    }
+}
+
+//APPLE80211_IOC_ASSOCIATE keys: a 32 character passphrase is as long as a PMK and must still
+//go through PBKDF2 when it is passed as a passphrase
+static void testPSKKey() {
+    const char* pass = "0123456789abcdef0123456789abcdef";
+    uint8_t psk[IEEE80211_PMK_LEN];
+
+    memset(psk, 0, sizeof(psk));
+    CHECK(ieee80211_psk_key(IEEE80211_PSK_PASSPHRASE, (const u_int8_t*)pass, 32, psk) == 1,
+          "32 character passphrase not sent to PBKDF2");
+    CHECK(psk[0] == 0, "32 character passphrase copied as the PMK");
+    CHECK(pkcs5_pbkdf2(pass, 32, (const uint8_t*)"linksys", 7, psk, sizeof(psk), IEEE80211_PSK_ITERATIONS) == 0 &&
+          hexEqual(psk, "90a8796e867d3d0398daf0887bf2d678eb0c838d485f134f4b465d1b0a74c98d", sizeof(psk)),
+          "32 character passphrase PSK");
+
+    CHECK(ieee80211_psk_key(IEEE80211_PSK_PMK, (const u_int8_t*)pass, 32, psk) == 0 && !memcmp(psk, pass, 32),
+          "PMK copied as it is");
+    CHECK(ieee80211_psk_key(IEEE80211_PSK_PMK, (const u_int8_t*)pass, 31, psk) == -1, "short PMK");
+    CHECK(ieee80211_psk_key(IEEE80211_PSK_PASSPHRASE, (const u_int8_t*)pass, 7, psk) == -1, "short passphrase");
+    CHECK(ieee80211_psk_key(IEEE80211_PSK_PASSPHRASE, (const u_int8_t*)pass, 8, psk) == 1, "8 character passphrase");
+}
+
+//pkcs5_pbkdf2 runs a single SHA-NI chain when it can, so the four lane kernel is
+//compared against SHA1Transform directly
+static void testSHA1X4() {
+    uint32_t state[5][4], block[16][4], expected[5];
+    uint8_t bytes[SHA1_BLOCK_LENGTH];
+
+    for (int i = 0; i < 5; i++) {
+        for (int lane = 0; lane < 4; lane++) {
+            state[i][lane] = 0x67452301u * (i + 1) + lane;
+        }
+    }
+    for (int i = 0; i < 16; i++) {
+        for (int lane = 0; lane < 4; lane++) {
+            block[i][lane] = 0x9e3779b9u * (i * 4 + lane + 1);
+        }
+    }
+    uint32_t original[5][4];
+    memcpy(original, state, sizeof(state));
+    SHA1TransformX4(state, block);
+
+    for (int lane = 0; lane < 4; lane++) {
+        for (int i = 0; i < 16; i++) {
+            bytes[4 * i] = block[i][lane] >> 24;
+            bytes[4 * i + 1] = block[i][lane] >> 16;
+            bytes[4 * i + 2] = block[i][lane] >> 8;
+            bytes[4 * i + 3] = block[i][lane];
+        }
+        for (int i = 0; i < 5; i++) {
+            expected[i] = original[i][lane];
+        }
+        SHA1Transform(expected, bytes);
+        for (int i = 0; i < 5; i++) {
+            CHECK(state[i][lane] == expected[i], "SHA1TransformX4 lane %d word %d", lane, i);
+        }
+    }
+}
+
+#ifdef CRYPTO_X86
+//As for GHASH the contexts are set up outside the checked call
+struct shaRun {
+    uint32_t sha1State[5];
+    uint32_t sha1X4State[5][4];
+    SHA2_CTX sha256;
+    uint8_t blocks[4 * SHA256_BLOCK_LENGTH];
+};
+
+static void sha1BlocksFn(void* arg) {
+    struct shaRun* run = (struct shaRun*)arg;
+    SHA1Transform(run->sha1State, run->blocks);
+}
+
+static void sha1X4Fn(void* arg) {
+    struct shaRun* run = (struct shaRun*)arg;
+    SHA1TransformX4(run->sha1X4State, (const uint32_t (*)[4])run->blocks);
+}
+
+static void sha256BlocksFn(void* arg) {
+    struct shaRun* run = (struct shaRun*)arg;
+    //Whole blocks with nothing buffered go straight to the compression function
+    SHA256Update(&run->sha256, run->blocks, sizeof(run->blocks));
+}
+
+static void testSHAPreservesXMM() {
+    static struct shaRun run;
+
+    CHECK(preservesXMM(sha1X4Fn, &run), "SHA-1 four lane kernel clobbered the caller's XMM registers");
+    if (!crypto_cpu_has(CRYPTO_CPU_SHA | CRYPTO_CPU_SSSE3 | CRYPTO_CPU_SSE41)) {
+        printf(TEST_NAME ": no SHA extensions, only the portable SHA was run\n");
+        return;
+    }
+    SHA256Init(&run.sha256);
+    CHECK(preservesXMM(sha1BlocksFn, &run), "SHA-1 SHA-NI clobbered the caller's XMM registers");
+    CHECK(preservesXMM(sha256BlocksFn, &run), "SHA-256 SHA-NI clobbered the caller's XMM registers");
+}
+#endif
+
+int main() {
+    testGHASH();
+    testSHA();
+    testHMAC();
+    testSHA1X4();
+    testPBKDF2();
+    testPSKKey();
+#ifdef CRYPTO_X86
+    testSHAPreservesXMM();
+#endif
+    return testResult(TEST_NAME);
+}
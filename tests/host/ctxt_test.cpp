@@ -0,0 +1,151 @@
+//
+//  ctxt_test.cpp
+//  net80211 host tests
+//
+//  Context info blocks built by IntelWiFiDriver_ctxt.hpp against the layout
+//  iwlwifi gives the firmware: the structure sizes and offsets the device
+//  reads, the DRAM section table of a split image, images the table rejects,
+//  and the gen2 context info and gen3 PRPH scratch filled for a set of queues
+//
+
+#include "hosttest.h"
+#include "wpihost.h"
+#include "wpi/IntelWiFiDriver_ctxt.hpp"
+
+#define MAC_ID      0x0354
+#define SECTION(i)  (0x10000000ULL + (i) * 0x1000)
+
+static const struct ContextInfoQueues queues = { 0x20000000, 0x20001000, 0x20002000, 0x20003000 };
+
+//Offsets in iwl-context-info.h as the firmware reads them
+static void testLayout() {
+    CHECK(sizeof(struct iwl_context_info) == 1792, "iwl_context_info is %zu bytes", sizeof(struct iwl_context_info));
+    CHECK(offsetof(struct iwl_context_info, rbd_cfg) == 24 && offsetof(struct iwl_context_info, hcmd_cfg) == 48,
+          "iwl_context_info queue configuration");
+    CHECK(offsetof(struct iwl_context_info, dram) == 192, "iwl_context_info DRAM table at %zu",
+          offsetof(struct iwl_context_info, dram));
+    CHECK(sizeof(struct iwl_context_info_dram) == 3 * IWL_MAX_DRAM_ENTRY * 8, "DRAM table size");
+    CHECK(offsetof(struct iwl_context_info_dram, lmac_img) == IWL_MAX_DRAM_ENTRY * 8, "UMAC entries come first");
+
+    CHECK(sizeof(struct iwl_prph_scratch_ctrl_cfg) == 60, "iwl_prph_scratch_ctrl_cfg is %zu bytes",
+          sizeof(struct iwl_prph_scratch_ctrl_cfg));
+    CHECK(offsetof(struct iwl_prph_scratch, dram) == 124 && sizeof(struct iwl_prph_scratch) == 1660,
+          "iwl_prph_scratch DRAM table at %zu of %zu", offsetof(struct iwl_prph_scratch, dram),
+          sizeof(struct iwl_prph_scratch));
+
+    CHECK(sizeof(struct iwl_context_info_gen3) == 104, "iwl_context_info_gen3 is %zu bytes",
+          sizeof(struct iwl_context_info_gen3));
+    CHECK(offsetof(struct iwl_context_info_gen3, mtr_base_addr) == 52 &&
+          offsetof(struct iwl_context_info_gen3, prph_scratch_base_addr) == 88, "iwl_context_info_gen3 offsets");
+}
+
+//Sections numbered by their position, separators carry the marker as their device offset
+static uint32_t makeImage(struct FirmwareSectionDMA* sections, uint32_t lmac, uint32_t umac, uint32_t paging) {
+    const uint32_t parts[] = { lmac, umac, paging };
+    uint32_t count = 0;
+
+    memset(sections, 0, sizeof(struct FirmwareSectionDMA) * UCODE_SECTION_MAX);
+    for (int part = 0; part < 3; part++) {
+        if (part) {
+            sections[count].deviceOffset = part == 1 ? CPU1_CPU2_SEPARATOR_SECTION : PAGING_SEPARATOR_SECTION;
+            sections[count].paddr = (uint32_t)SECTION(count);
+            count++;
+        }
+        for (uint32_t i = 0; i < parts[part]; i++, count++) {
+            sections[count].deviceOffset = 0x400000 + count * 0x100;
+            sections[count].paddr = (uint32_t)SECTION(count);
+        }
+    }
+    return count;
+}
+
+static void testDRAMTable() {
+    struct FirmwareSectionDMA sections[UCODE_SECTION_MAX];
+    struct iwl_context_info_dram dram;
+    uint32_t lmac, umac, paging;
+
+    memset(&dram, 0xff, sizeof(dram));
+    uint32_t count = makeImage(sections, 3, 4, 2);
+    CHECK(buildContextInfoDRAM(&dram, sections, count, &lmac, &umac, &paging), "split image");
+    CHECK(lmac == 3 && umac == 4 && paging == 2, "%u LMAC, %u UMAC, %u paging sections", lmac, umac, paging);
+    CHECK(le64_to_cpu(dram.lmac_img[0]) == SECTION(0) && le64_to_cpu(dram.lmac_img[2]) == SECTION(2) &&
+          !dram.lmac_img[3], "LMAC sections");
+    CHECK(le64_to_cpu(dram.umac_img[0]) == SECTION(4) && le64_to_cpu(dram.umac_img[3]) == SECTION(7) &&
+          !dram.umac_img[4], "UMAC sections after the first separator");
+    CHECK(le64_to_cpu(dram.virtual_img[0]) == SECTION(9) && le64_to_cpu(dram.virtual_img[1]) == SECTION(10) &&
+          !dram.virtual_img[2], "paging sections after the second separator");
+
+    //No paging part is fine, the table stops at the end of the image
+    count = makeImage(sections, 2, 2, 0);
+    CHECK(buildContextInfoDRAM(&dram, sections, count - 1, &lmac, &umac, &paging) && paging == 0 &&
+          le64_to_cpu(dram.umac_img[1]) == SECTION(4), "image without paging");
+
+    //An image without the LMAC/UMAC split leaves the table alone
+    memset(&dram, 0xff, sizeof(dram));
+    count = makeImage(sections, 5, 0, 0);
+    CHECK(!buildContextInfoDRAM(&dram, sections, 5, &lmac, &umac, &paging) && lmac == 5 && umac == 0,
+          "image without a separator");
+    CHECK(!buildContextInfoDRAM(&dram, sections, count, &lmac, &umac, &paging), "empty UMAC part");
+    count = makeImage(sections, 0, 3, 0);
+    CHECK(!buildContextInfoDRAM(&dram, sections, count, &lmac, &umac, &paging), "empty LMAC part");
+    CHECK((uint64_t)dram.lmac_img[0] == ~0ULL, "rejected images leave the table alone");
+}
+
+static void testContextInfo() {
+    struct iwl_context_info info;
+
+    memset(&info, 0, sizeof(info));
+    info.dram.lmac_img[0] = cpu_to_le64(SECTION(0));
+    fillContextInfo(&info, MAC_ID, &queues);
+    CHECK(le16_to_cpu(info.version.mac_id) == MAC_ID && info.version.version == 0, "version");
+    CHECK(le16_to_cpu(info.version.size) == 1792 / 4, "size in dwords %u", le16_to_cpu(info.version.size));
+    //TFD format long, 512 RBDs (log2 9) and 4K receive buffers
+    CHECK(le32_to_cpu(info.control.control_flags) == 0x990, "control flags %08x",
+          le32_to_cpu(info.control.control_flags));
+    CHECK(le64_to_cpu(info.rbd_cfg.free_rbd_addr) == queues.freeRBD &&
+          le64_to_cpu(info.rbd_cfg.used_rbd_addr) == queues.usedRBD &&
+          le64_to_cpu(info.rbd_cfg.status_wr_ptr) == queues.rbStatus, "RBD configuration");
+    CHECK(le64_to_cpu(info.hcmd_cfg.cmd_queue_addr) == queues.commandQueue && info.hcmd_cfg.cmd_queue_size == 2,
+          "command queue of %u", info.hcmd_cfg.cmd_queue_size);
+    CHECK(le64_to_cpu(info.dram.lmac_img[0]) == SECTION(0), "cached DRAM table kept");
+}
+
+static void testContextInfoG3() {
+    struct iwl_context_info_gen3 info;
+    struct iwl_prph_scratch scratch;
+    const uint64_t prphScratch = 0x30000000, prphInfo = 0x30001000;
+
+    memset(&info, 0xff, sizeof(info));
+    memset(&scratch, 0, sizeof(scratch));
+    scratch.dram.umac_img[0] = cpu_to_le64(SECTION(1));
+    fillContextInfoG3(&info, &scratch, MAC_ID, &queues, prphScratch, prphInfo, 4096);
+
+    CHECK(le16_to_cpu(scratch.ctrl_cfg.version.mac_id) == MAC_ID &&
+          le16_to_cpu(scratch.ctrl_cfg.version.size) == 1660 / 4, "scratch version");
+    //4K receive buffers, MTR mode and 256 byte MTR format
+    CHECK(le32_to_cpu(scratch.ctrl_cfg.control.control_flags) == 0xf0000, "scratch control flags %08x",
+          le32_to_cpu(scratch.ctrl_cfg.control.control_flags));
+    CHECK(le64_to_cpu(scratch.ctrl_cfg.rbd_cfg.free_rbd_addr) == queues.freeRBD, "scratch free RBDs");
+    CHECK(le64_to_cpu(scratch.dram.umac_img[0]) == SECTION(1), "cached DRAM table kept");
+
+    CHECK(info.version == 0 && info.config == 0 && info.tr_head_idx_arr_base_addr == 0 && info.reserved == 0,
+          "unused fields cleared");
+    CHECK(le64_to_cpu(info.prph_info_base_addr) == prphInfo &&
+          le64_to_cpu(info.prph_scratch_base_addr) == prphScratch &&
+          le32_to_cpu(info.prph_scratch_size) == 1660, "PRPH blocks");
+    CHECK(le64_to_cpu(info.tr_tail_idx_arr_base_addr) == prphInfo + 2048 &&
+          le64_to_cpu(info.cr_tail_idx_arr_base_addr) == prphInfo + 3072, "tail arrays in the PRPH info block");
+    CHECK(le64_to_cpu(info.cr_head_idx_arr_base_addr) == queues.rbStatus &&
+          le64_to_cpu(info.mtr_base_addr) == queues.commandQueue &&
+          le64_to_cpu(info.mcr_base_addr) == queues.usedRBD, "message rings");
+    CHECK(le16_to_cpu(info.mtr_size) == 2 && le16_to_cpu(info.mcr_size) == 9, "ring sizes %u/%u",
+          le16_to_cpu(info.mtr_size), le16_to_cpu(info.mcr_size));
+}
+
+int main() {
+    testLayout();
+    testDRAMTable();
+    testContextInfo();
+    testContextInfoG3();
+    return testResult("ctxt_test");
+}
@@ -0,0 +1,78 @@
+//
+//  devcfg_test.cpp
+//  net80211 host tests
+//
+//  PCI ID lookup used by setDeviceCFG. The table is included with a config
+//  name in place of the iwl_cfg pointer, the cfg definitions themselves need
+//  the Xcode compiler, then every entry and IDs around them are looked up
+//
+
+#include <stddef.h>
+
+#include "hosttest.h"
+#include "wpi/iwlwifi_headers/deviceLookup.h"
+
+struct hostCard {
+    uint16_t device;
+    uint16_t subdevice;
+    const char* config;
+};
+
+#define IWL_PCI_DEVICE(dev, subdev, cfg) \
+.device = (dev), \
+.subdevice = (subdev), \
+.config = #cfg
+
+static constexpr struct hostCard cards[] = {
+#include "wpi/iwlwifi_headers/deviceIDs.h"
+};
+
+#define CARD_COUNT (sizeof(cards) / sizeof(cards[0]))
+
+static_assert(wifiCardsSorted(cards, CARD_COUNT), "deviceIDs.h must be sorted by (device, subdevice)");
+
+static bool inTable(uint32_t device, uint32_t subdevice) {
+    for (size_t i = 0; i < CARD_COUNT; i++) {
+        if (cards[i].device == device && cards[i].subdevice == subdevice) return true;
+    }
+    return false;
+}
+
+static void testEveryEntry() {
+    for (size_t i = 0; i < CARD_COUNT; i++) {
+        const struct hostCard* card = findWifiCard(cards, CARD_COUNT, cards[i].device, cards[i].subdevice);
+        CHECK(card == &cards[i], "%04x:%04x (%s) found %s", cards[i].device, cards[i].subdevice, cards[i].config,
+              card ? card->config : "nothing");
+    }
+}
+
+//Neighbouring subdevices, the ends of the subdevice range and devices outside the table
+static void testMissing() {
+    size_t checked = 0;
+    
+    for (size_t i = 0; i < CARD_COUNT; i++) {
+        const uint32_t device = cards[i].device;
+        const uint32_t probes[][2] = {
+            { device, cards[i].subdevice - 1u }, { device, cards[i].subdevice + 1u },
+            { device, 0x0000 }, { device, 0xffff },
+            { device - 1, cards[i].subdevice }, { device + 1, cards[i].subdevice },
+        };
+        for (const auto& probe : probes) {
+            if (probe[0] > 0xffff || probe[1] > 0xffff || inTable(probe[0], probe[1])) continue;
+            const struct hostCard* card = findWifiCard(cards, CARD_COUNT, (uint16_t)probe[0], (uint16_t)probe[1]);
+            CHECK(card == NULL, "%04x:%04x is not a card but matched %s", probe[0], probe[1], card->config);
+            checked++;
+        }
+    }
+    CHECK(findWifiCard(cards, CARD_COUNT, 0x0000, 0x0000) == NULL, "0000:0000 matched");
+    CHECK(findWifiCard(cards, CARD_COUNT, 0xffff, 0xffff) == NULL, "ffff:ffff matched");
+    CHECK(findWifiCard(cards, 0, cards[0].device, cards[0].subdevice) == NULL, "empty table matched");
+    CHECK(checked > CARD_COUNT, "only %zu missing IDs probed", checked);
+}
+
+int main() {
+    testEveryEntry();
+    testMissing();
+    printf("devcfg_test: %zu PCI IDs\n", CARD_COUNT);
+    return testResult("devcfg_test");
+}
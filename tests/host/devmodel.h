@@ -0,0 +1,264 @@
+//
+//  devmodel.h
+//  net80211 host tests
+//
+//  Behavioural model of the NIC for driving the transport code without
+//  hardware. The register space is plain storage apart from the interrupt,
+//  GP_CNTRL, reset, PRPH window and write pointer registers, which behave
+//  enough like the hardware for bring up and the RX ring to run. RX
+//  completions are written to an RX status buffer in host memory standing in
+//  for the rb_stts DMA the device does
+//
+
+#ifndef _HOST_DEVMODEL_H_
+#define _HOST_DEVMODEL_H_
+
+#include "wpihost.h"
+#include "wpi/iwlwifi_headers/iwl-config.h"
+
+#define DEVICE_MODEL_CSR_SIZE   0x4000  //CSR, FH and MSI-X registers
+#define DEVICE_MODEL_PRPH_SLOTS 256     //Must be a power of two
+
+//iwl_csr_v1 and iwl_csr_v2 are defined in IntelWiFiDriver_io.cpp which needs IOKit
+static const struct iwl_csr_params hostCsrV1 = {
+    .flag_sw_reset = 7,
+    .flag_mac_clock_ready = 0,
+    .flag_init_done = 2,
+    .flag_mac_access_req = 3,
+    .flag_val_mac_access_en = 0,
+    .flag_master_dis = 8,
+    .flag_stop_master = 9,
+    .addr_sw_reset = WPI_HW_IF_CONFIG + 0x020,
+    .mac_addr0_otp = 0x380,
+    .mac_addr1_otp = 0x384,
+    .mac_addr0_strap = 0x388,
+    .mac_addr1_strap = 0x38C
+};
+
+static const struct iwl_csr_params hostCsrV2 = {
+    .flag_sw_reset = 31,
+    .flag_mac_clock_ready = 20,
+    .flag_init_done = 6,
+    .flag_mac_access_req = 21,
+    .flag_val_mac_access_en = 20,
+    .flag_master_dis = 28,
+    .flag_stop_master = 29,
+    .addr_sw_reset = WPI_HW_IF_CONFIG + 0x024,
+    .mac_addr0_otp = 0x30,
+    .mac_addr1_otp = 0x34,
+    .mac_addr0_strap = 0x38,
+    .mac_addr1_strap = 0x3C
+};
+
+struct deviceModelPRPH {
+    uint32_t    address;
+    uint32_t    value;
+    bool        inUse;
+};
+
+struct hostDeviceModel {
+    const struct iwl_csr_params* params;
+    struct iwl_rxq* rxq;            //rb_stts and queue_size of the queue being completed
+    uint32_t    csr[DEVICE_MODEL_CSR_SIZE / 4];
+    struct deviceModelPRPH prph[DEVICE_MODEL_PRPH_SLOTS];
+    uint32_t    prphWriteAddress;
+    uint32_t    rxWrite;            //RX write pointer last posted by the driver
+    uint32_t    rxClosed;           //Index of the next receive buffer the model fills
+    uint32_t    txPending;          //TX doorbells not completed yet
+
+    uint64_t    reads;
+    uint64_t    writes;
+    uint64_t    rxCompletions;
+    uint64_t    txCompletions;
+    uint64_t    rxOverruns;         //RX completions asked for with no free buffer posted
+    uint64_t    interrupts;
+
+    void init(const struct iwl_csr_params* csrParams, struct iwl_rxq* queue) {
+        memset(this, 0, sizeof(*this));
+        params = csrParams;
+        rxq = queue;
+    }
+
+    //Power on state, the counters are kept across resets
+    void reset(uint32_t hardwareRevision) {
+        memset(csr, 0, sizeof(csr));
+        memset(prph, 0, sizeof(prph));
+        prphWriteAddress = 0;
+        rxWrite = 0;
+        rxClosed = 0;
+        txPending = 0;
+        csr[WPI_HW_REV / 4] = hardwareRevision;
+    }
+
+    //Open addressed like the notification table, periphery registers are never released so
+    //an empty slot ends the probe
+    struct deviceModelPRPH* lookupPRPH(uint32_t address, bool create) {
+        uint32_t index = address >> 2;
+
+        for (uint32_t probe = 0; probe < DEVICE_MODEL_PRPH_SLOTS; probe++) {
+            struct deviceModelPRPH* slot = &prph[(index + probe) & (DEVICE_MODEL_PRPH_SLOTS - 1)];
+            if (!slot->inUse) {
+                if (!create) return NULL;
+                slot->inUse = true;
+                slot->address = address;
+                slot->value = 0;
+                return slot;
+            }
+            if (slot->address == address) {
+                return slot;
+            }
+        }
+        return NULL;
+    }
+
+    //busRead32, side effects all happen on write, PRPH_RDATA is filled in when PRPH_RADDR is
+    //written. Outside the modelled BAR reads float like a missing device
+    uint32_t read32(uint32_t offset) {
+        reads++;
+        if (offset >= DEVICE_MODEL_CSR_SIZE) return 0xffffffff;
+        return csr[offset / 4];
+    }
+
+    //busWrite32
+    void write32(uint32_t offset, uint32_t value) {
+        writes++;
+        if (offset >= DEVICE_MODEL_CSR_SIZE) return;
+        uint32_t* reg = &csr[offset / 4];
+
+        switch (offset) {
+            case WPI_INT:
+            case WPI_FH_INT:
+                //Write one to clear
+                *reg &= ~value;
+                return;
+            case WPI_PRPH_WADDR:
+                prphWriteAddress = value & 0x00ffffff;
+                break;
+            case WPI_PRPH_WDATA: {
+                struct deviceModelPRPH* slot = lookupPRPH(prphWriteAddress, true);
+                if (slot) slot->value = value;
+                break;
+            }
+            case WPI_PRPH_RADDR: {
+                struct deviceModelPRPH* slot = lookupPRPH(value & 0x00ffffff, false);
+                csr[WPI_PRPH_RDATA / 4] = slot ? slot->value : 0;
+                break;
+            }
+            case FH_RSCSR_CHNL0_WPTR:
+            case RFH_Q_FRBDCB_WIDX_TRG(0):
+                rxWrite = value;
+                break;
+            case WPI_HBUS_TARG_WRPTR:
+                //22560 posts RX buffers here with the queue above FIRST_RX_QUEUE, anything
+                //else is a TX doorbell
+                if ((value >> 16) >= FIRST_RX_QUEUE) {
+                    rxWrite = value & 0x0fff;
+                } else {
+                    txPending++;
+                }
+                break;
+        }
+        *reg = value;
+
+        //v2 parts keep the reset bits in GP_CNTRL so both checks can apply to one write
+        if (offset == WPI_GP_CNTRL) {
+            //The MAC clock runs once the device is initialised or the driver asks for access
+            uint32_t ready = BIT(params->flag_mac_clock_ready) | BIT(params->flag_val_mac_access_en);
+            if (value & (BIT(params->flag_mac_access_req) | BIT(params->flag_init_done))) {
+                *reg |= ready;
+            } else {
+                *reg &= ~ready;
+            }
+        }
+        if (offset == params->addr_sw_reset) {
+            if (value & BIT(params->flag_sw_reset)) {
+                reset(csr[WPI_HW_REV / 4]);
+                return;
+            }
+            if (value & BIT(params->flag_stop_master)) {
+                *reg |= BIT(params->flag_master_dis);
+            }
+        }
+    }
+
+    //busWrite8, only used for the MSI-X IVAR tables which have no side effects
+    void write8(uint32_t offset, uint8_t value) {
+        writes++;
+        if (offset >= DEVICE_MODEL_CSR_SIZE) return;
+        ((uint8_t*)csr)[offset] = value;
+    }
+
+    //Completes up to rxFrames receive buffers and txFrames TX doorbells and raises the matching
+    //interrupt causes. Returns true if the driver has one of them unmasked and its interrupt
+    //handler has to run
+    bool tick(uint32_t rxFrames, uint32_t txFrames) {
+        uint32_t inta = 0;
+
+        if (rxFrames) {
+            uint32_t size = rxq->queue_size ? rxq->queue_size : RX_QUEUE_SIZE;
+            //Buffers from the last closed one up to the write pointer belong to the device
+            uint32_t available = (rxWrite - rxClosed) & (size - 1);
+            if (rxFrames > available) {
+                rxOverruns += rxFrames - available;
+                rxFrames = available;
+            }
+            if (rxFrames) {
+                rxClosed = (rxClosed + rxFrames) & (size - 1);
+                rxCompletions += rxFrames;
+                //closed_rb_num leads iwl_rb_status and is all of the 22560 status
+                *(volatile __le16*)rxq->rb_stts = cpu_to_le16(rxClosed & 0x0fff);
+                inta |= WPI_INT_FH_RX;
+            }
+        }
+
+        if (txFrames) {
+            if (txFrames > txPending) {
+                txFrames = txPending;
+            }
+            if (txFrames) {
+                txPending -= txFrames;
+                txCompletions += txFrames;
+                inta |= WPI_INT_FH_TX;
+            }
+        }
+
+        if (!inta) return false;
+
+        csr[WPI_INT / 4] |= inta;
+        if (!(csr[WPI_INT / 4] & csr[WPI_MASK / 4])) return false;
+        interrupts++;
+        return true;
+    }
+};
+
+//The register sequence device_attach and the bring up issue before the transport runs, written
+//out here rather than run through the driver: reset the model to its power on state, read the
+//hardware revision, take NIC access and check the PRPH window, then unmask the RX and TX causes
+static inline bool attachDeviceModel(hostDeviceModel* model, uint32_t hardwareRevision) {
+    const struct iwl_csr_params* params = model->params;
+
+    model->reset(hardwareRevision);
+    if (!model->read32(WPI_HW_REV)) return false;
+
+    //grabNICAccess
+    model->write32(WPI_GP_CNTRL, model->read32(WPI_GP_CNTRL) | BIT(params->flag_mac_access_req));
+    uint32_t ready = BIT(params->flag_mac_clock_ready) | BIT(params->flag_val_mac_access_en);
+    int tries;
+    for (tries = 0; tries < 1000; tries++) {
+        if ((model->read32(WPI_GP_CNTRL) & ready) == ready) break;
+    }
+    if (tries == 1000) return false;
+
+    //writePRPHNoGrab and readPRPHNoGrab
+    model->write32(WPI_PRPH_WADDR, (WPI_APMG_CLK_ENA & 0x000fffff) | (3 << 24));
+    model->write32(WPI_PRPH_WDATA, 0x5a5a0001);
+    model->write32(WPI_PRPH_RADDR, (WPI_APMG_CLK_ENA & 0x000fffff) | (3 << 24));
+    if (model->read32(WPI_PRPH_RDATA) != 0x5a5a0001) return false;
+
+    //releaseNICAccess
+    model->write32(WPI_GP_CNTRL, model->read32(WPI_GP_CNTRL) & ~BIT(params->flag_mac_access_req));
+    model->write32(WPI_MASK, WPI_INT_FH_RX | WPI_INT_FH_TX);
+    return true;
+}
+
+#endif /* _HOST_DEVMODEL_H_ */
@@ -0,0 +1,95 @@
+//
+//  devmodel_test.cpp
+//  net80211 host tests
+//
+//  Register behaviour of the device model in devmodel.h: bring up on v1 and
+//  v2 parts, the PRPH window, the RX write pointer of each transport
+//  generation and completions written to the RX status
+//
+
+#include "hosttest.h"
+#include "devmodel.h"
+
+static hostDeviceModel model;
+static struct iwl_rxq rxq;
+static __le16 rbStatus[8];
+
+static void setUp(const struct iwl_csr_params* params, uint32_t queueSize) {
+    memset(&rxq, 0, sizeof(rxq));
+    memset(rbStatus, 0, sizeof(rbStatus));
+    rxq.queue_size = queueSize;
+    rxq.rb_stts = rbStatus;
+    model.init(params, &rxq);
+}
+
+static void testAttach() {
+    setUp(&hostCsrV1, RX_QUEUE_SIZE);
+    CHECK(!attachDeviceModel(&model, 0), "attached without a hardware revision");
+    CHECK(attachDeviceModel(&model, 0x140), "v1 attach");
+    CHECK(model.read32(WPI_HW_REV) == 0x140, "HW_REV %08x", model.read32(WPI_HW_REV));
+    CHECK(!(model.read32(WPI_GP_CNTRL) & BIT(hostCsrV1.flag_mac_clock_ready)), "clock ready after release");
+    CHECK(model.read32(DEVICE_MODEL_CSR_SIZE) == 0xffffffff, "read past the BAR");
+
+    setUp(&hostCsrV2, MQ_RX_TABLE_SIZE);
+    CHECK(attachDeviceModel(&model, 0x340), "v2 attach");
+    model.write32(WPI_GP_CNTRL, BIT(hostCsrV2.flag_init_done));
+    CHECK(model.read32(WPI_GP_CNTRL) & BIT(hostCsrV2.flag_mac_clock_ready), "v2 clock ready on init done");
+
+    //v2 keeps the reset bits in GP_CNTRL
+    model.write32(hostCsrV2.addr_sw_reset, BIT(hostCsrV2.flag_stop_master));
+    CHECK(model.read32(hostCsrV2.addr_sw_reset) & BIT(hostCsrV2.flag_master_dis), "master disabled");
+    model.write32(WPI_PRPH_WADDR, 0x1234 | (3 << 24));
+    model.write32(WPI_PRPH_WDATA, 7);
+    model.write32(hostCsrV2.addr_sw_reset, BIT(hostCsrV2.flag_sw_reset));
+    CHECK(model.read32(WPI_HW_REV) == 0x340 && model.read32(WPI_MASK) == 0, "SW reset keeps only HW_REV");
+    model.write32(WPI_PRPH_RADDR, 0x1234 | (3 << 24));
+    CHECK(model.read32(WPI_PRPH_RDATA) == 0, "SW reset clears the periphery");
+}
+
+static void testInterrupts() {
+    setUp(&hostCsrV1, RX_QUEUE_SIZE);
+    attachDeviceModel(&model, 0x140);
+
+    model.write32(FH_RSCSR_CHNL0_WPTR, 16);
+    CHECK(model.tick(4, 0), "unmasked RX interrupt");
+    CHECK(model.read32(WPI_INT) == (uint32_t)WPI_INT_FH_RX && le16_to_cpu(rbStatus[0]) == 4, "closed_rb_num %u",
+          le16_to_cpu(rbStatus[0]));
+    model.write32(WPI_INT, WPI_INT_FH_RX);
+    CHECK(model.read32(WPI_INT) == 0, "INT is write one to clear");
+
+    model.write32(WPI_MASK, 0);
+    CHECK(!model.tick(4, 0) && model.read32(WPI_INT) == (uint32_t)WPI_INT_FH_RX, "masked cause still latched");
+    CHECK(!model.tick(0, 1), "nothing to complete");
+    CHECK(model.interrupts == 1 && model.rxCompletions == 8 && model.txCompletions == 0, "counters");
+
+    //Only the buffers up to the write pointer can be filled
+    model.tick(20, 0);
+    CHECK(model.rxCompletions == 16 && model.rxOverruns == 12 && le16_to_cpu(rbStatus[0]) == 16, "overrun");
+}
+
+//Each generation posts its RX write pointer to a different register
+static void testWritePointers() {
+    setUp(&hostCsrV1, MQ_RX_TABLE_SIZE);
+    attachDeviceModel(&model, 0x310);
+    model.write32(RFH_Q_FRBDCB_WIDX_TRG(0), 8);
+    model.tick(MQ_RX_TABLE_SIZE, 0);
+    CHECK(model.rxCompletions == 8, "9000 write pointer %u", (uint32_t)model.rxCompletions);
+
+    setUp(&hostCsrV2, MQ_RX_TABLE_SIZE);
+    attachDeviceModel(&model, 0x340);
+    model.write32(WPI_HBUS_TARG_WRPTR, 24 | (FIRST_RX_QUEUE << 16));
+    model.write32(WPI_HBUS_TARG_WRPTR, 3 | (4 << 8));
+    model.write32(WPI_HBUS_TARG_WRPTR, 4 | (4 << 8));
+    CHECK(model.rxWrite == 24 && model.txPending == 2, "22560 RX pointer %u, %u doorbells", model.rxWrite,
+          model.txPending);
+    CHECK(model.tick(MQ_RX_TABLE_SIZE, 5) && model.read32(WPI_INT) == (uint32_t)(WPI_INT_FH_RX | WPI_INT_FH_TX),
+          "both causes");
+    CHECK(model.rxCompletions == 24 && model.txCompletions == 2 && model.txPending == 0, "22560 completions");
+}
+
+int main() {
+    testAttach();
+    testInterrupts();
+    testWritePointers();
+    return testResult("devmodel_test");
+}
@@ -0,0 +1,228 @@
+//
+//  fwparse_test.cpp
+//  net80211 host tests
+//
+//  TLV firmware parser checks. A synthetic image covers the fields the driver
+//  uses and every truncation of it, then any real .ucode files given on the
+//  command line (or found in $UCODE_DIR, /lib/firmware by default) are parsed
+//  and timed
+//
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/errno.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <vector>
+#include <string>
+
+#include "hosttest.h"
+#include "wpi/Firmware.hpp"
+
+static void putLE32(std::vector<uint8_t>& image, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        image.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static void putTLV(std::vector<uint8_t>& image, uint32_t type, const std::vector<uint8_t>& data) {
+    putLE32(image, type);
+    putLE32(image, (uint32_t)data.size());
+    image.insert(image.end(), data.begin(), data.end());
+    while (image.size() & 3) {
+        image.push_back(0);
+    }
+}
+
+static std::vector<uint8_t> words(std::initializer_list<uint32_t> values) {
+    std::vector<uint8_t> data;
+    for (uint32_t value : values) {
+        putLE32(data, value);
+    }
+    return data;
+}
+
+//Section payload prefixed with its load address, length chosen to need padding
+static std::vector<uint8_t> section(uint32_t address, uint32_t length, uint8_t fill) {
+    std::vector<uint8_t> data = words({ address });
+    data.insert(data.end(), length, fill);
+    return data;
+}
+
+static bool testBit(const u_long* bitmap, uint32_t bit) {
+    return bitmap[bit / (8 * sizeof(u_long))] >> (bit % (8 * sizeof(u_long))) & 1;
+}
+
+static std::vector<uint8_t> buildImage() {
+    std::vector<uint8_t> image;
+    char name[UCODE_HUMAN_READABLE_SIZE] = "host-test 1.2.3";
+
+    putLE32(image, 0);
+    putLE32(image, UCODE_TLV_MAGIC);
+    image.insert(image.end(), name, name + sizeof(name));
+    putLE32(image, 0x11223344);
+    putLE32(image, 42);
+    image.insert(image.end(), 8, 0);
+
+    putTLV(image, UCODE_TLV_NUM_OF_CPU, words({ 2 }));
+    putTLV(image, UCODE_TLV_FLAGS, words({ 0x5, 0xffffffff }));
+    putTLV(image, UCODE_TLV_API_CHANGES_SET, words({ 1, 0x3 }));
+    putTLV(image, UCODE_TLV_ENABLED_CAPABILITIES, words({ 0, 0x80000001 }));
+    putTLV(image, UCODE_TLV_SEC_INIT, section(0x00400000, 33, 0xa1));
+    putTLV(image, UCODE_TLV_SEC_RT, section(0x00404000, 100, 0xb1));
+    putTLV(image, UCODE_TLV_SEC_RT, section(0x00800000, 7, 0xb2));
+    putTLV(image, UCODE_TLV_SEC_RT, section(0xaaaabbbb, 0, 0));
+    putTLV(image, UCODE_TLV_PAGING, words({ 2 * UCODE_PAGING_PAGE_SIZE }));
+    putTLV(image, UCODE_TLV_CMD_VERSIONS, std::vector<uint8_t>({ 1, 0, 2, 3, 9, 4, 1, 1 }));
+    putTLV(image, UCODE_TLV_FW_RECOVERY_INFO, words({ 0x00c0ffee, 0x80 }));
+    //Unknown TLVs are skipped, the last one has no padding
+    image.resize(image.size() + 8);
+    memcpy(&image[image.size() - 8], words({ 0x7fff, 1 }).data(), 8);
+    image.push_back(0xee);
+    return image;
+}
+
+static void testSyntheticImage() {
+    std::vector<uint8_t> image = buildImage();
+    struct FirmwareFile file;
+    struct UCodeCapabilities capabilities;
+
+    CHECK(parseFirmwareFile(image.data(), image.size(), &file, &capabilities) == 0,
+          "synthetic image rejected at offset %u", file.errorOffset);
+    CHECK(!strcmp(file.humanReadable, "host-test 1.2.3"), "human readable version %s", file.humanReadable);
+    CHECK(file.ucodeVersion == 0x11223344 && file.build == 42, "version %08x build %u", file.ucodeVersion, file.build);
+    CHECK(file.numberOfCPUs == 2 && file.images[REGULAR].isDualCPUs, "dual CPU image");
+    CHECK(capabilities.flags == 0x5, "flags %08x", capabilities.flags);
+    CHECK(testBit(capabilities.api, 32) && testBit(capabilities.api, 33) && !testBit(capabilities.api, 34),
+          "API bits 32 and 33");
+    CHECK(testBit(capabilities.capa, 0) && testBit(capabilities.capa, 31), "capability bits 0 and 31");
+    CHECK(file.images[INIT].sectionCount == 1 && file.images[REGULAR].sectionCount == 3, "section counts %u %u",
+          file.images[INIT].sectionCount, file.images[REGULAR].sectionCount);
+
+    const struct FirmwareSection* rt = file.images[REGULAR].sections;
+    CHECK(rt[0].deviceOffset == 0x00404000 && rt[0].length == 100 && image[rt[0].offset] == 0xb1 &&
+          image[rt[0].offset + 99] == 0xb1, "first runtime section");
+    CHECK(rt[1].deviceOffset == 0x00800000 && rt[1].length == 7 && image[rt[1].offset + 6] == 0xb2,
+          "second runtime section");
+    CHECK(rt[2].deviceOffset == 0xaaaabbbb && rt[2].length == 0, "separator section");
+    CHECK(file.images[REGULAR].pagingMemSize == 2 * UCODE_PAGING_PAGE_SIZE, "paging size");
+    CHECK(capabilities.commandVersionsCount == 2 && capabilities.commandVersions[1].cmd == 9 &&
+          capabilities.commandVersions[1].notif_ver == 1, "command versions");
+    CHECK(capabilities.errorLogAddress == 0x00c0ffee && capabilities.errorLogSize == 0x80, "recovery info");
+}
+
+//Every prefix is copied into a buffer of exactly that size so anything read past the end
+//shows up under a sanitizer, parsed ranges have to lie within the prefix either way
+static void testTruncation() {
+    std::vector<uint8_t> image = buildImage();
+    struct FirmwareFile file;
+    struct UCodeCapabilities capabilities;
+    size_t accepted = 0;
+
+    for (size_t length = 0; length < image.size(); length++) {
+        uint8_t* prefix = (uint8_t*)malloc(length ? length : 1);
+        memcpy(prefix, image.data(), length);
+
+        if (parseFirmwareFile(prefix, length, &file, &capabilities) == 0) {
+            accepted++;
+            for (int type = 0; type < TYPE_MAX; type++) {
+                for (uint32_t i = 0; i < file.images[type].sectionCount; i++) {
+                    const struct FirmwareSection* s = &file.images[type].sections[i];
+                    CHECK((size_t)s->offset + s->length <= length, "prefix %zu: section past the end", length);
+                }
+            }
+            CHECK((const uint8_t*)(capabilities.commandVersions + capabilities.commandVersionsCount) <= prefix + length,
+                  "prefix %zu: command versions past the end", length);
+        } else {
+            CHECK(file.errorOffset <= length, "prefix %zu: error offset %u", length, file.errorOffset);
+        }
+        free(prefix);
+    }
+    //Only cuts at a TLV boundary after the first runtime section make a valid file
+    CHECK(accepted > 0 && accepted < 10, "%zu truncated images accepted", accepted);
+
+    //Lengths running past the end of the file
+    for (size_t offset = sizeof(struct TLVUCodeHeader); offset + 8 <= image.size(); offset += 4) {
+        std::vector<uint8_t> corrupt = image;
+        uint32_t huge = 0xfffffff0;
+        memcpy(&corrupt[offset], &huge, sizeof(huge));
+        if (parseFirmwareFile(corrupt.data(), corrupt.size(), &file, &capabilities) == 0) {
+            for (uint32_t i = 0; i < file.images[REGULAR].sectionCount; i++) {
+                const struct FirmwareSection* s = &file.images[REGULAR].sections[i];
+                CHECK((size_t)s->offset + s->length <= corrupt.size(), "corrupt word at %zu: section past the end", offset);
+            }
+        }
+    }
+}
+
+static long peakRSSKilobytes() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void parseFile(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    std::vector<uint8_t> data(size > 0 ? size : 0);
+    size_t got = fread(data.data(), 1, data.size(), f);
+    fclose(f);
+    if (got != data.size()) return;
+
+    struct FirmwareFile file;
+    struct UCodeCapabilities capabilities;
+    const int runs = 100;
+    long rssBefore = peakRSSKilobytes();
+    uint64_t start = monotonicNanoseconds();
+    int error = 0;
+    for (int i = 0; i < runs; i++) {
+        error = parseFirmwareFile(data.data(), data.size(), &file, &capabilities);
+    }
+    uint64_t elapsed = (monotonicNanoseconds() - start) / runs;
+    long rssAfter = peakRSSKilobytes();
+
+    const char* name = strrchr(path.c_str(), '/');
+    name = name ? name + 1 : path.c_str();
+    CHECK(error == 0, "%s: rejected (%d) at offset %u", name, error, file.errorOffset);
+    printf("  %-40s %8zu bytes  rt %2u init %2u  %6llu ns  peak RSS +%ld KB  %s\n", name, data.size(),
+           file.images[REGULAR].sectionCount, file.images[INIT].sectionCount, (unsigned long long)elapsed,
+           rssAfter - rssBefore, file.humanReadable);
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> files;
+
+    testSyntheticImage();
+    testTruncation();
+
+    for (int i = 1; i < argc; i++) {
+        files.push_back(argv[i]);
+    }
+    if (files.empty()) {
+        const char* dir = getenv("UCODE_DIR") ? getenv("UCODE_DIR") : "/lib/firmware";
+        if (DIR* d = opendir(dir)) {
+            while (struct dirent* entry = readdir(d)) {
+                size_t length = strlen(entry->d_name);
+                if (!strncmp(entry->d_name, "iwlwifi-", 8) && length > 6 &&
+                    !strcmp(entry->d_name + length - 6, ".ucode")) {
+                    files.push_back(std::string(dir) + "/" + entry->d_name);
+                }
+            }
+            closedir(d);
+        }
+    }
+
+    if (files.empty()) {
+        printf("fwparse_test: no .ucode files given or found, only the synthetic image was parsed\n");
+    } else {
+        printf("fwparse_test: parser state %zu bytes, nothing allocated per file\n",
+               sizeof(struct FirmwareFile) + sizeof(struct UCodeCapabilities));
+        for (const std::string& path : files) {
+            parseFile(path);
+        }
+    }
+    return testResult("fwparse_test");
+}
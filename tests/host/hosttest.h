@@ -0,0 +1,109 @@
+//
+//  hosttest.h
+//  net80211 host tests
+//
+//  Minimal check macros shared by the host test programs
+//
+
+#ifndef _HOSTTEST_H_
+#define _HOSTTEST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+static int testFailures;
+
+#define CHECK(cond, ...) do {                                           \
+    if (!(cond)) {                                                      \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);                 \
+        fprintf(stderr, __VA_ARGS__);                                   \
+        fputc('\n', stderr);                                            \
+        testFailures++;                                                 \
+    }                                                                   \
+} while (0)
+
+//Decode a hex string into out, returns the number of bytes written
+static inline size_t hexDecode(const char* hex, uint8_t* out, size_t size) {
+    size_t n = 0;
+    while (hex[0] && hex[1] && n < size) {
+        unsigned int byte;
+        sscanf(hex, "%2x", &byte);
+        out[n++] = (uint8_t)byte;
+        hex += 2;
+    }
+    return n;
+}
+
+static inline bool hexEqual(const uint8_t* data, const char* hex, size_t length) {
+    uint8_t expected[256];
+    return hexDecode(hex, expected, sizeof(expected)) == length && !memcmp(data, expected, length);
+}
+
+static inline uint64_t monotonicNanoseconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//User space instructions retired by this thread, for benchmarks whose time is too
+//short to compare between hosts. open() returns -1 where the counter is not available
+//(not Linux, perf_event_paranoid, no PMU in a VM) and the benchmarks only print times
+struct instructionCounter {
+    int fd;
+
+    bool open() {
+        fd = -1;
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+        return fd >= 0;
+    }
+
+    void start() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    uint64_t stop() {
+        uint64_t count = 0;
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) != sizeof(count)) count = 0;
+        }
+#endif
+        return count;
+    }
+
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+};
+
+static inline int testResult(const char* name) {
+    printf("%s: %s\n", name, testFailures ? "FAILED" : "ok");
+    return testFailures ? 1 : 0;
+}
+
+#endif /* _HOSTTEST_H_ */
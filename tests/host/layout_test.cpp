@@ -0,0 +1,100 @@
+//
+//  layout_test.cpp
+//  net80211 host tests
+//
+//  pahole style dump of the PCIDevice fast path blocks with the checks that go
+//  with it: each block stays on the cache lines it was given and the holes
+//  inside it are reported. IOKit objects are placeholders on the host but the
+//  fast path only holds pointers, so the offsets are the ones the kext gets on
+//  x86_64
+//
+
+#include "hosttest.h"
+#include "wpihost.h"
+#include "wpi/DrvStructs.hpp"
+
+struct fieldLayout {
+    const char* name;
+    size_t offset;
+    size_t size;
+};
+
+#define FIELD(name) { #name, offsetof(PCIDevice, name), sizeof(((PCIDevice*)0)->name) }
+
+//Interrupt handler and register access, first cache line
+static const struct fieldLayout interruptPath[] = {
+    FIELD(deviceMemoryMapVAddr),
+    FIELD(deviceConfig),
+    FIELD(NICAccessLock),
+    FIELD(NICAccessOwner),
+    FIELD(NICAccessDepth),
+    FIELD(intaBitMask),
+    FIELD(msixFHMask),
+    FIELD(msixHWMask),
+    FIELD(msixEnabled),
+    FIELD(holdNICAwake),
+    FIELD(comandInFlight),
+    FIELD(status),
+};
+
+//RX/TX queue state, second and third cache lines
+static const struct fieldLayout queuePath[] = {
+    FIELD(rxq),
+    FIELD(trans),
+    FIELD(tfdSize),
+    FIELD(maxTBS),
+    FIELD(commandQueue),
+    FIELD(rxQCount),
+};
+
+//Prints the block like pahole and checks it lies within [firstLine, lastLine]
+static void checkBlock(const char* name, const struct fieldLayout* fields, size_t count, size_t firstLine,
+                       size_t lastLine) {
+    size_t end = fields[0].offset;
+    size_t holes = 0;
+
+    printf("  /* %s, cache lines %zu-%zu */\n", name, firstLine, lastLine);
+    for (size_t i = 0; i < count; i++) {
+        const struct fieldLayout* field = &fields[i];
+        if (field->offset > end) {
+            printf("  /* XXX %zu bytes hole */\n", field->offset - end);
+            holes += field->offset - end;
+        }
+        if (field->offset / PCIDEVICE_CACHE_LINE != end / PCIDEVICE_CACHE_LINE && i > 0) {
+            printf("  /* --- cacheline %zu boundary (%zu bytes) --- */\n", field->offset / PCIDEVICE_CACHE_LINE,
+                   field->offset / PCIDEVICE_CACHE_LINE * PCIDEVICE_CACHE_LINE);
+        }
+        printf("  %-24s /* %5zu %5zu */\n", field->name, field->offset, field->size);
+
+        CHECK(field->offset >= end, "%s overlaps the field before it", field->name);
+        CHECK(field->offset / PCIDEVICE_CACHE_LINE >= firstLine, "%s starts before cache line %zu", field->name,
+              firstLine);
+        CHECK((field->offset + field->size - 1) / PCIDEVICE_CACHE_LINE <= lastLine,
+              "%s at %zu size %zu ends past cache line %zu", field->name, field->offset, field->size, lastLine);
+        end = field->offset + field->size;
+    }
+    size_t used = end - fields[0].offset;
+    size_t available = (lastLine + 1) * PCIDEVICE_CACHE_LINE - fields[0].offset;
+    printf("  /* size: %zu, holes: %zu bytes, free: %zu bytes */\n\n", used, holes, available - used);
+}
+
+int main() {
+    printf("layout_test: struct PCIDevice {\n");
+    checkBlock("interrupt and register access", interruptPath, ARRAY_SIZE(interruptPath), 0, 0);
+    checkBlock("RX/TX queues", queuePath, ARRAY_SIZE(queuePath), 1, 2);
+    printf("  txQueues                 /* %5zu %5zu */\n", offsetof(PCIDevice, txQueues), sizeof(((PCIDevice*)0)->txQueues));
+    printf("  /* size: %zu, cold state from %zu */\n};\n", sizeof(PCIDevice), offsetof(PCIDevice, device));
+
+    CHECK(offsetof(PCIDevice, rxq) == PCIDEVICE_CACHE_LINE, "RX/TX block starts at %zu", offsetof(PCIDevice, rxq));
+    CHECK(offsetof(PCIDevice, txQueues) == 3 * PCIDEVICE_CACHE_LINE, "txQueues starts at %zu",
+          offsetof(PCIDevice, txQueues));
+    CHECK(offsetof(PCIDevice, device) > offsetof(PCIDevice, txq_stopped), "cold state before the TX bitmaps");
+
+    //Statistics stripes must not share cache lines, the trace formats are read by tools
+    CHECK(sizeof(struct hardwareStatisticsStripe) % 64 == 0 && alignof(struct hardwareStatisticsStripe) == 64,
+          "hardwareStatisticsStripe is %zu bytes aligned to %zu", sizeof(struct hardwareStatisticsStripe),
+          alignof(struct hardwareStatisticsStripe));
+    CHECK(sizeof(struct mmioTraceEntry) == 12, "mmioTraceEntry is %zu bytes", sizeof(struct mmioTraceEntry));
+    CHECK(sizeof(struct mmioTraceHeader) == 16, "mmioTraceHeader is %zu bytes", sizeof(struct mmioTraceHeader));
+    return testResult("layout_test");
+}
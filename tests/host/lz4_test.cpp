@@ -0,0 +1,202 @@
+//
+//  lz4_test.cpp
+//  net80211 host tests
+//
+//  LZ4 block decoder checks: the embedded 3945 firmware sections written by
+//  tools/fwcompress.py, round trips through a small encoder, and corrupt
+//  blocks (truncated input, match offsets outside the output, output overruns)
+//  which must fail without writing past the end of the destination
+//
+
+#include <stdlib.h>
+#include <vector>
+
+#include "hosttest.h"
+#include "wpireg.h"
+#include "lz4.h"
+#include "wpi/Firmware.h"
+
+#define GUARD_BYTES 64
+#define GUARD       0xa5
+
+//Destination with guard bytes behind it, lz4_decompress is only given size bytes
+struct output {
+    std::vector<uint8_t> buffer;
+    size_t size;
+
+    explicit output(size_t bytes) : buffer(bytes + GUARD_BYTES, GUARD), size(bytes) {}
+
+    int decompress(const std::vector<uint8_t>& src) {
+        return lz4_decompress(src.data(), src.size(), buffer.data(), size);
+    }
+
+    bool guardIntact() const {
+        for (size_t i = size; i < buffer.size(); i++) {
+            if (buffer[i] != GUARD) return false;
+        }
+        return true;
+    }
+};
+
+static void putLength(std::vector<uint8_t>* out, size_t length) {
+    for (; length >= 255; length -= 255) {
+        out->push_back(255);
+    }
+    out->push_back((uint8_t)length);
+}
+
+static void putSequence(std::vector<uint8_t>* out, const uint8_t* literals, size_t literalLength, size_t offset,
+                        size_t matchLength) {
+    size_t match = offset ? matchLength - 4 : 0;
+    out->push_back((uint8_t)((literalLength < 15 ? literalLength : 15) << 4 | (match < 15 ? match : 15)));
+    if (literalLength >= 15) putLength(out, literalLength - 15);
+    out->insert(out->end(), literals, literals + literalLength);
+    if (!offset) return;
+    out->push_back((uint8_t)offset);
+    out->push_back((uint8_t)(offset >> 8));
+    if (match >= 15) putLength(out, match - 15);
+}
+
+//Greedy encoder with one candidate per hash, keeping the rules of the reference encoder
+//tools/fwcompress.py follows: the last 5 bytes are literals and no match starts in the last 12
+static std::vector<uint8_t> compress(const std::vector<uint8_t>& src) {
+    std::vector<uint8_t> out;
+    std::vector<int64_t> table(1 << 12, -1);
+    size_t n = src.size(), anchor = 0, i = 0;
+
+    while (n >= 12 && i < n - 12) {
+        uint32_t word;
+        memcpy(&word, &src[i], 4);
+        uint32_t hash = (word * 2654435761U) >> 20;
+        int64_t candidate = table[hash];
+        table[hash] = (int64_t)i;
+        if (candidate < 0 || i - candidate > 65535 || memcmp(&src[candidate], &src[i], 4)) {
+            i++;
+            continue;
+        }
+        size_t length = 4;
+        while (i + length < n - 5 && src[candidate + length] == src[i + length]) {
+            length++;
+        }
+        putSequence(&out, &src[anchor], i - anchor, i - candidate, length);
+        i += length;
+        anchor = i;
+    }
+    putSequence(&out, src.data() + anchor, n - anchor, 0, 0);
+    return out;
+}
+
+static void testFirmware() {
+    const struct wpi_firmware_hdr* hdr = (const struct wpi_firmware_hdr*)Intel3945FirmwareImage;
+    const struct wpi_firmware_lz4_hdr* lz4 = (const struct wpi_firmware_lz4_hdr*)(hdr + 1);
+    const uint32_t sizes[] = { hdr->main_textsz, hdr->main_datasz, hdr->init_textsz, hdr->init_datasz };
+    const uint32_t compressed[] = { lz4->main_textcsz, lz4->main_datacsz, lz4->init_textcsz, lz4->init_datacsz };
+    const uint8_t* section = (const uint8_t*)(lz4 + 1);
+    uint32_t raw = sizeof(*hdr) + hdr->boot_textsz;
+
+    CHECK(lz4->magic == WPI_FW_LZ4_MAGIC, "firmware magic %08x", lz4->magic);
+    for (int i = 0; i < 4; i++) {
+        std::vector<uint8_t> src(section, section + compressed[i]);
+        output exact(sizes[i]), short1(sizes[i] - 1);
+
+        CHECK(exact.decompress(src) == (int)sizes[i] && exact.guardIntact(), "firmware section %d", i);
+        CHECK(short1.decompress(src) == -1 && short1.guardIntact(), "firmware section %d into a short buffer", i);
+        section += compressed[i];
+        raw += sizes[i];
+    }
+    CHECK(raw == Intel3945FirmwareImage_rawlen, "sections add up to %u bytes", raw);
+    CHECK(section + hdr->boot_textsz == Intel3945FirmwareImage + Intel3945FirmwareImage_len, "boot code at the end");
+}
+
+static void testRoundTrip() {
+    std::vector<std::vector<uint8_t>> inputs;
+    std::vector<uint8_t> data;
+
+    inputs.push_back(data);
+    inputs.push_back(std::vector<uint8_t>(11, 'x'));
+    //Runs overlapping their own output and lengths needing extension bytes
+    inputs.push_back(std::vector<uint8_t>(5000, 0));
+    srand(1);
+    for (int i = 0; i < 100000; i++) {
+        data.push_back((uint8_t)rand());
+    }
+    inputs.push_back(data);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (i % 1000 < 600) ? (uint8_t)(i % 7) : data[i];
+    }
+    inputs.push_back(data);
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        std::vector<uint8_t> compressed = compress(inputs[i]);
+        output out(inputs[i].size());
+        CHECK(out.decompress(compressed) == (int)inputs[i].size() && out.guardIntact() &&
+              !memcmp(out.buffer.data(), inputs[i].data(), inputs[i].size()), "round trip %zu", i);
+    }
+}
+
+static void testMalformed() {
+    //"abcd", a 6 byte match 4 back, then "12345": "abcdabcdab12345"
+    const uint8_t valid[] = { 0x42, 'a', 'b', 'c', 'd', 4, 0, 0x50, '1', '2', '3', '4', '5' };
+    std::vector<uint8_t> block(valid, valid + sizeof(valid));
+    std::vector<uint8_t> bad;
+
+    output out(15);
+    CHECK(out.decompress(block) == 15 && !memcmp(out.buffer.data(), "abcdabcdab12345", 15), "valid block");
+
+    //Every truncation either fails or decodes a prefix, never more
+    for (size_t length = 0; length < block.size(); length++) {
+        std::vector<uint8_t> truncated(block.begin(), block.begin() + length);
+        output cut(15);
+        int result = cut.decompress(truncated);
+        CHECK(result <= 15 && cut.guardIntact(), "truncated to %zu bytes", length);
+        if (length == 6) CHECK(result == -1, "truncated inside the offset");
+    }
+    bad.assign({ 0xf0 });
+    CHECK(output(64).decompress(bad) == -1, "literal length extension missing");
+    bad.assign({ 0x4f, 'a', 'b', 'c', 'd', 4, 0, 255 });
+    CHECK(output(512).decompress(bad) == -1, "match length extension cut short");
+
+    //Offsets of zero or reaching before the start of the output
+    bad = block;
+    bad[5] = 0;
+    CHECK(output(15).decompress(bad) == -1, "zero offset");
+    bad[5] = 5;
+    CHECK(output(15).decompress(bad) == -1, "offset before the output");
+    bad[5] = 0;
+    bad[6] = 1;
+    CHECK(output(15).decompress(bad) == -1, "offset 256 bytes back");
+
+    //Output one byte short in the literals, the match and the last literals
+    for (size_t size = 0; size < 15; size++) {
+        output small(size);
+        CHECK(small.decompress(block) == -1 && small.guardIntact(), "%zu byte output", size);
+    }
+
+    //Random corruption never writes past the output
+    std::vector<uint8_t> original(3000);
+    for (size_t i = 0; i < original.size(); i++) {
+        original[i] = (uint8_t)((i * 7) % 13 + (i / 500));
+    }
+    std::vector<uint8_t> compressed = compress(original);
+    srand(2);
+    for (int round = 0; round < 20000; round++) {
+        std::vector<uint8_t> corrupt = compressed;
+        for (int flips = 1 + rand() % 4; flips > 0; flips--) {
+            corrupt[rand() % corrupt.size()] ^= (uint8_t)(1 << (rand() % 8));
+        }
+        if (rand() % 4 == 0) corrupt.resize(rand() % corrupt.size());
+        output fuzzed(original.size());
+        int result = fuzzed.decompress(corrupt);
+        if (result > (int)original.size() || !fuzzed.guardIntact()) {
+            CHECK(false, "corrupt block %d wrote past the output", round);
+            break;
+        }
+    }
+}
+
+int main() {
+    testFirmware();
+    testRoundTrip();
+    testMalformed();
+    return testResult("lz4_test");
+}
@@ -0,0 +1,117 @@
+//
+//  mmiobus.h
+//  net80211 host tests
+//
+//  Register accesses made the way IntelWiFiDriver_io.cpp makes them, against a
+//  plain register file while recording and against a loaded trace while
+//  replaying, with the same MMIOTrace.cpp engine as the kext
+//
+
+#ifndef _HOST_MMIOBUS_H_
+#define _HOST_MMIOBUS_H_
+
+#include <stdlib.h>
+
+#include "wpireg.h"
+#include "wpi/MMIOTrace.hpp"
+
+#define MMIO_BUS_BYTES 0x4000 //CSR, FH and MSI-X registers
+
+struct hostMMIOBus {
+    struct mmioTrace trace;
+    bool replay;
+    uint32_t prphMask;
+    uint64_t stepNanoseconds;   //Recorded gap between accesses
+    uint32_t registers[MMIO_BUS_BYTES / 4];
+
+    void init(bool replaying, uint32_t mask = 0x000fffff) {
+        memset(&trace, 0, sizeof(trace));
+        trace.entries = (struct mmioTraceEntry*)calloc(MMIO_TRACE_ENTRIES, sizeof(struct mmioTraceEntry));
+        memset(registers, 0, sizeof(registers));
+        replay = replaying;
+        prphMask = mask;
+        stepNanoseconds = 50;
+    }
+
+    void destroy() {
+        free(trace.entries);
+        trace.entries = NULL;
+    }
+
+    //busRead32, busWrite32 and busWrite8
+    uint32_t read32(uint32_t offset) {
+        if (replay) return replayMMIOAccess(&trace, mmioRead32, offset, 0);
+        uint32_t value = registers[(offset % MMIO_BUS_BYTES) / 4];
+        recordMMIOAccess(&trace, mmioRead32, offset, value, stepNanoseconds);
+        return value;
+    }
+
+    void write32(uint32_t offset, uint32_t value) {
+        if (replay) {
+            replayMMIOAccess(&trace, mmioWrite32, offset, value);
+            return;
+        }
+        recordMMIOAccess(&trace, mmioWrite32, offset, value, stepNanoseconds);
+        registers[(offset % MMIO_BUS_BYTES) / 4] = value;
+    }
+
+    void write8(uint32_t offset, uint8_t value) {
+        if (replay) {
+            replayMMIOAccess(&trace, mmioWrite8, offset, value);
+            return;
+        }
+        recordMMIOAccess(&trace, mmioWrite8, offset, value, stepNanoseconds);
+        ((uint8_t*)registers)[offset % MMIO_BUS_BYTES] = value;
+    }
+
+    //The kext only records annotations, they are counted on replay for the report
+    void annotate(enum mmioTraceOp op, uint32_t address, uint32_t value) {
+        if (replay) {
+            trace.ops[op]++;
+            return;
+        }
+        recordMMIOAccess(&trace, op, address, value, 0);
+    }
+
+    //readPRPHNoGrab, writePRPHNoGrab, busReadShr and busWriteShr
+    uint32_t readPRPH(uint32_t offset) {
+        write32(WPI_PRPH_RADDR, (offset & prphMask) | 3 << 24);
+        uint32_t value = read32(WPI_PRPH_RDATA);
+        annotate(mmioReadPRPH, offset, value);
+        return value;
+    }
+
+    void writePRPH(uint32_t offset, uint32_t value) {
+        write32(WPI_PRPH_WADDR, (offset & prphMask) | (3 << 24));
+        write32(WPI_PRPH_WDATA, value);
+        annotate(mmioWritePRPH, offset, value);
+    }
+
+    uint32_t readShr(uint32_t address) {
+        write32(HEEP_CTRL_WRD_PCIEX_CRTL_REG, (address & 0x0000ffff) | (2 << 28));
+        uint32_t value = read32(HEEP_CTRL_WRD_PCIEX_DATA_REG);
+        annotate(mmioReadShr, address, value);
+        return value;
+    }
+
+    void writeShr(uint32_t address, uint32_t value) {
+        write32(HEEP_CTRL_WRD_PCIEX_DATA_REG, value);
+        write32(HEEP_CTRL_WRD_PCIEX_CRTL_REG, (address & 0x0000ffff) | (3 << 28));
+        annotate(mmioWriteShr, address, value);
+    }
+};
+
+//Interrupt handling and RX restock as the driver does them, round picks the values written
+static inline void mmioWorkload(hostMMIOBus* bus, uint32_t round) {
+    uint32_t interrupts = bus->read32(WPI_INT);
+    bus->write32(WPI_INT, interrupts);
+    bus->write32(WPI_FH_INT, bus->read32(WPI_FH_INT));
+    bus->writePRPH(WPI_APMG_CLK_ENA, round);
+    bus->readPRPH(WPI_APMG_PS);
+    bus->writeShr(0x1f0, round ^ 0x5a5a);
+    bus->readShr(0x1f0);
+    bus->write8(WPI_FH_RX_WPTR, (uint8_t)(round & ~7));
+    bus->write32(WPI_HBUS_TARG_WRPTR, round & 0xff);
+}
+
+#endif /* _HOST_MMIOBUS_H_ */
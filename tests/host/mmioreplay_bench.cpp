@@ -0,0 +1,151 @@
+//
+//  mmioreplay_bench.cpp
+//  net80211 host tests
+//
+//  Host replay driver for traces saved from debug.voodoo80211.mmio_trace. Each
+//  trace given on the command line is loaded into the replay engine and driven
+//  in its recorded order: CSR accesses are reissued as they are, PRPH and SHR
+//  accesses through the same register sequences the driver uses, so a trace
+//  that does not decompose the way IntelWiFiDriver_io.cpp writes it shows up as
+//  mismatches. Without arguments a synthetic trace is recorded and replayed.
+//  The replay rate is printed next to the recorded time of the trace
+//
+//  mmioreplay_bench [--prph-mask=0xffffff] [trace...]
+//
+
+#include <stdlib.h>
+#include <vector>
+#include <string>
+
+#include "hosttest.h"
+#include "mmiobus.h"
+
+static hostMMIOBus bus;
+
+static bool readFile(const std::string& path, std::vector<uint8_t>* data) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data->resize(size > 0 ? size : 0);
+    size_t got = fread(data->data(), 1, data->size(), f);
+    fclose(f);
+    return got == data->size();
+}
+
+static inline enum mmioTraceOp entryOp(const struct mmioTraceEntry* entry) {
+    return (enum mmioTraceOp)(entry->address >> 24);
+}
+
+//Issue the accesses of entries against the loaded trace. entries is a copy of the trace,
+//the engine consumes its own
+static void drive(const struct mmioTraceEntry* entries, uint32_t count) {
+    for (uint32_t i = 0; i < count;) {
+        const struct mmioTraceEntry* entry = &entries[i];
+        uint32_t address = entry->address & 0x00ffffff;
+
+        //Each annotation follows the two CSR accesses that make it up
+        if (i + 2 < count && entryOp(&entries[i + 2]) >= mmioReadPRPH) {
+            const struct mmioTraceEntry* note = &entries[i + 2];
+            uint32_t noteAddress = note->address & 0x00ffffff;
+            switch (entryOp(note)) {
+                case mmioReadPRPH:  bus.readPRPH(noteAddress); break;
+                case mmioWritePRPH: bus.writePRPH(noteAddress, note->value); break;
+                case mmioReadShr:   bus.readShr(noteAddress); break;
+                default:            bus.writeShr(noteAddress, note->value); break;
+            }
+            i += 3;
+            continue;
+        }
+        switch (entryOp(entry)) {
+            case mmioRead32:  bus.read32(address); break;
+            case mmioWrite32: bus.write32(address, entry->value); break;
+            case mmioWrite8:  bus.write8(address, (uint8_t)entry->value); break;
+            //An annotation without its accesses, the ring wrapped inside it
+            default: break;
+        }
+        i++;
+    }
+}
+
+static int replay(const char* name, const std::vector<uint8_t>& saved) {
+    const struct mmioTraceHeader* header = (const struct mmioTraceHeader*)saved.data();
+    int error = loadMMIOTrace(&bus.trace, saved.data(), saved.size());
+    if (error) {
+        fprintf(stderr, "%s: not a trace (%d)\n", name, error);
+        return 1;
+    }
+    std::vector<struct mmioTraceEntry> entries(bus.trace.entries, bus.trace.entries + bus.trace.count);
+    uint64_t recorded = 0;
+    for (const struct mmioTraceEntry& entry : entries) {
+        recorded += entry.delta;
+    }
+
+    const int runs = 20;
+    uint64_t start = monotonicNanoseconds();
+    for (int run = 0; run < runs; run++) {
+        bus.trace.head = 0;
+        bus.trace.mismatches = 0;
+        memset(bus.trace.ops, 0, sizeof(bus.trace.ops));
+        drive(entries.data(), (uint32_t)entries.size());
+    }
+    uint64_t elapsed = (monotonicNanoseconds() - start) / runs;
+    uint64_t accesses = bus.trace.ops[mmioRead32] + bus.trace.ops[mmioWrite32] + bus.trace.ops[mmioWrite8];
+
+    printf("  %-28s %6u entries (%u dropped)  r %llu w %llu w8 %llu  prph %llu/%llu shr %llu/%llu\n", name,
+           header->count, header->dropped, (unsigned long long)bus.trace.ops[mmioRead32],
+           (unsigned long long)bus.trace.ops[mmioWrite32], (unsigned long long)bus.trace.ops[mmioWrite8],
+           (unsigned long long)bus.trace.ops[mmioReadPRPH], (unsigned long long)bus.trace.ops[mmioWritePRPH],
+           (unsigned long long)bus.trace.ops[mmioReadShr], (unsigned long long)bus.trace.ops[mmioWriteShr]);
+    printf("  %-28s recorded %llu us, replayed in %llu us, %.1f ns/access, %u mismatches\n", "",
+           (unsigned long long)(recorded / 1000), (unsigned long long)(elapsed / 1000),
+           accesses ? (double)elapsed / accesses : 0.0, bus.trace.mismatches);
+    CHECK(bus.trace.mismatches == 0, "%s: %u mismatches", name, bus.trace.mismatches);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    uint32_t prphMask = 0x000fffff;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "--prph-mask=", 12)) {
+            prphMask = (uint32_t)strtoul(argv[i] + 12, NULL, 0);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    printf("mmioreplay_bench:\n");
+    if (files.empty()) {
+        bus.init(false, prphMask);
+        for (uint32_t round = 0; round < 4096; round++) {
+            bus.registers[WPI_INT / 4] = round;
+            mmioWorkload(&bus, round);
+        }
+        std::vector<uint8_t> saved(savedMMIOTraceSize(&bus.trace));
+        saved.resize(saveMMIOTrace(&bus.trace, saved.data(), saved.size()));
+        bus.destroy();
+
+        bus.init(true, prphMask);
+        replay("synthetic workload", saved);
+        bus.destroy();
+        return testResult("mmioreplay_bench");
+    }
+
+    for (const std::string& path : files) {
+        std::vector<uint8_t> saved;
+        const char* name = strrchr(path.c_str(), '/');
+        name = name ? name + 1 : path.c_str();
+        if (!readFile(path, &saved)) {
+            fprintf(stderr, "%s: cannot read\n", path.c_str());
+            testFailures++;
+            continue;
+        }
+        bus.init(true, prphMask);
+        testFailures += replay(name, saved);
+        bus.destroy();
+    }
+    return testResult("mmioreplay_bench");
+}
@@ -0,0 +1,161 @@
+//
+//  mmiotrace_test.cpp
+//  net80211 host tests
+//
+//  MMIO trace engine checks. Accesses recorded on the host bus are saved in the
+//  layout debug.voodoo80211.mmio_trace exports, loaded back and replayed, then
+//  the replay is made to diverge and saved traces are corrupted
+//
+
+#include <sys/errno.h>
+#include <vector>
+
+#include "hosttest.h"
+#include "mmiobus.h"
+
+static std::vector<uint8_t> save(const struct mmioTrace* trace) {
+    std::vector<uint8_t> buffer(savedMMIOTraceSize(trace));
+    size_t length = saveMMIOTrace(trace, buffer.data(), buffer.size());
+    CHECK(length == buffer.size(), "saved %zu of %zu bytes", length, buffer.size());
+    return buffer;
+}
+
+static const struct mmioTraceHeader* header(const std::vector<uint8_t>& saved) {
+    return (const struct mmioTraceHeader*)saved.data();
+}
+
+static const struct mmioTraceEntry* entries(const std::vector<uint8_t>& saved) {
+    return (const struct mmioTraceEntry*)(header(saved) + 1);
+}
+
+static void testRecord() {
+    static hostMMIOBus bus;
+    bus.init(false);
+
+    CHECK(sizeof(struct mmioTraceEntry) == 12 && sizeof(struct mmioTraceHeader) == 16, "trace layout");
+    mmioWorkload(&bus, 1);
+    //4 interrupt accesses, 3 per PRPH and SHR access, the RX write pointers
+    CHECK(bus.trace.head == 18, "%llu entries recorded", (unsigned long long)bus.trace.head);
+    CHECK(bus.trace.ops[mmioRead32] == 4 && bus.trace.ops[mmioWrite32] == 9 && bus.trace.ops[mmioWrite8] == 1 &&
+          bus.trace.ops[mmioWritePRPH] == 1 && bus.trace.ops[mmioReadShr] == 1, "op counts");
+
+    std::vector<uint8_t> saved = save(&bus.trace);
+    CHECK(header(saved)->magic == MMIO_TRACE_MAGIC && header(saved)->version == MMIO_TRACE_VERSION &&
+          header(saved)->entrySize == 12 && header(saved)->count == 18 && header(saved)->dropped == 0, "header");
+    CHECK(entries(saved)[0].address == (mmioRead32 << 24 | WPI_INT), "first entry %08x", entries(saved)[0].address);
+    CHECK(entries(saved)[6].address == (mmioWritePRPH << 24 | WPI_APMG_CLK_ENA) && entries(saved)[6].value == 1,
+          "PRPH annotation after its CSR accesses");
+    CHECK(entries(saved)[0].delta == 50 && entries(saved)[6].delta == 0, "deltas");
+
+    //Gaps saturate instead of wrapping
+    recordMMIOAccess(&bus.trace, mmioRead32, 0, 0, 1ULL << 40);
+    CHECK(bus.trace.entries[18].delta == UINT32_MAX, "saturated delta %u", bus.trace.entries[18].delta);
+    bus.destroy();
+}
+
+static void testWrap() {
+    static hostMMIOBus bus;
+    bus.init(false);
+
+    for (uint32_t i = 0; i < MMIO_TRACE_ENTRIES + 100; i++) {
+        bus.write32(WPI_HBUS_TARG_WRPTR, i);
+    }
+    std::vector<uint8_t> saved = save(&bus.trace);
+    CHECK(header(saved)->count == MMIO_TRACE_ENTRIES && header(saved)->dropped == 100, "count %u dropped %u",
+          header(saved)->count, header(saved)->dropped);
+    CHECK(entries(saved)[0].value == 100 && entries(saved)[MMIO_TRACE_ENTRIES - 1].value == MMIO_TRACE_ENTRIES + 99,
+          "oldest entries overwritten");
+
+    //A short buffer keeps the newest entries
+    std::vector<uint8_t> small(sizeof(struct mmioTraceHeader) + 10 * sizeof(struct mmioTraceEntry) + 5);
+    CHECK(saveMMIOTrace(&bus.trace, small.data(), small.size()) == small.size() - 5, "short save");
+    CHECK(header(small)->count == 10 && entries(small)[9].value == MMIO_TRACE_ENTRIES + 99, "newest kept");
+    CHECK(saveMMIOTrace(&bus.trace, small.data(), sizeof(struct mmioTraceHeader) - 1) == 0, "no room for header");
+    bus.destroy();
+}
+
+static void testReplay() {
+    static hostMMIOBus recorder, player;
+    recorder.init(false);
+    player.init(true);
+
+    for (uint32_t round = 0; round < 100; round++) {
+        recorder.registers[WPI_INT / 4] = round * 3;
+        recorder.registers[WPI_PRPH_RDATA / 4] = ~round;
+        mmioWorkload(&recorder, round);
+    }
+    std::vector<uint8_t> saved = save(&recorder.trace);
+    CHECK(loadMMIOTrace(&player.trace, saved.data(), saved.size()) == 0, "load");
+
+    bool readsMatch = true;
+    for (uint32_t round = 0; round < 100; round++) {
+        readsMatch &= player.read32(WPI_INT) == round * 3;
+        player.write32(WPI_INT, round * 3);
+        player.write32(WPI_FH_INT, player.read32(WPI_FH_INT));
+        player.writePRPH(WPI_APMG_CLK_ENA, round);
+        readsMatch &= player.readPRPH(WPI_APMG_PS) == ~round;
+        player.writeShr(0x1f0, round ^ 0x5a5a);
+        player.readShr(0x1f0);
+        player.write8(WPI_FH_RX_WPTR, (uint8_t)(round & ~7));
+        player.write32(WPI_HBUS_TARG_WRPTR, round & 0xff);
+    }
+    CHECK(readsMatch, "replayed reads return the recorded values");
+    CHECK(player.trace.mismatches == 0, "%u mismatches", player.trace.mismatches);
+    CHECK(player.trace.head == player.trace.count, "trace consumed");
+    CHECK(player.trace.ops[mmioWrite32] == recorder.trace.ops[mmioWrite32], "replayed writes");
+
+    //Past the end reads look like a removed device
+    CHECK(player.read32(WPI_INT) == ~0U && player.trace.mismatches == 1, "read past the end");
+
+    //A different value, register or access type each count once
+    CHECK(loadMMIOTrace(&player.trace, saved.data(), saved.size()) == 0, "reload");
+    player.read32(WPI_INT);
+    player.write32(WPI_INT, 12345);
+    player.read32(WPI_MASK);
+    player.write8(WPI_FH_INT, 0);
+    CHECK(player.trace.mismatches == 3, "%u mismatches after diverging", player.trace.mismatches);
+
+    recorder.destroy();
+    player.destroy();
+}
+
+static void testLoadErrors() {
+    static hostMMIOBus recorder, player;
+    recorder.init(false);
+    player.init(true);
+    mmioWorkload(&recorder, 7);
+    std::vector<uint8_t> saved = save(&recorder.trace);
+    std::vector<uint8_t> corrupt;
+
+    CHECK(loadMMIOTrace(&player.trace, saved.data(), sizeof(struct mmioTraceHeader) - 1) == -EINVAL, "short header");
+    corrupt = saved;
+    ((struct mmioTraceHeader*)corrupt.data())->magic ^= 1;
+    CHECK(loadMMIOTrace(&player.trace, corrupt.data(), corrupt.size()) == -EINVAL, "magic");
+    corrupt = saved;
+    ((struct mmioTraceHeader*)corrupt.data())->version++;
+    CHECK(loadMMIOTrace(&player.trace, corrupt.data(), corrupt.size()) == -EINVAL, "version");
+    corrupt = saved;
+    ((struct mmioTraceHeader*)corrupt.data())->entrySize = 16;
+    CHECK(loadMMIOTrace(&player.trace, corrupt.data(), corrupt.size()) == -EINVAL, "entry size");
+    CHECK(loadMMIOTrace(&player.trace, saved.data(), saved.size() - 1) == -E2BIG, "truncated entries");
+    corrupt = saved;
+    ((struct mmioTraceHeader*)corrupt.data())->count = MMIO_TRACE_ENTRIES + 1;
+    CHECK(loadMMIOTrace(&player.trace, corrupt.data(), corrupt.size()) == -E2BIG, "count past the ring");
+    CHECK(player.trace.count == 0, "failed loads leave the trace alone");
+
+    struct mmioTrace unallocated;
+    memset(&unallocated, 0, sizeof(unallocated));
+    CHECK(loadMMIOTrace(&unallocated, saved.data(), saved.size()) == -ENOMEM, "no ring");
+    CHECK(savedMMIOTraceSize(&unallocated) == 0, "nothing to save");
+
+    recorder.destroy();
+    player.destroy();
+}
+
+int main() {
+    testRecord();
+    testWrap();
+    testReplay();
+    testLoadErrors();
+    return testResult("mmiotrace_test");
+}
@@ -0,0 +1,91 @@
+//
+//  restock_bench.cpp
+//  net80211 host tests
+//
+//  Cost of handing RX buffers back to the device per transport generation.
+//  Each round frees a batch of buffers and restocks them, the rounds are run
+//  again with only the freeing to subtract it. Instructions are counted where
+//  perf events are available, times are printed either way
+//
+
+#include "hosttest.h"
+#include "rxring.h"
+
+#define ROUNDS 20000
+
+static hostRxRing ring;
+
+struct restockCost {
+    double nanoseconds;
+    double instructions;
+};
+
+template <class Trans>
+static uint64_t runRounds(uint32_t batch, bool restock, instructionCounter* counter, uint64_t* instructions) {
+    uint32_t misaligned = 0;
+    uint32_t first = 0;
+
+    ring.init();
+    counter->start();
+    uint64_t start = monotonicNanoseconds();
+    for (int round = 0; round < ROUNDS; round++) {
+        ring.free(first, batch);
+        first += batch;
+        if (restock) {
+            restockRxQueue<Trans>(&ring.rxq, &misaligned);
+        } else {
+            //Empty the list the way restock would so the next round starts the same
+            TAILQ_INIT(&ring.freeList);
+            ring.rxq.free_count = 0;
+            __asm__ volatile("" ::: "memory");
+        }
+    }
+    uint64_t elapsed = monotonicNanoseconds() - start;
+    *instructions = counter->stop();
+    CHECK(misaligned == 0, "%u misaligned buffers", misaligned);
+    return elapsed;
+}
+
+template <class Trans>
+static struct restockCost measure(uint32_t batch, instructionCounter* counter) {
+    uint64_t restockInstructions, freeInstructions;
+    //Warm up the ring and the buffers
+    runRounds<Trans>(batch, true, counter, &restockInstructions);
+    uint64_t restockTime = runRounds<Trans>(batch, true, counter, &restockInstructions);
+    uint64_t freeTime = runRounds<Trans>(batch, false, counter, &freeInstructions);
+    double rbds = (double)ROUNDS * batch;
+    struct restockCost cost;
+
+    cost.nanoseconds = restockTime > freeTime ? (restockTime - freeTime) / rbds : 0;
+    cost.instructions = restockInstructions > freeInstructions ? (restockInstructions - freeInstructions) / rbds : 0;
+    return cost;
+}
+
+template <class Trans>
+static void benchGeneration(const char* name, instructionCounter* counter) {
+    static const uint32_t batches[] = { 1, 8, 32, 128 };
+
+    for (uint32_t batch : batches) {
+        struct restockCost cost = measure<Trans>(batch, counter);
+        if (counter->fd >= 0) {
+            printf("  %-16s batch %3u  %6.2f ns/RBD  %6.1f instructions/RBD\n", name, batch, cost.nanoseconds,
+                   cost.instructions);
+        } else {
+            printf("  %-16s batch %3u  %6.2f ns/RBD\n", name, batch, cost.nanoseconds);
+        }
+    }
+}
+
+int main() {
+    instructionCounter counter;
+
+    if (!counter.open()) {
+        printf("restock_bench: instruction counter not available, printing times only\n");
+    }
+    printf("restock_bench: %d rounds per batch size\n", ROUNDS);
+    benchGeneration<TransGen1>("gen1 (7000/8000)", &counter);
+    benchGeneration<TransGen1MQ>("gen1 multiqueue", &counter);
+    benchGeneration<TransGen3>("gen3 (22560)", &counter);
+    counter.close();
+    return testResult("restock_bench");
+}
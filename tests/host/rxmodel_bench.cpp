@@ -0,0 +1,117 @@
+//
+//  rxmodel_bench.cpp
+//  net80211 host tests
+//
+//  RX ring cost per transport generation against the device model. The model
+//  completes a batch of receive buffers and raises FH_RX, a stand-in for the
+//  interrupt handler acks it, reads the closed RB index from the RX status,
+//  frees the buffers, restocks them and posts the write pointer. Interleaved TX
+//  doorbells are completed with the same interrupt. Only restockRxQueue and the
+//  transport policies in IntelWiFiDriver_trans.hpp are driver code: the
+//  interrupt and write pointer glue below is written for the bench, the driver
+//  handlers need IOKit and handleRxINT does not process the ring yet, so the
+//  numbers are not the driver's per frame cost. Time and register accesses are
+//  printed per frame
+//
+
+#include "hosttest.h"
+#include "rxring.h"
+#include "devmodel.h"
+
+#define FRAMES (1 << 20)
+
+static hostRxRing ring;
+static hostDeviceModel model;
+static __le16 rbStatus[8];
+
+struct rxDriver {
+    uint32_t nextBuffer;    //Buffers are freed in the order they were restocked
+    uint32_t misaligned;
+    uint64_t received;
+    uint64_t txDone;
+};
+
+//Same rounding as rxQueueIncrementWritePointerT without the wakeup check, the device only
+//sees multiples of 8
+template <class Trans>
+static void postWritePointer(struct iwl_rxq* rxq) {
+    if (rxq->write_actual == (rxq->write & ~0x7)) return;
+    rxq->write_actual = round_down(rxq->write, 8);
+    model.write32(Trans::rxWritePointerOffset(rxq), Trans::rxWritePointerValue(rxq));
+}
+
+template <class Trans>
+static void freeAndRestock(struct rxDriver* driver, uint32_t count) {
+    ring.free(driver->nextBuffer, count);
+    driver->nextBuffer = (driver->nextBuffer + count) % MQ_RX_TABLE_SIZE;
+    restockRxQueue<Trans>(&ring.rxq, &driver->misaligned);
+    postWritePointer<Trans>(&ring.rxq);
+}
+
+//Stand-in for interruptHandler and an RX handler that consumes the ring
+template <class Trans>
+static void handleInterrupt(struct rxDriver* driver) {
+    struct iwl_rxq* rxq = &ring.rxq;
+    uint32_t inta = model.read32(WPI_INT);
+
+    model.write32(WPI_INT, inta);
+    if (inta & WPI_INT_FH_TX) {
+        driver->txDone++;
+    }
+    if (!(inta & WPI_INT_FH_RX)) return;
+
+    uint32_t closed = le16_to_cpu(*(volatile __le16*)rxq->rb_stts) & 0x0fff;
+    uint32_t count = (closed - rxq->read) & Trans::rxQueueMask;
+    rxq->read = closed;
+    driver->received += count;
+    freeAndRestock<Trans>(driver, count);
+}
+
+template <class Trans>
+static void benchGeneration(const char* name, const struct iwl_csr_params* params, uint32_t hardwareRevision) {
+    static const uint32_t batches[] = { 1, 8, 32, 64 };
+
+    for (uint32_t batch : batches) {
+        struct rxDriver driver;
+        memset(&driver, 0, sizeof(driver));
+        ring.init();
+        ring.rxq.queue_size = Trans::rxQueueMask + 1;
+        ring.rxq.rb_stts = rbStatus;
+        memset(rbStatus, 0, sizeof(rbStatus));
+        model.init(params, &ring.rxq);
+        if (!attachDeviceModel(&model, hardwareRevision)) {
+            CHECK(false, "%s: attach failed", name);
+            return;
+        }
+
+        //Leave a write pointer step free so a full ring does not look empty
+        freeAndRestock<Trans>(&driver, Trans::rxQueueMask + 1 - 8);
+        uint64_t accesses = model.reads + model.writes;
+        uint64_t start = monotonicNanoseconds();
+        for (uint32_t frame = 0; frame < FRAMES; frame += batch) {
+            //One TX doorbell per RX batch, queue 4 is the first data queue
+            model.write32(WPI_HBUS_TARG_WRPTR, (frame & 0xff) | (4 << 8));
+            if (model.tick(batch, 1)) {
+                handleInterrupt<Trans>(&driver);
+            }
+        }
+        uint64_t elapsed = monotonicNanoseconds() - start;
+        accesses = model.reads + model.writes - accesses;
+
+        printf("  %-16s batch %3u  %6.2f ns/frame  %5.2f accesses/frame  %llu interrupts\n", name, batch,
+               (double)elapsed / FRAMES, (double)accesses / FRAMES, (unsigned long long)model.interrupts);
+        CHECK(driver.received == FRAMES && model.rxCompletions == FRAMES, "%s: %llu frames received", name,
+              (unsigned long long)driver.received);
+        CHECK(model.rxOverruns == 0 && driver.misaligned == 0, "%s: %llu overruns", name,
+              (unsigned long long)model.rxOverruns);
+        CHECK(driver.txDone == model.interrupts && model.txPending == 0, "%s: TX completions", name);
+    }
+}
+
+int main() {
+    printf("rxmodel_bench: %d frames per batch size\n", FRAMES);
+    benchGeneration<TransGen1>("gen1 (7000/8000)", &hostCsrV1, 0x140);
+    benchGeneration<TransGen1MQ>("gen1 multiqueue", &hostCsrV1, 0x310);
+    benchGeneration<TransGen3>("gen3 (22560)", &hostCsrV2, 0x340);
+    return testResult("rxmodel_bench");
+}
@@ -0,0 +1,51 @@
+//
+//  rxring.h
+//  net80211 host tests
+//
+//  An RX queue with its descriptor ring and receive buffers in host memory,
+//  for driving restockRxQueue without a device
+//
+
+#ifndef _HOST_RXRING_H_
+#define _HOST_RXRING_H_
+
+#include <type_traits>
+
+#include "wpihost.h"
+#include "wpi/IntelWiFiDriver_trans.hpp"
+
+//Large enough for MQ_RX_TABLE_SIZE transfer descriptors, the biggest RBD format
+#define RX_RING_BYTES (MQ_RX_TABLE_SIZE * sizeof(struct iwl_rx_transfer_desc))
+
+struct hostRxRing {
+    typedef std::remove_pointer<decltype(iwl_rxq::rx_free)>::type FreeList;
+
+    struct iwl_rxq rxq;
+    FreeList freeList;
+    struct iwl_rx_mem_buffer buffers[MQ_RX_TABLE_SIZE];
+    uint8_t bd[RX_RING_BYTES] __attribute__((aligned(256)));
+
+    //Buffers get 4K aligned addresses and their index as the virtual RB ID
+    void init() {
+        memset(&rxq, 0, sizeof(rxq));
+        memset(bd, 0, sizeof(bd));
+        rxq.bd = bd;
+        rxq.rx_free = &freeList;
+        TAILQ_INIT(&freeList);
+        for (uint32_t i = 0; i < MQ_RX_TABLE_SIZE; i++) {
+            buffers[i].page_dma = 0x12340000000ULL + (uint64_t)i * 4096;
+            buffers[i].vid = (u16)i;
+            buffers[i].invalid = true;
+        }
+    }
+
+    //Queue count buffers starting at first on rx_free
+    void free(uint32_t first, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            TAILQ_INSERT_TAIL(&freeList, &buffers[(first + i) % MQ_RX_TABLE_SIZE], list);
+        }
+        rxq.free_count += count;
+    }
+};
+
+#endif /* _HOST_RXRING_H_ */
@@ -0,0 +1,62 @@
+//
+//  IOLib.h
+//  net80211 host tests
+//
+//  The parts of IOKit/IOLib.h and libkern/OSAtomic.h the iwlwifi headers use,
+//  so the transport and layout headers build on the host. Locks are never
+//  taken by the code built here
+//
+
+#ifndef _HOST_IOKIT_IOLIB_H_
+#define _HOST_IOKIT_IOLIB_H_
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libkern/OSByteOrder.h>
+
+typedef uint8_t  UInt8;
+typedef uint16_t UInt16;
+typedef uint32_t UInt32;
+typedef uint64_t UInt64;
+typedef int8_t   SInt8;
+typedef int16_t  SInt16;
+typedef int32_t  SInt32;
+typedef int64_t  SInt64;
+typedef uint64_t IOPhysicalAddress64;
+typedef uint64_t bus_addr_t;
+typedef uint64_t IOByteCount;
+typedef struct IOSimpleLock IOSimpleLock;
+typedef struct _IOLock IOLock;
+
+#define OS_INLINE static inline
+
+#define IOLog printf
+#define IOMalloc(size) malloc(size)
+#define IOFree(p, size) free(p)
+#define IODelay(us) usleep(us)
+#define IOSleep(ms) usleep((ms) * 1000)
+#define IOSimpleLockAlloc() ((IOSimpleLock*)NULL)
+#define IOSimpleLockLock(lock) ((void)(lock))
+#define IOSimpleLockUnlock(lock) ((void)(lock))
+#define OSSynchronizeIO() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#define OSIncrementAtomic(p) __atomic_fetch_add((p), 1, __ATOMIC_SEQ_CST)
+#define OSDecrementAtomic(p) __atomic_fetch_sub((p), 1, __ATOMIC_SEQ_CST)
+#define OSAddAtomic(v, p) __atomic_fetch_add((volatile SInt32*)(p), (v), __ATOMIC_SEQ_CST)
+
+//Bits are numbered from the most significant bit of the first byte like xnu
+static inline bool OSTestAndSet(uint32_t bit, volatile UInt8* address) {
+    UInt8 mask = 0x80 >> (bit & 7);
+    return __atomic_fetch_or(&address[bit >> 3], mask, __ATOMIC_SEQ_CST) & mask;
+}
+
+static inline bool OSTestAndClear(uint32_t bit, volatile UInt8* address) {
+    UInt8 mask = 0x80 >> (bit & 7);
+    return __atomic_fetch_and(&address[bit >> 3], (UInt8)~mask, __ATOMIC_SEQ_CST) & mask;
+}
+
+#endif /* _HOST_IOKIT_IOLIB_H_ */
@@ -0,0 +1,13 @@
+//
+//  thread.h
+//  net80211 host tests
+//
+//  Opaque thread handle of kern/thread.h
+//
+
+#ifndef _HOST_KERN_THREAD_H_
+#define _HOST_KERN_THREAD_H_
+
+typedef struct thread* thread_t;
+
+#endif /* _HOST_KERN_THREAD_H_ */
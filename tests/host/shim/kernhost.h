@@ -0,0 +1,20 @@
+//
+//  kernhost.h
+//  net80211 host tests
+//
+//  Definitions the xnu headers make visible everywhere, force included into the
+//  driver sources built for the host
+//
+
+#ifndef _HOST_KERNHOST_H_
+#define _HOST_KERNHOST_H_
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef __packed
+#define __packed __attribute__((__packed__))
+#endif
+
+#endif /* _HOST_KERNHOST_H_ */
@@ -0,0 +1,46 @@
+//
+//  OSByteOrder.h
+//  net80211 host tests
+//
+//  Byte order helpers of libkern/OSByteOrder.h
+//
+
+#ifndef _HOST_LIBKERN_OSBYTEORDER_H_
+#define _HOST_LIBKERN_OSBYTEORDER_H_
+
+#include <stdint.h>
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define __LITTLE_ENDIAN__ 1
+#define OSSwapHostToLittleInt16(x) ((uint16_t)(x))
+#define OSSwapHostToLittleInt32(x) ((uint32_t)(x))
+#define OSSwapHostToLittleInt64(x) ((uint64_t)(x))
+#define OSSwapHostToBigInt16(x) __builtin_bswap16(x)
+#define OSSwapHostToBigInt32(x) __builtin_bswap32(x)
+#define OSSwapHostToBigInt64(x) __builtin_bswap64(x)
+#else
+#define __BIG_ENDIAN__ 1
+#define OSSwapHostToLittleInt16(x) __builtin_bswap16(x)
+#define OSSwapHostToLittleInt32(x) __builtin_bswap32(x)
+#define OSSwapHostToLittleInt64(x) __builtin_bswap64(x)
+#define OSSwapHostToBigInt16(x) ((uint16_t)(x))
+#define OSSwapHostToBigInt32(x) ((uint32_t)(x))
+#define OSSwapHostToBigInt64(x) ((uint64_t)(x))
+#endif
+#define OSSwapLittleToHostInt16(x) OSSwapHostToLittleInt16(x)
+#define OSSwapLittleToHostInt32(x) OSSwapHostToLittleInt32(x)
+#define OSSwapLittleToHostInt64(x) OSSwapHostToLittleInt64(x)
+#define OSSwapBigToHostInt16(x) OSSwapHostToBigInt16(x)
+#define OSSwapBigToHostInt32(x) OSSwapHostToBigInt32(x)
+#define OSSwapBigToHostInt64(x) OSSwapHostToBigInt64(x)
+
+#define OSWriteLittleInt16(base, offset, data) \
+(*(volatile uint16_t*)((uintptr_t)(base) + (offset)) = OSSwapHostToLittleInt16(data))
+#define OSWriteLittleInt32(base, offset, data) \
+(*(volatile uint32_t*)((uintptr_t)(base) + (offset)) = OSSwapHostToLittleInt32(data))
+#define OSReadLittleInt16(base, offset) \
+OSSwapLittleToHostInt16(*(volatile uint16_t*)((uintptr_t)(base) + (offset)))
+#define OSReadLittleInt32(base, offset) \
+OSSwapLittleToHostInt32(*(volatile uint32_t*)((uintptr_t)(base) + (offset)))
+
+#endif /* _HOST_LIBKERN_OSBYTEORDER_H_ */
@@ -0,0 +1,16 @@
+//
+//  OSKextLib.h
+//  net80211 host tests
+//
+//  Types of libkern/OSKextLib.h held in the driver structures
+//
+
+#ifndef _HOST_LIBKERN_OSKEXTLIB_H_
+#define _HOST_LIBKERN_OSKEXTLIB_H_
+
+#include <stdint.h>
+
+typedef uint32_t OSKextRequestTag;
+typedef int OSReturn;
+
+#endif /* _HOST_LIBKERN_OSKEXTLIB_H_ */
@@ -0,0 +1,25 @@
+//
+//  md5.h
+//  net80211 host tests
+//
+//  libkern MD5 interface. HMAC-MD5 is not covered by the host tests so the
+//  functions only have to link
+//
+
+#ifndef _HOST_LIBKERN_CRYPTO_MD5_H_
+#define _HOST_LIBKERN_CRYPTO_MD5_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef struct {
+    uint32_t state[4];
+    uint32_t count[2];
+    unsigned char buffer[64];
+} MD5_CTX;
+
+static inline void MD5Init(MD5_CTX* ctx) { abort(); }
+static inline void MD5Update(MD5_CTX* ctx, const void* data, unsigned int len) { abort(); }
+static inline void MD5Final(unsigned char digest[16], MD5_CTX* ctx) { abort(); }
+
+#endif /* _HOST_LIBKERN_CRYPTO_MD5_H_ */
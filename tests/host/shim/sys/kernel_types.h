@@ -0,0 +1,16 @@
+//
+//  kernel_types.h
+//  net80211 host tests
+//
+//  Opaque kernel types referenced by the driver structures
+//
+
+#ifndef _HOST_SYS_KERNEL_TYPES_H_
+#define _HOST_SYS_KERNEL_TYPES_H_
+
+#include <sys/types.h>
+
+typedef struct __ifnet* ifnet_t;
+typedef struct __mbuf* mbuf_t;
+
+#endif /* _HOST_SYS_KERNEL_TYPES_H_ */
@@ -0,0 +1,17 @@
+//
+//  systm.h
+//  net80211 host tests
+//
+//  Kernel libc subset used by the sources built on the host
+//
+
+#ifndef _HOST_SYS_SYSTM_H_
+#define _HOST_SYS_SYSTM_H_
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#endif /* _HOST_SYS_SYSTM_H_ */
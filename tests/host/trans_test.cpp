@@ -0,0 +1,96 @@
+//
+//  trans_test.cpp
+//  net80211 host tests
+//
+//  RX restock of each transport generation in IntelWiFiDriver_trans.hpp: the
+//  descriptor format and ring size the device expects, see iwl_pcie_rxsq_restock
+//  and iwl_pcie_rxmq_restock
+//
+
+#include "hosttest.h"
+#include "rxring.h"
+
+static hostRxRing ring;
+
+static uint32_t le32At(const uint8_t* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t le64At(const uint8_t* p) {
+    return le32At(p) | (uint64_t)le32At(p + 4) << 32;
+}
+
+//7000/8000: 32 bit RBDs holding the address shifted down by 8, 256 entries
+static void testGen1() {
+    uint32_t misaligned = 0;
+
+    ring.init();
+    ring.rxq.write = RX_QUEUE_SIZE - 2;
+    ring.free(0, 4);
+    CHECK(restockRxQueue<TransGen1>(&ring.rxq, &misaligned) == 4, "gen1 restocked count");
+    CHECK(ring.rxq.write == 2 && ring.rxq.free_count == 0 && TAILQ_EMPTY(&ring.freeList), "gen1 write %u", ring.rxq.write);
+    for (uint32_t i = 0; i < 4; i++) {
+        uint32_t index = (RX_QUEUE_SIZE - 2 + i) & RX_QUEUE_MASK;
+        CHECK(le32At(&ring.bd[index * 4]) == (uint32_t)(ring.buffers[i].page_dma >> 8), "gen1 RBD %u is %08x", index,
+              le32At(&ring.bd[index * 4]));
+        CHECK(ring.rxq.queue[index] == &ring.buffers[i] && !ring.buffers[i].invalid, "gen1 queue entry %u", index);
+    }
+    //Nothing written past the 32 bit entries
+    CHECK(le32At(&ring.bd[2 * 4]) == 0 && le32At(&ring.bd[(RX_QUEUE_SIZE - 3) * 4]) == 0, "gen1 neighbouring RBDs");
+    CHECK(misaligned == 0, "gen1 misaligned %u", misaligned);
+
+    ring.buffers[4].page_dma |= 0x80;
+    ring.free(4, 1);
+    restockRxQueue<TransGen1>(&ring.rxq, &misaligned);
+    CHECK(misaligned == 1, "gen1 did not count an address below 256 byte alignment");
+    CHECK(TransGen1::rxWritePointerOffset(&ring.rxq) == FH_RSCSR_CHNL0_WPTR, "gen1 write pointer register");
+}
+
+//9000 and 22000: 64 bit RBDs with the virtual RB ID in the low 12 bits, 512 entries
+static void testGen1MQ() {
+    uint32_t misaligned = 0;
+
+    ring.init();
+    ring.rxq.write = MQ_RX_TABLE_SIZE - 1;
+    ring.free(7, 3);
+    CHECK(restockRxQueue<TransGen1MQ>(&ring.rxq, &misaligned) == 3, "MQ restocked count");
+    CHECK(ring.rxq.write == 2, "MQ write %u", ring.rxq.write);
+    for (uint32_t i = 0; i < 3; i++) {
+        uint32_t index = (MQ_RX_TABLE_SIZE - 1 + i) & MQ_RX_TABLE_MASK;
+        const struct iwl_rx_mem_buffer* rxmb = &ring.buffers[7 + i];
+        CHECK(le64At(&ring.bd[index * 8]) == (rxmb->page_dma | rxmb->vid), "MQ RBD %u is %016llx", index,
+              (unsigned long long)le64At(&ring.bd[index * 8]));
+    }
+    CHECK(le64At(&ring.bd[2 * 8]) == 0, "MQ RBD after the last one");
+
+    ring.buffers[10].page_dma |= 0x100;
+    ring.free(10, 1);
+    restockRxQueue<TransGen1MQ>(&ring.rxq, &misaligned);
+    CHECK(misaligned == 1, "MQ did not count an address overlapping the RB ID");
+    CHECK(TransGen2::rxQueueMask == MQ_RX_TABLE_MASK, "22000 ring size");
+}
+
+//22560: transfer descriptors with the RB ID and the address in separate fields
+static void testGen3() {
+    uint32_t misaligned = 0;
+
+    ring.init();
+    ring.rxq.id = 1;
+    ring.free(20, 2);
+    CHECK(restockRxQueue<TransGen3>(&ring.rxq, &misaligned) == 2, "gen3 restocked count");
+    for (uint32_t i = 0; i < 2; i++) {
+        const uint8_t* desc = &ring.bd[i * sizeof(struct iwl_rx_transfer_desc)];
+        CHECK((uint32_t)(desc[0] | desc[1] << 8) == 20 + i, "gen3 rbid %u", desc[0] | desc[1] << 8);
+        CHECK(le64At(desc + 8) == ring.buffers[20 + i].page_dma, "gen3 address");
+    }
+    ring.rxq.write_actual = 8;
+    CHECK(TransGen3::rxWritePointerOffset(&ring.rxq) == WPI_HBUS_TARG_WRPTR &&
+          TransGen3::rxWritePointerValue(&ring.rxq) == (8 | (FIRST_RX_QUEUE + 1) << 16), "gen3 write pointer");
+}
+
+int main() {
+    testGen1();
+    testGen1MQ();
+    testGen3();
+    return testResult("trans_test");
+}
@@ -0,0 +1,153 @@
+//
+//  txpower_bench.cpp
+//  net80211 host tests
+//
+//  3945 TXPOWER command cost per channel switch before and after the table in
+//  if_wpi_txpower.h. Before, wpi_set_txpower interpolated the EEPROM samples,
+//  compensated for temperature and looked up the gains for every rate on every
+//  switch; it is rebuilt here from the same helpers the table uses. After, the
+//  command copies a table row and the table is only updated when the
+//  temperature moves. A scan visits every channel, the recalibration rounds
+//  change the temperature before each scan. Both paths must build the same
+//  commands
+//
+
+#include "hosttest.h"
+#include "wpireg.h"
+#include "wpi/if_wpi_txpower.h"
+
+#define SCANS 20000
+
+static struct wpi_power_group groups[WPI_POWER_GROUPS_COUNT];
+static int8_t maxpwr[WPI_PWR_NCHANS];
+static u_int channels[WPI_PWR_MAXCHAN];
+static int nchannels;
+static struct wpi_txpower_table table;
+
+static int is5ghz(u_int chan) {
+    return chan > 14;
+}
+
+//EEPROM contents of a 3945ABG: one 2GHz group, four 5GHz groups ending at channels
+//34, 64, 140 and 165, samples from high to low power
+static void setUp() {
+    static const u_int enabled[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+                                     36, 40, 44, 48, 52, 56, 60, 64, 100, 104, 108, 112, 116, 120, 124, 128,
+                                     132, 136, 140, 149, 153, 157, 161, 165 };
+    static const uint8_t groupChannels[WPI_POWER_GROUPS_COUNT] = { 0, 34, 64, 140, 165 };
+
+    for (int grp = 0; grp < WPI_POWER_GROUPS_COUNT; grp++) {
+        for (int i = 0; i < WPI_SAMPLES_COUNT; i++) {
+            groups[grp].samples[i].index = (uint8_t)(4 + grp + i * 16);
+            groups[grp].samples[i].power = (int8_t)(34 - grp - i * 8);
+        }
+        groups[grp].chan = groupChannels[grp];
+        groups[grp].maxpwr = (int8_t)(36 - grp);
+        groups[grp].temp = (int16_t)(180 + grp * 10);
+    }
+
+    nchannels = 0;
+    wpi_txpower_table_init(&table);
+    for (u_int chan : enabled) {
+        maxpwr[chan] = is5ghz(chan) ? 14 : 16;
+        channels[nchannels++] = chan;
+        wpi_txpower_table_add(&table, groups, chan, wpi_power_group(groups, chan, is5ghz(chan)), maxpwr[chan],
+                              !is5ghz(chan));
+    }
+}
+
+//wpi_set_txpower as it was, everything computed per rate
+static void buildBefore(struct wpi_cmd_txpower* cmd, u_int chan, int temp) {
+    const struct wpi_power_group* group = &groups[wpi_power_group(groups, chan, is5ghz(chan))];
+    struct wpi_txpower_gain gain;
+
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->band = is5ghz(chan) ? WPI_BAND_5GHZ : WPI_BAND_2GHZ;
+    cmd->chan = htole16(chan);
+    for (int i = 0; i <= WPI_RIDX_MAX; i++) {
+        int idx = wpi_power_index(group, maxpwr[chan], !is5ghz(chan), i) - wpi_power_delta(group, temp);
+        wpi_power_gain(idx, is5ghz(chan), &gain);
+        cmd->rates[i].plcp = wpi_rates[i].plcp;
+        cmd->rates[i].rf_gain = gain.rf_gain;
+        cmd->rates[i].dsp_gain = gain.dsp_gain;
+    }
+}
+
+//wpi_set_txpower now
+static void buildAfter(struct wpi_cmd_txpower* cmd, u_int chan, int temp) {
+    int row = table.row[chan];
+
+    if (!table.valid || table.temp != temp) {
+        wpi_txpower_table_update(&table, groups, temp);
+    }
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->band = is5ghz(chan) ? WPI_BAND_5GHZ : WPI_BAND_2GHZ;
+    cmd->chan = htole16(chan);
+    for (int i = 0; i <= WPI_RIDX_MAX; i++) {
+        cmd->rates[i].plcp = wpi_rates[i].plcp;
+        cmd->rates[i].rf_gain = table.gain[row][i].rf_gain;
+        cmd->rates[i].dsp_gain = table.gain[row][i].dsp_gain;
+    }
+}
+
+static void testSameCommands() {
+    struct wpi_cmd_txpower before, after;
+
+    //Temperatures below and above calibration, far enough out to clamp the index
+    for (int temp = -400; temp <= 800; temp += 7) {
+        for (int i = 0; i < nchannels; i++) {
+            buildBefore(&before, channels[i], temp);
+            buildAfter(&after, channels[i], temp);
+            if (memcmp(&before, &after, sizeof(before))) {
+                CHECK(false, "channel %u at temperature %d differs", channels[i], temp);
+                return;
+            }
+        }
+    }
+}
+
+//Nanoseconds per channel switch, the temperature changes every recalibrate scans or never
+static double scan(void (*build)(struct wpi_cmd_txpower*, u_int, int), int recalibrate) {
+    struct wpi_cmd_txpower cmd;
+    uint32_t sink = 0;
+    int temp = 200;
+
+    table.valid = 0;
+    uint64_t start = monotonicNanoseconds();
+    for (int round = 0; round < SCANS; round++) {
+        if (recalibrate && round % recalibrate == 0) {
+            temp = 150 + round % 97;
+        }
+        for (int i = 0; i < nchannels; i++) {
+            build(&cmd, channels[i], temp);
+            sink += cmd.rates[i % (WPI_RIDX_MAX + 1)].rf_gain;
+            __asm__ volatile("" : : "r"(&cmd) : "memory");
+        }
+    }
+    uint64_t elapsed = monotonicNanoseconds() - start;
+    __asm__ volatile("" : : "r"(sink));
+    return (double)elapsed / ((double)SCANS * nchannels);
+}
+
+int main() {
+    setUp();
+    testSameCommands();
+
+    printf("txpower_bench: %d channels, %d scans\n", nchannels, SCANS);
+    static const int recalibrations[] = { 0, 8, 1 };
+    for (int recalibrate : recalibrations) {
+        //Warm up both paths
+        scan(buildBefore, recalibrate);
+        scan(buildAfter, recalibrate);
+        double before = scan(buildBefore, recalibrate);
+        double after = scan(buildAfter, recalibrate);
+        char label[32];
+        if (recalibrate) {
+            snprintf(label, sizeof(label), "new temp every %d", recalibrate);
+        } else {
+            snprintf(label, sizeof(label), "same temp");
+        }
+        printf("  %-20s before %7.2f ns/switch  after %7.2f ns/switch\n", label, before, after);
+    }
+    return testResult("txpower_bench");
+}
@@ -0,0 +1,27 @@
+//
+//  wpihost.h
+//  net80211 host tests
+//
+//  Headers for host programs that use the Intel driver structures. The kext
+//  gets the IOKit classes through Voodoo80211Device.h, here they are empty
+//  placeholders. Pointers to them are laid out like in the kext, anything
+//  holding one by value has a different size
+//
+
+#ifndef _HOST_WPIHOST_H_
+#define _HOST_WPIHOST_H_
+
+class IOWorkLoop;
+class IOCommandGate;
+class IOMemoryMap;
+class IOPCIDevice;
+class IO80211Interface;
+class IOEventSource {};
+class IOTimerEventSource : public IOEventSource {};
+class IntelWiFiDriver;
+
+#include "wpireg.h"
+#include "wpi/iwlwifi_headers/iwl-fh.h"
+#include "wpi/iwlwifi_headers/internals.h"
+
+#endif /* _HOST_WPIHOST_H_ */
@@ -0,0 +1,24 @@
+//
+//  wpireg.h
+//  net80211 host tests
+//
+//  The 802.11 and register definitions of the Intel drivers without the
+//  iwlwifi headers, which redefine errno values as IOReturn codes
+//
+
+#ifndef _HOST_WPIREG_H_
+#define _HOST_WPIREG_H_
+
+//sys/endian.h defines the BSD names over the ones glibc already made visible
+#undef htobe16
+#undef htobe32
+#undef htobe64
+#undef htole16
+#undef htole32
+#undef htole64
+
+#include "ieee80211.h"
+#include "ieee80211_crypto.h"
+#include "wpi/if_wpireg.h"
+
+#endif /* _HOST_WPIREG_H_ */
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+#
+#  fwcompress.py
+#  net80211
+#
+#  Created by Administrator on 19/10/2026.
+#
+# Generates net80211/wpi/Firmware.h from a 3945 firmware file (wpi-3945abg).
+#
+# The runtime and init sections are stored as LZ4 blocks and decompressed by
+# wpi_load_firmware straight into the firmware DMA buffer, so only the
+# compressed image stays resident in the kext. The boot code is at most 1KB
+# and is uploaded by the CPU, it is kept uncompressed.
+#
+# Usage: tools/fwcompress.py wpi-3945abg > net80211/wpi/Firmware.h
+
+import struct
+import sys
+
+WPI_FW_LZ4_MAGIC = 0x345a4c57   # "WLZ4"
+MIN_MATCH = 4
+LAST_LITERALS = 5               # the last 5 bytes are always literals
+MF_LIMIT = 12                   # no match may start in the last 12 bytes
+MAX_OFFSET = 65535
+HASH_LOG = 16
+MAX_CHAIN = 256
+
+
+def lz4_compress(src):
+    """Compress src into a single LZ4 block (hash chain match finder)."""
+    out = bytearray()
+    n = len(src)
+    head = [-1] * (1 << HASH_LOG)
+    chain = [-1] * n
+
+    def hash4(i):
+        v = struct.unpack_from('<I', src, i)[0]
+        return ((v * 2654435761) & 0xffffffff) >> (32 - HASH_LOG)
+
+    def insert(i):
+        h = hash4(i)
+        chain[i] = head[h]
+        head[h] = i
+
+    def emit(literals, offset, matchlen):
+        lit = len(literals)
+        token = (min(lit, 15) << 4) | (min(matchlen - MIN_MATCH, 15) if offset else 0)
+        out.append(token)
+        if lit >= 15:
+            rest = lit - 15
+            while rest >= 255:
+                out.append(255)
+                rest -= 255
+            out.append(rest)
+        out.extend(literals)
+        if not offset:
+            return
+        out.extend(struct.pack('<H', offset))
+        if matchlen - MIN_MATCH >= 15:
+            rest = matchlen - MIN_MATCH - 15
+            while rest >= 255:
+                out.append(255)
+                rest -= 255
+            out.append(rest)
+
+    anchor = 0
+    i = 0
+    match_limit = n - MF_LIMIT
+    while i < match_limit:
+        best_len, best_pos = 0, -1
+        cand = head[hash4(i)]
+        depth = 0
+        while cand >= 0 and i - cand <= MAX_OFFSET and depth < MAX_CHAIN:
+            if src[cand:cand + MIN_MATCH] == src[i:i + MIN_MATCH]:
+                length = MIN_MATCH
+                end = n - LAST_LITERALS
+                while i + length < end and src[cand + length] == src[i + length]:
+                    length += 1
+                if length > best_len:
+                    best_len, best_pos = length, cand
+            cand = chain[cand]
+            depth += 1
+        insert(i)
+        if best_len < MIN_MATCH:
+            i += 1
+            continue
+        emit(src[anchor:i], i - best_pos, best_len)
+        for j in range(i + 1, min(i + best_len, match_limit)):
+            insert(j)
+        i += best_len
+        anchor = i
+    emit(src[anchor:], 0, 0)
+    return bytes(out)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit('usage: %s wpi-3945abg' % sys.argv[0])
+    with open(sys.argv[1], 'rb') as f:
+        fw = f.read()
+
+    # struct wpi_firmware_hdr
+    hdr = fw[:24]
+    version, main_text, main_data, init_text, init_data, boot_text = \
+        struct.unpack('<6I', hdr)
+    sizes = (main_text, main_data, init_text, init_data)
+    if len(fw) != 24 + sum(sizes) + boot_text:
+        sys.exit('%s: bad firmware size' % sys.argv[1])
+
+    sections = []
+    offset = 24
+    for size in sizes:
+        sections.append(lz4_compress(fw[offset:offset + size]))
+        offset += size
+    boot = fw[offset:offset + boot_text]
+
+    # struct wpi_firmware_lz4_hdr
+    image = hdr + struct.pack('<5I', WPI_FW_LZ4_MAGIC,
+                              *[len(s) for s in sections])
+    image += b''.join(sections) + boot
+
+    out = sys.stdout
+    out.write('/*\n'
+              ' * Intel PRO/Wireless 3945ABG firmware, generated by '
+              'tools/fwcompress.py.\n'
+              ' * Runtime and init sections are LZ4 compressed, see '
+              'wpi_read_firmware().\n'
+              ' */\n')
+    out.write('#define Intel3945FirmwareImage_rawlen\t%d\n\n' % len(fw))
+    out.write('const unsigned char Intel3945FirmwareImage[] = {\n')
+    for i in range(0, len(image), 12):
+        row = ', '.join('0x%02x' % b for b in image[i:i + 12])
+        out.write('  %s%s\n' % (row, ',' if i + 12 < len(image) else ''))
+    out.write('};\n')
+    out.write('const unsigned int Intel3945FirmwareImage_len = %d;\n'
+              % len(image))
+    sys.stderr.write('%d -> %d bytes\n' % (len(fw), len(image)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+#
+#  fwdump.py
+#  net80211
+#
+#  Created by Administrator on 19/10/2026.
+#
+# Decodes the firmware error dumps captured by the Intel driver
+# (captureFirmwareError). A dump is an iwlwifi dump file, struct
+# iwl_fw_error_dump_file: a barker and the file length followed by sections of
+# type, length and data (struct iwl_fw_error_dump_data).
+#
+# The input is what debug.voodoo80211.fw_dump returns (struct
+# voodoo80211_fw_dump_header followed by the dump) or a bare dump file. On
+# macOS the dump can be read straight from the sysctl (as root, the index is
+# written with the read), --index picks it, 0 is the newest.
+#
+# Usage: tools/fwdump.py [--index N] [--hex] [file | -]
+
+import argparse
+import ctypes
+import ctypes.util
+import os
+import struct
+import sys
+
+IWL_FW_ERROR_DUMP_BARKER = 0x14789632
+VOODOO80211_SYSCTL_VERSION = 1
+VOODOO80211_FW_DUMP_MAX = 32 * 1024
+FW_DUMP_HEADER = struct.Struct('<4I')    # version, index, sequence, len
+
+SECTION_TYPES = {
+    1: 'CSR', 2: 'RXF', 3: 'TXCMD', 4: 'DEV_FW_INFO', 5: 'FW_MONITOR',
+    6: 'PRPH', 7: 'TXF', 8: 'FH_REGS', 9: 'MEM', 10: 'ERROR_INFO', 11: 'RB',
+    12: 'PAGING', 13: 'RADIO_REG', 14: 'INTERNAL_TXF', 15: 'EXTERNAL',
+    16: 'MEM_CFG', 17: 'D3_DEBUG_DATA',
+}
+
+TRIGGERS = [
+    'INVALID', 'USER', 'FW_ASSERT', 'MISSED_BEACONS', 'CHANNEL_SWITCH',
+    'FW_NOTIF', 'MLME', 'STATS', 'RSSI', 'TXQ_TIMERS', 'TIME_EVENT', 'BA',
+    'TX_LATENCY', 'TDLS', 'TX_STATUS', 'ALIVE_TIMEOUT', 'DRIVER',
+]
+
+MEM_TYPES = {0: 'SRAM', 1: 'SMEM', 10: 'NAMED_MEM'}
+
+# CSRs worth naming in a dump, iwl-csr.h
+CSR_NAMES = {
+    0x000: 'HW_IF_CONFIG_REG', 0x008: 'INT', 0x00c: 'INT_MASK',
+    0x010: 'FH_INT_STATUS', 0x018: 'GPIO_IN', 0x020: 'RESET',
+    0x024: 'GP_CNTRL', 0x028: 'HW_REV', 0x02c: 'EEPROM_REG',
+    0x030: 'EEPROM_GP', 0x034: 'OTP_GP_REG', 0x03c: 'GIO_REG',
+    0x054: 'GP_UCODE_REG', 0x058: 'GP_DRIVER_REG', 0x05c: 'UCODE_DRV_GP1',
+    0x060: 'UCODE_DRV_GP2', 0x088: 'LED_REG', 0x094: 'DRAM_INT_TBL_REG',
+    0x0a8: 'MAC_SHADOW_REG_CTRL', 0x100: 'GIO_CHICKEN_BITS',
+    0x1e8: 'DBG_HPET_MEM_REG', 0x240: 'DBG_LINK_PWR_MGMT_REG',
+}
+
+# Leading words of the firmware error log, struct iwl_error_event_table
+ERROR_LOG_FIELDS = [
+    'valid', 'error_id', 'trm_hw_status0', 'trm_hw_status1', 'blink2',
+    'ilink1', 'ilink2', 'data1', 'data2', 'data3', 'bcon_time', 'tsf_low',
+    'tsf_hi', 'gp1', 'gp2', 'fw_rev_type', 'major', 'minor', 'hw_ver',
+    'brd_ver', 'log_pc', 'frame_ptr', 'stack_ptr', 'hcmd', 'isr0', 'isr1',
+    'isr2', 'isr3', 'isr4', 'last_cmd_id', 'wait_event', 'l2p_control',
+    'l2p_duration', 'l2p_mhvalid', 'l2p_addr_match', 'lmpm_pmg_sel',
+    'u_timestamp', 'flow_handler',
+]
+
+
+class DumpError(Exception):
+    pass
+
+
+def cstring(data):
+    return data.split(b'\0', 1)[0].decode('ascii', 'replace')
+
+
+def words(data):
+    return struct.unpack_from('<%dI' % (len(data) // 4), data)
+
+
+def hexdump(data, base=0, out=sys.stdout):
+    for offset in range(0, len(data), 16):
+        line = data[offset:offset + 16]
+        out.write('    %08x  %-47s\n' % (base + offset, ' '.join('%02x' % b for b in line)))
+
+
+def read_sysctl(index):
+    """Reads one dump from debug.voodoo80211.fw_dump (macOS only)."""
+    libc = ctypes.CDLL(ctypes.util.find_library('c'), use_errno=True)
+    size = ctypes.c_size_t(FW_DUMP_HEADER.size + VOODOO80211_FW_DUMP_MAX)
+    buffer = ctypes.create_string_buffer(size.value)
+    selector = ctypes.c_uint32(index)
+    if libc.sysctlbyname(b'debug.voodoo80211.fw_dump', buffer, ctypes.byref(size),
+                         ctypes.byref(selector), ctypes.c_size_t(4)) != 0:
+        error = ctypes.get_errno()
+        raise DumpError('debug.voodoo80211.fw_dump: %s' % os.strerror(error))
+    return buffer.raw[:size.value]
+
+
+def split_header(data):
+    """Strips the voodoo80211_fw_dump_header if there is one."""
+    if len(data) >= 4 and struct.unpack_from('<I', data)[0] == IWL_FW_ERROR_DUMP_BARKER:
+        return None, data
+    if len(data) < FW_DUMP_HEADER.size:
+        raise DumpError('%d bytes, too short for a dump' % len(data))
+    version, index, sequence, length = FW_DUMP_HEADER.unpack_from(data)
+    if version != VOODOO80211_SYSCTL_VERSION:
+        raise DumpError('unknown sysctl version %d' % version)
+    body = data[FW_DUMP_HEADER.size:]
+    if length > len(body):
+        raise DumpError('header says %d bytes, only %d follow' % (length, len(body)))
+    return (index, sequence), body[:length]
+
+
+def sections(dump):
+    """Yields (offset, type, data) for each section, checking every length."""
+    if len(dump) < 8:
+        raise DumpError('%d bytes, too short for iwl_fw_error_dump_file' % len(dump))
+    barker, file_len = struct.unpack_from('<II', dump)
+    if barker != IWL_FW_ERROR_DUMP_BARKER:
+        raise DumpError('bad barker 0x%08x' % barker)
+    if file_len > len(dump):
+        raise DumpError('file_len %d past the %d bytes read' % (file_len, len(dump)))
+    offset = 8
+    while offset < file_len:
+        if file_len - offset < 8:
+            raise DumpError('%d stray bytes at 0x%x' % (file_len - offset, offset))
+        kind, length = struct.unpack_from('<II', dump, offset)
+        if length > file_len - offset - 8:
+            raise DumpError('section %s at 0x%x: %d bytes past the end' %
+                            (SECTION_TYPES.get(kind, kind), offset, length - (file_len - offset - 8)))
+        yield offset, kind, dump[offset + 8:offset + 8 + length]
+        offset += 8 + length
+
+
+def print_registers(data, base, names, out):
+    for i, value in enumerate(words(data)):
+        address = base + 4 * i
+        name = names.get(address)
+        if name:
+            out.write('    0x%03x %-24s 0x%08x\n' % (address, name, value))
+
+
+def print_section(kind, data, show_hex, out):
+    if kind == 4 and len(data) >= 144:
+        hw_type, hw_step = struct.unpack_from('<II', data)
+        out.write('    hw type 0x%x step %d\n' % (hw_type, hw_step))
+        out.write('    firmware %s\n' % cstring(data[8:72]))
+        out.write('    device   %s\n' % cstring(data[72:136]))
+        out.write('    bus      %s\n' % cstring(data[136:144]))
+    elif kind == 10 and len(data) >= 4:
+        trigger = struct.unpack_from('<I', data)[0]
+        out.write('    trigger %s\n' % (TRIGGERS[trigger] if trigger < len(TRIGGERS) else trigger))
+    elif kind == 1:
+        print_registers(data, 0, CSR_NAMES, out)
+    elif kind == 9 and len(data) >= 8:
+        mem_type, address = struct.unpack_from('<II', data)
+        out.write('    %s at 0x%08x, %d bytes\n' %
+                  (MEM_TYPES.get(mem_type, mem_type), address, len(data) - 8))
+        for name, value in zip(ERROR_LOG_FIELDS, words(data[8:])):
+            out.write('    %-16s 0x%08x\n' % (name, value))
+        if show_hex:
+            hexdump(data[8:], address, out)
+        return
+    if show_hex:
+        hexdump(data, 0, out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode an iwlwifi firmware error dump')
+    parser.add_argument('file', nargs='?', help='dump file, - for stdin, read the sysctl if omitted')
+    parser.add_argument('--index', type=int, default=0, help='dump to read from the sysctl, 0 is the newest')
+    parser.add_argument('--hex', action='store_true', help='hex dump every section')
+    args = parser.parse_args()
+
+    try:
+        if args.file == '-':
+            data = sys.stdin.buffer.read()
+        elif args.file:
+            with open(args.file, 'rb') as f:
+                data = f.read()
+        else:
+            data = read_sysctl(args.index)
+
+        header, dump = split_header(data)
+        if header:
+            sys.stdout.write('dump %d, capture #%d, %d bytes\n' % (header[0], header[1], len(dump)))
+        for offset, kind, section in sections(dump):
+            sys.stdout.write('0x%05x %-14s %6d bytes\n' % (offset, SECTION_TYPES.get(kind, 'type %d' % kind),
+                                                            len(section)))
+            print_section(kind, section, args.hex, sys.stdout)
+    except (DumpError, OSError) as error:
+        sys.stderr.write('fwdump: %s\n' % error)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())